@@ -1,28 +1,63 @@
 #include "auto_complete.h"
 
 #include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
 
-bool auto_complete_insert(AutoComplete_t* auto_complete, const char* option, const char* description)
+#define BLOCK_SIZE (16 * 1024)
+
+static const char* copy_string(AutoComplete_t* auto_complete, const char* string)
 {
-     CompleteNode_t* new_node = calloc(1, sizeof(*new_node));
-     if(!new_node){
-          ce_message("failed to allocate auto complete option");
-          return false;
+     size_t size = strlen(string) + 1;
+     CompleteBlock_t* block = auto_complete->blocks;
+
+     if(!block || block->size - block->used < size){
+          size_t block_size = (size > BLOCK_SIZE) ? size : BLOCK_SIZE;
+          block = malloc(sizeof(*block) + block_size);
+          if(!block) return NULL;
+          block->next = auto_complete->blocks;
+          block->used = 0;
+          block->size = block_size;
+          auto_complete->blocks = block;
      }
 
-     new_node->option = strdup(option);
-     if(description) new_node->description = strdup(description);
+     char* copy = block->data + block->used;
+     memcpy(copy, string, size);
+     block->used += size;
+     return copy;
+}
+
+static void stale_matches(AutoComplete_t* auto_complete)
+{
+     free(auto_complete->narrowed);
+     auto_complete->narrowed = NULL;
+}
 
-     if(auto_complete->tail){
-          auto_complete->tail->next = new_node;
-          new_node->prev = auto_complete->tail;
+bool auto_complete_insert(AutoComplete_t* auto_complete, const char* option, const char* description)
+{
+     if(auto_complete->option_count == auto_complete->option_capacity){
+          int64_t new_capacity = auto_complete->option_capacity ? auto_complete->option_capacity * 2 : 64;
+          CompleteOption_t* new_options = realloc(auto_complete->options, new_capacity * sizeof(*new_options));
+          if(!new_options){
+               ce_message("failed to allocate auto complete option");
+               return false;
+          }
+          auto_complete->options = new_options;
+          auto_complete->option_capacity = new_capacity;
      }
 
-     auto_complete->tail = new_node;
-     if(!auto_complete->head){
-          auto_complete->head = new_node;
+     CompleteOption_t* new_option = auto_complete->options + auto_complete->option_count;
+     new_option->option = copy_string(auto_complete, option);
+     new_option->description = description ? copy_string(auto_complete, description) : NULL;
+     if(!new_option->option || (description && !new_option->description)){
+          ce_message("failed to allocate auto complete option");
+          return false;
      }
+     new_option->option_length = strlen(option);
+     new_option->mask = fuzzy_mask(option, new_option->option_length);
 
+     auto_complete->option_count++;
+     stale_matches(auto_complete);
      return true;
 }
 
@@ -31,7 +66,8 @@ void auto_complete_start(AutoComplete_t* auto_complete, AutoCompleteType_t type,
      assert(start.x >= 0);
      auto_complete->start = start;
      auto_complete->type = type;
-     auto_complete->current = auto_complete->head;
+     auto_complete->current = auto_complete->option_count ? 0 : -1;
+     auto_complete->window_top = 0;
 }
 
 void auto_complete_end(AutoComplete_t* auto_complete)
@@ -44,6 +80,259 @@ bool auto_completing(AutoComplete_t* auto_complete)
     return auto_complete->start.x >= 0;
 }
 
+const char* auto_complete_current(const AutoComplete_t* auto_complete)
+{
+     if(auto_complete->current < 0 || auto_complete->current >= auto_complete->option_count) return NULL;
+     return auto_complete->options[auto_complete->current].option;
+}
+
+static int compare_options(const void* a, const void* b)
+{
+     const CompleteOption_t* const* option_a = a;
+     const CompleteOption_t* const* option_b = b;
+     return strcmp((*option_a)->option, (*option_b)->option);
+}
+
+static bool sort_options(AutoComplete_t* auto_complete)
+{
+     if(auto_complete->sorted_count == auto_complete->option_count) return true;
+
+     const CompleteOption_t** new_sorted = realloc(auto_complete->sorted,
+                                                   auto_complete->option_count * sizeof(*new_sorted));
+     if(!new_sorted) return false;
+     auto_complete->sorted = new_sorted;
+
+     for(int64_t i = 0; i < auto_complete->option_count; ++i){
+          auto_complete->sorted[i] = auto_complete->options + i;
+     }
+
+     qsort(auto_complete->sorted, auto_complete->option_count, sizeof(*auto_complete->sorted), compare_options);
+     auto_complete->sorted_count = auto_complete->option_count;
+     return true;
+}
+
+// first sorted option that starts with the prefix, or with upper, the first one after those
+static int64_t sorted_bound(const AutoComplete_t* auto_complete, const char* prefix, int64_t prefix_len, bool upper)
+{
+     int64_t low = 0;
+     int64_t high = auto_complete->sorted_count;
+
+     while(low < high){
+          int64_t middle = low + (high - low) / 2;
+          int compare = strncmp(auto_complete->sorted[middle]->option, prefix, prefix_len);
+          if(compare < 0 || (upper && compare == 0)){
+               low = middle + 1;
+          }else{
+               high = middle;
+          }
+     }
+
+     return low;
+}
+
+// how many matches come before the option at index
+static int64_t match_bound(const AutoComplete_t* auto_complete, int64_t index)
+{
+     int64_t low = 0;
+     int64_t high = auto_complete->match_count;
+
+     while(low < high){
+          int64_t middle = low + (high - low) / 2;
+          if(auto_complete->matches[middle] < index){
+               low = middle + 1;
+          }else{
+               high = middle;
+          }
+     }
+
+     return low;
+}
+
+static int compare_indices(const void* a, const void* b)
+{
+     int64_t index_a = *(const int64_t*)(a);
+     int64_t index_b = *(const int64_t*)(b);
+     return (index_a > index_b) - (index_a < index_b);
+}
+
+static bool option_matches(const AutoComplete_t* auto_complete, const CompleteOption_t* option, const char* match,
+                           int64_t match_len)
+{
+     if(auto_complete->type == ACT_EXACT){
+          return option->option_length >= match_len && strncmp(option->option, match, match_len) == 0;
+     }
+
+     return strstr(option->option, match) != NULL;
+}
+
+typedef struct{
+     const AutoComplete_t* auto_complete;
+     const FuzzyPattern_t* pattern;
+     const int64_t* candidates; // NULL for every option
+     int64_t first;
+     int64_t last;
+     int64_t ranked_count; // written from ranked + first
+}FuzzyWork_t;
+
+static void* fuzzy_worker(void* data)
+{
+     FuzzyWork_t* work = data;
+     const AutoComplete_t* auto_complete = work->auto_complete;
+     FuzzyMatch_t* ranked = auto_complete->ranked + work->first;
+     uint64_t pattern_mask = work->pattern->mask;
+
+     for(int64_t i = work->first; i < work->last; ++i){
+          int64_t index = work->candidates ? work->candidates[i] : i;
+          const CompleteOption_t* option = auto_complete->options + index;
+          if(pattern_mask & ~option->mask) continue;
+
+          int32_t score = fuzzy_score(work->pattern, option->option, option->option_length);
+          if(score == FUZZY_NO_MATCH) continue;
+
+          ranked[work->ranked_count++] = (FuzzyMatch_t){index, score, option->option_length};
+     }
+
+     return NULL;
+}
+
+// candidates are either the previous matches, or every option
+static int64_t narrow_fuzzy(AutoComplete_t* auto_complete, const char* match, bool candidates_are_matches)
+{
+     FuzzyPattern_t pattern;
+     fuzzy_pattern_init(&pattern, match);
+
+     const int64_t* candidates = candidates_are_matches ? auto_complete->matches : NULL;
+     int64_t candidate_count = candidates_are_matches ? auto_complete->match_count : auto_complete->option_count;
+
+     if(auto_complete->ranked_capacity < candidate_count){
+          FuzzyMatch_t* new_ranked = realloc(auto_complete->ranked, candidate_count * sizeof(*new_ranked));
+          if(!new_ranked) return -1;
+          auto_complete->ranked = new_ranked;
+          auto_complete->ranked_capacity = candidate_count;
+     }
+
+     int64_t thread_count = 1;
+     if(candidate_count >= AUTO_COMPLETE_FUZZY_THREAD_MIN){
+          thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+          if(thread_count <= 0) thread_count = 1;
+          if(thread_count > AUTO_COMPLETE_FUZZY_MAX_THREADS) thread_count = AUTO_COMPLETE_FUZZY_MAX_THREADS;
+     }
+
+     // each thread ranks its own slice of the candidates into the same slice of ranked
+     FuzzyWork_t work[AUTO_COMPLETE_FUZZY_MAX_THREADS];
+     pthread_t threads[AUTO_COMPLETE_FUZZY_MAX_THREADS];
+     bool started[AUTO_COMPLETE_FUZZY_MAX_THREADS] = {};
+     int64_t slice = (candidate_count + thread_count - 1) / thread_count;
+
+     for(int64_t i = 0; i < thread_count; ++i){
+          int64_t first = i * slice;
+          int64_t last = first + slice;
+          if(last > candidate_count) last = candidate_count;
+          if(first > last) first = last;
+          work[i] = (FuzzyWork_t){auto_complete, &pattern, candidates, first, last, 0};
+          if(i > 0) started[i] = (pthread_create(threads + i, NULL, fuzzy_worker, work + i) == 0);
+     }
+
+     // this thread pitches in too, and picks up any slice we failed to start a thread for
+     fuzzy_worker(work);
+     for(int64_t i = 1; i < thread_count; ++i){
+          if(started[i]){
+               pthread_join(threads[i], NULL);
+          }else{
+               fuzzy_worker(work + i);
+          }
+     }
+
+     int64_t ranked_count = 0;
+     for(int64_t i = 0; i < thread_count; ++i){
+          if(work[i].first != ranked_count){
+               memmove(auto_complete->ranked + ranked_count, auto_complete->ranked + work[i].first,
+                       work[i].ranked_count * sizeof(*auto_complete->ranked));
+          }
+          ranked_count += work[i].ranked_count;
+     }
+
+     fuzzy_sort_best(auto_complete->ranked, ranked_count, AUTO_COMPLETE_FUZZY_SORTED);
+
+     for(int64_t i = 0; i < ranked_count; ++i){
+          auto_complete->matches[i] = auto_complete->ranked[i].index;
+     }
+     auto_complete->match_count = ranked_count;
+     return ranked_count;
+}
+
+int64_t auto_complete_narrow(AutoComplete_t* auto_complete, const char* match)
+{
+     if(!match) match = "";
+     int64_t match_len = strlen(match);
+
+     // NOTE: anything matching more text also matched less of it, so when the text only grew, filter what we have
+     if(auto_complete->narrowed && auto_complete->narrowed_type == auto_complete->type){
+          int64_t narrowed_len = strlen(auto_complete->narrowed);
+          if(narrowed_len <= match_len && strncmp(match, auto_complete->narrowed, narrowed_len) == 0){
+               if(narrowed_len == match_len) return auto_complete->match_count;
+
+               if(auto_complete->type == ACT_FUZZY){
+                    if(narrow_fuzzy(auto_complete, match, true) >= 0) goto remember;
+                    stale_matches(auto_complete);
+                    auto_complete->match_count = 0;
+                    return 0;
+               }
+
+               int64_t kept = 0;
+               for(int64_t i = 0; i < auto_complete->match_count; ++i){
+                    const CompleteOption_t* option = auto_complete->options + auto_complete->matches[i];
+                    if(option_matches(auto_complete, option, match, match_len)){
+                         auto_complete->matches[kept++] = auto_complete->matches[i];
+                    }
+               }
+
+               auto_complete->match_count = kept;
+               goto remember;
+          }
+     }
+
+     if(auto_complete->match_capacity < auto_complete->option_count){
+          int64_t* new_matches = realloc(auto_complete->matches, auto_complete->option_count * sizeof(*new_matches));
+          if(!new_matches){
+               stale_matches(auto_complete);
+               auto_complete->match_count = 0;
+               return 0;
+          }
+          auto_complete->matches = new_matches;
+          auto_complete->match_capacity = auto_complete->option_count;
+     }
+
+     auto_complete->match_count = 0;
+
+     if(match_len && auto_complete->type == ACT_FUZZY){
+          if(narrow_fuzzy(auto_complete, match, false) < 0){
+               stale_matches(auto_complete);
+               auto_complete->match_count = 0;
+               return 0;
+          }
+     }else if(match_len && auto_complete->type == ACT_EXACT && sort_options(auto_complete)){
+          int64_t first = sorted_bound(auto_complete, match, match_len, false);
+          int64_t last = sorted_bound(auto_complete, match, match_len, true);
+          for(int64_t i = first; i < last; ++i){
+               auto_complete->matches[auto_complete->match_count++] = auto_complete->sorted[i] - auto_complete->options;
+          }
+          qsort(auto_complete->matches, auto_complete->match_count, sizeof(*auto_complete->matches), compare_indices);
+     }else{
+          for(int64_t i = 0; i < auto_complete->option_count; ++i){
+               if(option_matches(auto_complete, auto_complete->options + i, match, match_len)){
+                    auto_complete->matches[auto_complete->match_count++] = i;
+               }
+          }
+     }
+
+remember:
+     free(auto_complete->narrowed);
+     auto_complete->narrowed = strdup(match); // if this fails we just start over next time
+     auto_complete->narrowed_type = auto_complete->type;
+     return auto_complete->match_count;
+}
+
 static int64_t string_common_beginning(const char* a, const char* b)
 {
      size_t common = 0;
@@ -66,31 +355,29 @@ static int64_t string_common_beginning(const char* a, const char* b)
 char* auto_complete_get_completion(AutoComplete_t* auto_complete, int64_t x)
 {
      int64_t offset = x - auto_complete->start.x;
-     if(offset < 0) return NULL;
+     if(offset < 0 || !auto_complete_current(auto_complete)) return NULL;
 
-     CompleteNode_t* itr = auto_complete->current;
-     int64_t complete_len = strlen(auto_complete->current->option + offset);
-     int64_t min_complete_len = complete_len;
+     const CompleteOption_t* current = auto_complete->options + auto_complete->current;
+     if(offset >= current->option_length) return NULL;
 
-     do{
-          itr = itr->next;
-          if(!itr) itr = auto_complete->head;
-          int64_t option_len = strlen(itr->option);
+     int64_t complete_len = current->option_length - offset;
 
-          if(option_len <= offset) continue;
-          if(auto_complete->type == ACT_EXACT){
-               if(strncmp(auto_complete->current->option, itr->option, offset) != 0) continue;
+     if(auto_complete->type == ACT_EXACT && sort_options(auto_complete)){
+          // NOTE: sorted, the options sharing what was typed sit together, and what they all have in common after
+          //       that is what the first and last of them have in common
+          int64_t first = sorted_bound(auto_complete, current->option, offset, false);
+          int64_t last = sorted_bound(auto_complete, current->option, offset, true);
+          while(first < last && auto_complete->sorted[first]->option_length <= offset) first++;
 
-               int64_t check_complete_len = string_common_beginning(auto_complete->current->option + offset, itr->option + offset);
-               if(check_complete_len < min_complete_len) min_complete_len = check_complete_len;
+          if(first < last){
+               int64_t common = string_common_beginning(auto_complete->sorted[first]->option + offset,
+                                                        auto_complete->sorted[last - 1]->option + offset);
+               if(common) complete_len = common;
           }
-     }while(itr != auto_complete->current);
-
-     if(min_complete_len) complete_len = min_complete_len;
-     if(complete_len == 0) return NULL;
+     }
 
      char* completion = malloc(complete_len + 1);
-     strncpy(completion, auto_complete->current->option + offset, complete_len);
+     strncpy(completion, current->option + offset, complete_len);
      completion[complete_len] = 0;
 
      return completion;
@@ -100,64 +387,108 @@ void auto_complete_free(AutoComplete_t* auto_complete)
 {
      auto_complete_end(auto_complete);
 
-     CompleteNode_t* itr = auto_complete->head;
+     CompleteBlock_t* itr = auto_complete->blocks;
      while(itr){
-          CompleteNode_t* tmp = itr;
+          CompleteBlock_t* tmp = itr;
           itr = itr->next;
-          free(tmp->option);
-          free(tmp->description);
           free(tmp);
      }
 
-     auto_complete->head = NULL;
-     auto_complete->tail = NULL;
-     auto_complete->current = NULL;
+     free(auto_complete->options);
+     free(auto_complete->sorted);
+     free(auto_complete->matches);
+     free(auto_complete->ranked);
+     free(auto_complete->source);
+     stale_matches(auto_complete);
+
+     auto_complete->blocks = NULL;
+     auto_complete->options = NULL;
+     auto_complete->option_count = 0;
+     auto_complete->option_capacity = 0;
+     auto_complete->sorted = NULL;
+     auto_complete->sorted_count = 0;
+     auto_complete->matches = NULL;
+     auto_complete->match_count = 0;
+     auto_complete->match_capacity = 0;
+     auto_complete->ranked = NULL;
+     auto_complete->ranked_capacity = 0;
+     auto_complete->source = NULL;
+     auto_complete->source_version = 0;
+     auto_complete->current = -1;
 }
 
-bool auto_complete_next(AutoComplete_t* auto_complete, const char* match)
+int64_t auto_complete_current_match(const AutoComplete_t* auto_complete)
 {
-     int64_t match_len = 0;
-     if(match){
-          match_len = strlen(match);
-     }else{
-          match = "";
+     if(auto_complete->type == ACT_FUZZY){
+          for(int64_t i = 0; i < auto_complete->match_count; ++i){
+               if(auto_complete->matches[i] == auto_complete->current) return i;
+          }
+          return -1;
      }
-     CompleteNode_t* initial_node = auto_complete->current;
 
-     do{
-          auto_complete->current = auto_complete->current->next;
-          if(!auto_complete->current) auto_complete->current = auto_complete->head;
-          if(auto_complete->type == ACT_EXACT){
-               if(strncmp(auto_complete->current->option, match, match_len) == 0) return true;
-          }else if(auto_complete->type == ACT_OCCURANCE){
-               if(strstr(auto_complete->current->option, match)) return true;
-          }
-     }while(auto_complete->current != initial_node);
+     int64_t position = match_bound(auto_complete, auto_complete->current);
+     if(position < auto_complete->match_count && auto_complete->matches[position] == auto_complete->current){
+          return position;
+     }
 
-     auto_complete_end(auto_complete);
-     return false;
+     return -1;
+}
+
+// NOTE: fuzzy matches are in the order they rank, so we step through them by position instead
+static int64_t next_match(const AutoComplete_t* auto_complete)
+{
+     if(auto_complete->type == ACT_FUZZY) return auto_complete_current_match(auto_complete) + 1;
+     return match_bound(auto_complete, auto_complete->current + 1);
+}
+
+static int64_t prev_match(const AutoComplete_t* auto_complete)
+{
+     if(auto_complete->type == ACT_FUZZY){
+          int64_t position = auto_complete_current_match(auto_complete);
+          return (position < 0) ? auto_complete->match_count - 1 : position - 1;
+     }
+     return match_bound(auto_complete, auto_complete->current) - 1;
+}
+
+bool auto_complete_next(AutoComplete_t* auto_complete, const char* match)
+{
+     if(!auto_complete_narrow(auto_complete, match)){
+          auto_complete_end(auto_complete);
+          return false;
+     }
+
+     int64_t position = next_match(auto_complete);
+     if(position == auto_complete->match_count) position = 0;
+     auto_complete->current = auto_complete->matches[position];
+     return true;
 }
 
 bool auto_complete_prev(AutoComplete_t* auto_complete, const char* match)
 {
-     int64_t match_len = 0;
-     if(match){
-          match_len = strlen(match);
-     }else{
-          match = "";
+     if(!auto_complete_narrow(auto_complete, match)){
+          auto_complete_end(auto_complete);
+          return false;
      }
-     CompleteNode_t* initial_node = auto_complete->current;
 
-     do{
-          auto_complete->current = auto_complete->current->prev;
-          if(!auto_complete->current) auto_complete->current = auto_complete->tail;
-          if(auto_complete->type == ACT_EXACT){
-               if(strncmp(auto_complete->current->option, match, match_len) == 0) return true;
-          }else if(auto_complete->type == ACT_OCCURANCE){
-               if(strstr(auto_complete->current->option, match)) return true;
-          }
-     }while(auto_complete->current != initial_node);
+     int64_t position = prev_match(auto_complete);
+     if(position < 0) position = auto_complete->match_count - 1;
+     auto_complete->current = auto_complete->matches[position];
+     return true;
+}
 
-     auto_complete_end(auto_complete);
-     return false;
+bool auto_complete_select(AutoComplete_t* auto_complete, const char* match)
+{
+     if(!auto_complete_narrow(auto_complete, match)){
+          auto_complete_end(auto_complete);
+          return false;
+     }
+
+     if(auto_complete->type == ACT_FUZZY){
+          auto_complete->current = auto_complete->matches[0];
+          auto_complete->window_top = 0;
+          return true;
+     }
+
+     if(auto_complete_current_match(auto_complete) >= 0) return true;
+     return auto_complete_next(auto_complete, match);
 }
@@ -1,31 +1,72 @@
 #pragma once
 
 #include "ce.h"
+#include "fuzzy.h"
+
+#define AUTO_COMPLETE_FUZZY_SORTED 256 // best fuzzy matches put in order, the rest are only ever scrolled to
+#define AUTO_COMPLETE_FUZZY_THREAD_MIN 16384 // candidates before ranking them is split across threads
+#define AUTO_COMPLETE_FUZZY_MAX_THREADS 8
 
 typedef enum{
      ACT_EXACT,
      ACT_OCCURANCE,
+     ACT_FUZZY, // matches are ordered best first, rather than in the order they were inserted
 }AutoCompleteType_t;
 
-typedef struct CompleteNode_t{
-     char* option;
-     char* description;
-     struct CompleteNode_t* next;
-     struct CompleteNode_t* prev;
-}CompleteNode_t;
+typedef struct{
+     const char* option;
+     const char* description; // NULL if there isn't one
+     int64_t option_length;
+     uint64_t mask; // see fuzzy_mask()
+}CompleteOption_t;
+
+// options and descriptions are copied into blocks that never move, so we can point at them while the options grow
+typedef struct CompleteBlock_t{
+     struct CompleteBlock_t* next;
+     size_t used;
+     size_t size;
+     char data[];
+}CompleteBlock_t;
 
 typedef struct{
-     CompleteNode_t* head;
-     CompleteNode_t* tail;
-     CompleteNode_t* current;
+     CompleteOption_t* options; // in the order they were inserted, which is the order they are shown in
+     int64_t option_count;
+     int64_t option_capacity;
+     CompleteBlock_t* blocks;
+
+     const CompleteOption_t** sorted; // by option, to binary search for the options starting with what was typed
+     int64_t sorted_count; // rebuilt when it falls behind option_count
+
+     // options matching the last text we narrowed to, by ascending index unless fuzzy. Typing more only filters these
+     int64_t* matches;
+     int64_t match_count;
+     int64_t match_capacity;
+     FuzzyMatch_t* ranked;
+     int64_t ranked_capacity;
+     char* narrowed; // NULL when the matches are stale
+     AutoCompleteType_t narrowed_type;
+
+     int64_t current; // index of the selected option, -1 if there is none
+     int64_t window_top; // first match put in the completion buffer
      Point_t start;
      AutoCompleteType_t type;
+
+     // what the options were generated from, so a generator can tell it has them already. NULL if nobody said
+     char* source;
+     uint64_t source_version;
 }AutoComplete_t;
 
 bool auto_complete_insert(AutoComplete_t* auto_complete, const char* option, const char* description);
 void auto_complete_start(AutoComplete_t* auto_complete, AutoCompleteType_t type, Point_t start);
 void auto_complete_end(AutoComplete_t* auto_complete);
 bool auto_completing(AutoComplete_t* auto_complete);
+const char* auto_complete_current(const AutoComplete_t* auto_complete);
+int64_t auto_complete_narrow(AutoComplete_t* auto_complete, const char* match); // returns how many options match
+int64_t auto_complete_current_match(const AutoComplete_t* auto_complete); // position in the matches, -1 if not in them
+
+// narrows and selects the best match if fuzzy, otherwise keeps the selected option if it still matches or moves to the
+// next one that does. Ends completing if nothing matches
+bool auto_complete_select(AutoComplete_t* auto_complete, const char* match);
 char* auto_complete_get_completion(AutoComplete_t* auto_complete, int64_t x);
 void auto_complete_free(AutoComplete_t* auto_complete);
 bool auto_complete_next(AutoComplete_t* auto_complete, const char* match);
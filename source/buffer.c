@@ -261,6 +261,7 @@ void buffer_state_free(BufferState_t* buffer_state)
      }
 
      vim_marks_free(&buffer_state->vim_buffer_state.mark_head);
+     vim_multi_cursor_free(&buffer_state->vim_buffer_state.multi_cursor);
      free(buffer_state);
 }
 
@@ -293,9 +294,8 @@ bool buffer_delete_at_index(BufferNode_t** head, TabView_t* tab_head, int64_t bu
      if(term_itr){
           if(term_itr == *terminal_current) *terminal_current = NULL;
 
-          pthread_cancel(term_itr->check_update_thread);
-          pthread_detach(term_itr->check_update_thread);
           terminal_free(&term_itr->terminal);
+          dest_index_free(&term_itr->destinations);
 
           if(term_prev){
                term_prev->next = term_itr->next;
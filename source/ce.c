@@ -5,8 +5,11 @@
 #include <string.h>
 #include <inttypes.h>
 #include <assert.h>
+#include <fcntl.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 
 Point_t* g_terminal_dimensions = NULL;
 
@@ -150,9 +153,10 @@ void clear_lines_impl(Buffer_t* buffer)
                free(buffer->lines[i]);
           }
 
-          free(buffer->lines);
+          free(buffer->lines - buffer->line_offset);
           buffer->lines = NULL;
           buffer->line_count = 0;
+          buffer->line_offset = 0;
      }
 
      mark_buffer_as_modified(buffer);
@@ -472,6 +476,34 @@ char* ce_dupe_line(const Buffer_t* buffer, int64_t line)
      return memcpy(duped_line, buffer->lines[line], len - 2);
 }
 
+static bool block_edits_on_buffer(const Buffer_t* buffer, const BufferLineEdit_t* edits, int64_t edit_count, bool removing,
+                                  bool reverse);
+
+char* ce_dupe_block(const Buffer_t* buffer, const BufferLineEdit_t* edits, int64_t edit_count)
+{
+     if(!block_edits_on_buffer(buffer, edits, edit_count, true, false)) return NULL;
+
+     int64_t total_len = 0;
+     for(int64_t i = 0; i < edit_count; ++i){
+          total_len += edits[i].length;
+     }
+
+     char* new_str = malloc(total_len + 1);
+     if(!new_str){
+          ce_message("%s() failed to alloc string", __FUNCTION__);
+          return NULL;
+     }
+
+     char* itr = new_str;
+     for(int64_t i = 0; i < edit_count; ++i){
+          memcpy(itr, buffer->lines[edits[i].line] + edits[i].column, edits[i].length);
+          itr += edits[i].length;
+     }
+
+     new_str[total_len] = 0;
+     return new_str;
+}
+
 char* ce_dupe_lines(const Buffer_t* buffer, int64_t start_line, int64_t end_line)
 {
      if(start_line < 0){
@@ -1179,6 +1211,48 @@ bool ce_set_char_readonly(Buffer_t* buffer, Point_t location, char c)
      return set_char_impl(buffer, location, c);
 }
 
+// NOTE: overwrites length characters starting at location, the line grows if the string runs past the end of it
+static bool set_string_impl(Buffer_t* buffer, Point_t location, const char* string, int64_t length)
+{
+     if(!ce_point_on_buffer(buffer, location)) return false;
+     if(length <= 0) return true;
+
+     char* line = buffer->lines[location.y];
+     int64_t line_len = 0;
+     if(line) line_len = strlen(line);
+
+     int64_t new_line_len = location.x + length;
+     if(new_line_len > line_len){
+          char* new_line = realloc(line, new_line_len + 1);
+          if(!new_line){
+               ce_message("%s() failed to alloc line %"PRId64, __FUNCTION__, location.y);
+               return false;
+          }
+
+          new_line[new_line_len] = 0;
+          buffer->lines[location.y] = new_line;
+          line = new_line;
+     }
+
+     memcpy(line + location.x, string, length);
+     mark_buffer_as_modified(buffer);
+     return true;
+}
+
+bool ce_set_string(Buffer_t* buffer, Point_t location, const char* string, int64_t length)
+{
+     if(buffer->status == BS_READONLY) return false;
+
+     return set_string_impl(buffer, location, string, length);
+}
+
+bool ce_set_string_readonly(Buffer_t* buffer, Point_t location, const char* string, int64_t length)
+{
+     if(buffer->status != BS_READONLY) return false;
+
+     return set_string_impl(buffer, location, string, length);
+}
+
 static bool insert_line_impl(Buffer_t* buffer, int64_t line, const char* string)
 {
      // make sure we are only inserting in the middle or at the very end, or the buffer is empty
@@ -1187,12 +1261,15 @@ static bool insert_line_impl(Buffer_t* buffer, int64_t line, const char* string)
      if(string) string_line_count = ce_count_string_lines(string);
 
      int64_t new_line_count = buffer->line_count + string_line_count;
-     char** new_lines = realloc(buffer->lines, new_line_count * sizeof(char*));
+     char** allocation = buffer->lines ? buffer->lines - buffer->line_offset : NULL;
+     char** new_lines = realloc(allocation, (buffer->line_offset + new_line_count) * sizeof(char*));
      if(!new_lines){
           printf("%s() failed to malloc new lines: %"PRId64"\n", __FUNCTION__, new_line_count);
           return false;
      }
 
+     new_lines += buffer->line_offset;
+
      if(buffer->line_count){
           memmove(new_lines + line + string_line_count, new_lines + line, (buffer->line_count - line) * sizeof(*new_lines));
      }
@@ -1249,6 +1326,35 @@ bool ce_append_line_readonly(Buffer_t* buffer, const char* string)
      return ce_insert_line_readonly(buffer, buffer->line_count, string);
 }
 
+// NOTE: rather than moving the rest of the lines up, lines is advanced past the dropped lines. The dead space at the
+//       front of the allocation is only reclaimed once it outgrows the lines still in use, so each drop is O(1) amortized
+bool ce_drop_first_lines_readonly(Buffer_t* buffer, int64_t count)
+{
+     if(buffer->status != BS_READONLY) return false;
+
+     if(count <= 0 || count >= buffer->line_count){
+          ce_message("%s() cannot drop %"PRId64" lines, buffer has %"PRId64" lines", __FUNCTION__, count, buffer->line_count);
+          return false;
+     }
+
+     for(int64_t i = 0; i < count; ++i){
+          free(buffer->lines[i]);
+     }
+
+     buffer->lines += count;
+     buffer->line_offset += count;
+     buffer->line_count -= count;
+
+     if(buffer->line_offset >= buffer->line_count){
+          char** allocation = buffer->lines - buffer->line_offset;
+          memmove(allocation, buffer->lines, buffer->line_count * sizeof(*buffer->lines));
+          buffer->lines = allocation;
+          buffer->line_offset = 0;
+     }
+
+     return true;
+}
+
 bool ce_insert_newline(Buffer_t* buffer, int64_t line)
 {
      return ce_insert_line(buffer, line, NULL);
@@ -1277,28 +1383,41 @@ bool ce_join_line(Buffer_t* buffer, int64_t line){
 }
 
 bool ce_remove_line(Buffer_t* buffer, int64_t line)
+{
+     return ce_remove_lines(buffer, line, 1);
+}
+
+static bool remove_lines_impl(Buffer_t* buffer, int64_t line, int64_t count)
 {
      if(line >= buffer->line_count || line < 0){
           ce_message("%s() specified line %"PRId64" ouside of buffer, which has %"PRId64" lines", __FUNCTION__, line, buffer->line_count);
           return false;
      }
 
-     if(buffer->status == BS_READONLY) return false;
+     if(count <= 0 || line + count > buffer->line_count){
+          ce_message("%s() cannot remove %"PRId64" lines at line %"PRId64", buffer has %"PRId64" lines", __FUNCTION__, count, line, buffer->line_count);
+          return false;
+     }
 
-     // free the old line
-     free(buffer->lines[line]);
+     // free the old lines
+     for(int64_t i = 0; i < count; ++i){
+          free(buffer->lines[line + i]);
+     }
 
-     int64_t new_line_count = buffer->line_count - 1;
+     int64_t new_line_count = buffer->line_count - count;
 
      if(new_line_count){
-          // move trailing lines up 1
-          memmove(buffer->lines + line, buffer->lines + line + 1, (new_line_count - line) * sizeof(*buffer->lines));
+          // move trailing lines up all at once
+          memmove(buffer->lines + line, buffer->lines + line + count, (new_line_count - line) * sizeof(*buffer->lines));
 
-          buffer->lines = realloc(buffer->lines, new_line_count * sizeof(*buffer->lines));
-          if(!buffer->lines){
+          char** new_lines = realloc(buffer->lines - buffer->line_offset,
+                                     (buffer->line_offset + new_line_count) * sizeof(*buffer->lines));
+          if(!new_lines){
                ce_message("%s() failed to realloc new lines: %"PRId64"", __FUNCTION__, new_line_count);
                return false;
           }
+
+          buffer->lines = new_lines + buffer->line_offset;
      }
 
      buffer->line_count = new_line_count;
@@ -1306,10 +1425,23 @@ bool ce_remove_line(Buffer_t* buffer, int64_t line)
      return true;
 }
 
-static bool remove_string_impl(Buffer_t* buffer, Point_t location, int64_t length)
+bool ce_remove_lines(Buffer_t* buffer, int64_t line, int64_t count)
 {
      if(buffer->status == BS_READONLY) return false;
 
+     return remove_lines_impl(buffer, line, count);
+}
+
+bool ce_remove_lines_readonly(Buffer_t* buffer, int64_t line, int64_t count)
+{
+     if(buffer->status != BS_READONLY) return false;
+
+     return remove_lines_impl(buffer, line, count);
+}
+
+// NOTE: callers check the buffer's status, so we stick to the _impl functions that don't check it again
+static bool remove_string_impl(Buffer_t* buffer, Point_t location, int64_t length)
+{
      if(length == 0) return true;
 
      // TODO: should this return false and not do anything if we try to remove
@@ -1343,7 +1475,7 @@ static bool remove_string_impl(Buffer_t* buffer, Point_t location, int64_t lengt
      length -= rest_of_the_line_len + 1; // account for newline
      buffer->lines[location.y][location.x] = '\0';
      if(location.x == 0 && length == 0){
-          ce_remove_line(buffer, location.y);
+          remove_lines_impl(buffer, location.y, 1);
           mark_buffer_as_modified(buffer);
           return true;
      }
@@ -1351,32 +1483,33 @@ static bool remove_string_impl(Buffer_t* buffer, Point_t location, int64_t lengt
      // hard case: string spans multiple lines
      int64_t delete_index = location.y + 1;
 
-     while(length >= 0){
-          assert(delete_index <= buffer->line_count);
-          if(delete_index >= buffer->line_count) break;
+     // count any lines that we have the length to remove completely, so they can be removed all at once
+     int64_t delete_count = 0;
+     while(delete_index + delete_count < buffer->line_count){
+          int64_t next_line_len = strlen(buffer->lines[delete_index + delete_count]);
+          if(length < next_line_len + 1) break;
+          length -= next_line_len + 1;
+          delete_count++;
+     }
 
-          int64_t next_line_len = strlen(buffer->lines[delete_index]);
-          if(length >= next_line_len + 1){
-               // remove any lines that we have the length to remove completely
-               ce_remove_line(buffer, delete_index);
-               length -= next_line_len + 1;
-          }else{ // we have to mash together our first and last line
-               // NOTE: this is only run once
-               // slurp up end of first line and beginning of last line
-               int64_t next_line_part_len = next_line_len - length;
-               int64_t new_line_len = location.x + next_line_part_len;
-               buffer->lines[location.y] = realloc(buffer->lines[location.y], new_line_len + 1);
-               if(!buffer->lines[location.y]){
-                    ce_message("%s() failed to realloc new line", __FUNCTION__);
-                    return false;
-               }
+     if(delete_count) remove_lines_impl(buffer, delete_index, delete_count);
 
-               assert(buffer->lines[location.y+1][length+next_line_part_len] == '\0');
-               memcpy(buffer->lines[location.y] + location.x,
-                      buffer->lines[location.y+1] + length, next_line_part_len + 1);
-               ce_remove_line(buffer, location.y+1);
-               break;
+     if(delete_index < buffer->line_count){
+          // we have to mash together our first and last line
+          // slurp up end of first line and beginning of last line
+          int64_t next_line_len = strlen(buffer->lines[delete_index]);
+          int64_t next_line_part_len = next_line_len - length;
+          int64_t new_line_len = location.x + next_line_part_len;
+          buffer->lines[location.y] = realloc(buffer->lines[location.y], new_line_len + 1);
+          if(!buffer->lines[location.y]){
+               ce_message("%s() failed to realloc new line", __FUNCTION__);
+               return false;
           }
+
+          assert(buffer->lines[location.y+1][length+next_line_part_len] == '\0');
+          memcpy(buffer->lines[location.y] + location.x,
+                 buffer->lines[location.y+1] + length, next_line_part_len + 1);
+          remove_lines_impl(buffer, location.y+1, 1);
      }
 
      mark_buffer_as_modified(buffer);
@@ -1397,25 +1530,196 @@ bool ce_remove_string_readonly(Buffer_t* buffer, Point_t location, int64_t lengt
      return remove_string_impl(buffer, location, length);
 }
 
+static bool block_edits_on_buffer(const Buffer_t* buffer, const BufferLineEdit_t* edits, int64_t edit_count, bool removing,
+                                  bool reverse)
+{
+     // NOTE: each edit applies to what the one before it left, so track how much the edits before it on the same line
+     //       moved the end of that line. Edits to one line are expected to sit next to each other
+     int64_t line_delta = 0;
+
+     for(int64_t e = 0; e < edit_count; ++e){
+          int64_t i = reverse ? edit_count - 1 - e : e;
+          const BufferLineEdit_t* edit = edits + i;
+
+          if(edit->line < 0 || edit->line >= buffer->line_count || edit->column < 0 || edit->length < 0){
+               ce_message("%s() edit %"PRId64" at %"PRId64", %"PRId64" is not on the buffer", __FUNCTION__,
+                          i, edit->column, edit->line);
+               return false;
+          }
+
+          if(e == 0 || edits[reverse ? i + 1 : i - 1].line != edit->line) line_delta = 0;
+
+          int64_t line_len = strlen(buffer->lines[edit->line]) + line_delta;
+          int64_t edit_end = removing ? edit->column + edit->length : edit->column;
+          if(edit_end > line_len){
+               ce_message("%s() edit %"PRId64" at %"PRId64", %"PRId64" goes past the end of the line", __FUNCTION__,
+                          i, edit->column, edit->line);
+               return false;
+          }
+
+          line_delta += removing ? -edit->length : edit->length;
+     }
+
+     return true;
+}
+
+// reverse applies the edits last to first, which is how a block is undone
+static bool insert_block_impl(Buffer_t* buffer, const BufferLineEdit_t* edits, int64_t edit_count, const char* text,
+                              bool reverse)
+{
+     if(buffer->status == BS_READONLY) return false;
+
+     // check every edit up front so we don't leave the block half inserted
+     if(!block_edits_on_buffer(buffer, edits, edit_count, false, reverse)) return false;
+
+     int64_t offset = 0;
+     if(reverse){
+          for(int64_t i = 0; i < edit_count; ++i) offset += edits[i].length;
+     }
+
+     for(int64_t e = 0; e < edit_count; ++e){
+          int64_t i = reverse ? edit_count - 1 - e : e;
+          const BufferLineEdit_t* edit = edits + i;
+          if(reverse) offset -= edit->length;
+          if(!edit->length) continue;
+
+          char* line = buffer->lines[edit->line];
+          int64_t line_len = strlen(line);
+          char* new_line = realloc(line, line_len + edit->length + 1);
+          if(!new_line){
+               ce_message("%s() failed to realloc line %"PRId64, __FUNCTION__, edit->line);
+               return false;
+          }
+
+          memmove(new_line + edit->column + edit->length, new_line + edit->column, (line_len - edit->column) + 1);
+          memcpy(new_line + edit->column, text + offset, edit->length);
+          buffer->lines[edit->line] = new_line;
+          if(!reverse) offset += edit->length;
+     }
+
+     mark_buffer_as_modified(buffer);
+     return true;
+}
+
+static bool remove_block_impl(Buffer_t* buffer, const BufferLineEdit_t* edits, int64_t edit_count, bool reverse)
+{
+     if(buffer->status == BS_READONLY) return false;
+
+     if(!block_edits_on_buffer(buffer, edits, edit_count, true, reverse)) return false;
+
+     for(int64_t e = 0; e < edit_count; ++e){
+          int64_t i = reverse ? edit_count - 1 - e : e;
+          const BufferLineEdit_t* edit = edits + i;
+          if(!edit->length) continue;
+
+          char* line = buffer->lines[edit->line];
+          int64_t line_len = strlen(line);
+          int64_t new_line_len = line_len - edit->length;
+          memmove(line + edit->column, line + edit->column + edit->length, (line_len - (edit->column + edit->length)) + 1);
+
+          // shrink the allocation now that we have fixed up the line
+          char* new_line = realloc(line, new_line_len + 1);
+          if(new_line) buffer->lines[edit->line] = new_line;
+     }
+
+     mark_buffer_as_modified(buffer);
+     return true;
+}
+
+bool ce_insert_block(Buffer_t* buffer, const BufferLineEdit_t* edits, int64_t edit_count, const char* text)
+{
+     return insert_block_impl(buffer, edits, edit_count, text, false);
+}
+
+bool ce_remove_block(Buffer_t* buffer, const BufferLineEdit_t* edits, int64_t edit_count)
+{
+     return remove_block_impl(buffer, edits, edit_count, false);
+}
+
+#define WRITE_BUFFER_IOVECS 1024 // IOV_MAX on linux
+
+static bool write_iovecs(int fd, struct iovec* iovecs, int count)
+{
+     while(count){
+          ssize_t written = writev(fd, iovecs, count);
+          if(written < 0){
+               if(errno == EINTR) continue;
+               return false;
+          }
+
+          // NOTE: pipes and sockets may take part of it, pick up where they left off
+          while(count && (size_t)(written) >= iovecs->iov_len){
+               written -= iovecs->iov_len;
+               iovecs++;
+               count--;
+          }
+
+          if(count){
+               iovecs->iov_base = (char*)(iovecs->iov_base) + written;
+               iovecs->iov_len -= written;
+          }
+     }
+
+     return true;
+}
+
+bool ce_write_buffer(const Buffer_t* buffer, int fd)
+{
+     // NOTE: the kernel gathers the lines from where they sit, we never build a copy of the buffer
+     static char newline = '\n';
+     struct iovec iovecs[WRITE_BUFFER_IOVECS];
+
+     int64_t line = 0;
+     while(line < buffer->line_count){
+          int count = 0;
+          while(line < buffer->line_count && count + 2 <= WRITE_BUFFER_IOVECS){
+               char* text = buffer->lines[line];
+               if(text && text[0]) iovecs[count++] = (struct iovec){text, strlen(text)};
+               iovecs[count++] = (struct iovec){&newline, 1};
+               line++;
+          }
+
+          if(!write_iovecs(fd, iovecs, count)) return false;
+     }
+
+     return true;
+}
+
+int ce_buffer_memfd(const Buffer_t* buffer)
+{
+     int fd = memfd_create("ce_buffer", MFD_CLOEXEC);
+     if(fd < 0){
+          ce_message("%s() memfd_create() failed: %s", __FUNCTION__, strerror(errno));
+          return -1;
+     }
+
+     if(!ce_write_buffer(buffer, fd) || lseek(fd, 0, SEEK_SET) != 0){
+          ce_message("%s() failed to write buffer: %s", __FUNCTION__, strerror(errno));
+          close(fd);
+          return -1;
+     }
+
+     return fd;
+}
+
 bool ce_save_buffer(Buffer_t* buffer, const char* filename)
 {
      // save file loaded
-     FILE* file = fopen(filename, "w");
-     if(!file){
+     int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+     if(fd < 0){
           // TODO: console output ? perror!
           ce_message("%s() failed to open '%s': %s", __FUNCTION__, filename, strerror(errno));
           return false;
      }
 
-     for(int64_t i = 0; i < buffer->line_count; ++i){
-          if(buffer->lines[i]){
-               size_t len = strlen(buffer->lines[i]);
-               fwrite(buffer->lines[i], len, 1, file);
-          }
-          fwrite("\n", 1, 1, file);
+     bool written = ce_write_buffer(buffer, fd);
+     if(close(fd) != 0) written = false;
+
+     if(!written){
+          ce_message("%s() failed to write '%s': %s", __FUNCTION__, filename, strerror(errno));
+          return false;
      }
 
-     fclose(file);
      buffer->status = BS_NONE;
      return true;
 }
@@ -1435,6 +1739,27 @@ static int64_t count_digits(int64_t n)
 
 static const char non_printable_repr = '~';
 
+// figure out which columns of a line are highlighted once, so drawing each character is just a column compare
+static void calc_highlight_columns(const Buffer_t* buffer, int64_t line, int64_t* first, int64_t* last)
+{
+     const Point_t* start = &buffer->highlight_start;
+     const Point_t* end = &buffer->highlight_end;
+
+     *first = 0;
+     *last = -1;
+
+     if(line < start->y || line > end->y) return;
+
+     if(buffer->highlight_block){
+          *first = start->x;
+          *last = end->x;
+          return;
+     }
+
+     *first = (line == start->y) ? start->x : 0;
+     *last = (line == end->y) ? end->x : INT64_MAX;
+}
+
 bool ce_draw_buffer(const Buffer_t* buffer, const Point_t* cursor, const Point_t* term_top_left,
                     const Point_t* term_bottom_right, const Point_t* buffer_top_left, const regex_t* highlight_regex,
                     LineNumberType_t line_number_type, HighlightLineType_t highlight_line_type)
@@ -1513,6 +1838,8 @@ bool ce_draw_buffer(const Buffer_t* buffer, const Point_t* cursor, const Point_t
           syntax_data.highlight_line_type = highlight_line_type;
           syntax_data.state = SS_INITIALIZING;
           syntax_data.loc = (Point_t){0, buffer_top_left->y};
+          syntax_data.highlight_first = 0;
+          syntax_data.highlight_last = -1;
 
           if(buffer->syntax_fn) buffer->syntax_fn(&syntax_data, buffer->syntax_user_data);
 
@@ -1539,6 +1866,7 @@ bool ce_draw_buffer(const Buffer_t* buffer, const Point_t* cursor, const Point_t
                     // call syntax function at the beginning of the line
                     syntax_data.loc = (Point_t){buffer_top_left->x, i};
                     syntax_data.state = SS_BEGINNING_OF_LINE;
+                    calc_highlight_columns(buffer, i, &syntax_data.highlight_first, &syntax_data.highlight_last);
                     buffer->syntax_fn(&syntax_data, buffer->syntax_user_data);
 
                     if(line_length >= buffer_top_left->x){
@@ -1907,6 +2235,32 @@ bool ce_commit_change_string(BufferCommitNode_t** tail, Point_t start, Point_t u
      return ce_commit_change(tail, &change);
 }
 
+static bool commit_block(BufferCommitNode_t** tail, BufferCommitType_t type, Point_t undo_cursor, Point_t redo_cursor,
+                         BufferLineEdit_t* edits, int64_t edit_count, char* text, BufferCommitChain_t chain)
+{
+     BufferCommit_t change;
+     change.type = type;
+     change.start = edit_count ? (Point_t){edits[0].column, edits[0].line} : undo_cursor;
+     change.undo_cursor = undo_cursor;
+     change.redo_cursor = redo_cursor;
+     change.str = text;
+     change.line_edits = edits;
+     change.line_edit_count = edit_count;
+     change.chain = chain;
+
+     return ce_commit_change(tail, &change);
+}
+
+bool ce_commit_insert_block(BufferCommitNode_t** tail, Point_t undo_cursor, Point_t redo_cursor, BufferLineEdit_t* edits, int64_t edit_count, char* text, BufferCommitChain_t chain)
+{
+     return commit_block(tail, BCT_INSERT_BLOCK, undo_cursor, redo_cursor, edits, edit_count, text, chain);
+}
+
+bool ce_commit_remove_block(BufferCommitNode_t** tail, Point_t undo_cursor, Point_t redo_cursor, BufferLineEdit_t* edits, int64_t edit_count, char* text, BufferCommitChain_t chain)
+{
+     return commit_block(tail, BCT_REMOVE_BLOCK, undo_cursor, redo_cursor, edits, edit_count, text, chain);
+}
+
 void free_commit(BufferCommitNode_t* node)
 {
      if(node->commit.type == BCT_INSERT_STRING ||
@@ -1915,6 +2269,10 @@ void free_commit(BufferCommitNode_t* node)
      }else if(node->commit.type == BCT_CHANGE_STRING){
           free(node->commit.str);
           free(node->commit.prev_str);
+     }else if(node->commit.type == BCT_INSERT_BLOCK ||
+              node->commit.type == BCT_REMOVE_BLOCK){
+          free(node->commit.str);
+          free(node->commit.line_edits);
      }
 
      free(node);
@@ -1922,6 +2280,8 @@ void free_commit(BufferCommitNode_t* node)
 
 bool ce_commit_change(BufferCommitNode_t** tail, const BufferCommit_t* commit)
 {
+     static uint64_t next_id = 1;
+
      BufferCommitNode_t* new_node = calloc(1, sizeof(*new_node));
      if(!new_node){
           ce_message("%s() failed to allocate new change", __FUNCTION__);
@@ -1929,6 +2289,7 @@ bool ce_commit_change(BufferCommitNode_t** tail, const BufferCommit_t* commit)
      }
 
      new_node->commit = *commit;
+     new_node->id = next_id++;
      new_node->prev = *tail;
 
      // TODO: rather than branching, just free rest of the redo list on this change
@@ -1962,6 +2323,8 @@ bool ce_commits_dump(BufferCommitNode_t* tail)
           "REMOVE STRING",
           "CHANGE CHAR",
           "CHANGE STRING",
+          "INSERT BLOCK",
+          "REMOVE BLOCK",
      };
 
      const char* chain_str [] = {
@@ -1994,6 +2357,12 @@ bool ce_commits_dump(BufferCommitNode_t* tail)
                ce_message("    inserted char: '%s'", tail->commit.str);
                ce_message("     removed char: '%s'", tail->commit.prev_str);
                break;
+          case BCT_INSERT_BLOCK:
+               ce_message("   inserted block: '%s' on %"PRId64" lines", tail->commit.str, tail->commit.line_edit_count);
+               break;
+          case BCT_REMOVE_BLOCK:
+               ce_message("    removed block: '%s' on %"PRId64" lines", tail->commit.str, tail->commit.line_edit_count);
+               break;
           }
 
           ce_message("            start: %"PRId64", %"PRId64"", tail->commit.start.x, tail->commit.start.y);
@@ -2045,6 +2414,12 @@ bool ce_commit_undo(Buffer_t* buffer, BufferCommitNode_t** tail, Point_t* cursor
                ce_remove_string(buffer, commit->start, strlen(commit->str));
                ce_insert_string(buffer, commit->start, commit->prev_str);
                break;
+          case BCT_INSERT_BLOCK:
+               remove_block_impl(buffer, commit->line_edits, commit->line_edit_count, true);
+               break;
+          case BCT_REMOVE_BLOCK:
+               insert_block_impl(buffer, commit->line_edits, commit->line_edit_count, commit->str, true);
+               break;
           }
 
           *cursor = *ce_clamp_cursor(buffer, &(*tail)->commit.undo_cursor);
@@ -2097,6 +2472,12 @@ bool ce_commit_redo(Buffer_t* buffer, BufferCommitNode_t** tail, Point_t* cursor
                ce_remove_string(buffer, commit->start, strlen(commit->prev_str));
                ce_insert_string(buffer, commit->start, commit->str);
                break;
+          case BCT_INSERT_BLOCK:
+               ce_insert_block(buffer, commit->line_edits, commit->line_edit_count, commit->str);
+               break;
+          case BCT_REMOVE_BLOCK:
+               ce_remove_block(buffer, commit->line_edits, commit->line_edit_count);
+               break;
           }
 
           *cursor = (*tail)->commit.redo_cursor;
@@ -82,6 +82,8 @@ typedef struct{
      LineNumberType_t line_number_type;
      HighlightLineType_t highlight_line_type;
      SyntaxState_t state;
+     int64_t highlight_first; // columns of the current line inside the buffer's highlight, first > last when none are
+     int64_t highlight_last;
 }SyntaxHighlighterData_t;
 
 typedef void syntax_highlighter(SyntaxHighlighterData_t*, void*);
@@ -115,6 +117,7 @@ typedef enum{
 typedef struct Buffer_t{
      char** lines; // '\0' terminated, does not contain newlines, NULL if empty
      int64_t line_count;
+     int64_t line_offset; // how many dropped lines lines has been advanced past in its allocation
 
      BufferStatus_t status;
      BufferFileType_t type;
@@ -124,6 +127,7 @@ typedef struct Buffer_t{
      // TODO: these are used for drawing, consider passing them as arguments?
      Point_t highlight_start;
      Point_t highlight_end;
+     bool highlight_block; // highlight_start and highlight_end are the corners of a block rather than a range
      Point_t mark;
      bool blink; // used to show highlight using blink colors
 
@@ -146,6 +150,13 @@ typedef struct BufferNode_t {
      struct BufferNode_t* next;
 }BufferNode_t;
 
+// an insert or remove of text on a single line, block functions apply one of these to each line in a list
+typedef struct {
+     int64_t line;
+     int64_t column;
+     int64_t length;
+}BufferLineEdit_t;
+
 typedef enum {
      BCT_NONE,
      BCT_INSERT_CHAR,
@@ -154,6 +165,8 @@ typedef enum {
      BCT_REMOVE_STRING,
      BCT_CHANGE_CHAR,
      BCT_CHANGE_STRING,
+     BCT_INSERT_BLOCK,
+     BCT_REMOVE_BLOCK,
 }BufferCommitType_t;
 
 typedef enum {
@@ -178,11 +191,17 @@ typedef struct {
      union {
           char prev_c;
           char* prev_str;
+          struct {
+               // block commits keep the text of every line edit back to back in str
+               BufferLineEdit_t* line_edits;
+               int64_t line_edit_count;
+          };
      };
 }BufferCommit_t;
 
 typedef struct BufferCommitNode_t {
      BufferCommit_t commit;
+     uint64_t id; // unique per commit, so a commit can be told apart from one allocated where a free'd one used to be
      struct BufferCommitNode_t* prev;
      struct BufferCommitNode_t* next;
 }BufferCommitNode_t;
@@ -283,16 +302,25 @@ bool ce_remove_string_readonly  (Buffer_t* buffer, Point_t location, int64_t len
 bool ce_prepend_string          (Buffer_t* buffer, int64_t line, const char* string);
 bool ce_append_string           (Buffer_t* buffer, int64_t line, const char* string);
 bool ce_append_string_readonly  (Buffer_t* buffer, int64_t line, const char* string);
+bool ce_set_string              (Buffer_t* buffer, Point_t location, const char* string, int64_t length); // string cannot contain newlines
+bool ce_set_string_readonly     (Buffer_t* buffer, Point_t location, const char* string, int64_t length);
 
 bool ce_insert_line             (Buffer_t* buffer, int64_t line, const char* string);
 bool ce_insert_line_readonly    (Buffer_t* buffer, int64_t line, const char* string);
 bool ce_remove_line             (Buffer_t* buffer, int64_t line);
+bool ce_remove_lines            (Buffer_t* buffer, int64_t line, int64_t count);
+bool ce_remove_lines_readonly   (Buffer_t* buffer, int64_t line, int64_t count);
 bool ce_append_line             (Buffer_t* buffer, const char* string);
 bool ce_append_line_readonly    (Buffer_t* buffer, const char* string);
+bool ce_drop_first_lines_readonly(Buffer_t* buffer, int64_t count); // keeps the last line, used for scrollback
 bool ce_join_line               (Buffer_t* buffer, int64_t line);
 
 bool ce_insert_newline          (Buffer_t* buffer, int64_t line);
 
+// NOTE: each line edit must be on a different line and the text cannot contain newlines
+bool ce_insert_block            (Buffer_t* buffer, const BufferLineEdit_t* edits, int64_t edit_count, const char* text);
+bool ce_remove_block            (Buffer_t* buffer, const BufferLineEdit_t* edits, int64_t edit_count);
+
 
 // Buffer Inspection Functions
 bool    ce_draw_buffer              (const Buffer_t* buffer, const Point_t* cursor, const Point_t* term_top_left,
@@ -300,6 +328,8 @@ bool    ce_draw_buffer              (const Buffer_t* buffer, const Point_t* curs
                                      const regex_t* highlight_regex, LineNumberType_t line_number_type,
                                      HighlightLineType_t highlight_line_type);
 bool    ce_save_buffer              (Buffer_t* buffer, const char* filename);
+bool    ce_write_buffer             (const Buffer_t* buffer, int fd); // every line and its newline, without copying them
+int     ce_buffer_memfd             (const Buffer_t* buffer); // snapshot to hand to a child as its stdin, -1 on failure
 bool    ce_point_on_buffer          (const Buffer_t* buffer, Point_t location);
 bool    ce_get_char                 (const Buffer_t* buffer, Point_t location, char* c);
 char    ce_get_char_raw             (const Buffer_t* buffer, Point_t location);
@@ -308,6 +338,7 @@ char*   ce_dupe_string              (const Buffer_t* buffer, Point_t start, Poin
 char*   ce_dupe_buffer              (const Buffer_t* buffer);
 char*   ce_dupe_line                (const Buffer_t* buffer, int64_t line);
 char*   ce_dupe_lines               (const Buffer_t* buffer, int64_t start_line, int64_t end_line);
+char*   ce_dupe_block               (const Buffer_t* buffer, const BufferLineEdit_t* edits, int64_t edit_count);
 int64_t ce_get_indentation_for_line (const Buffer_t* buffer, Point_t location, int64_t tab_len);
 
 
@@ -348,6 +379,9 @@ bool ce_commit_insert_string (BufferCommitNode_t** tail, Point_t start, Point_t
 bool ce_commit_remove_string (BufferCommitNode_t** tail, Point_t start, Point_t undo_cursor, Point_t redo_cursor, char* string, BufferCommitChain_t chain);
 bool ce_commit_change_string (BufferCommitNode_t** tail, Point_t start, Point_t undo_cursor, Point_t redo_cursor, char* new_string, char* prev_string, BufferCommitChain_t chain);
 
+bool ce_commit_insert_block  (BufferCommitNode_t** tail, Point_t undo_cursor, Point_t redo_cursor, BufferLineEdit_t* edits, int64_t edit_count, char* text, BufferCommitChain_t chain);
+bool ce_commit_remove_block  (BufferCommitNode_t** tail, Point_t undo_cursor, Point_t redo_cursor, BufferLineEdit_t* edits, int64_t edit_count, char* text, BufferCommitChain_t chain);
+
 bool ce_commit_undo          (Buffer_t* buffer, BufferCommitNode_t** tail, Point_t* cursor);
 bool ce_commit_redo          (Buffer_t* buffer, BufferCommitNode_t** tail, Point_t* cursor);
 bool ce_commit_change        (BufferCommitNode_t** tail, const BufferCommit_t* change);
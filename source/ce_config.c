@@ -15,6 +15,9 @@
 #include "completion.h"
 #include "info.h"
 #include "terminal_helper.h"
+#include "lsp_helper.h"
+#include "symbol_helper.h"
+#include "file_index_helper.h"
 #include "misc.h"
 
 #define SCROLL_LINES 1
@@ -74,43 +77,122 @@ void mouse_handle_event(BufferView_t* buffer_view, VimState_t* vim_state, Input_
      }
 }
 
-static int int_strneq(int* a, int* b, size_t len)
+static KeyBindNode_t* key_bind_find_child(KeyBindNode_t* node, int key)
 {
-     for(size_t i = 0; i < len; ++i){
-          if(!*a) return false;
-          if(!*b) return false;
-          if(*a != *b) return false;
-          a++;
-          b++;
+     // children are sorted by key, so binary search them
+     int64_t low = 0;
+     int64_t high = node->child_count - 1;
+
+     while(low <= high){
+          int64_t mid = low + (high - low) / 2;
+          int mid_key = node->children[mid].key;
+
+          if(mid_key == key) return node->children + mid;
+
+          if(mid_key < key){
+               low = mid + 1;
+          }else{
+               high = mid - 1;
+          }
      }
 
-     return true;
+     return NULL;
+}
+
+static KeyBindNode_t* key_bind_insert_child(KeyBindNode_t* node, int key)
+{
+     int64_t index = 0;
+     while(index < node->child_count && node->children[index].key < key) index++;
+
+     KeyBindNode_t* new_children = realloc(node->children, (node->child_count + 1) * sizeof(*node->children));
+     if(!new_children){
+          ce_message("failed to allocate key bind node");
+          return NULL;
+     }
+
+     node->children = new_children;
+     memmove(node->children + index + 1, node->children + index, (node->child_count - index) * sizeof(*node->children));
+     node->child_count++;
+
+     KeyBindNode_t* child = node->children + index;
+     memset(child, 0, sizeof(*child));
+     child->key = key;
+     return child;
 }
 
-static void convert_bind_defs(KeyBinds_t* binds, KeyBindDef_t* bind_defs, int64_t bind_def_count)
+static void key_bind_node_free(KeyBindNode_t* node)
 {
-     binds->count = bind_def_count;
-     binds->binds = malloc(binds->count * sizeof(*binds->binds));
+     for(int64_t i = 0; i < node->child_count; ++i){
+          key_bind_node_free(node->children + i);
+     }
 
-     for(int64_t i = 0; i < binds->count; ++i){
-          command_parse(&binds->binds[i].command, bind_defs[i].command);
-          binds->binds[i].key_count = 0;
+     free(node->children);
+     node->children = NULL;
+     node->child_count = 0;
 
-          for(int k = 0; k < 4; ++k){
+     if(node->bound){
+          command_free(&node->command);
+          node->bound = false;
+     }
+}
+
+static void convert_bind_defs(KeyBinds_t* binds, KeyBindDef_t* bind_defs, int64_t bind_def_count,
+                              CommandEntry_t* command_entries, int64_t command_entry_count)
+{
+     for(int64_t i = 0; i < bind_def_count; ++i){
+          KeyBindNode_t* node = &binds->root;
+
+          for(int k = 0; k < KEY_BIND_MAX_KEYS; ++k){
                if(bind_defs[i].keys[k] == 0) break;
-               binds->binds[i].key_count++;
+
+               KeyBindNode_t* child = key_bind_find_child(node, bind_defs[i].keys[k]);
+               if(!child) child = key_bind_insert_child(node, bind_defs[i].keys[k]);
+               if(!child) return;
+               node = child;
           }
 
-          if(!binds->binds[i].key_count) continue;
+          // the first bind defined for a set of keys wins
+          if(node == &binds->root || node->bound) continue;
 
-          binds->binds[i].keys = malloc(binds->binds[i].key_count * sizeof(binds->binds[i].keys[0]));
+          node->bound = true;
+          command_parse(&node->command, bind_defs[i].command);
 
-          for(int k = 0; k < binds->binds[i].key_count; ++k){
-               binds->binds[i].keys[k] = bind_defs[i].keys[k];
+          for(int64_t e = 0; e < command_entry_count; ++e){
+               if(strcmp(command_entries[e].name, node->command.name) == 0){
+                    node->command_entry = command_entries + e;
+                    node->command_func = command_entries[e].func;
+                    break;
+               }
           }
      }
 }
 
+// if auto complete has a current matching value, overwrite what the user wrote after offset with that completion
+static bool input_take_completion(ConfigState_t* config_state, int64_t offset)
+{
+     if(!auto_completing(&config_state->auto_complete) || !auto_complete_current(&config_state->auto_complete)) return true;
+
+     int64_t len = strlen(config_state->input.buffer.lines[0] + offset);
+     if(!ce_remove_string(&config_state->input.buffer, (Point_t){offset, 0}, len)) return false;
+     return ce_insert_string(&config_state->input.buffer, (Point_t){offset, 0}, auto_complete_current(&config_state->auto_complete));
+}
+
+// show the file we loaded in the current view, remembering where we jumped from, or the message buffer if it failed
+static void view_show_loaded_file(ConfigState_t* config_state, BufferNode_t* head, Buffer_t* new_buffer, Point_t cursor)
+{
+     BufferView_t* view = config_state->tab_current->view_current;
+
+     if(new_buffer){
+          JumpArray_t* jump_array = &((BufferViewState_t*)(view->user_data))->jump_array;
+          jump_insert(jump_array, view->buffer->filename, view->buffer->cursor);
+          view->buffer = new_buffer;
+          view->cursor = cursor;
+     }else{
+          view->buffer = head->buffer; // message buffer
+          view->cursor = (Point_t){0, 0};
+     }
+}
+
 static bool confirm_action(ConfigState_t* config_state, BufferNode_t** head)
 {
      BufferView_t* buffer_view = config_state->tab_current->view_current;
@@ -142,13 +224,7 @@ static bool confirm_action(ConfigState_t* config_state, BufferNode_t** head)
           case INPUT_SWITCH_BUFFER:
           {
                if(!config_state->input.buffer.line_count) break;
-
-               // if auto complete has a current matching value, overwrite what the user wrote with that completion
-               if(auto_completing(&config_state->auto_complete) && config_state->auto_complete.current){
-                    int64_t len = strlen(config_state->input.buffer.lines[0]);
-                    if(!ce_remove_string(&config_state->input.buffer, (Point_t){0, 0}, len)) break;
-                    if(!ce_insert_string(&config_state->input.buffer, (Point_t){0, 0}, config_state->auto_complete.current->option)) break;
-               }
+               if(!input_take_completion(config_state, 0)) break;
 
                BufferNode_t* itr = *head;
 
@@ -171,18 +247,11 @@ static bool confirm_action(ConfigState_t* config_state, BufferNode_t** head)
           {
                if(!config_state->input.buffer.line_count) break;
 
-               bool switched_to_open_file = false;
-
-               // if auto complete has a current matching value, overwrite what the user wrote with that completion
-               if(auto_completing(&config_state->auto_complete) && config_state->auto_complete.current){
-                    char* last_slash = strrchr(config_state->input.buffer.lines[0], '/');
-                    int64_t offset = 0;
-                    if(last_slash) offset = (last_slash - config_state->input.buffer.lines[0]) + 1;
-
-                    int64_t len = strlen(config_state->input.buffer.lines[0] + offset);
-                    if(!ce_remove_string(&config_state->input.buffer, (Point_t){offset, 0}, len)) break;
-                    if(!ce_insert_string(&config_state->input.buffer, (Point_t){offset, 0}, config_state->auto_complete.current->option)) break;
-               }
+               // only complete the last part of the path
+               char* last_slash = strrchr(config_state->input.buffer.lines[0], '/');
+               int64_t offset = 0;
+               if(last_slash) offset = (last_slash - config_state->input.buffer.lines[0]) + 1;
+               if(!input_take_completion(config_state, offset)) break;
 
                // load the buffer, either from the current working dir, or from another base filepath
                Buffer_t* new_buffer = NULL;
@@ -196,26 +265,23 @@ static bool confirm_action(ConfigState_t* config_state, BufferNode_t** head)
                     if(new_buffer_node) new_buffer = new_buffer_node->buffer;
                }
 
-               if(new_buffer){
-                    JumpArray_t* jump_array = &((BufferViewState_t*)(config_state->tab_current->view_current->user_data))->jump_array;
-                    jump_insert(jump_array, config_state->tab_current->view_current->buffer->filename,
-                                config_state->tab_current->view_current->buffer->cursor);
-                    config_state->tab_current->view_current->buffer = new_buffer;
-                    config_state->tab_current->view_current->cursor = (Point_t){0, 0};
-                    switched_to_open_file = true;
-               }
-
                // free the search path so we can re-use it
                free(config_state->input.load_file_search_path);
                config_state->input.load_file_search_path = NULL;
 
-               if(!switched_to_open_file){
-                    config_state->tab_current->view_current->buffer = (*head)->buffer; // message buffer
-                    config_state->tab_current->view_current->cursor = (Point_t){0, 0};
-               }
-
+               view_show_loaded_file(config_state, *head, new_buffer, (Point_t){0, 0});
                return true;
           } break;
+          case INPUT_FIND_FILE:
+          {
+               if(!config_state->input.buffer.line_count) break;
+               if(!input_take_completion(config_state, 0)) break;
+
+               BufferNode_t* new_buffer_node = file_index_load_file(config_state, head, config_state->input.buffer.lines[0]);
+               view_show_loaded_file(config_state, *head, new_buffer_node ? new_buffer_node->buffer : NULL,
+                                     new_buffer_node ? new_buffer_node->buffer->cursor : (Point_t){0, 0});
+               return true;
+          }
           case INPUT_SEARCH:
           case INPUT_REVERSE_SEARCH:
                if(!config_state->input.buffer.line_count) break;
@@ -336,10 +402,10 @@ static bool confirm_action(ConfigState_t* config_state, BufferNode_t** head)
                     }
                }else{
                     // if auto complete has a current matching value, overwrite what the user wrote with that completion
-                    if(auto_completing(&config_state->auto_complete) && config_state->auto_complete.current){
+                    if(auto_completing(&config_state->auto_complete) && auto_complete_current(&config_state->auto_complete)){
                          int64_t len = strlen(config_state->input.buffer.lines[0]);
                          if(!ce_remove_string(&config_state->input.buffer, (Point_t){0, 0}, len)) break;
-                         if(!ce_insert_string(&config_state->input.buffer, (Point_t){0, 0}, config_state->auto_complete.current->option)) break;
+                         if(!ce_insert_string(&config_state->input.buffer, (Point_t){0, 0}, auto_complete_current(&config_state->auto_complete))) break;
                     }
 
                     // run all commands in the input buffer
@@ -413,6 +479,8 @@ static bool confirm_action(ConfigState_t* config_state, BufferNode_t** head)
           view_center(buffer_view);
 
           return true;
+     }else if(buffer_view->buffer == &config_state->symbol_list_buffer){
+          return symbol_list_goto(config_state, head, cursor->y);
      }else if(buffer_view->buffer == &config_state->macro_list_buffer){
           int64_t line = cursor->y - 1; // account for buffer list row header
           if(line < 0) return false;
@@ -474,11 +542,12 @@ static bool confirm_action(ConfigState_t* config_state, BufferNode_t** head)
 }
 
 void draw_view_statuses(BufferView_t* view, BufferView_t* current_view, VimMode_t vim_mode,
-                        char recording_macro, TerminalNode_t* terminal_current)
+                        char recording_macro, TerminalNode_t* terminal_head, TerminalNode_t* terminal_current,
+                        LspState_t* lsp)
 {
      // recursively call draw view for all statuses
-     if(view->next_horizontal) draw_view_statuses(view->next_horizontal, current_view, vim_mode, recording_macro, terminal_current);
-     if(view->next_vertical) draw_view_statuses(view->next_vertical, current_view, vim_mode, recording_macro, terminal_current);
+     if(view->next_horizontal) draw_view_statuses(view->next_horizontal, current_view, vim_mode, recording_macro, terminal_head, terminal_current, lsp);
+     if(view->next_vertical) draw_view_statuses(view->next_vertical, current_view, vim_mode, recording_macro, terminal_head, terminal_current, lsp);
 
      // NOTE: mode names need space at the end for OCD ppl like me
      static const char* mode_names[] = {
@@ -525,8 +594,39 @@ void draw_view_statuses(BufferView_t* view, BufferView_t* current_view, VimMode_
 
      // finally print extra info for special modes, recording macro, or in terminal
      if(terminal_current && view->buffer == terminal_current->buffer) printw("$ ");
+
+     // let the user know why a flooding terminal isn't drawing every line, and how hard it is flooding
+     TerminalNode_t* terminal_node = is_terminal_buffer(terminal_head, view->buffer);
+     if(terminal_node && terminal_node->terminal.flood.fast_forward){
+          double rate = terminal_node->terminal.flood.bytes_per_second;
+          const char* units[] = {"B", "KB", "MB", "GB"};
+          int unit = 0;
+          while(rate >= 1024.0 && unit < 3){
+               rate /= 1024.0;
+               unit++;
+          }
+          printw("FAST-FORWARD %.1f %s/s ", rate, units[unit]);
+     }
+
+     // how many file locations in the output we can jump to
+     if(terminal_node && terminal_node->destinations.count){
+          printw("LOCATIONS %"PRId64" ", terminal_node->destinations.count);
+     }
      if(view == current_view && recording_macro) printw("RECORDING %c ", recording_macro);
 
+     // what the language server found wrong, and what it said about the symbol we asked it about
+     int64_t errors = lsp_diagnostic_count(&lsp->client, buffer, LDS_ERROR);
+     int64_t warnings = lsp_diagnostic_count(&lsp->client, buffer, LDS_WARNING);
+     if(errors) printw("ERRORS %"PRId64" ", errors);
+     if(warnings) printw("WARNINGS %"PRId64" ", warnings);
+     if(view == current_view && lsp->hover){
+          int hover_y, hover_x;
+          getyx(stdscr, hover_y, hover_x);
+          (void)(hover_y);
+          int space_for_hover = (position_info_x - hover_x) - 1;
+          if(space_for_hover > 0) printw("%.*s", space_for_hover, lsp->hover);
+     }
+
 #if 0 // NOTE: useful to show key presses when debugging
      if(view == current_view) printw("%s %d ", keyname(g_last_key), g_last_key);
 #endif
@@ -622,6 +722,14 @@ bool initializer(BufferNode_t** head, Point_t* terminal_dimensions, int argc, ch
      config_state->macro_list_buffer.syntax_user_data = realloc(config_state->macro_list_buffer.syntax_user_data, sizeof(SyntaxC_t));
      config_state->macro_list_buffer.type = BFT_C;
 
+     config_state->symbol_list_buffer.name = strdup("[symbols]");
+     buffer_initialize(&config_state->symbol_list_buffer);
+     config_state->symbol_list_buffer.status = BS_READONLY;
+     config_state->symbol_list_buffer.absolutely_no_line_numbers_under_any_circumstances = true;
+     config_state->symbol_list_buffer.syntax_fn = syntax_highlight_c;
+     config_state->symbol_list_buffer.syntax_user_data = realloc(config_state->symbol_list_buffer.syntax_user_data, sizeof(SyntaxC_t));
+     config_state->symbol_list_buffer.type = BFT_C;
+
      // if we reload, the completionbuffer may already exist, don't recreate it
      BufferNode_t* itr = *head;
      while(itr){
@@ -691,6 +799,12 @@ bool initializer(BufferNode_t** head, Point_t* terminal_dimensions, int argc, ch
      config_state->highlight_line_type = HLT_ENTIRE_LINE;
 
      config_state->max_auto_complete_height = 10;
+     dir_cache_init(&config_state->dir_cache);
+     config_state->terminal_scrollback_lines = TERM_DEFAULT_SCROLLBACK_LINES;
+
+     // NOTE: the index lives in its own thread, so start it before we wait on anything else
+     symbol_index_start_project(config_state);
+     file_index_start_project(config_state);
 
 #if 0
      // enable mouse events
@@ -829,6 +943,7 @@ bool initializer(BufferNode_t** head, Point_t* terminal_dimensions, int argc, ch
                {command_command_dialogue, "command_dialogue", NULL, "open a dialogue to run a ce command", NULL},
                {command_search_dialogue, "search_dialogue", "[dir]", "open a dialogue to search the current buffer for a regex", "dirs: up, down"},
                {command_load_file_dialogue, "load_file_dialogue", NULL, "open a dialogue to load a file", NULL},
+               {command_find_file_dialogue, "find_file_dialogue", NULL, "open a dialogue to fuzzy find any file in the project", NULL},
                {command_replace_dialogue, "replace_dialogue", NULL, "open a dialogue to replace in the current buffer", NULL},
                {command_cancel_dialogue, "cancel_dialogue", NULL, "cancel any open dialogue", NULL},
 
@@ -841,14 +956,19 @@ bool initializer(BufferNode_t** head, Point_t* terminal_dimensions, int argc, ch
                {command_jump_next, "jump_next", NULL, "using the jump list, move the cursor to the next destination in the list", NULL},
                {command_jump_previous, "jump_previous", NULL, "using the jump list, move the cursor to the previous destination in the list", NULL},
 
-               {command_completion_toggle, "completion_toggle", NULL, "toggle auto completion for c using clang", NULL},
+               {command_completion_toggle, "completion_toggle", NULL, "toggle auto completion using the language server, clang for c if there isn't one, or the words in the open buffers otherwise", NULL},
                {command_completion_apply, "completion_apply", NULL, "if auto completion is running, insert the selection option at the cursor", NULL},
                {command_completion_next, "completion_next", NULL, "if auto completion is running, select the next completion in the list", NULL},
                {command_completion_previous, "completion_previous", NULL, "if auto completion is running, select the next completion in the list", NULL},
 
-               {command_cscope_goto_definition, "cscope_goto_definition", "<symbol>", "jump to the definition of the specified symbol. If no symbol is specified, use word under cursor", NULL},
+               {command_cscope_goto_definition, "cscope_goto_definition", "<symbol>", "jump to the definition of the specified symbol, or list them if there are several. If no symbol is specified, use word under cursor, asking the language server if there is one", NULL},
+               {command_symbol_references, "symbol_references", "<symbol>", "list every reference to the specified symbol, or the word under the cursor", NULL},
+               {command_hover, "hover", NULL, "show what the language server knows about the symbol under the cursor", NULL},
                {command_goto_file_under_cursor, "goto_file_under_cursor", NULL, "checks the word under the cursor for a valid file, if valid opens that file", NULL},
                {command_macro_backslashes, "macro_backslashes", NULL, "add formatted backslashes around a macro", NULL},
+
+               {command_multi_cursor_add, "multi_cursor_add", "[mode]", "add cursors that repeat whatever is typed in insert mode at the view's cursor", "modes: matches, up, down"},
+               {command_multi_cursor_clear, "multi_cursor_clear", NULL, "remove all of the extra cursors in the current buffer", NULL},
           };
 
           // init and copy from our stack array
@@ -888,7 +1008,8 @@ bool initializer(BufferNode_t** head, Point_t* terminal_dimensions, int argc, ch
                {{11}, "view_switch up"}, // Ctrl + k
                {{12}, "view_switch right"}, // Ctrl + l
                {{19}, "view_split horizontal"}, // Ctrl + s
-               {{22}, "view_split vertical"}, // Ctrl + v
+               {{'\\', 'v'}, "view_split vertical"},
+               {{'\\', 'f'}, "find_file_dialogue"},
                {{15}, "jump_next"}, // Ctrl + o
                {{9}, "jump_previous"}, // Ctrl + i
                {{29}, "cscope_goto_definition"}, // Ctrl + ]
@@ -902,11 +1023,16 @@ bool initializer(BufferNode_t** head, Point_t* terminal_dimensions, int argc, ch
                {{'@', '?'}, "show_macros"},
                {{'y', '?'}, "show_yanks"},
                {{'Z', 'Z'}, "save_and_close_view"},
+               {{'\\', 'n'}, "multi_cursor_add matches"},
+               {{'\\', 'j'}, "multi_cursor_add down"},
+               {{'\\', 'k'}, "multi_cursor_add up"},
+               {{'\\', 'x'}, "multi_cursor_clear"},
                {{14}, "completion_next"},
                {{16}, "completion_previous"},
           };
 
-          convert_bind_defs(config_state->binds + VM_NORMAL, normal_mode_bind_defs, sizeof(normal_mode_bind_defs) / sizeof(normal_mode_bind_defs[0]));
+          convert_bind_defs(config_state->binds + VM_NORMAL, normal_mode_bind_defs, sizeof(normal_mode_bind_defs) / sizeof(normal_mode_bind_defs[0]),
+                            config_state->command_entries, config_state->command_entry_count);
 
           KeyBindDef_t insert_mode_bind_defs[] = {
                {{KEY_TAB}, "completion_apply"},
@@ -915,7 +1041,8 @@ bool initializer(BufferNode_t** head, Point_t* terminal_dimensions, int argc, ch
                {{16}, "completion_previous"}, // Ctrl + p
           };
 
-          convert_bind_defs(config_state->binds + VM_INSERT, insert_mode_bind_defs, sizeof(insert_mode_bind_defs) / sizeof(insert_mode_bind_defs[0]));
+          convert_bind_defs(config_state->binds + VM_INSERT, insert_mode_bind_defs, sizeof(insert_mode_bind_defs) / sizeof(insert_mode_bind_defs[0]),
+                            config_state->command_entries, config_state->command_entry_count);
      }
 
      // read in state file if it exists
@@ -1046,23 +1173,20 @@ bool destroyer(BufferNode_t** head, void* user_data)
           }
      }
 
-     if(config_state->terminal_head){
-          TerminalColorPairNode_t* color_itr = terminal_color_pairs_head;
+     lsp_stop_server(config_state);
+     symbol_index_stop_project(config_state);
+     file_index_stop_project(config_state);
+     clang_completion_stop();
 
-          while(color_itr){
-               TerminalColorPairNode_t* tmp = color_itr;
-               color_itr = color_itr->next;
-               free(tmp);
-          }
-     }
+     // NOTE: the draw and io threads walk the terminals, so stop them before the terminals go away
+     terminal_stop_draw_thread(config_state);
+     terminal_io_stop();
+     terminal_color_pairs_free();
 
      TerminalNode_t* term_itr = config_state->terminal_head;
      while(term_itr){
-          if(term_itr->check_update_thread){
-               pthread_cancel(term_itr->check_update_thread);
-               pthread_join(term_itr->check_update_thread, NULL);
-               terminal_free(&term_itr->terminal);
-          }
+          terminal_free(&term_itr->terminal);
+          dest_index_free(&term_itr->destinations);
 
           TerminalNode_t* tmp = term_itr;
           term_itr = term_itr->next;
@@ -1127,6 +1251,10 @@ bool destroyer(BufferNode_t** head, void* user_data)
      free(config_state->macro_list_buffer.syntax_user_data);
      ce_free_buffer(&config_state->macro_list_buffer);
 
+     buffer_state_free(config_state->symbol_list_buffer.user_data);
+     free(config_state->symbol_list_buffer.syntax_user_data);
+     ce_free_buffer(&config_state->symbol_list_buffer);
+
      free(config_state->command_entries);
 
      // history
@@ -1136,6 +1264,8 @@ bool destroyer(BufferNode_t** head, void* user_data)
      pthread_mutex_destroy(&draw_lock);
 
      auto_complete_free(&config_state->auto_complete);
+     word_index_free(&config_state->word_index);
+     dir_cache_free(&config_state->dir_cache);
 
      free(config_state->vim_state.last_insert_command);
 
@@ -1147,10 +1277,9 @@ bool destroyer(BufferNode_t** head, void* user_data)
      }
 
      // key binds
-     for(int64_t i = 0; i < config_state->binds[VM_NORMAL].count; ++i){
-          free(config_state->binds[VM_NORMAL].binds[i].keys);
+     for(int64_t i = 0; i < VM_COUNT; ++i){
+          key_bind_node_free(&config_state->binds[i].root);
      }
-     free(config_state->binds[VM_NORMAL].binds);
 
      vim_yanks_free(&config_state->vim_state.yank_head);
      vim_macros_free(&config_state->vim_state.macro_head);
@@ -1163,7 +1292,7 @@ bool destroyer(BufferNode_t** head, void* user_data)
      return true;
 }
 
-bool key_handler(int key, BufferNode_t** head, void* user_data)
+static bool key_handler_impl(int key, BufferNode_t** head, void* user_data)
 {
      ConfigState_t* config_state = user_data;
      Buffer_t* buffer = config_state->tab_current->view_current->buffer;
@@ -1196,82 +1325,62 @@ bool key_handler(int key, BufferNode_t** head, void* user_data)
 
      // as long as vim isn't in the middle of handling keys, in insert mode vim returns VKH_HANDLED_KEY TODO: is that what we want?
      if(config_state->last_vim_result_type != VKH_HANDLED_KEY || config_state->last_vim_mode == VM_INSERT){
-          // append to keys
-          if(config_state->keys){
+          // continue from the node the previous key matched, otherwise start at the root for the current mode
+          KeyBindNode_t* key_bind_node = config_state->key_count ? config_state->key_bind_node :
+                                                                   &config_state->binds[config_state->vim_state.mode].root;
+          key_bind_node = key_bind_find_child(key_bind_node, key);
+
+          if(config_state->key_count < KEY_BIND_MAX_KEYS){
+               config_state->keys[config_state->key_count] = key;
                config_state->key_count++;
-               config_state->keys = realloc(config_state->keys, config_state->key_count * sizeof(config_state->keys[0]));
-          }else{
-               config_state->key_count = 1;
-               config_state->keys = malloc(config_state->key_count * sizeof(config_state->keys[0]));
           }
 
-          config_state->keys[config_state->key_count - 1] = key;
-
-          // if matches a key bind
-          bool no_matches = true;
-          for(int64_t i = 0; i < config_state->binds[config_state->vim_state.mode].count; ++i){
-               if(int_strneq(config_state->binds[config_state->vim_state.mode].binds[i].keys, config_state->keys, config_state->key_count)){
-                    no_matches = false;
+          if(key_bind_node && key_bind_node->bound){
+               // we completely match a key bind, execute the action
+               Command_t* command = &key_bind_node->command;
+               CommandEntry_t* entry = key_bind_node->command_entry;
 
-                    // if we have matches, but don't completely match, then wait for more keypresses,
-                    // otherwise, execute the action
-                    if(config_state->binds[config_state->vim_state.mode].binds[i].key_count == config_state->key_count){
-                         Command_t* command = &config_state->binds[config_state->vim_state.mode].binds[i].command;
-                         ce_command* command_func = NULL;
-                         CommandEntry_t* entry = NULL;
-                         for(int64_t i = 0; i < config_state->command_entry_count; ++i){
-                              entry = config_state->command_entries + i;
-                              if(strcmp(entry->name, command->name) == 0){
-                                   command_func = entry->func;
-                                   break;
-                              }
-                         }
-
-                         if(command_func){
-                              CommandData_t command_data = {config_state, head};
-                              CommandStatus_t cs = command_func(command, &command_data);
-
-                              switch(cs){
-                              default:
-                                   handled_key = true;
-                                   break;
-                              case CS_NO_ACTION:
-                                   break;
-                              case CS_FAILURE:
-                                   ce_message("'%s' failed", entry->name);
-                                   break;
-                              case CS_PRINT_HELP:
-                                   ce_message("command help:");
-                                   command_entry_log(entry);
-                                   ce_message("");
-                                   break;
-                              }
-                         }else{
-                              ce_message("unknown command: '%s'", command->name);
-                         }
+               if(key_bind_node->command_func){
+                    CommandData_t command_data = {config_state, head};
+                    CommandStatus_t cs = key_bind_node->command_func(command, &command_data);
 
-                         free(config_state->keys);
-                         config_state->keys = NULL;
-                         break;
-                    }else{
+                    switch(cs){
+                    default:
                          handled_key = true;
+                         break;
+                    case CS_NO_ACTION:
+                         break;
+                    case CS_FAILURE:
+                         ce_message("'%s' failed", entry->name);
+                         break;
+                    case CS_PRINT_HELP:
+                         ce_message("command help:");
+                         command_entry_log(entry);
+                         ce_message("");
+                         break;
                     }
+               }else{
+                    ce_message("unknown command: '%s'", command->name);
                }
-          }
 
-          if(no_matches){
+               config_state->key_count = 0;
+               config_state->key_bind_node = NULL;
+          }else if(key_bind_node){
+               // if we have matches, but don't completely match, then wait for more keypresses
+               config_state->key_bind_node = key_bind_node;
+               handled_key = true;
+          }else{
                // hand off the keys to vim to see if that creates a valid action if we have at least matched one key
                if(config_state->key_count > 1){
-                    ce_keys_free(&config_state->vim_state.command_head);
+                    vim_action_parser_reset(&config_state->vim_state.action_parser);
                     // skip pushing the last key since we are going to pass that one in this loop
                     for(int64_t i = 0; i < config_state->key_count - 1; ++i){
-                         ce_keys_push(&config_state->vim_state.command_head, config_state->keys[i]);
+                         vim_action_parser_push(&config_state->vim_state.action_parser, config_state->keys[i]);
                     }
                }
 
-               free(config_state->keys);
-               config_state->keys = NULL;
                config_state->key_count = 0;
+               config_state->key_bind_node = NULL;
           }
      }
 
@@ -1295,6 +1404,7 @@ bool key_handler(int key, BufferNode_t** head, void* user_data)
      if(!handled_key && key == KEY_ENTER){
           if(confirm_action(config_state, head)){
                ce_keys_free(&config_state->vim_state.command_head);
+               vim_action_parser_reset(&config_state->vim_state.action_parser);
                handled_key = true;
           }
      }
@@ -1354,7 +1464,7 @@ bool key_handler(int key, BufferNode_t** head, void* user_data)
                          default:
                               break;
                          case INPUT_LOAD_FILE:
-                              completion_calc_start_and_path(&config_state->auto_complete,
+                              completion_calc_start_and_path(&config_state->auto_complete, &config_state->dir_cache,
                                                              buffer->lines[cursor->y],
                                                              *cursor,
                                                              config_state->completion_buffer,
@@ -1363,6 +1473,7 @@ bool key_handler(int key, BufferNode_t** head, void* user_data)
                          case INPUT_COMMAND:
                               // intentional fallthrough
                          case INPUT_SWITCH_BUFFER:
+                         case INPUT_FIND_FILE:
                          {
                               Point_t end = {cursor->x - 1, cursor->y};
                               if(end.x < 0) end.x = 0;
@@ -1371,13 +1482,12 @@ bool key_handler(int key, BufferNode_t** head, void* user_data)
                               pthread_mutex_lock(&completion_lock);
                               if(auto_completing(&config_state->auto_complete)){
                                    if(!ce_points_equal(config_state->auto_complete.start, *cursor)) match = ce_dupe_string(buffer, config_state->auto_complete.start, end);
-                                   if(strstr(config_state->auto_complete.current->option, match) == NULL){
-                                        auto_complete_next(&config_state->auto_complete, match);
-                                   }
+                                   auto_complete_select(&config_state->auto_complete, match);
                               }else{
-                                   auto_complete_start(&config_state->auto_complete, ACT_OCCURANCE, (Point_t){0, cursor->y});
+                                   AutoCompleteType_t type = (config_state->input.type == INPUT_COMMAND) ? ACT_OCCURANCE : ACT_FUZZY;
+                                   auto_complete_start(&config_state->auto_complete, type, (Point_t){0, cursor->y});
                                    if(!ce_points_equal(config_state->auto_complete.start, *cursor)) match = ce_dupe_string(buffer, config_state->auto_complete.start, end);
-                                   auto_complete_next(&config_state->auto_complete, match);
+                                   auto_complete_select(&config_state->auto_complete, match);
                               }
 
                               completion_update_buffer(config_state->completion_buffer, &config_state->auto_complete, match);
@@ -1389,18 +1499,13 @@ bool key_handler(int key, BufferNode_t** head, void* user_data)
                          if(auto_completing(&config_state->auto_complete)){
                               Point_t end = {cursor->x - 1, cursor->y};
                               if(end.x < 0) end.x = 0;
-                              char* match = "";
-                              match = ce_dupe_string(buffer, config_state->auto_complete.start, end);
-                              size_t match_len = 0;
-                              if(match) match_len = strlen(match);
-                              if(config_state->auto_complete.current && strncmp(config_state->auto_complete.current->option, match, match_len) == 0){
-                                   // pass
-                              }else{
-                                   pthread_mutex_lock(&completion_lock);
-                                   auto_complete_next(&config_state->auto_complete, match);
-                                   completion_update_buffer(config_state->completion_buffer, &config_state->auto_complete, match);
-                                   pthread_mutex_unlock(&completion_lock);
-                              }
+                              char* match = ce_dupe_string(buffer, config_state->auto_complete.start, end);
+
+                              // NOTE: narrowing only filters what matched before, so keep the options shown in step
+                              pthread_mutex_lock(&completion_lock);
+                              auto_complete_select(&config_state->auto_complete, match);
+                              completion_update_buffer(config_state->completion_buffer, &config_state->auto_complete, match);
+                              pthread_mutex_unlock(&completion_lock);
 
                               free(match);
                          }
@@ -1412,7 +1517,8 @@ bool key_handler(int key, BufferNode_t** head, void* user_data)
                                    char prev_char = 0;
                                    if(cursor->x > 1 && ce_get_char(buffer, (Point_t){cursor->x - 2, cursor->y}, &prev_char)){
                                         if(!isalnum(prev_char) && prev_char != '_'){
-                                             clang_completion(config_state, (Point_t){cursor->x - 1, cursor->y});
+                                             Point_t start = {cursor->x - 1, cursor->y};
+                                             if(!lsp_complete(config_state, start)) clang_completion(config_state, start);
                                         }
                                    }
                               }
@@ -1432,9 +1538,21 @@ bool key_handler(int key, BufferNode_t** head, void* user_data)
                               // intentional fallthrough
                          }
                          case '.':
-                              clang_completion(config_state, *cursor);
+                              if(!lsp_complete(config_state, *cursor)) clang_completion(config_state, *cursor);
                               break;
                          }
+                    }else if(!is_terminal_buffer(config_state->terminal_head, buffer)){
+                         // everything else completes the words in the open buffers, looked up again as the word grows
+                         Point_t start = *cursor;
+                         const char* line = buffer->lines[cursor->y];
+                         while(line && start.x > 0 && (isalnum(line[start.x - 1]) || line[start.x - 1] == '_')) start.x--;
+
+                         if((isalnum(key) || key == '_' || key == KEY_BACKSPACE) &&
+                            cursor->x - start.x >= WORD_COMPLETION_MIN_PREFIX){
+                              word_completion(config_state, start);
+                         }else if(auto_completing(&config_state->auto_complete)){
+                              auto_complete_end(&config_state->auto_complete);
+                         }
                     }
                }
                break;
@@ -1462,6 +1580,7 @@ bool key_handler(int key, BufferNode_t** head, void* user_data)
 
                          vim_enter_normal_mode(&config_state->vim_state);
                          ce_keys_free(&config_state->vim_state.command_head);
+                         vim_action_parser_reset(&config_state->vim_state.action_parser);
                     }
                }else if(vkh_result.completed_action.change.type == VCT_PASTE_BEFORE ||
                         vkh_result.completed_action.change.type == VCT_PASTE_AFTER){
@@ -1470,13 +1589,7 @@ bool key_handler(int key, BufferNode_t** head, void* user_data)
                          Terminal_t* terminal = &terminal_node->terminal;
                          char reg = vkh_result.completed_action.change.reg ? vkh_result.completed_action.change.reg : '"';
                          VimYankNode_t* yank = vim_yank_find(config_state->vim_state.yank_head, reg);
-                         if(yank){
-                              const char* itr = yank->text;
-                              while(*itr){
-                                   terminal_send_key(terminal, *itr);
-                                   itr++;
-                              }
-                         }
+                         if(yank) terminal_send_string(terminal, yank->text, strlen(yank->text), true);
                     }
                }
                break;
@@ -1510,6 +1623,7 @@ bool key_handler(int key, BufferNode_t** head, void* user_data)
                          buffer->blink = true;
                          buffer->highlight_start = *action_range.sorted_start;
                          buffer->highlight_end = *action_range.sorted_end;
+                         buffer->highlight_block = (action_range.yank_mode == YANK_BLOCK);
                     }
                }else if(vkh_result.completed_action.change.type == VCT_SUBSTITUTE){
                     VimYankNode_t* yank = vim_yank_find(config_state->vim_state.yank_head,
@@ -1647,16 +1761,35 @@ bool key_handler(int key, BufferNode_t** head, void* user_data)
           info_update_macro_list_buffer(&config_state->macro_list_buffer, &config_state->vim_state);
      }
 
-     // grab the draw lock so we can draw
-     if(pthread_mutex_trylock(&draw_lock) == 0){
-          view_drawer(user_data);
-          pthread_mutex_unlock(&draw_lock);
-     }
+     view_drawer(user_data);
 
      g_last_key = key;
      return true;
 }
 
+bool key_handler(int key, BufferNode_t** head, void* user_data)
+{
+     // NOTE: terminal output is only applied to terminal buffers while holding the draw lock, so holding it while we
+     //       handle the key means no buffer changes out from under us. Catch up on the output first, so we act on
+     //       what is actually on screen
+     pthread_mutex_lock(&draw_lock);
+     terminal_apply_all_updates(user_data);
+
+     // hover text only lasts until the next key
+     ConfigState_t* config_state = user_data;
+     free(config_state->lsp.hover);
+     config_state->lsp.hover = NULL;
+
+     bool result = key_handler_impl(key, head, user_data);
+
+     // NOTE: the language server keeps up with every key, so what we ask it next is about what is on screen
+     lsp_sync_all_buffers(config_state, *head);
+     word_completion_sync(config_state, *head);
+
+     pthread_mutex_unlock(&draw_lock);
+     return result;
+}
+
 void view_drawer(void* user_data)
 {
      // clear all lines in the terminal
@@ -1745,6 +1878,7 @@ void view_drawer(void* user_data)
 
           buffer->highlight_start = *start;
           buffer->highlight_end = *end;
+          buffer->highlight_block = false;
      }else if(config_state->vim_state.mode == VM_VISUAL_LINE){
           int64_t start_line = config_state->vim_state.visual_start.y;
           int64_t end_line = config_state->tab_current->view_current->cursor.y;
@@ -1757,9 +1891,20 @@ void view_drawer(void* user_data)
 
           buffer->highlight_start = (Point_t){0, start_line};
           buffer->highlight_end = (Point_t){strlen(config_state->tab_current->view_current->buffer->lines[end_line]), end_line};
+          buffer->highlight_block = false;
+     }else if(config_state->vim_state.mode == VM_VISUAL_BLOCK){
+          const Point_t* visual_start = &config_state->vim_state.visual_start;
+          const Point_t* visual_end = &config_state->tab_current->view_current->cursor;
+
+          buffer->highlight_start = (Point_t){visual_start->x < visual_end->x ? visual_start->x : visual_end->x,
+                                              visual_start->y < visual_end->y ? visual_start->y : visual_end->y};
+          buffer->highlight_end = (Point_t){visual_start->x > visual_end->x ? visual_start->x : visual_end->x,
+                                            visual_start->y > visual_end->y ? visual_start->y : visual_end->y};
+          buffer->highlight_block = true;
      }else if(!buffer->blink){
           buffer->highlight_start = (Point_t){0, 0};
           buffer->highlight_end = (Point_t){-1, 0};
+          buffer->highlight_block = false;
      }
 
      // setup highlight for hotmark
@@ -1768,7 +1913,8 @@ void view_drawer(void* user_data)
 
      // turn off highlighting the current line when in visual mode
      HighlightLineType_t highlight_line_type = config_state->highlight_line_type;
-     if(config_state->vim_state.mode == VM_VISUAL_RANGE || config_state->vim_state.mode == VM_VISUAL_LINE){
+     if(config_state->vim_state.mode == VM_VISUAL_RANGE || config_state->vim_state.mode == VM_VISUAL_LINE ||
+        config_state->vim_state.mode == VM_VISUAL_BLOCK){
           highlight_line_type = HLT_NONE;
      }
 
@@ -1781,6 +1927,20 @@ void view_drawer(void* user_data)
      // draw starting from the head
      ce_draw_views(config_state->tab_current->view_head, highlight_regex, config_state->line_number_type, highlight_line_type);
 
+     // draw the extra cursors in the current view
+     {
+          const VimMultiCursor_t* multi_cursor = &buffer_state->vim_buffer_state.multi_cursor;
+          for(int64_t i = 0; i < multi_cursor->count; ++i){
+               const Point_t* location = multi_cursor->cursors + i;
+               if(location->y < buffer_view->top_row || location->x < buffer_view->left_column) continue;
+
+               Point_t on_terminal = misc_get_cursor_on_user_terminal(location, buffer_view, line_number_type);
+               if(on_terminal.y > buffer_view->bottom_right.y || on_terminal.x > buffer_view->bottom_right.x) continue;
+
+               mvchgat(on_terminal.y, on_terminal.x, 1, A_REVERSE, 0, NULL);
+          }
+     }
+
      // draw input status
      if(auto_completing(&config_state->auto_complete)){
           move(auto_complete_top_left.y - 1, auto_complete_top_left.x);
@@ -1804,7 +1964,7 @@ void view_drawer(void* user_data)
      // draw all view statuses recursively
      draw_view_statuses(config_state->tab_current->view_head, config_state->tab_current->view_current,
                         config_state->vim_state.mode, config_state->vim_state.recording_macro,
-                        config_state->terminal_current);
+                        config_state->terminal_head, config_state->terminal_current, &config_state->lsp);
 
      // if in input mode, draw input mode's status line
      if(config_state->input.type > INPUT_NONE){
@@ -1832,15 +1992,15 @@ void view_drawer(void* user_data)
           ce_draw_views(config_state->input.view, NULL, LNT_NONE, HLT_NONE);
           draw_view_statuses(config_state->input.view, config_state->tab_current->view_current,
                              config_state->vim_state.mode, config_state->vim_state.recording_macro,
-                             config_state->terminal_current);
+                             config_state->terminal_head, config_state->terminal_current, &config_state->lsp);
      }
 
      // draw auto complete
-     if(auto_completing(&config_state->auto_complete) && config_state->auto_complete.current && config_state->auto_complete.type == ACT_EXACT){
+     if(auto_completing(&config_state->auto_complete) && auto_complete_current(&config_state->auto_complete) && config_state->auto_complete.type == ACT_EXACT){
           move(terminal_cursor.y, terminal_cursor.x);
           int64_t offset = cursor->x - config_state->auto_complete.start.x;
           if(offset >= 0){
-               const char* option = config_state->auto_complete.current->option + offset;
+               const char* option = auto_complete_current(&config_state->auto_complete) + offset;
                attron(COLOR_PAIR(S_AUTO_COMPLETE));
                while(*option){
                     addch(*option);
@@ -8,6 +8,12 @@
 #include "ce.h"
 #include "vim.h"
 #include "terminal.h"
+#include "dest_index.h"
+#include "lsp.h"
+#include "symbol_index.h"
+#include "word_index.h"
+#include "dir_cache.h"
+#include "file_index.h"
 #include "tab_view.h"
 #include "input.h"
 #include "auto_complete.h"
@@ -17,6 +23,9 @@
 // NOTE: 60 fps limit
 #define DRAW_USEC_LIMIT 16666
 
+// NOTE: 4 fps while a terminal is flooding output, its output is still applied as fast as it comes in
+#define TERMINAL_FAST_FORWARD_DRAW_USEC 250000
+
 typedef struct{
      BufferCommitNode_t* commit_tail;
      VimBufferState_t vim_buffer_state;
@@ -25,8 +34,9 @@ typedef struct{
 typedef struct TerminalNode_t{
      Terminal_t terminal;
      Buffer_t* buffer;
-     pthread_t check_update_thread;
      int64_t last_jump_location;
+     int64_t lines_dropped; // how many of the terminal's dropped lines we have shifted our line indices for
+     DestIndex_t destinations; // lines of output we can jump to
      struct TerminalNode_t* next;
 }TerminalNode_t;
 
@@ -34,20 +44,36 @@ typedef struct{
      JumpArray_t jump_array;
 }BufferViewState_t;
 
+// the language server is started for the first c or c++ buffer, its answers are applied on the client's thread
 typedef struct{
-     int* keys;
-     int64_t key_count;
+     LspClient_t client;
+     bool tried; // we only try to start it once, without it we complete with clang and find definitions with cscope
+     int64_t latest[LRT_COUNT]; // newest request of each type, answers to anything older are dropped
+     const Buffer_t* request_buffer[LRT_COUNT]; // buffer the newest request of each type was made in
+     Point_t completion_start;
+     char* completion_prefix; // the line up to completion_start when it was asked for
+     char* hover; // shown in the current view's status until the next key
+}LspState_t;
+
+#define KEY_BIND_MAX_KEYS 4
+
+// key binds are compiled into a trie per vim mode, the command function is looked up once when the trie is built
+typedef struct KeyBindNode_t{
+     int key;
+     bool bound; // true if a key bind ends at this node
      Command_t command;
-     VimMode_t vim_mode;
-}KeyBind_t;
+     ce_command* command_func; // NULL if the command is unknown
+     CommandEntry_t* command_entry;
+     struct KeyBindNode_t* children; // sorted by key
+     int64_t child_count;
+}KeyBindNode_t;
 
 typedef struct{
-     KeyBind_t* binds;
-     int64_t count;
+     KeyBindNode_t root;
 }KeyBinds_t;
 
 typedef struct{
-     int keys[4];
+     int keys[KEY_BIND_MAX_KEYS];
      const char* command;
 }KeyBindDef_t;
 
@@ -56,6 +82,7 @@ typedef struct{
      Buffer_t mark_list_buffer;
      Buffer_t yank_list_buffer;
      Buffer_t macro_list_buffer;
+     Buffer_t symbol_list_buffer;
      Buffer_t clang_completion_buffer;
 
      Buffer_t* completion_buffer;
@@ -73,12 +100,18 @@ typedef struct{
 
      BufferView_t* view_auto_complete;
 
-     pthread_t clang_complete_thread;
-
      TerminalNode_t* terminal_head;
      TerminalNode_t* terminal_current; // most recent terminal in focus
+     pthread_t terminal_draw_thread; // shared by all terminals, started with the first one
 
      AutoComplete_t auto_complete;
+     WordIndex_t word_index; // words in the open buffers, completed where there is no clang or language server
+     DirCache_t dir_cache; // listings for path completion, shared by anything that browses files
+
+     LspState_t lsp;
+
+     SymbolIndex_t symbol_index;
+     FileIndex_t file_index;
 
      LineNumberType_t line_number_type;
      HighlightLineType_t highlight_line_type;
@@ -92,11 +125,14 @@ typedef struct{
      CommandEntry_t* command_entries;
      int64_t command_entry_count;
      int64_t max_auto_complete_height;
+     int64_t terminal_scrollback_lines;
 
      KeyBinds_t binds[VM_COUNT];
 
-     int* keys;
+     // keys matched so far against the current mode's key binds
+     int keys[KEY_BIND_MAX_KEYS];
      int64_t key_count;
+     KeyBindNode_t* key_bind_node;
 
      bool quit;
 
@@ -7,6 +7,9 @@
 #include "terminal_helper.h"
 #include "misc.h"
 #include "completion.h"
+#include "lsp_helper.h"
+#include "symbol_helper.h"
+#include "file_index_helper.h"
 
 #include <ctype.h>
 #include <unistd.h>
@@ -271,7 +274,7 @@ CommandStatus_t command_save(Command_t* command, void* user_data)
      ConfigState_t* config_state = command_data->config_state;
      Buffer_t* buffer = config_state->tab_current->view_current->buffer;
 
-     ce_save_buffer(buffer, buffer->filename);
+     if(ce_save_buffer(buffer, buffer->filename)) symbol_buffer_saved(config_state, buffer);
      return CS_SUCCESS;
 }
 
@@ -766,7 +769,7 @@ CommandStatus_t command_switch_buffer_dialogue(Command_t* command, void* user_da
                auto_complete_insert(&config_state->auto_complete, itr->buffer->name, NULL);
                itr = itr->next;
           }
-          auto_complete_start(&config_state->auto_complete, ACT_OCCURANCE, (Point_t){0, 0});
+          auto_complete_start(&config_state->auto_complete, ACT_FUZZY, (Point_t){0, 0});
           completion_update_buffer(config_state->completion_buffer, &config_state->auto_complete, NULL);
           pthread_mutex_unlock(&completion_lock);
 
@@ -798,6 +801,24 @@ CommandStatus_t command_command_dialogue(Command_t* command, void* user_data)
      return CS_SUCCESS;
 }
 
+CommandStatus_t command_find_file_dialogue(Command_t* command, void* user_data)
+{
+     if(command->arg_count != 0) return CS_PRINT_HELP;
+
+     CommandData_t* command_data = (CommandData_t*)(user_data);
+     ConfigState_t* config_state = command_data->config_state;
+
+     if(config_state->input.type > INPUT_NONE &&
+        config_state->tab_current->view_current == config_state->input.view){
+          // pass
+     }else if(file_index_complete_files(config_state)){
+          input_start(&config_state->input, &config_state->tab_current->view_current, &config_state->vim_state,
+                      "Find File", INPUT_FIND_FILE);
+     }
+
+     return CS_SUCCESS;
+}
+
 CommandStatus_t command_search_dialogue(Command_t* command, void* user_data)
 {
      if(command->arg_count != 1) return CS_PRINT_HELP;
@@ -857,7 +878,7 @@ CommandStatus_t command_load_file_dialogue(Command_t* command, void* user_data)
           }
      }
 
-     completion_calc_start_and_path(&config_state->auto_complete,
+     completion_calc_start_and_path(&config_state->auto_complete, &config_state->dir_cache,
                                     config_state->input.buffer.lines[0],
                                     (Point_t){0, 0},
                                     config_state->completion_buffer,
@@ -891,7 +912,13 @@ CommandStatus_t command_cancel_dialogue(Command_t* command, void* user_data)
      CommandData_t* command_data = (CommandData_t*)(user_data);
      ConfigState_t* config_state = command_data->config_state;
 
-     if(config_state->input.type > INPUT_NONE) input_cancel(&config_state->input, &config_state->tab_current->view_current, &config_state->vim_state);
+     if(config_state->input.type > INPUT_NONE){
+          input_cancel(&config_state->input, &config_state->tab_current->view_current, &config_state->vim_state);
+     }else{
+          // with no dialogue up, escape drops any extra cursors
+          BufferState_t* buffer_state = config_state->tab_current->view_current->buffer->user_data;
+          vim_multi_cursor_clear(&buffer_state->vim_buffer_state.multi_cursor);
+     }
 
      return CS_SUCCESS;
 }
@@ -908,8 +935,7 @@ CommandStatus_t command_terminal_goto(Command_t* command, void* user_data)
      if(config_state->terminal_current){
           // revive terminal if it is dead !
           if(!config_state->terminal_current->terminal.is_alive){
-               pthread_cancel(config_state->terminal_current->terminal.reader_thread);
-               pthread_join(config_state->terminal_current->terminal.reader_thread, NULL);
+               terminal_free(&config_state->terminal_current->terminal);
 
                if(!terminal_start_in_view(buffer_view, config_state->terminal_current, config_state)){
                     return CS_FAILURE;
@@ -976,6 +1002,8 @@ CommandStatus_t command_terminal_new(Command_t* command, void* user_data)
           return CS_FAILURE;
      }
 
+     node->terminal.scrollback_lines = config_state->terminal_scrollback_lines;
+
      if(!terminal_start_in_view(buffer_view, node, config_state)){
           return CS_FAILURE;
      }
@@ -1141,11 +1169,8 @@ CommandStatus_t command_completion_toggle(Command_t* command, void* user_data)
      Point_t* cursor = &buffer_view->cursor;
 
      if(auto_completing(&config_state->auto_complete)){
-          if(config_state->clang_complete_thread){
-               pthread_cancel(config_state->clang_complete_thread);
-               pthread_detach(config_state->clang_complete_thread);
-               config_state->clang_complete_thread = 0;
-          }
+          lsp_cancel_completion(config_state);
+          clang_completion_cancel();
 
           auto_complete_end(&config_state->auto_complete);
      }else{
@@ -1157,7 +1182,13 @@ CommandStatus_t command_completion_toggle(Command_t* command, void* user_data)
                }
           }
 
-          clang_completion(config_state, beginning_of_word);
+          if(!lsp_complete(config_state, beginning_of_word)){
+               if(buffer->type == BFT_C || buffer->type == BFT_CPP){
+                    clang_completion(config_state, beginning_of_word);
+               }else if(!word_completion(config_state, beginning_of_word)){
+                    ce_message("no words start with what is under the cursor");
+               }
+          }
      }
 
      return CS_SUCCESS;
@@ -1186,17 +1217,17 @@ CommandStatus_t command_completion_apply(Command_t* command, void* user_data)
                }else{
                     free(complete);
                }
-          }else if(config_state->auto_complete.type == ACT_OCCURANCE){
-               int64_t complete_len = strlen(config_state->auto_complete.current->option);
+          }else{ // the whole line is replaced by occurance and fuzzy matches
+               int64_t complete_len = strlen(auto_complete_current(&config_state->auto_complete));
                int64_t line_len = strlen(buffer->lines[config_state->auto_complete.start.y]);
                char* removed = ce_dupe_string(buffer, config_state->auto_complete.start,
                                               (Point_t){config_state->auto_complete.start.x + line_len - 1, config_state->auto_complete.start.y});
                if(ce_remove_string(buffer, config_state->auto_complete.start, line_len)){
                     ce_commit_remove_string(&buffer_state->commit_tail, config_state->auto_complete.start, *cursor, *cursor, removed, BCC_KEEP_GOING);
-                    if(ce_insert_string(buffer, config_state->auto_complete.start, config_state->auto_complete.current->option)){
+                    if(ce_insert_string(buffer, config_state->auto_complete.start, auto_complete_current(&config_state->auto_complete))){
                          Point_t save_cursor = *cursor;
                          cursor->x = config_state->auto_complete.start.x + complete_len;
-                         char* inserted = strdup(config_state->auto_complete.current->option);
+                         char* inserted = strdup(auto_complete_current(&config_state->auto_complete));
                          ce_commit_insert_string(&buffer_state->commit_tail, config_state->auto_complete.start, save_cursor, *cursor, inserted, BCC_KEEP_GOING);
                     }
                }
@@ -1208,7 +1239,7 @@ CommandStatus_t command_completion_apply(Command_t* command, void* user_data)
           default:
                break;
           case INPUT_LOAD_FILE:
-               completion_calc_start_and_path(&config_state->auto_complete,
+               completion_calc_start_and_path(&config_state->auto_complete, &config_state->dir_cache,
                                               buffer->lines[cursor->y],
                                               *cursor,
                                               config_state->completion_buffer,
@@ -1294,6 +1325,9 @@ CommandStatus_t command_cscope_goto_definition(Command_t* command, void* user_da
      ConfigState_t* config_state = command_data->config_state;
 
      if(command->arg_count == 0){
+          // the language server answers later, it jumps us there when it does
+          if(lsp_goto_definition(config_state)) return CS_SUCCESS;
+
           BufferView_t* buffer_view = config_state->tab_current->view_current;
           Buffer_t* buffer = buffer_view->buffer;
           Point_t* cursor = &buffer_view->cursor;
@@ -1302,17 +1336,62 @@ CommandStatus_t command_cscope_goto_definition(Command_t* command, void* user_da
           if(!ce_get_word_at_location(buffer, *cursor, &word_start, &word_end)) return CS_FAILURE;
           int len = (word_end.x - word_start.x) + 1;
           char* search_word = strndupa(buffer->lines[cursor->y] + word_start.x, len);
+          if(symbol_goto_definition(config_state, command_data->head, search_word)) return CS_SUCCESS;
           dest_cscope_goto_definition(config_state->tab_current->view_current, command_data->head, search_word);
           return CS_SUCCESS;
      }else if(command->args[0].type != CAT_STRING){
           return CS_PRINT_HELP;
      }
 
+     if(symbol_goto_definition(config_state, command_data->head, command->args[0].string)) return CS_SUCCESS;
      dest_cscope_goto_definition(config_state->tab_current->view_current, command_data->head, command->args[0].string);
 
      return CS_SUCCESS;
 }
 
+CommandStatus_t command_hover(Command_t* command, void* user_data)
+{
+     if(command->arg_count != 0) return CS_PRINT_HELP;
+
+     CommandData_t* command_data = (CommandData_t*)(user_data);
+     if(!lsp_hover(command_data->config_state)){
+          ce_message("no language server running for this buffer");
+          return CS_FAILURE;
+     }
+
+     return CS_SUCCESS;
+}
+
+CommandStatus_t command_symbol_references(Command_t* command, void* user_data)
+{
+     if(command->arg_count > 1) return CS_PRINT_HELP;
+     if(command->arg_count == 1 && command->args[0].type != CAT_STRING) return CS_PRINT_HELP;
+
+     CommandData_t* command_data = (CommandData_t*)(user_data);
+     ConfigState_t* config_state = command_data->config_state;
+
+     const char* word = NULL;
+     if(command->arg_count == 1){
+          word = command->args[0].string;
+     }else{
+          BufferView_t* buffer_view = config_state->tab_current->view_current;
+          Buffer_t* buffer = buffer_view->buffer;
+          Point_t* cursor = &buffer_view->cursor;
+
+          Point_t word_start, word_end;
+          if(!ce_get_word_at_location(buffer, *cursor, &word_start, &word_end)) return CS_FAILURE;
+          int len = (word_end.x - word_start.x) + 1;
+          word = strndupa(buffer->lines[cursor->y] + word_start.x, len);
+     }
+
+     if(!symbol_show_references(config_state, word)){
+          ce_message("the symbol index isn't ready yet");
+          return CS_FAILURE;
+     }
+
+     return CS_SUCCESS;
+}
+
 CommandStatus_t command_goto_file_under_cursor(Command_t* command, void* user_data)
 {
      if(command->arg_count != 0){
@@ -1442,3 +1521,52 @@ CommandStatus_t command_macro_backslashes(Command_t* command, void* user_data)
 
      return CS_SUCCESS;
 }
+
+CommandStatus_t command_multi_cursor_add(Command_t* command, void* user_data)
+{
+     if(command->arg_count != 1) return CS_PRINT_HELP;
+     if(command->args[0].type != CAT_STRING) return CS_PRINT_HELP;
+
+     CommandData_t* command_data = (CommandData_t*)(user_data);
+     ConfigState_t* config_state = command_data->config_state;
+     BufferView_t* buffer_view = config_state->tab_current->view_current;
+     Buffer_t* buffer = buffer_view->buffer;
+     BufferState_t* buffer_state = buffer->user_data;
+     VimMultiCursor_t* multi_cursor = &buffer_state->vim_buffer_state.multi_cursor;
+     Point_t* cursor = &buffer_view->cursor;
+
+     if(strcmp(command->args[0].string, "matches") == 0){
+          if(!config_state->vim_state.search.valid_regex){
+               ce_message("no search to add cursors at");
+               return CS_FAILURE;
+          }
+
+          int64_t added = vim_multi_cursor_add_matches(multi_cursor, buffer, &config_state->vim_state.search.regex, *cursor);
+          ce_message("added %"PRId64" cursors", added);
+     }else if(strcmp(command->args[0].string, "up") == 0 ||
+              strcmp(command->args[0].string, "down") == 0){
+          // leave a cursor behind and move the view's cursor along the column
+          int64_t delta = (strcmp(command->args[0].string, "up") == 0) ? -1 : 1;
+          Point_t location = *cursor;
+          ce_move_cursor(buffer, cursor, (Point_t){0, delta});
+          if(cursor->y == location.y) return CS_FAILURE;
+          if(!vim_multi_cursor_add(multi_cursor, location)) return CS_FAILURE;
+     }else{
+          ce_message("unrecognized option: '%s'", command->args[0].string);
+          return CS_PRINT_HELP;
+     }
+
+     return CS_SUCCESS;
+}
+
+CommandStatus_t command_multi_cursor_clear(Command_t* command, void* user_data)
+{
+     if(command->arg_count != 0) return CS_PRINT_HELP;
+
+     CommandData_t* command_data = (CommandData_t*)(user_data);
+     ConfigState_t* config_state = command_data->config_state;
+     BufferState_t* buffer_state = config_state->tab_current->view_current->buffer->user_data;
+
+     vim_multi_cursor_clear(&buffer_state->vim_buffer_state.multi_cursor);
+     return CS_SUCCESS;
+}
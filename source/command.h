@@ -84,6 +84,7 @@ CommandStatus_t command_show_macros(Command_t* command, void* user_data);
 CommandStatus_t command_show_yanks(Command_t* command, void* user_data); // LOL
 
 CommandStatus_t command_switch_buffer_dialogue(Command_t* command, void* user_data);
+CommandStatus_t command_find_file_dialogue(Command_t* command, void* user_data);
 CommandStatus_t command_command_dialogue(Command_t* command, void* user_data);
 CommandStatus_t command_search_dialogue(Command_t* command, void* user_data);
 CommandStatus_t command_load_file_dialogue(Command_t* command, void* user_data);
@@ -105,5 +106,10 @@ CommandStatus_t command_completion_next(Command_t* command, void* user_data);
 CommandStatus_t command_completion_previous(Command_t* command, void* user_data);
 
 CommandStatus_t command_cscope_goto_definition(Command_t* command, void* user_data);
+CommandStatus_t command_hover(Command_t* command, void* user_data);
+CommandStatus_t command_symbol_references(Command_t* command, void* user_data);
 CommandStatus_t command_goto_file_under_cursor(Command_t* command, void* user_data);
 CommandStatus_t command_macro_backslashes(Command_t* command, void* user_data);
+
+CommandStatus_t command_multi_cursor_add(Command_t* command, void* user_data);
+CommandStatus_t command_multi_cursor_clear(Command_t* command, void* user_data);
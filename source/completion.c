@@ -1,11 +1,16 @@
 #include "completion.h"
+#include "terminal_helper.h"
+#include "util.h"
 
 #include <assert.h>
 #include <dirent.h>
 #include <ctype.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <sys/wait.h>
 #include <sys/stat.h>
+#include <signal.h>
+#include <inttypes.h>
 
 extern pthread_mutex_t draw_lock;
 extern pthread_mutex_t completion_lock;
@@ -33,30 +38,40 @@ static void str_collapse_chars(char* string, char* collapseable_chars)
      *src = 0;
 }
 
-// NOTE: stderr is redirected to stdout
-static pid_t bidirectional_popen(const char* cmd, int* in_fd, int* out_fd)
+// NOTE: stderr is redirected to stdout. If stdin_fd is a file, like a memfd, the child reads it directly and in_fd is
+//       -1, otherwise we write its input to in_fd
+static pid_t bidirectional_popen(const char* cmd, int stdin_fd, int* in_fd, int* out_fd)
 {
-     int input_fds[2];
+     int input_fds[2] = {-1, -1};
      int output_fds[2];
 
-     if(pipe(input_fds) != 0) return 0;
-     if(pipe(output_fds) != 0) return 0;
+     if(stdin_fd < 0 && pipe(input_fds) != 0) return 0;
+     if(pipe(output_fds) != 0){
+          if(stdin_fd < 0){
+               close(input_fds[0]);
+               close(input_fds[1]);
+          }
+          return 0;
+     }
 
      pid_t pid = fork();
      if(pid < 0) return 0;
 
      if(pid == 0){
-          close(input_fds[1]);
+          if(stdin_fd < 0){
+               close(input_fds[1]);
+               stdin_fd = input_fds[0];
+          }
           close(output_fds[0]);
 
-          dup2(input_fds[0], STDIN_FILENO);
+          dup2(stdin_fd, STDIN_FILENO);
           dup2(output_fds[1], STDOUT_FILENO);
           dup2(output_fds[1], STDERR_FILENO);
 
           execl("/bin/sh", "/bin/sh", "-c", cmd, NULL);
           assert(0);
      }else{
-         close(input_fds[0]);
+         if(stdin_fd < 0) close(input_fds[0]);
          close(output_fds[1]);
 
          *in_fd = input_fds[1];
@@ -71,74 +86,108 @@ void completion_update_buffer(Buffer_t* completion_buffer, AutoComplete_t* auto_
      assert(completion_buffer->status == BS_READONLY);
      ce_clear_lines_readonly(completion_buffer);
 
-     int64_t match_len = 0;
-     if(match){
-          match_len = strlen(match);
-     }else{
-          match = "";
-     }
-     int64_t line_count = 0;
-     CompleteNode_t* itr = auto_complete->head;
-     char line[256];
-     while(itr){
-          bool matches = false;
+     int64_t match_count = auto_complete_narrow(auto_complete, match);
 
-          if(auto_complete->type == ACT_EXACT){
-               matches = (strncmp(itr->option, match, match_len) == 0 || match_len == 0);
-          }else if(auto_complete->type == ACT_OCCURANCE){
-               matches = (strstr(itr->option, match) || match_len == 0);
+     // NOTE: there may be thousands of matches, only the ones around the selected one make it into the buffer
+     int64_t top = auto_complete->window_top;
+     int64_t selected = auto_complete_current_match(auto_complete);
+     if(selected >= 0){
+          if(selected < top){
+               top = selected;
+          }else if(selected >= top + COMPLETION_MAX_LINES){
+               top = (selected - COMPLETION_MAX_LINES) + 1;
           }
+     }
+     if(top > match_count - COMPLETION_MAX_LINES) top = match_count - COMPLETION_MAX_LINES;
+     if(top < 0) top = 0;
+     auto_complete->window_top = top;
 
-          if(matches){
-               if(itr->description){
-                    snprintf(line, 256, "%s %s", itr->option, itr->description);
-               }else{
-                    snprintf(line, 256, "%s", itr->option);
-               }
+     int64_t bottom = top + COMPLETION_MAX_LINES;
+     if(bottom > match_count) bottom = match_count;
 
-               ce_append_line_readonly(completion_buffer, line);
-               line_count++;
+     char line[256];
+     for(int64_t i = top; i < bottom; ++i){
+          const CompleteOption_t* option = auto_complete->options + auto_complete->matches[i];
+          if(option->description){
+               snprintf(line, 256, "%s %s", option->option, option->description);
+          }else{
+               snprintf(line, 256, "%s", option->option);
+          }
 
-               if(itr == auto_complete->current){
-                    int64_t last_index = line_count - 1;
-                    completion_buffer->highlight_start = (Point_t){0, last_index};
-                    completion_buffer->highlight_end = (Point_t){strlen(completion_buffer->lines[last_index]), last_index};
-               }
+          ce_append_line_readonly(completion_buffer, line);
+
+          if(i == selected){
+               int64_t last_index = completion_buffer->line_count - 1;
+               completion_buffer->highlight_start = (Point_t){0, last_index};
+               completion_buffer->highlight_end = (Point_t){strlen(completion_buffer->lines[last_index]), last_index};
           }
+     }
+}
 
-          itr = itr->next;
+void completion_show_options(ConfigState_t* config_state, const Buffer_t* buffer, Point_t start)
+{
+     // if any elements existed, let us know
+     if(!config_state->auto_complete.option_count) return;
+
+     auto_complete_start(&config_state->auto_complete, ACT_EXACT, start);
+     Point_t end = config_state->tab_current->view_current->cursor;
+     end.x--;
+     if(end.x < 0) end.x = 0;
+     if(!ce_points_equal(start, end)){
+          char* match = ce_dupe_string(buffer, start, end);
+          // NOTE: options come best first, so keep the first one selected if it matches
+          auto_complete_select(&config_state->auto_complete, match);
+          completion_update_buffer(config_state->completion_buffer, &config_state->auto_complete, match);
+          free(match);
+     }else{
+          completion_update_buffer(config_state->completion_buffer, &config_state->auto_complete, "");
      }
 }
 
-bool completion_gen_files_in_current_dir(AutoComplete_t* auto_complete, const char* dir)
+bool completion_gen_files_in_current_dir(AutoComplete_t* auto_complete, DirCache_t* dir_cache, const char* dir,
+                                         bool* rebuilt)
 {
-     struct dirent *node;
-     DIR* os_dir = opendir(dir);
-     if(!os_dir) return false;
+     *rebuilt = false;
+
+     dir_cache_lock(dir_cache);
+     const DirListing_t* listing = dir_cache_list(dir_cache, dir);
+     if(!listing){
+          dir_cache_unlock(dir_cache);
+          return false;
+     }
+
+     // NOTE: while only the basename is being typed, the options we have are still the right ones
+     if(auto_complete->source && strcmp(auto_complete->source, dir) == 0 &&
+        auto_complete->source_version == listing->read){
+          dir_cache_unlock(dir_cache);
+          return auto_complete->option_count > 0;
+     }
 
      auto_complete_free(auto_complete);
+     *rebuilt = true;
 
      char tmp[PATH_MAX];
-     struct stat info;
-     while((node = readdir(os_dir)) != NULL){
-          snprintf(tmp, PATH_MAX, "%s/%s", dir, node->d_name);
-          stat(tmp, &info);
-          if(S_ISDIR(info.st_mode)){
-               snprintf(tmp, PATH_MAX, "%s/", node->d_name);
+     for(int64_t i = 0; i < listing->entry_count; ++i){
+          const DirEntry_t* entry = listing->entries + i;
+          if(entry->directory){
+               snprintf(tmp, PATH_MAX, "%s/", entry->name);
+               auto_complete_insert(auto_complete, tmp, NULL);
           }else{
-               strncpy(tmp, node->d_name, PATH_MAX);
+               auto_complete_insert(auto_complete, entry->name, NULL);
           }
-          auto_complete_insert(auto_complete, tmp, NULL);
      }
 
-     closedir(os_dir);
+     auto_complete->source = strdup(dir);
+     auto_complete->source_version = listing->read;
+
+     dir_cache_unlock(dir_cache);
 
-     if(!auto_complete->head) return false;
+     if(!auto_complete->option_count) return false;
      return true;
 }
 
-bool completion_calc_start_and_path(AutoComplete_t* auto_complete, const char* line, Point_t cursor,
-                                    Buffer_t* completion_buffer, const char* start_path)
+bool completion_calc_start_and_path(AutoComplete_t* auto_complete, DirCache_t* dir_cache, const char* line,
+                                    Point_t cursor, Buffer_t* completion_buffer, const char* start_path)
 {
      // we only auto complete in the case where the cursor is up against path with directories
      // -pat|
@@ -166,6 +215,7 @@ bool completion_calc_start_and_path(AutoComplete_t* auto_complete, const char* l
 
      // generate based on the path
      bool rc = false;
+     bool rebuilt = false;
      if(last_slash){
           int64_t user_path_len = (last_slash - path_begin) + 1;
 
@@ -184,7 +234,7 @@ bool completion_calc_start_and_path(AutoComplete_t* auto_complete, const char* l
                memcpy(path + start_path_len, path_begin, user_path_len);
                path[path_len] = 0;
 
-               rc = completion_gen_files_in_current_dir(auto_complete, path);
+               rc = completion_gen_files_in_current_dir(auto_complete, dir_cache, path, &rebuilt);
                free(path);
           }else{
                char* path = malloc(user_path_len + 1);
@@ -197,64 +247,268 @@ bool completion_calc_start_and_path(AutoComplete_t* auto_complete, const char* l
 
                path[user_path_len] = 0;
 
-               rc = completion_gen_files_in_current_dir(auto_complete, path);
+               rc = completion_gen_files_in_current_dir(auto_complete, dir_cache, path, &rebuilt);
                free(path);
           }
      }else{
-          rc = completion_gen_files_in_current_dir(auto_complete, start_path);
+          rc = completion_gen_files_in_current_dir(auto_complete, dir_cache, start_path, &rebuilt);
      }
 
      // set the start point if we generated files
      if(rc){
-          if(last_slash){
-               const char* completion = last_slash + 1;
-               auto_complete_start(auto_complete, ACT_OCCURANCE, (Point_t){(last_slash - line) + 1, cursor.y});
-               auto_complete_next(auto_complete, completion);
-               completion_update_buffer(completion_buffer, auto_complete, completion);
-          }else{
-               auto_complete_start(auto_complete, ACT_OCCURANCE, (Point_t){(path_begin - line), cursor.y});
-               auto_complete_next(auto_complete, path_begin);
-               completion_update_buffer(completion_buffer, auto_complete, path_begin);
+          const char* completion = last_slash ? last_slash + 1 : path_begin;
+          Point_t start = {completion - line, cursor.y};
+
+          if(rebuilt || !auto_completing(auto_complete) || !ce_points_equal(auto_complete->start, start)){
+               auto_complete_start(auto_complete, ACT_FUZZY, start);
+               auto_complete_select(auto_complete, completion);
+          }else if(!auto_complete_narrow(auto_complete, completion)){
+               auto_complete_end(auto_complete);
+          }else if(auto_complete_current_match(auto_complete) < 0){
+               // NOTE: only move the selection when what was typed no longer matches it
+               auto_complete_select(auto_complete, completion);
           }
+
+          completion_update_buffer(completion_buffer, auto_complete, completion);
      }
 
      pthread_mutex_unlock(&completion_lock);
      return rc;
 }
 
+#define CLANG_PREAMBLE_CACHE_SIZE 16
+#define CLANG_DEBOUNCE_MS 40 // a request has to go this long without being replaced before clang is run for it
+
+// the #include lines at the top of a file, compiled into a pch once so each completion doesn't reparse every header
+typedef struct{
+     char* filename; // NULL if the slot is unused
+     uint64_t hash; // of the command line and the preamble, the pch is rebuilt when it changes
+     bool built; // false if the preamble failed to compile, we don't try again until it changes
+}ClangPreamble_t;
+
 typedef struct{
-     Buffer_t* buffer_to_complete;
+     Buffer_t* buffer; // only compared against, the buffer may be gone by the time we have results
+     BufferFileType_t type;
+     char* filename;
+     int contents_fd; // memfd with the buffer as it was when the completion was asked for
+     char* line_prefix; // the line up to start, the results only apply while it is unchanged
      Point_t start;
      Point_t cursor;
-     Buffer_t* clang_output_buffer;
-     Buffer_t* completion_buffer;
-     AutoComplete_t* auto_complete;
+     uint64_t id; // the worker's generation when it was asked for, any newer request or cancel replaces it
+}ClangRequest_t;
+
+// completions are handled one at a time by a long lived thread, rather than a new thread for each keystroke
+typedef struct{
+     pthread_t thread;
+     pthread_mutex_t lock;
+     pthread_cond_t wake;
+     bool running;
+     ClangRequest_t* pending; // newest request, replaces any that wasn't picked up yet
+     uint64_t generation; // bumped by each request and cancel, so results for an old request are thrown away
+     pid_t pid; // clang process running for the current request, 0 if there isn't one
      ConfigState_t* config_state;
-}ClangCompleteThreadData_t;
+     char pch_directory[32]; // from mkdtemp(), empty if we couldn't make one
+     ClangPreamble_t preambles[CLANG_PREAMBLE_CACHE_SIZE];
+     int64_t next_preamble; // slot to reuse next once they are all taken
+}ClangWorker_t;
+
+bool completion_still_applies(const Buffer_t* buffer, Point_t cursor, Point_t start, const char* line_prefix)
+{
+     if(cursor.y != start.y || cursor.x < start.x || start.y >= buffer->line_count) return false;
+
+     const char* line = buffer->lines[start.y];
+     if(!line) line = "";
+
+     size_t length = strlen(line_prefix);
+     return (int64_t)(length) == start.x && strncmp(line, line_prefix, length) == 0;
+}
+
+static ClangWorker_t clang_worker = {.lock = PTHREAD_MUTEX_INITIALIZER, .wake = PTHREAD_COND_INITIALIZER};
+
+static void clang_request_free(ClangRequest_t* request)
+{
+     if(!request) return;
+     free(request->filename);
+     if(request->contents_fd >= 0) close(request->contents_fd);
+     free(request->line_prefix);
+     free(request);
+}
 
-void clang_complete_thread_cleanup(void* data)
+int64_t clang_preamble_length(const char* contents, int64_t size)
 {
-     free(data);
+     int64_t length = 0;
+     const char* line = contents;
+     const char* end = contents + size;
+
+     // NOTE: we stop at the first line that isn't blank, a comment or a preprocessor directive. If the preamble
+     //       leaves an #if open, the pch fails to build and we fall back on parsing everything
+     while(line < end){
+          const char* line_end = memchr(line, '\n', end - line);
+          if(!line_end) break;
+
+          const char* itr = line;
+          while(*itr == ' ' || *itr == '\t') itr++;
+
+          bool continued = line_end > line && line_end[-1] == '\\';
+          if(continued) break;
+
+          if(*itr != '#' && *itr != '\n' && strncmp(itr, "//", 2) != 0) break;
+
+          line = line_end + 1;
+          length = line - contents;
+     }
+
+     return length;
+}
+
+// clang reads the input from input_file if it isn't -1, otherwise we write it input_length bytes from input. Returns false
+// if the request was canceled while running
+static bool clang_run(const char* command, int input_file, const char* input, int64_t input_length,
+                      Buffer_t* output_buffer, uint64_t generation)
+{
+     // NOTE: the child shares the file's offset
+     if(input_file >= 0 && lseek(input_file, 0, SEEK_SET) != 0) return false;
+
+     int input_fd = -1;
+     int output_fd = 0;
+     pid_t pid = bidirectional_popen(command, input_file, &input_fd, &output_fd);
+     if(pid == 0){
+          ce_message("failed to do bidirectional_popen() with clang command\n");
+          return false;
+     }
+
+     // let a newer request kill the process rather than wait on it
+     pthread_mutex_lock(&clang_worker.lock);
+     bool canceled = clang_worker.generation != generation;
+     if(canceled){
+          kill(pid, SIGKILL);
+     }else{
+          clang_worker.pid = pid;
+     }
+     pthread_mutex_unlock(&clang_worker.lock);
+
+     // write buffer data to stdin
+     int64_t written = 0;
+     while(!canceled && input_fd >= 0 && written < input_length){
+          ssize_t bytes_written = write(input_fd, input + written, input_length - written);
+          if(bytes_written < 0){
+               if(errno == EINTR) continue;
+               if(errno != EPIPE) ce_message("failed to write to clang input fd: '%s'", strerror(errno));
+               break;
+          }
+          written += bytes_written;
+     }
+
+     if(input_fd >= 0) close(input_fd);
+
+     // collect output
+     char bytes[BUFSIZ];
+     while(true){
+          ssize_t byte_count = read(output_fd, bytes, BUFSIZ - 1);
+          if(byte_count < 0){
+               if(errno == EINTR) continue;
+               ce_message("%s() read from pid %d failed\n", __FUNCTION__, pid);
+               break;
+          }
+
+          if(byte_count == 0) break;
+
+          if(output_buffer){
+               bytes[byte_count] = 0;
+               ce_append_line(output_buffer, bytes);
+          }
+     }
+
+     close(output_fd);
+
+     // NOTE: the terminal's SIGCHLD handler may have reaped the process already
+     int status = 0;
+     while(waitpid(pid, &status, 0) < 0 && errno == EINTR);
+
+     pthread_mutex_lock(&clang_worker.lock);
+     clang_worker.pid = 0;
+     canceled = clang_worker.generation != generation;
+     pthread_mutex_unlock(&clang_worker.lock);
+
+     return !canceled;
 }
 
-void* clang_complete_thread(void* data)
+// builds the pch for the request's preamble if it changed, returns the slot to use, or -1 to parse without a pch
+static int64_t clang_prepare_preamble(const ClangRequest_t* request, const char* contents, const char* command_start,
+                                      const char* language_flag, int64_t preamble_length, uint64_t generation)
 {
-     ClangCompleteThreadData_t* thread_data = data;
+     // the preamble has to end before the completion does, or clang would complete in the pch
+     if(preamble_length == 0 || !clang_worker.pch_directory[0]) return -1;
+
+     int64_t preamble_lines = 0;
+     for(int64_t i = 0; i < preamble_length; ++i){
+          if(contents[i] == '\n') preamble_lines++;
+     }
+
+     if(request->cursor.y < preamble_lines) return -1;
+
+     uint64_t hash = util_hash(UTIL_HASH_SEED, command_start, strlen(command_start));
+     hash = util_hash(hash, contents, preamble_length);
+
+     int64_t slot = -1;
+     for(int64_t i = 0; i < CLANG_PREAMBLE_CACHE_SIZE; ++i){
+          if(clang_worker.preambles[i].filename && strcmp(clang_worker.preambles[i].filename, request->filename) == 0){
+               slot = i;
+               break;
+          }
+     }
+
+     ClangPreamble_t* preamble = NULL;
+     if(slot >= 0){
+          preamble = clang_worker.preambles + slot;
+          if(preamble->hash == hash) return preamble->built ? slot : -1;
+     }else{
+          slot = clang_worker.next_preamble;
+          clang_worker.next_preamble = (clang_worker.next_preamble + 1) % CLANG_PREAMBLE_CACHE_SIZE;
+
+          preamble = clang_worker.preambles + slot;
+          free(preamble->filename);
+          preamble->filename = strdup(request->filename);
+          if(!preamble->filename) return -1;
+     }
+
+     char pch_path[64];
+     snprintf(pch_path, sizeof(pch_path), "%s/%"PRId64".pch", clang_worker.pch_directory, slot);
+     unlink(pch_path);
 
-     pthread_cleanup_push(clang_complete_thread_cleanup, data);
+     // NOTE: clang only writes the pch if the preamble compiles, so whether the file is there is what tells us
+     char command[BUFSIZ];
+     snprintf(command, BUFSIZ, "%s %s-header - -o %s", command_start, language_flag, pch_path);
+     // NOTE: only part of the file is wanted, so this one goes through a pipe, straight from the mapping
+     bool finished = clang_run(command, -1, contents, preamble_length, NULL, generation);
+     if(!finished){
+          // try again next time
+          free(preamble->filename);
+          preamble->filename = NULL;
+          return -1;
+     }
+
+     preamble->hash = hash;
+     preamble->built = access(pch_path, F_OK) == 0;
+     return preamble->built ? slot : -1;
+}
+
+static void clang_complete(ClangRequest_t* request, uint64_t generation)
+{
+     ConfigState_t* config_state = clang_worker.config_state;
 
      const char* compiler = NULL;
      const char* language_flag = NULL;
 
-     if(thread_data->buffer_to_complete->type == BFT_C){
+     if(request->type == BFT_C){
           compiler = "clang";
           language_flag = "-x c";
-     }else if(thread_data->buffer_to_complete->type == BFT_CPP){
+     }else if(request->type == BFT_CPP){
           compiler = "clang++";
           language_flag = "-x c++";
      }else{
-          ce_message("unsupported clang completion on buffer type %d", thread_data->buffer_to_complete->type);
-          pthread_exit(NULL);
+          ce_message("unsupported clang completion on buffer type %d", request->type);
+          return;
      }
 
      // NOTE: extend to fit more flags
@@ -265,11 +519,11 @@ void* clang_complete_thread(void* data)
      base_include[0] = 0;
 
      // build flags filepath
-     if(thread_data->buffer_to_complete->name[0] == '/'){
-          const char* last_slash = strrchr(thread_data->buffer_to_complete->name, '/');
-          int path_len = last_slash - thread_data->buffer_to_complete->name;
-          snprintf(bytes, BUFSIZ, "%.*s/.clang_complete", path_len, thread_data->buffer_to_complete->name);
-          snprintf(base_include, PATH_MAX, "-I%.*s", path_len, thread_data->buffer_to_complete->name);
+     if(request->filename[0] == '/'){
+          const char* last_slash = strrchr(request->filename, '/');
+          int path_len = last_slash - request->filename;
+          snprintf(bytes, BUFSIZ, "%.*s/.clang_complete", path_len, request->filename);
+          snprintf(base_include, PATH_MAX, "-I%.*s", path_len, request->filename);
      }else{
           strncpy(bytes, ".clang_complete", BUFSIZ);
      }
@@ -291,87 +545,88 @@ void* clang_complete_thread(void* data)
                     strncpy(bytes + written, line, line_len);
                     written += line_len;
                }
-               bytes[written - 1] = 0;
+               if(written) bytes[written - 1] = 0;
                fclose(flags_file);
           }else{
-               pthread_exit(NULL);
+               return;
           }
      }
 
-     // run command
-     char command[BUFSIZ];
-     snprintf(command, BUFSIZ, "%s %s %s -fsyntax-only -ferror-limit=1 %s - -Xclang -code-completion-macros -Xclang -code-completion-at=-:%ld:%ld",
-              compiler, bytes, base_include, language_flag, thread_data->cursor.y + 1, thread_data->cursor.x + 1);
+     char command_start[BUFSIZ];
+     snprintf(command_start, BUFSIZ, "%s %s %s", compiler, bytes, base_include);
 
-     int input_fd = 0;
-     int output_fd = 0;
-     pid_t pid = bidirectional_popen(command, &input_fd, &output_fd);
-     if(pid == 0){
-          ce_message("failed to do bidirectional_popen() with clang command\n");
-          pthread_exit(NULL);
+     // NOTE: the snapshot is ours alone, so map it shared and edit it in place for clang to read
+     struct stat info;
+     if(fstat(request->contents_fd, &info) != 0) return;
+
+     int64_t contents_size = info.st_size;
+     char* contents = NULL;
+     if(contents_size){
+          contents = mmap(NULL, contents_size, PROT_READ | PROT_WRITE, MAP_SHARED, request->contents_fd, 0);
+          if(contents == MAP_FAILED){
+               ce_message("%s() mmap() failed: %s", __FUNCTION__, strerror(errno));
+               return;
+          }
      }
 
-     // write buffer data to stdin
-     char* contents = ce_dupe_buffer(thread_data->buffer_to_complete);
-     ssize_t len = strlen(contents);
-     ssize_t written = 0;
-
-     while(written < len){
-          ssize_t bytes_written = write(input_fd, contents + written, len - written);
-          if(bytes_written < 0){
-               ce_message("failed to write to clang input fd: '%s'", strerror(errno));
-               pthread_exit(NULL);
+     // blank out the preamble rather than remove it, so the line numbers don't change
+     int64_t preamble_length = contents ? clang_preamble_length(contents, contents_size) : 0;
+     int64_t preamble_slot = clang_prepare_preamble(request, contents, command_start, language_flag, preamble_length,
+                                                    generation);
+
+     char include_pch[96];
+     include_pch[0] = 0;
+     if(preamble_slot >= 0){
+          snprintf(include_pch, sizeof(include_pch), "-include-pch %s/%"PRId64".pch", clang_worker.pch_directory,
+                   preamble_slot);
+          for(int64_t i = 0; i < preamble_length; ++i){
+               if(contents[i] != '\n') contents[i] = ' ';
           }
-          written += bytes_written;
      }
 
-     close(input_fd);
+     // run command
+     char command[BUFSIZ * 2];
+     snprintf(command, sizeof(command), "%s %s -fsyntax-only -ferror-limit=1 %s - -Xclang -code-completion-macros -Xclang -code-completion-at=-:%ld:%ld",
+              command_start, include_pch, language_flag, request->cursor.y + 1, request->cursor.x + 1);
 
-     free(contents);
+     Buffer_t* clang_output_buffer = &config_state->clang_completion_buffer;
+     ce_clear_lines(clang_output_buffer);
 
-     ce_clear_lines(thread_data->clang_output_buffer);
+     bool finished = clang_run(command, request->contents_fd, NULL, 0, clang_output_buffer, generation);
+     if(contents) munmap(contents, contents_size);
+     if(!finished) return;
 
-     // collect output
-     int status = 0;
-     pid_t w;
-     ssize_t byte_count = 1;
-
-     do{
-          while(byte_count != 0){
-               byte_count = read(output_fd, bytes, BUFSIZ);
-               if(byte_count < 0){
-                    ce_message("%s() read from pid %d failed\n", __FUNCTION__, pid);
-                    pthread_exit(NULL);
-               }else if(byte_count > 0){
-                    bytes[byte_count] = 0;
-                    ce_append_line(thread_data->clang_output_buffer, bytes);
-               }
-          }
+     // wait for our interval limit, before drawing
+     struct timeval current_time;
+     gettimeofday(&current_time, NULL);
+     uint64_t elapsed = (current_time.tv_sec - config_state->last_draw_time.tv_sec) * 1000000LL +
+                        (current_time.tv_usec - config_state->last_draw_time.tv_usec);
+     if(elapsed < DRAW_USEC_LIMIT) usleep(DRAW_USEC_LIMIT - elapsed);
 
-          w = waitpid(pid, &status, WNOHANG);
-          if(w == -1){
-               pthread_exit(NULL);
-          }
+     // NOTE: the draw lock keeps the buffer from changing under us while we look at it. Take it before the completion
+     //       lock, the key handler takes them in that order
+     pthread_mutex_lock(&draw_lock);
+     pthread_mutex_lock(&completion_lock);
 
-          if(WIFEXITED(status)){
-               int rc = WEXITSTATUS(status);
-               if(rc != 0) ce_message("clang proccess pid %d exited, status = %d\n", pid, WEXITSTATUS(status));
-          }else if(WIFSIGNALED(status)){
-               ce_message("clang proccess pid %d killed by signal %d\n", pid, WTERMSIG(status));
-          }else if(WIFSTOPPED(status)){
-               ce_message("clang proccess pid %d stopped by signal %d\n", pid, WSTOPSIG(status));
-          }else if (WIFCONTINUED(status)){
-               ce_message("clang proccess pid %d continued\n", pid);
-          }
-     }while(!WIFEXITED(status) && !WIFSIGNALED(status));
+     pthread_mutex_lock(&clang_worker.lock);
+     bool canceled = clang_worker.generation != generation;
+     pthread_mutex_unlock(&clang_worker.lock);
+
+     BufferView_t* view = config_state->tab_current->view_current;
+     Buffer_t* buffer_to_complete = view->buffer;
+     if(canceled || buffer_to_complete != request->buffer ||
+        !completion_still_applies(buffer_to_complete, view->cursor, request->start, request->line_prefix)){
+          pthread_mutex_unlock(&completion_lock);
+          pthread_mutex_unlock(&draw_lock);
+          return;
+     }
 
-     pthread_mutex_lock(&completion_lock);
-     auto_complete_free(thread_data->auto_complete);
+     auto_complete_free(&config_state->auto_complete);
 
      // populate auto complete
      // addnstr : [#int#]addnstr(<#const char *#>, <#int#>)
-     for(int64_t i = 0; i < thread_data->clang_output_buffer->line_count; ++i){
-          const char* line = thread_data->clang_output_buffer->lines[i];
+     for(int64_t i = 0; i < clang_output_buffer->line_count; ++i){
+          const char* line = clang_output_buffer->lines[i];
           if(strncmp(line, "COMPLETION: ", 12) == 0){
                const char* start = line + 12;
                const char* end = strchr(start, ' ');
@@ -402,76 +657,233 @@ void* clang_complete_thread(void* data)
                          snprintf(bytes, BUFSIZ, "%.*s", (int)(type_end - type_start), type_start);
                     }
 
-                    auto_complete_insert(thread_data->auto_complete, option, bytes);
+                    auto_complete_insert(&config_state->auto_complete, option, bytes);
                }else{
-                    auto_complete_insert(thread_data->auto_complete, option, NULL);
+                    auto_complete_insert(&config_state->auto_complete, option, NULL);
                }
           }
      }
 
-     // if any elements existed, let us know
-     if(thread_data->auto_complete->head){
-          auto_complete_start(thread_data->auto_complete, ACT_EXACT, thread_data->start);
-          Point_t end = thread_data->cursor;
-          end.x--;
-          if(end.x < 0) end.x = 0;
-          if(!ce_points_equal(thread_data->start, end)){
-               char* match = ce_dupe_string(thread_data->buffer_to_complete, thread_data->start, end);
-               auto_complete_next(thread_data->auto_complete, match);
-               completion_update_buffer(thread_data->completion_buffer, thread_data->auto_complete, match);
-               free(match);
-          }else{
-               completion_update_buffer(thread_data->completion_buffer, thread_data->auto_complete, "");
-          }
-     }
+     completion_show_options(config_state, buffer_to_complete, request->start);
 
      pthread_mutex_unlock(&completion_lock);
 
-     // TODO: merge with terminal thread re-drawing code
-     struct timeval current_time;
-     uint64_t elapsed = 0;
+     view_drawer(config_state);
+     pthread_mutex_unlock(&draw_lock);
+}
 
-     // make sure the other view drawer is done before drawing
-     pthread_mutex_lock(&draw_lock);
+static void* clang_worker_thread(void* data)
+{
+     (void)(data);
 
-     // wait for our interval limit, before drawing
-     do{
-          gettimeofday(&current_time, NULL);
-          elapsed = (current_time.tv_sec - thread_data->config_state->last_draw_time.tv_sec) * 1000000LL +
-                    (current_time.tv_usec - thread_data->config_state->last_draw_time.tv_usec);
-     }while(elapsed < DRAW_USEC_LIMIT);
+     pthread_mutex_lock(&clang_worker.lock);
 
-     view_drawer(thread_data->config_state);
-     pthread_mutex_unlock(&draw_lock);
+     while(true){
+          while(clang_worker.running && !clang_worker.pending){
+               pthread_cond_wait(&clang_worker.wake, &clang_worker.lock);
+          }
+
+          if(!clang_worker.running) break;
 
-     pthread_cleanup_pop(data);
+          ClangRequest_t* request = clang_worker.pending;
+          uint64_t id = request->id;
 
+          // NOTE: typing a.b.c quickly asks for three completions, only the last is worth running clang for
+          struct timespec deadline;
+          clock_gettime(CLOCK_REALTIME, &deadline);
+          deadline.tv_nsec += CLANG_DEBOUNCE_MS * 1000000L;
+          if(deadline.tv_nsec >= 1000000000L){
+               deadline.tv_sec++;
+               deadline.tv_nsec -= 1000000000L;
+          }
+
+          while(clang_worker.running && clang_worker.generation == id){
+               if(pthread_cond_timedwait(&clang_worker.wake, &clang_worker.lock, &deadline) == ETIMEDOUT) break;
+          }
+
+          // a newer request or a cancel took its place, and already free'd it
+          if(!clang_worker.running) break;
+          if(clang_worker.generation != id) continue;
+
+          clang_worker.pending = NULL;
+
+          pthread_mutex_unlock(&clang_worker.lock);
+          clang_complete(request, id);
+          clang_request_free(request);
+          pthread_mutex_lock(&clang_worker.lock);
+     }
+
+     pthread_mutex_unlock(&clang_worker.lock);
      return NULL;
 }
 
-void clang_completion(ConfigState_t* config_state, Point_t start_completion)
+static bool clang_worker_start(ConfigState_t* config_state)
 {
-     if(config_state->clang_complete_thread){
-          pthread_cancel(config_state->clang_complete_thread);
-          pthread_detach(config_state->clang_complete_thread);
-          config_state->clang_complete_thread = 0;
+     if(clang_worker.running) return true;
+
+     clang_worker.config_state = config_state;
+
+     // NOTE: without somewhere to put the pchs, we still complete, just without them
+     snprintf(clang_worker.pch_directory, sizeof(clang_worker.pch_directory), "/tmp/ce_clang_XXXXXX");
+     if(!mkdtemp(clang_worker.pch_directory)){
+          ce_message("%s() mkdtemp() failed: %s", __FUNCTION__, strerror(errno));
+          clang_worker.pch_directory[0] = 0;
+     }
+
+     clang_worker.running = true;
+
+     int rc = pthread_create(&clang_worker.thread, NULL, clang_worker_thread, NULL);
+     if(rc != 0){
+          clang_worker.running = false;
+          ce_message("pthread_create() for clang auto complete failed");
+          return false;
      }
 
+     return true;
+}
+
+// clang_worker.lock must be held
+static void clang_cancel_locked()
+{
+     clang_request_free(clang_worker.pending);
+     clang_worker.pending = NULL;
+     clang_worker.generation++;
+     if(clang_worker.pid) kill(clang_worker.pid, SIGKILL);
+
+     // NOTE: the worker may be holding off on the request we just threw away
+     pthread_cond_signal(&clang_worker.wake);
+}
+
+void clang_completion_cancel()
+{
+     pthread_mutex_lock(&clang_worker.lock);
+     clang_cancel_locked();
+     pthread_mutex_unlock(&clang_worker.lock);
+}
+
+void clang_completion_stop()
+{
+     if(!clang_worker.running) return;
+
+     clang_completion_cancel();
+
+     pthread_mutex_lock(&clang_worker.lock);
+     clang_worker.running = false;
+     pthread_cond_signal(&clang_worker.wake);
+     pthread_mutex_unlock(&clang_worker.lock);
+
+     pthread_join(clang_worker.thread, NULL);
+
+     for(int64_t i = 0; i < CLANG_PREAMBLE_CACHE_SIZE; ++i){
+          ClangPreamble_t* preamble = clang_worker.preambles + i;
+          if(!preamble->filename) continue;
+
+          char pch_path[64];
+          snprintf(pch_path, sizeof(pch_path), "%s/%"PRId64".pch", clang_worker.pch_directory, i);
+          unlink(pch_path);
+
+          free(preamble->filename);
+          *preamble = (ClangPreamble_t){};
+     }
+
+     if(clang_worker.pch_directory[0]) rmdir(clang_worker.pch_directory);
+     clang_worker.pch_directory[0] = 0;
+     clang_worker.next_preamble = 0;
+}
+
+void clang_completion(ConfigState_t* config_state, Point_t start_completion)
+{
      if(auto_completing(&config_state->auto_complete)){
           auto_complete_end(&config_state->auto_complete);
      }
 
-     ClangCompleteThreadData_t* thread_data = malloc(sizeof(*thread_data));
-     if(!thread_data) return;
-     thread_data->buffer_to_complete = config_state->tab_current->view_current->buffer;
-     thread_data->start = start_completion;
-     thread_data->cursor = config_state->tab_current->view_current->cursor;
-     thread_data->clang_output_buffer = &config_state->clang_completion_buffer;
-     thread_data->completion_buffer = config_state->completion_buffer;
-     thread_data->auto_complete = &config_state->auto_complete;
-     thread_data->config_state = config_state;
-     int rc = pthread_create(&config_state->clang_complete_thread, NULL, clang_complete_thread, thread_data);
-     if(rc != 0){
-          ce_message("pthread_create() for clang auto complete failed");
+     if(!clang_worker_start(config_state)) return;
+
+     Buffer_t* buffer = config_state->tab_current->view_current->buffer;
+
+     ClangRequest_t* request = calloc(1, sizeof(*request));
+     if(!request) return;
+
+     request->buffer = buffer;
+     request->type = buffer->type;
+     request->filename = strdup(buffer->name);
+     request->contents_fd = ce_buffer_memfd(buffer);
+     request->start = start_completion;
+     request->cursor = config_state->tab_current->view_current->cursor;
+
+     const char* line = (start_completion.y < buffer->line_count) ? buffer->lines[start_completion.y] : NULL;
+     request->line_prefix = strndup(line ? line : "", start_completion.x);
+
+     if(!request->filename || request->contents_fd < 0 || !request->line_prefix){
+          clang_request_free(request);
+          return;
      }
+
+     // replace whatever we haven't gotten to yet, and stop working on what is already out of date
+     pthread_mutex_lock(&clang_worker.lock);
+     clang_cancel_locked();
+     request->id = clang_worker.generation;
+     clang_worker.pending = request;
+     pthread_cond_signal(&clang_worker.wake);
+     pthread_mutex_unlock(&clang_worker.lock);
+}
+
+void word_completion_sync(ConfigState_t* config_state, BufferNode_t* head)
+{
+     WordIndex_t* index = &config_state->word_index;
+
+     for(BufferNode_t* itr = head; itr; itr = itr->next){
+          Buffer_t* buffer = itr->buffer;
+          BufferState_t* buffer_state = buffer->user_data;
+
+          // NOTE: readonly buffers (messages, terminals, lists) change without commits, so each change would rescan
+          //       them from scratch, and the completion buffer only has words we already know
+          if(!buffer_state || !buffer_state->commit_tail || buffer == config_state->completion_buffer) continue;
+          if(buffer->status == BS_READONLY || is_terminal_buffer(config_state->terminal_head, buffer)) continue;
+
+          word_index_sync_buffer(index, buffer, buffer_state->commit_tail);
+     }
+
+     // forget the words of buffers that were deleted
+     for(int64_t i = index->buffer_count - 1; i >= 0; --i){
+          const Buffer_t* buffer = index->buffers[i].buffer;
+
+          BufferNode_t* itr = head;
+          while(itr && itr->buffer != buffer) itr = itr->next;
+          if(!itr) word_index_remove_buffer(index, buffer);
+     }
+}
+
+bool word_completion(ConfigState_t* config_state, Point_t start)
+{
+     BufferView_t* view = config_state->tab_current->view_current;
+     Buffer_t* buffer = view->buffer;
+     Point_t cursor = view->cursor;
+
+     int64_t length = cursor.x - start.x;
+     if(start.y != cursor.y || length < 0 || length > WORD_INDEX_MAX_LENGTH) return false;
+     if(!buffer->lines[cursor.y] || (int64_t)(strlen(buffer->lines[cursor.y])) < cursor.x) return false;
+
+     char prefix[WORD_INDEX_MAX_LENGTH + 1];
+     memcpy(prefix, buffer->lines[cursor.y] + start.x, length);
+     prefix[length] = 0;
+
+     WordMatch_t matches[WORD_COMPLETION_MAX_OPTIONS];
+     int64_t match_count = word_index_complete(&config_state->word_index, prefix, matches, WORD_COMPLETION_MAX_OPTIONS);
+
+     pthread_mutex_lock(&completion_lock);
+
+     auto_complete_free(&config_state->auto_complete);
+     for(int64_t i = 0; i < match_count; ++i){
+          auto_complete_insert(&config_state->auto_complete, matches[i].word, NULL);
+     }
+
+     if(match_count){
+          completion_show_options(config_state, buffer, start);
+     }else{
+          auto_complete_end(&config_state->auto_complete);
+     }
+
+     pthread_mutex_unlock(&completion_lock);
+     return match_count > 0;
 }
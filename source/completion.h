@@ -4,8 +4,26 @@
 #include "ce_config.h"
 #include "auto_complete.h"
 
+#define COMPLETION_MAX_LINES 64 // matches around the selected one put in the completion buffer, more than fit on screen
+
 void completion_update_buffer(Buffer_t* completion_buffer, AutoComplete_t* auto_complete, const char* match);
-bool completion_gen_files_in_current_dir(AutoComplete_t* auto_complete, const char* dir);
-bool completion_calc_start_and_path(AutoComplete_t* auto_complete, const char* line, Point_t cursor,
-                                    Buffer_t* completion_buffer, const char* start_path);
+void completion_show_options(ConfigState_t* config_state, const Buffer_t* buffer, Point_t start); // completion_lock must be held
+// sets *rebuilt if the options had to be generated, rather than being what dir held the last time
+bool completion_gen_files_in_current_dir(AutoComplete_t* auto_complete, DirCache_t* dir_cache, const char* dir,
+                                         bool* rebuilt);
+bool completion_calc_start_and_path(AutoComplete_t* auto_complete, DirCache_t* dir_cache, const char* line,
+                                    Point_t cursor, Buffer_t* completion_buffer, const char* start_path);
 void clang_completion(ConfigState_t* config_state, Point_t start_completion);
+void clang_completion_cancel();
+void clang_completion_stop();
+int64_t clang_preamble_length(const char* contents, int64_t size); // bytes of #include lines and such at the start, ends on a line
+
+// completions asked for at start are still worth showing if the cursor is still in the word being completed and
+// nothing before it on the line changed
+bool completion_still_applies(const Buffer_t* buffer, Point_t cursor, Point_t start, const char* line_prefix);
+
+#define WORD_COMPLETION_MIN_PREFIX 2
+#define WORD_COMPLETION_MAX_OPTIONS 32
+
+void word_completion_sync(ConfigState_t* config_state, BufferNode_t* head); // after each key
+bool word_completion(ConfigState_t* config_state, Point_t start); // false if no word starts with what is typed
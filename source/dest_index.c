@@ -0,0 +1,164 @@
+#include "dest_index.h"
+#include "util.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+static DestFile_t* find_slot(DestFile_t* files, int64_t capacity, const char* path)
+{
+     int64_t mask = capacity - 1;
+     int64_t i = util_hash_string(path) & mask;
+     while(files[i].path && strcmp(files[i].path, path) != 0) i = (i + 1) & mask;
+     return files + i;
+}
+
+static bool file_cache_grow(DestFileCache_t* cache)
+{
+     int64_t new_capacity = cache->capacity ? cache->capacity * 2 : 64;
+     DestFile_t* new_files = calloc(new_capacity, sizeof(*new_files));
+     if(!new_files){
+          ce_message("%s() failed to allocate %"PRId64" files", __FUNCTION__, new_capacity);
+          return false;
+     }
+
+     for(int64_t i = 0; i < cache->capacity; ++i){
+          if(cache->files[i].path) *find_slot(new_files, new_capacity, cache->files[i].path) = cache->files[i];
+     }
+
+     free(cache->files);
+     cache->files = new_files;
+     cache->capacity = new_capacity;
+     return true;
+}
+
+bool dest_file_exists(DestFileCache_t* cache, const char* path)
+{
+     if(cache->capacity){
+          DestFile_t* file = find_slot(cache->files, cache->capacity, path);
+          if(file->path){
+               if(file->exists) return true;
+
+               int64_t now = util_now_ms();
+               if(now - file->checked_ms < DEST_FILE_MISS_MS) return false;
+
+               file->exists = access(path, F_OK) == 0;
+               file->checked_ms = now;
+               return file->exists;
+          }
+     }
+
+     bool exists = access(path, F_OK) == 0;
+
+     // NOTE: output is full of words that look like file names, so don't let them pile up forever
+     if(cache->count >= DEST_FILE_CACHE_MAX) dest_file_cache_free(cache);
+
+     // keep the load factor under a half
+     if((cache->count + 1) * 2 > cache->capacity && !file_cache_grow(cache)) return exists;
+
+     char* path_copy = strdup(path);
+     if(!path_copy) return exists;
+
+     DestFile_t* file = find_slot(cache->files, cache->capacity, path);
+     file->path = path_copy;
+     file->exists = exists;
+     file->checked_ms = exists ? 0 : util_now_ms();
+     cache->count++;
+     return exists;
+}
+
+void dest_file_cache_free(DestFileCache_t* cache)
+{
+     for(int64_t i = 0; i < cache->capacity; ++i){
+          free(cache->files[i].path);
+     }
+
+     free(cache->files);
+     cache->files = NULL;
+     cache->count = 0;
+     cache->capacity = 0;
+}
+
+bool dest_index_add(DestIndex_t* index, int64_t line)
+{
+     assert(index->count == 0 || index->lines[index->count - 1] < line);
+
+     if(index->count == index->capacity){
+          int64_t new_capacity = index->capacity ? index->capacity * 2 : 64;
+          int64_t* new_lines = realloc(index->lines, new_capacity * sizeof(*new_lines));
+          if(!new_lines){
+               ce_message("%s() failed to grow to %"PRId64" lines", __FUNCTION__, new_capacity);
+               return false;
+          }
+
+          index->lines = new_lines;
+          index->capacity = new_capacity;
+     }
+
+     index->lines[index->count] = line;
+     index->count++;
+     return true;
+}
+
+// first entry in lines that is >= line, count if there isn't one
+static int64_t lower_bound(const DestIndex_t* index, int64_t line)
+{
+     int64_t low = 0;
+     int64_t high = index->count;
+     while(low < high){
+          int64_t middle = low + (high - low) / 2;
+          if(index->lines[middle] < line){
+               low = middle + 1;
+          }else{
+               high = middle;
+          }
+     }
+
+     return low;
+}
+
+void dest_index_invalidate(DestIndex_t* index, int64_t line)
+{
+     if(line >= index->scanned) return;
+     if(line < 0) line = 0;
+
+     index->count = lower_bound(index, line);
+     index->scanned = line;
+}
+
+void dest_index_shift(DestIndex_t* index, int64_t count)
+{
+     if(count <= 0) return;
+
+     int64_t dropped = lower_bound(index, count);
+     index->count -= dropped;
+     for(int64_t i = 0; i < index->count; ++i){
+          index->lines[i] = index->lines[i + dropped] - count;
+     }
+
+     index->scanned -= count;
+     if(index->scanned < 0) index->scanned = 0;
+}
+
+int64_t dest_index_next(const DestIndex_t* index, int64_t line, bool forwards)
+{
+     if(index->count == 0) return -1;
+
+     if(forwards){
+          int64_t next = lower_bound(index, line + 1);
+          return next < index->count ? next : 0;
+     }
+
+     int64_t previous = lower_bound(index, line) - 1;
+     return previous >= 0 ? previous : index->count - 1;
+}
+
+void dest_index_free(DestIndex_t* index)
+{
+     free(index->lines);
+     index->lines = NULL;
+     index->count = 0;
+     index->capacity = 0;
+     index->scanned = 0;
+     dest_file_cache_free(&index->file_cache);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "ce.h"
+
+// whether a file existed when we looked for it, so scanning output doesn't stat the same file every line
+typedef struct{
+     char* path; // NULL if the slot is empty
+     bool exists;
+     int64_t checked_ms; // when we last looked for a missing file
+}DestFile_t;
+
+#define DEST_FILE_CACHE_MAX 4096 // past this many files, the cache starts over
+#define DEST_FILE_MISS_MS 500 // look for a missing file again after this long, it may have been generated since
+
+typedef struct{
+     DestFile_t* files; // open addressing, capacity is a power of 2
+     int64_t count;
+     int64_t capacity;
+}DestFileCache_t;
+
+// lines of a terminal's buffer that hold a file destination, kept sorted as the output streams in
+typedef struct{
+     int64_t* lines;
+     int64_t count;
+     int64_t capacity;
+     int64_t scanned; // lines before this have been checked, the rest still need to be
+     DestFileCache_t file_cache;
+}DestIndex_t;
+
+bool dest_file_exists(DestFileCache_t* cache, const char* path);
+void dest_file_cache_free(DestFileCache_t* cache);
+
+bool dest_index_add(DestIndex_t* index, int64_t line); // line must be after every line in the index
+void dest_index_invalidate(DestIndex_t* index, int64_t line); // this line and the ones after it changed, rescan them
+void dest_index_shift(DestIndex_t* index, int64_t count); // count lines were dropped from the front of the buffer
+int64_t dest_index_next(const DestIndex_t* index, int64_t line, bool forwards); // index into lines, wraps, -1 if empty
+void dest_index_free(DestIndex_t* index);
@@ -15,19 +15,33 @@ static bool str_all_digits(const char* string)
      return true;
 }
 
-// NOTE: modifies last_jump only if we succeed
-bool dest_goto_file_location_in_buffer(BufferNode_t** head, Buffer_t* buffer, int64_t line, BufferView_t* head_view,
-                                       BufferView_t* view, int64_t* last_jump, char* terminal_current_directory)
+typedef struct{
+     char filename[BUFSIZ];
+     int line; // 1 indexed
+     int column; // 1 indexed, 0 if there wasn't one
+}FileLocation_t;
+
+static bool file_exists(DestFileCache_t* file_cache, const char* filename)
 {
-     if(!buffer->line_count) return false;
+     if(file_cache) return dest_file_exists(file_cache, filename);
+     return access(filename, F_OK) == 0;
+}
 
+// file_cache may be NULL, in which case we always check if the file exists
+// terminal_current_directory is NULL once the shell exits, so fall back on our own directory
+static bool parse_file_location(const Buffer_t* buffer, int64_t line, const char* terminal_current_directory,
+                                DestFileCache_t* file_cache, FileLocation_t* location)
+{
      assert(line >= 0);
      assert(line < buffer->line_count);
 
-     char filename[BUFSIZ];
+     if(!terminal_current_directory) terminal_current_directory = ".";
+
+     char* filename = location->filename;
      char line_number_str[BUFSIZ];
      char column_number_str[BUFSIZ];
 
+     line_number_str[0] = 0;
      column_number_str[0] = 0;
 
      // prepend the terminal current directory with a slash
@@ -58,7 +72,7 @@ bool dest_goto_file_location_in_buffer(BufferNode_t** head, Buffer_t* buffer, in
           char* first_slash = strchr(buffer->lines[file_line], '/');
           if(!first_slash) return false;
           strncpy(filename + filename_start, first_slash + 1, BUFSIZ - filename_start);
-          if(access(filename, F_OK) == -1) return false; // file does not exist
+          if(!file_exists(file_cache, filename)) return false;
 
           char* plus = strchr(buffer->lines[line], '+');
           if(!plus) return false;
@@ -80,11 +94,14 @@ bool dest_goto_file_location_in_buffer(BufferNode_t** head, Buffer_t* buffer, in
           if(!file_end) return false;
 
           int64_t filename_len = file_end - (open_paren + 1);
-          if(filename_len > (BUFSIZ - filename_start)) return false;
+          if(filename_len >= (BUFSIZ - filename_start)) return false;
           strncpy(filename + filename_start, (open_paren + 1), filename_len);
+          filename[filename_start + filename_len] = 0;
 
           int64_t line_number_len = (close_paren - file_end) - 1;
+          if(line_number_len < 0 || line_number_len >= BUFSIZ) return false;
           strncpy(line_number_str, file_end + 1, line_number_len);
+          line_number_str[line_number_len] = 0;
 
           if(!str_all_digits(line_number_str)) return false;
      }else{
@@ -94,10 +111,10 @@ bool dest_goto_file_location_in_buffer(BufferNode_t** head, Buffer_t* buffer, in
           if(!file_end) return false;
           if(buffer->lines[line][0] == '/') filename_start = 0; // if the buffer line starts with a '/', then overwrite the initial path
           int64_t filename_len = file_end - buffer->lines[line];
-          if(filename_len > (BUFSIZ - filename_start)) return false;
+          if(filename_len >= (BUFSIZ - filename_start)) return false;
           strncpy(filename + filename_start, buffer->lines[line], filename_len);
           filename[filename_start + filename_len] = 0;
-          if(access(filename, F_OK) == -1) return false; // file does not exist
+          if(!file_exists(file_cache, filename)) return false;
 
           char* line_number_begin_delim = NULL;
           char* line_number_end_delim = NULL;
@@ -132,21 +149,44 @@ bool dest_goto_file_location_in_buffer(BufferNode_t** head, Buffer_t* buffer, in
           }
      }
 
-     if(line_number_str[0]){
-          int line_number = atoi(line_number_str);
-          int column = (*column_number_str) ? atoi(column_number_str) : 0;
-          bool opened_file = dest_open_file(head, view, filename, line_number, column);
-          if(opened_file){
-               BufferView_t* command_view = ce_buffer_in_view(head_view, buffer);
-               if(command_view) command_view->top_row = line;
-               *last_jump = line;
-               return true;
-          }
+     if(!line_number_str[0]) return false;
+
+     location->line = atoi(line_number_str);
+     location->column = (*column_number_str) ? atoi(column_number_str) : 0;
+     return true;
+}
+
+// NOTE: modifies last_jump only if we succeed
+bool dest_goto_file_location_in_buffer(BufferNode_t** head, Buffer_t* buffer, int64_t line, BufferView_t* head_view,
+                                       BufferView_t* view, int64_t* last_jump, char* terminal_current_directory)
+{
+     if(!buffer->line_count) return false;
+
+     FileLocation_t location;
+     if(!parse_file_location(buffer, line, terminal_current_directory, NULL, &location)) return false;
+
+     if(dest_open_file(head, view, location.filename, location.line, location.column)){
+          BufferView_t* command_view = ce_buffer_in_view(head_view, buffer);
+          if(command_view) command_view->top_row = line;
+          *last_jump = line;
+          return true;
      }
 
      return false;
 }
 
+void dest_index_update(DestIndex_t* index, const Buffer_t* buffer, const char* terminal_current_directory)
+{
+     FileLocation_t location;
+     for(; index->scanned < buffer->line_count; index->scanned++){
+          if(!parse_file_location(buffer, index->scanned, terminal_current_directory, &index->file_cache, &location)){
+               continue;
+          }
+
+          if(!dest_index_add(index, index->scanned)) return;
+     }
+}
+
 void dest_jump_to_next_in_terminal(BufferNode_t** head, TerminalNode_t* terminal_head, TerminalNode_t** terminal_current,
                                    BufferView_t* view_head, BufferView_t* view_current, bool forwards)
 {
@@ -168,17 +208,14 @@ void dest_jump_to_next_in_terminal(BufferNode_t** head, TerminalNode_t* terminal
           }
      }
 
-     int64_t lines_checked = 0;
-     int64_t delta = forwards ? 1 : -1;
-     for(int64_t i = (*terminal_current)->last_jump_location + delta; lines_checked < terminal_buffer->line_count;
-         i += delta, lines_checked++){
-          if(i == terminal_buffer->line_count && forwards){
-               i = 0;
-          }else if(i <= 0 && !forwards){
-               i = terminal_buffer->line_count - 1;
-          }
+     // NOTE: the index only holds lines that parsed when they came in, the file may be gone by now, so keep going
+     //       until one opens
+     DestIndex_t* index = &(*terminal_current)->destinations;
+     char* terminal_current_directory = terminal_get_current_directory(&(*terminal_current)->terminal);
+     int64_t from = (*terminal_current)->last_jump_location;
 
-          char* terminal_current_directory = terminal_get_current_directory(&(*terminal_current)->terminal);
+     for(int64_t checked = 0; checked < index->count; ++checked){
+          int64_t i = index->lines[dest_index_next(index, from, forwards)];
           if(dest_goto_file_location_in_buffer(head, terminal_buffer, i, view_head,
                                                view_current, &(*terminal_current)->last_jump_location,
                                                terminal_current_directory)){
@@ -186,12 +223,13 @@ void dest_jump_to_next_in_terminal(BufferNode_t** head, TerminalNode_t* terminal
                terminal_buffer->cursor.x = 0;
                terminal_buffer->cursor.y = i;
                if(terminal_view) terminal_view->cursor = terminal_buffer->cursor;
-               free(terminal_current_directory);
                break;
           }
 
-          free(terminal_current_directory);
+          from = i;
      }
+
+     free(terminal_current_directory);
 }
 
 void dest_cscope_goto_definition(BufferView_t* view_current, BufferNode_t** head, const char* search_word)
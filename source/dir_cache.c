@@ -0,0 +1,258 @@
+#include "dir_cache.h"
+#include "util.h"
+#include "ce.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define WATCH_EVENTS (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | \
+                      IN_ONLYDIR)
+
+bool dir_cache_init(DirCache_t* cache)
+{
+     memset(cache, 0, sizeof(*cache));
+     pthread_mutex_init(&cache->lock, NULL);
+
+     cache->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+     if(cache->inotify_fd < 0){
+          ce_message("%s() inotify_init1() failed: %s, checking directory modification times instead", __FUNCTION__,
+                     strerror(errno));
+     }
+
+     return true;
+}
+
+static void free_listing(DirListing_t* listing)
+{
+     free(listing->path);
+     free(listing->entries);
+     free(listing->names);
+     memset(listing, 0, sizeof(*listing));
+     listing->watch = -1;
+}
+
+void dir_cache_free(DirCache_t* cache)
+{
+     for(int64_t i = 0; i < cache->listing_count; ++i){
+          free_listing(cache->listings + i);
+     }
+     cache->listing_count = 0;
+
+     // NOTE: closing the instance drops all of its watches
+     if(cache->inotify_fd >= 0) close(cache->inotify_fd);
+     cache->inotify_fd = -1;
+
+     pthread_mutex_destroy(&cache->lock);
+}
+
+void dir_cache_lock(DirCache_t* cache)
+{
+     pthread_mutex_lock(&cache->lock);
+}
+
+void dir_cache_unlock(DirCache_t* cache)
+{
+     pthread_mutex_unlock(&cache->lock);
+}
+
+// NOTE: watching the same directory through two paths gives back the same watch, so more than one listing may match
+static void stale_watch(DirCache_t* cache, int watch, bool removed)
+{
+     for(int64_t i = 0; i < cache->listing_count; ++i){
+          DirListing_t* listing = cache->listings + i;
+          if(listing->watch != watch) continue;
+          listing->stale = true;
+          if(removed) listing->watch = -1;
+     }
+}
+
+static void read_events(DirCache_t* cache)
+{
+     if(cache->inotify_fd < 0) return;
+
+     char events[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+     while(true){
+          ssize_t length = read(cache->inotify_fd, events, sizeof(events));
+          if(length <= 0) break;
+
+          for(char* itr = events; itr < events + length;){
+               const struct inotify_event* event = (const struct inotify_event*)(itr);
+
+               if(event->mask & IN_Q_OVERFLOW){
+                    for(int64_t i = 0; i < cache->listing_count; ++i){
+                         cache->listings[i].stale = true;
+                    }
+               }else{
+                    stale_watch(cache, event->wd, event->mask & IN_IGNORED);
+               }
+
+               itr += sizeof(*event) + event->len;
+          }
+     }
+}
+
+static bool modified_since(const DirListing_t* listing)
+{
+     struct stat info;
+     if(stat(listing->path, &info) != 0) return true;
+     return info.st_mtim.tv_sec != listing->modified.tv_sec || info.st_mtim.tv_nsec != listing->modified.tv_nsec;
+}
+
+static bool entry_is_directory(const char* dir, const struct dirent* node)
+{
+     char path[PATH_MAX];
+     snprintf(path, PATH_MAX, "%s/%s", dir, node->d_name);
+     return util_entry_is_directory(path, node, true);
+}
+
+static bool read_listing(DirCache_t* cache, DirListing_t* listing)
+{
+     // NOTE: watch before reading, so nothing can change in between without us hearing about it
+     if(listing->watch < 0 && cache->inotify_fd >= 0){
+          listing->watch = inotify_add_watch(cache->inotify_fd, listing->path, WATCH_EVENTS);
+     }
+
+     struct stat info;
+     if(stat(listing->path, &info) != 0) return false;
+     listing->modified = info.st_mtim;
+
+     DIR* os_dir = opendir(listing->path);
+     if(!os_dir) return false;
+
+     int64_t entry_count = 0;
+     int64_t entry_capacity = 64;
+     int64_t names_size = 0;
+     int64_t names_capacity = 4096;
+     DirEntry_t* entries = malloc(entry_capacity * sizeof(*entries));
+     char* names = malloc(names_capacity);
+     bool success = entries && names;
+
+     struct dirent* node;
+     while(success && (node = readdir(os_dir)) != NULL){
+          int64_t name_size = strlen(node->d_name) + 1;
+
+          if(entry_count == entry_capacity){
+               entry_capacity *= 2;
+               DirEntry_t* new_entries = realloc(entries, entry_capacity * sizeof(*new_entries));
+               if(!new_entries){
+                    success = false;
+                    break;
+               }
+               entries = new_entries;
+          }
+
+          if(names_size + name_size > names_capacity){
+               while(names_size + name_size > names_capacity) names_capacity *= 2;
+               char* new_names = realloc(names, names_capacity);
+               if(!new_names){
+                    success = false;
+                    break;
+               }
+               names = new_names;
+          }
+
+          // NOTE: names may still move, so hold on to offsets until we are done
+          memcpy(names + names_size, node->d_name, name_size);
+          entries[entry_count].name = (const char*)(uintptr_t)(names_size);
+          entries[entry_count].directory = entry_is_directory(listing->path, node);
+          entry_count++;
+          names_size += name_size;
+     }
+
+     closedir(os_dir);
+
+     if(!success){
+          ce_message("%s() failed to allocate listing of %s", __FUNCTION__, listing->path);
+          free(entries);
+          free(names);
+          return false;
+     }
+
+     for(int64_t i = 0; i < entry_count; ++i){
+          entries[i].name = names + (uintptr_t)(entries[i].name);
+     }
+
+     free(listing->entries);
+     free(listing->names);
+     listing->entries = entries;
+     listing->entry_count = entry_count;
+     listing->names = names;
+     listing->stale = false;
+     listing->read = ++cache->reads;
+     return true;
+}
+
+static void evict(DirCache_t* cache, DirListing_t* listing)
+{
+     bool shared = false;
+     for(int64_t i = 0; i < cache->listing_count; ++i){
+          const DirListing_t* other = cache->listings + i;
+          if(other != listing && other->watch >= 0 && other->watch == listing->watch) shared = true;
+     }
+
+     if(listing->watch >= 0 && !shared) inotify_rm_watch(cache->inotify_fd, listing->watch);
+
+     int64_t index = listing - cache->listings;
+     free_listing(listing);
+     cache->listings[index] = cache->listings[--cache->listing_count];
+}
+
+const DirListing_t* dir_cache_list(DirCache_t* cache, const char* path)
+{
+     char key[PATH_MAX];
+     strncpy(key, path, PATH_MAX - 1);
+     key[PATH_MAX - 1] = 0;
+
+     // NOTE: "dir" and "dir/" are the same listing
+     int64_t key_len = strlen(key);
+     while(key_len > 1 && key[key_len - 1] == '/') key[--key_len] = 0;
+
+     read_events(cache);
+     cache->uses++;
+
+     DirListing_t* listing = NULL;
+     for(int64_t i = 0; i < cache->listing_count; ++i){
+          if(strcmp(cache->listings[i].path, key) == 0){
+               listing = cache->listings + i;
+               break;
+          }
+     }
+
+     if(listing){
+          if(listing->watch < 0 && !listing->stale) listing->stale = modified_since(listing);
+          if(listing->stale && !read_listing(cache, listing)){
+               evict(cache, listing);
+               return NULL;
+          }
+          listing->last_used = cache->uses;
+          return listing;
+     }
+
+     if(cache->listing_count == DIR_CACHE_MAX_LISTINGS){
+          DirListing_t* oldest = cache->listings;
+          for(int64_t i = 1; i < cache->listing_count; ++i){
+               if(cache->listings[i].last_used < oldest->last_used) oldest = cache->listings + i;
+          }
+          evict(cache, oldest);
+     }
+
+     listing = cache->listings + cache->listing_count;
+     memset(listing, 0, sizeof(*listing));
+     listing->watch = -1;
+     listing->path = strdup(key);
+     if(!listing->path) return NULL;
+     cache->listing_count++;
+
+     if(!read_listing(cache, listing)){
+          evict(cache, listing);
+          return NULL;
+     }
+
+     listing->last_used = cache->uses;
+     return listing;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+// directory listings kept around between completions, inotify tells us when one needs to be read again. Where we run
+// out of inotify watches, the directory's modification time is checked instead
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#define DIR_CACHE_MAX_LISTINGS 64 // the least recently used is dropped past this
+
+typedef struct{
+     const char* name;
+     bool directory; // following symlinks
+}DirEntry_t;
+
+typedef struct{
+     char* path;
+     int watch; // -1 if we aren't watching it
+     struct timespec modified;
+     bool stale;
+     uint64_t last_used;
+     DirEntry_t* entries;
+     int64_t entry_count;
+     char* names; // every entry's name back to back, entries point in here
+     uint64_t read; // which of the cache's reads filled in the entries, so it changes whenever they might have
+}DirListing_t;
+
+typedef struct{
+     int inotify_fd; // -1 if inotify isn't available, then every listing is checked by modification time
+     DirListing_t listings[DIR_CACHE_MAX_LISTINGS];
+     int64_t listing_count;
+     uint64_t uses;
+     uint64_t reads;
+     pthread_mutex_t lock;
+}DirCache_t;
+
+bool dir_cache_init(DirCache_t* cache);
+void dir_cache_free(DirCache_t* cache);
+
+// the listing is only good until the cache is unlocked, NULL if the directory can't be read
+void dir_cache_lock(DirCache_t* cache);
+void dir_cache_unlock(DirCache_t* cache);
+const DirListing_t* dir_cache_list(DirCache_t* cache, const char* path);
@@ -0,0 +1,1190 @@
+#include "file_index.h"
+#include "symbol_index.h"
+#include "util.h"
+#include "ce.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define WATCH_EVENTS (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_ONLYDIR)
+#define MAX_SETTLE_MS 1000 // a steady stream of changes still shows up this often
+
+static const char file_index_magic[8] = {'C', 'E', 'F', 'I', 'L', 'E', 'S', 0};
+
+static char removed_slot;
+#define FILE_SET_REMOVED (&removed_slot)
+
+static bool push(void** array, int64_t* count, int64_t* capacity, size_t element_size, const void* element)
+{
+     if(*count == *capacity){
+          int64_t new_capacity = *capacity ? *capacity * 2 : 16;
+          void* new_array = realloc(*array, new_capacity * element_size);
+          if(!new_array) return false;
+          *array = new_array;
+          *capacity = new_capacity;
+     }
+
+     memcpy((char*)(*array) + *count * element_size, element, element_size);
+     (*count)++;
+     return true;
+}
+
+// glob matching
+
+static const char* class_end(const char* pattern)
+{
+     const char* itr = pattern + 1;
+     if(*itr == '!' || *itr == '^') itr++;
+     if(*itr == ']') itr++;
+     while(*itr && *itr != ']') itr++;
+     return *itr ? itr : NULL;
+}
+
+static bool class_match(const char* pattern, const char* end, char c)
+{
+     const char* itr = pattern + 1;
+     bool negate = (*itr == '!' || *itr == '^');
+     if(negate) itr++;
+
+     bool found = false;
+     while(itr < end){
+          if(itr + 2 < end && itr[1] == '-'){
+               if(c >= itr[0] && c <= itr[2]) found = true;
+               itr += 3;
+          }else{
+               if(*itr == c) found = true;
+               itr++;
+          }
+     }
+
+     return found != negate;
+}
+
+bool file_index_glob_match(const char* pattern, const char* path)
+{
+     while(*pattern){
+          if(pattern[0] == '*' && pattern[1] == '*'){
+               if(!pattern[2]) return true;
+
+               if(pattern[2] == '/'){
+                    // NOTE: "**/" matches any number of whole directories, including none
+                    for(const char* itr = path; *itr; ++itr){
+                         if((itr == path || itr[-1] == '/') && file_index_glob_match(pattern + 3, itr)) return true;
+                    }
+                    return false;
+               }
+
+               // anywhere else it is just a *
+               pattern++;
+          }
+
+          if(*pattern == '*'){
+               pattern++;
+               for(const char* itr = path; ; ++itr){
+                    if(file_index_glob_match(pattern, itr)) return true;
+                    if(!*itr || *itr == '/') return false;
+               }
+          }
+
+          if(!*path) return false;
+
+          if(*pattern == '?'){
+               if(*path == '/') return false;
+               pattern++;
+               path++;
+               continue;
+          }
+
+          if(*pattern == '['){
+               const char* end = class_end(pattern);
+               if(end){
+                    if(*path == '/' || !class_match(pattern, end, *path)) return false;
+                    pattern = end + 1;
+                    path++;
+                    continue;
+               }
+          }
+
+          if(*pattern == '\\' && pattern[1]) pattern++;
+          if(*pattern != *path) return false;
+          pattern++;
+          path++;
+     }
+
+     return !*path;
+}
+
+// ignore rules
+
+static void parse_ignore_file(IgnoreRules_t* rules, const char* path)
+{
+     FILE* file = fopen(path, "r");
+     if(!file) return;
+
+     char* line = NULL;
+     size_t size = 0;
+     ssize_t length;
+
+     while((length = getline(&line, &size, file)) >= 0){
+          while(length && isspace((unsigned char)(line[length - 1]))) line[--length] = 0;
+
+          char* pattern = line;
+          if(!*pattern || *pattern == '#') continue;
+
+          IgnoreRule_t rule = {};
+          if(*pattern == '!'){
+               rule.negate = true;
+               pattern++;
+          }else if(*pattern == '\\' && (pattern[1] == '!' || pattern[1] == '#')){
+               pattern++;
+          }
+
+          length = strlen(pattern);
+          if(length && pattern[length - 1] == '/'){
+               rule.directory_only = true;
+               pattern[--length] = 0;
+          }
+
+          // NOTE: a slash anywhere but the end ties the pattern to the .gitignore's directory
+          if(strchr(pattern, '/')) rule.anchored = true;
+          if(*pattern == '/') pattern++;
+          if(!*pattern) continue;
+
+          rule.pattern = strdup(pattern);
+          if(!rule.pattern) continue;
+
+          if(!push((void**)&rules->rules, &rules->count, &rules->capacity, sizeof(rule), &rule)) free(rule.pattern);
+     }
+
+     free(line);
+     fclose(file);
+}
+
+static void free_rules(IgnoreRules_t* rules)
+{
+     for(int64_t i = 0; i < rules->count; ++i) free(rules->rules[i].pattern);
+     free(rules->rules);
+     free(rules->base);
+     free(rules);
+}
+
+static void free_arena(IgnoreArena_t* arena)
+{
+     for(int64_t i = 0; i < arena->count; ++i) free_rules(arena->all[i]);
+     free(arena->all);
+     memset(arena, 0, sizeof(*arena));
+}
+
+// the rules for a directory are its own .gitignore on top of its parent's, a directory without one just shares its
+// parent's rules
+static IgnoreRules_t* directory_rules(const char* root, const char* directory, IgnoreRules_t* parent,
+                                      IgnoreArena_t* arena, pthread_mutex_t* arena_lock)
+{
+     IgnoreRules_t* rules = calloc(1, sizeof(*rules));
+     if(!rules) return parent;
+
+     rules->parent = parent;
+     rules->base = strdup(directory);
+
+     char path[PATH_MAX];
+     if(!directory[0]){
+          // NOTE: the repository's own excludes come first, so the .gitignore can override them
+          snprintf(path, sizeof(path), "%s/.git/info/exclude", root);
+          parse_ignore_file(rules, path);
+          snprintf(path, sizeof(path), "%s/.gitignore", root);
+     }else{
+          snprintf(path, sizeof(path), "%s/%s/.gitignore", root, directory);
+     }
+     parse_ignore_file(rules, path);
+
+     if(!rules->base || !rules->count){
+          free_rules(rules);
+          return parent;
+     }
+
+     if(arena_lock) pthread_mutex_lock(arena_lock);
+     bool pushed = push((void**)&arena->all, &arena->count, &arena->capacity, sizeof(rules), &rules);
+     if(arena_lock) pthread_mutex_unlock(arena_lock);
+
+     if(!pushed){
+          free_rules(rules);
+          return parent;
+     }
+
+     return rules;
+}
+
+// deeper .gitignores win, and within one the last rule that matches wins
+static bool ignored(const IgnoreRules_t* rules, const char* path, const char* name, bool directory)
+{
+     for(; rules; rules = rules->parent){
+          size_t base_length = strlen(rules->base);
+          const char* relative = base_length ? path + base_length + 1 : path;
+
+          for(int64_t i = rules->count - 1; i >= 0; --i){
+               const IgnoreRule_t* rule = rules->rules + i;
+               if(rule->directory_only && !directory) continue;
+               if(file_index_glob_match(rule->pattern, rule->anchored ? relative : name)) return !rule->negate;
+          }
+     }
+
+     return false;
+}
+
+// things that never belong in the index, whatever the .gitignore says
+static bool skipped(const char* directory, const char* name)
+{
+     if(strcmp(name, ".") == 0 || strcmp(name, "..") == 0) return true;
+     if(strcmp(name, ".git") == 0) return true;
+     if(directory[0]) return false;
+
+     // our own indexes, and the temporary files they are written through
+     return strcmp(name, FILE_INDEX_FILE) == 0 || strcmp(name, FILE_INDEX_FILE ".tmp") == 0 ||
+            strcmp(name, SYMBOL_INDEX_FILE) == 0 || strcmp(name, SYMBOL_INDEX_FILE ".tmp") == 0;
+}
+
+// the set of files
+
+static bool set_rehash(FileSet_t* set)
+{
+     int64_t new_capacity = 1024;
+     while(new_capacity < (set->count + 1) * 4) new_capacity *= 2;
+
+     char** new_slots = calloc(new_capacity, sizeof(*new_slots));
+     if(!new_slots) return false;
+
+     for(int64_t i = 0; i < set->capacity; ++i){
+          char* path = set->slots[i];
+          if(!path || path == FILE_SET_REMOVED) continue;
+
+          uint64_t slot = util_hash_string(path) & (new_capacity - 1);
+          while(new_slots[slot]) slot = (slot + 1) & (new_capacity - 1);
+          new_slots[slot] = path;
+     }
+
+     free(set->slots);
+     set->slots = new_slots;
+     set->capacity = new_capacity;
+     set->used = set->count;
+     return true;
+}
+
+// takes the path, which is free'd if it was already there
+static bool set_add(FileSet_t* set, char* path)
+{
+     if((set->used + 1) * 2 > set->capacity && !set_rehash(set)){
+          free(path);
+          return false;
+     }
+
+     uint64_t mask = set->capacity - 1;
+     int64_t removed = -1;
+     for(uint64_t slot = util_hash_string(path) & mask; ; slot = (slot + 1) & mask){
+          char* other = set->slots[slot];
+          if(!other){
+               if(removed >= 0){
+                    slot = removed;
+               }else{
+                    set->used++;
+               }
+               set->slots[slot] = path;
+               set->count++;
+               return true;
+          }
+
+          if(other == FILE_SET_REMOVED){
+               if(removed < 0) removed = slot;
+          }else if(strcmp(other, path) == 0){
+               free(path);
+               return false;
+          }
+     }
+}
+
+static bool set_remove(FileSet_t* set, const char* path)
+{
+     if(!set->count) return false;
+
+     uint64_t mask = set->capacity - 1;
+     for(uint64_t slot = util_hash_string(path) & mask; set->slots[slot]; slot = (slot + 1) & mask){
+          char* other = set->slots[slot];
+          if(other == FILE_SET_REMOVED || strcmp(other, path) != 0) continue;
+
+          free(other);
+          set->slots[slot] = FILE_SET_REMOVED;
+          set->count--;
+          return true;
+     }
+
+     return false;
+}
+
+// everything under a directory, the only way to find it is to look at every path
+static int64_t set_remove_directory(FileSet_t* set, const char* directory)
+{
+     size_t length = strlen(directory);
+     int64_t removed = 0;
+
+     for(int64_t i = 0; i < set->capacity; ++i){
+          char* path = set->slots[i];
+          if(!path || path == FILE_SET_REMOVED) continue;
+          if(strncmp(path, directory, length) != 0 || path[length] != '/') continue;
+
+          free(path);
+          set->slots[i] = FILE_SET_REMOVED;
+          set->count--;
+          removed++;
+     }
+
+     return removed;
+}
+
+static void set_free(FileSet_t* set)
+{
+     for(int64_t i = 0; i < set->capacity; ++i){
+          if(set->slots[i] != FILE_SET_REMOVED) free(set->slots[i]);
+     }
+     free(set->slots);
+     memset(set, 0, sizeof(*set));
+}
+
+// the directory each watch is on
+
+static FileWatch_t* watch_find(FileIndex_t* index, int watch)
+{
+     if(!index->watch_capacity) return NULL;
+
+     uint64_t mask = index->watch_capacity - 1;
+     for(uint64_t slot = (uint64_t)(watch) * 2654435761u & mask; index->watches[slot].watch; slot = (slot + 1) & mask){
+          if(index->watches[slot].watch == watch) return index->watches + slot;
+     }
+
+     return NULL;
+}
+
+static void watch_remove(FileIndex_t* index, int watch)
+{
+     FileWatch_t* found = watch_find(index, watch);
+     if(!found) return;
+
+     free(found->path);
+     found->path = NULL;
+     found->watch = -1;
+}
+
+// stop watching a directory and everything under it
+static void watch_remove_directory(FileIndex_t* index, const char* directory)
+{
+     size_t length = strlen(directory);
+
+     for(int64_t i = 0; i < index->watch_capacity; ++i){
+          FileWatch_t* watch = index->watches + i;
+          if(watch->watch <= 0 || strncmp(watch->path, directory, length) != 0) continue;
+          if(watch->path[length] && watch->path[length] != '/') continue;
+
+          inotify_rm_watch(index->inotify_fd, watch->watch);
+          free(watch->path);
+          watch->path = NULL;
+          watch->watch = -1;
+     }
+}
+
+// takes the path. A directory that is walked again keeps its watch, so the watch may already be there
+static void watch_put(FileIndex_t* index, int watch, char* path)
+{
+     FileWatch_t* found = watch_find(index, watch);
+     if(found){
+          free(found->path);
+          found->path = path;
+          return;
+     }
+
+     if((index->watch_used + 1) * 2 > index->watch_capacity){
+          int64_t live = 0;
+          for(int64_t i = 0; i < index->watch_capacity; ++i){
+               if(index->watches[i].watch > 0) live++;
+          }
+
+          int64_t new_capacity = 256;
+          while(new_capacity < (live + 1) * 4) new_capacity *= 2;
+
+          FileWatch_t* new_watches = calloc(new_capacity, sizeof(*new_watches));
+          if(!new_watches){
+               free(path);
+               return;
+          }
+
+          for(int64_t i = 0; i < index->watch_capacity; ++i){
+               const FileWatch_t* old = index->watches + i;
+               if(old->watch <= 0) continue;
+               uint64_t slot = (uint64_t)(old->watch) * 2654435761u & (new_capacity - 1);
+               while(new_watches[slot].watch) slot = (slot + 1) & (new_capacity - 1);
+               new_watches[slot] = *old;
+          }
+
+          free(index->watches);
+          index->watches = new_watches;
+          index->watch_capacity = new_capacity;
+          index->watch_used = live;
+     }
+
+     uint64_t mask = index->watch_capacity - 1;
+     uint64_t slot = (uint64_t)(watch) * 2654435761u & mask;
+     while(index->watches[slot].watch > 0) slot = (slot + 1) & mask;
+     if(!index->watches[slot].watch) index->watch_used++;
+     index->watches[slot].watch = watch;
+     index->watches[slot].path = path;
+}
+
+static void watches_free(FileIndex_t* index)
+{
+     for(int64_t i = 0; i < index->watch_capacity; ++i) free(index->watches[i].path);
+     free(index->watches);
+     index->watches = NULL;
+     index->watch_capacity = 0;
+     index->watch_used = 0;
+}
+
+// walking
+
+typedef struct{
+     char* path;
+     IgnoreRules_t* rules; // that apply to the directory's parent
+}WalkDirectory_t;
+
+typedef struct{
+     const char* root;
+     int inotify_fd;
+
+     pthread_mutex_t lock;
+     pthread_cond_t changed;
+     WalkDirectory_t* queue;
+     int64_t queue_count;
+     int64_t queue_capacity;
+     int64_t busy; // workers in the middle of a directory, which may queue more
+
+     char** files;
+     int64_t file_count;
+     int64_t file_capacity;
+     FileWatch_t* watches;
+     int64_t watch_count;
+     int64_t watch_capacity;
+     IgnoreArena_t arena;
+     bool full;
+}Walk_t;
+
+// symlinked directories are never followed, they could loop or take us out of the project
+static bool symlinked_directory(const char* path)
+{
+     struct stat info;
+     return lstat(path, &info) == 0 && S_ISLNK(info.st_mode) && stat(path, &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+static void walk_directory(Walk_t* walk, const WalkDirectory_t* directory)
+{
+     char full_path[PATH_MAX];
+     if(directory->path[0]){
+          snprintf(full_path, sizeof(full_path), "%s/%s", walk->root, directory->path);
+     }else{
+          snprintf(full_path, sizeof(full_path), "%s", walk->root);
+     }
+
+     // NOTE: watch before reading, so nothing can change in between without us hearing about it
+     int watch = -1;
+     if(walk->inotify_fd >= 0) watch = inotify_add_watch(walk->inotify_fd, full_path, WATCH_EVENTS);
+
+     DIR* os_dir = opendir(full_path);
+     if(!os_dir){
+          if(watch >= 0) inotify_rm_watch(walk->inotify_fd, watch);
+          return;
+     }
+
+     IgnoreRules_t* rules = directory_rules(walk->root, directory->path, directory->rules, &walk->arena, &walk->lock);
+
+     char** files = NULL;
+     int64_t file_count = 0;
+     int64_t file_capacity = 0;
+     WalkDirectory_t* subdirectories = NULL;
+     int64_t subdirectory_count = 0;
+     int64_t subdirectory_capacity = 0;
+
+     struct dirent* node;
+     while((node = readdir(os_dir)) != NULL){
+          if(skipped(directory->path, node->d_name)) continue;
+
+          char* path = util_join_path(directory->path, node->d_name);
+          if(!path) continue;
+
+          char entry_path[PATH_MAX];
+          if(snprintf(entry_path, PATH_MAX, "%s/%s", full_path, node->d_name) >= PATH_MAX){
+               free(path);
+               continue;
+          }
+          bool is_directory = util_entry_is_directory(entry_path, node, false);
+          if(node->d_type == DT_LNK && symlinked_directory(entry_path)){
+               free(path);
+               continue;
+          }
+
+          if(ignored(rules, path, node->d_name, is_directory)){
+               free(path);
+               continue;
+          }
+
+          bool pushed;
+          if(is_directory){
+               WalkDirectory_t subdirectory = {path, rules};
+               pushed = push((void**)&subdirectories, &subdirectory_count, &subdirectory_capacity,
+                             sizeof(subdirectory), &subdirectory);
+          }else{
+               pushed = push((void**)&files, &file_count, &file_capacity, sizeof(path), &path);
+          }
+
+          if(!pushed) free(path);
+     }
+
+     closedir(os_dir);
+
+     pthread_mutex_lock(&walk->lock);
+
+     for(int64_t i = 0; i < file_count; ++i){
+          if(walk->file_count >= FILE_INDEX_MAX_FILES) walk->full = true;
+          if(walk->full || !push((void**)&walk->files, &walk->file_count, &walk->file_capacity, sizeof(files[i]),
+                                 files + i)){
+               free(files[i]);
+          }
+     }
+
+     for(int64_t i = 0; i < subdirectory_count; ++i){
+          if(walk->full || !push((void**)&walk->queue, &walk->queue_count, &walk->queue_capacity,
+                                 sizeof(subdirectories[i]), subdirectories + i)){
+               free(subdirectories[i].path);
+          }
+     }
+
+     if(watch >= 0){
+          FileWatch_t file_watch = {watch, strdup(directory->path)};
+          if(!file_watch.path || !push((void**)&walk->watches, &walk->watch_count, &walk->watch_capacity,
+                                       sizeof(file_watch), &file_watch)){
+               free(file_watch.path);
+          }
+     }
+
+     pthread_cond_broadcast(&walk->changed);
+     pthread_mutex_unlock(&walk->lock);
+
+     free(files);
+     free(subdirectories);
+}
+
+static void* walk_worker(void* data)
+{
+     Walk_t* walk = data;
+
+     pthread_mutex_lock(&walk->lock);
+
+     while(true){
+          while(!walk->queue_count && walk->busy) pthread_cond_wait(&walk->changed, &walk->lock);
+          if(!walk->queue_count) break;
+
+          WalkDirectory_t directory = walk->queue[--walk->queue_count];
+          walk->busy++;
+          pthread_mutex_unlock(&walk->lock);
+
+          walk_directory(walk, &directory);
+          free(directory.path);
+
+          pthread_mutex_lock(&walk->lock);
+          walk->busy--;
+     }
+
+     // NOTE: wake whoever is still waiting, there is nothing left to do
+     pthread_cond_broadcast(&walk->changed);
+     pthread_mutex_unlock(&walk->lock);
+     return NULL;
+}
+
+static void walk_init(Walk_t* walk, const char* root, int inotify_fd)
+{
+     memset(walk, 0, sizeof(*walk));
+     walk->root = root;
+     walk->inotify_fd = inotify_fd;
+     pthread_mutex_init(&walk->lock, NULL);
+     pthread_cond_init(&walk->changed, NULL);
+}
+
+// the files and watches are left for whoever took them out of the walk
+static void walk_free(Walk_t* walk)
+{
+     free(walk->queue);
+     free(walk->files);
+     free(walk->watches);
+     free_arena(&walk->arena);
+     pthread_mutex_destroy(&walk->lock);
+     pthread_cond_destroy(&walk->changed);
+}
+
+// walk down from a directory, the rules are the ones that apply to its parent. Every file that isn't ignored lands in
+// the walk's files, and every directory gets watched if the walk has an inotify fd
+static void walk_run(Walk_t* walk, const char* directory, IgnoreRules_t* rules, int64_t thread_count)
+{
+     WalkDirectory_t start = {strdup(directory), rules};
+     if(!start.path || !push((void**)&walk->queue, &walk->queue_count, &walk->queue_capacity, sizeof(start), &start)){
+          free(start.path);
+     }
+
+     pthread_t threads[FILE_INDEX_MAX_THREADS];
+     int64_t started = 0;
+     for(int64_t i = 1; i < thread_count && i < FILE_INDEX_MAX_THREADS; ++i){
+          if(pthread_create(threads + started, NULL, walk_worker, walk) != 0) break;
+          started++;
+     }
+
+     // this thread pitches in too
+     walk_worker(walk);
+
+     for(int64_t i = 0; i < started; ++i){
+          pthread_join(threads[i], NULL);
+     }
+
+     if(walk->full){
+          ce_message("%s() stopped walking %s at %d files", __FUNCTION__, walk->root, FILE_INDEX_MAX_FILES);
+     }
+}
+
+// walk into the set and watch every directory
+static bool walk_tree(FileIndex_t* index, const char* directory, IgnoreRules_t* rules)
+{
+     Walk_t walk;
+     walk_init(&walk, index->root, index->inotify_fd);
+     walk_run(&walk, directory, rules, index->thread_count);
+
+     bool changed = false;
+     for(int64_t i = 0; i < walk.file_count; ++i){
+          if(set_add(&index->files, walk.files[i])) changed = true;
+     }
+
+     for(int64_t i = 0; i < walk.watch_count; ++i){
+          watch_put(index, walk.watches[i].watch, walk.watches[i].path);
+     }
+
+     walk_free(&walk);
+     return changed;
+}
+
+char** file_index_walk(const char* root, int64_t thread_count, int64_t* count)
+{
+     if(thread_count <= 0) thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+
+     Walk_t walk;
+     walk_init(&walk, root, -1);
+     walk_run(&walk, "", NULL, thread_count);
+
+     char** files = walk.files;
+     *count = walk.file_count;
+     walk.files = NULL;
+     walk_free(&walk);
+     return files;
+}
+
+// the rules that apply inside a directory, reading every .gitignore from the root down to it
+static IgnoreRules_t* rules_for(FileIndex_t* index, const char* directory)
+{
+     if(index->rules_directory && strcmp(index->rules_directory, directory) == 0) return index->rules;
+
+     free_arena(&index->rules_arena);
+     free(index->rules_directory);
+     index->rules_directory = strdup(directory);
+     index->rules = directory_rules(index->root, "", NULL, &index->rules_arena, NULL);
+
+     char prefix[PATH_MAX];
+     for(const char* itr = directory; *itr; ++itr){
+          if(itr[1] != '/' && itr[1]) continue;
+
+          size_t length = itr - directory + 1;
+          if(length >= sizeof(prefix)) break;
+          memcpy(prefix, directory, length);
+          prefix[length] = 0;
+          index->rules = directory_rules(index->root, prefix, index->rules, &index->rules_arena, NULL);
+     }
+
+     return index->rules;
+}
+
+static void forget_rules(FileIndex_t* index)
+{
+     free_arena(&index->rules_arena);
+     free(index->rules_directory);
+     index->rules_directory = NULL;
+     index->rules = NULL;
+}
+
+// tables
+
+static void table_free(FileTable_t* table)
+{
+     free(table->strings);
+     free(table->paths);
+     memset(table, 0, sizeof(*table));
+}
+
+static int compare_path(const void* a, const void* b)
+{
+     return strcmp(*(const char**)(a), *(const char**)(b));
+}
+
+// the strings are laid out the same way they are in the file
+static bool table_point_paths(FileTable_t* table, uint64_t string_size)
+{
+     table->paths = malloc((table->count + 1) * sizeof(*table->paths));
+     if(!table->paths) return false;
+
+     uint64_t offset = 0;
+     for(int64_t i = 0; i < table->count; ++i){
+          if(offset >= string_size) return false;
+          const char* path = table->strings + offset;
+          const char* end = memchr(path, 0, string_size - offset);
+          if(!end) return false;
+          table->paths[i] = path;
+          offset += end - path + 1;
+     }
+
+     return true;
+}
+
+static bool table_build(const FileSet_t* set, FileTable_t* table, uint64_t* string_size)
+{
+     memset(table, 0, sizeof(*table));
+
+     const char** sorted = malloc((set->count + 1) * sizeof(*sorted));
+     if(!sorted) return false;
+
+     int64_t count = 0;
+     uint64_t size = 0;
+     for(int64_t i = 0; i < set->capacity; ++i){
+          const char* path = set->slots[i];
+          if(!path || path == FILE_SET_REMOVED) continue;
+          sorted[count++] = path;
+          size += strlen(path) + 1;
+     }
+
+     qsort(sorted, count, sizeof(*sorted), compare_path);
+
+     table->strings = malloc(size + 1);
+     table->count = count;
+     if(!table->strings){
+          free(sorted);
+          table_free(table);
+          return false;
+     }
+
+     char* itr = table->strings;
+     for(int64_t i = 0; i < count; ++i){
+          size_t length = strlen(sorted[i]) + 1;
+          memcpy(itr, sorted[i], length);
+          itr += length;
+     }
+     free(sorted);
+
+     if(!table_point_paths(table, size)){
+          table_free(table);
+          return false;
+     }
+
+     *string_size = size;
+     return true;
+}
+
+static bool table_load(FileTable_t* table, const char* path)
+{
+     memset(table, 0, sizeof(*table));
+
+     FILE* file = fopen(path, "rb");
+     if(!file) return false;
+
+     FileIndexHeader_t header;
+     bool success = fread(&header, sizeof(header), 1, file) == 1 &&
+                    memcmp(header.magic, file_index_magic, sizeof(file_index_magic)) == 0 &&
+                    header.version == FILE_INDEX_VERSION && header.file_count <= FILE_INDEX_MAX_FILES &&
+                    header.string_size < (uint64_t)(FILE_INDEX_MAX_FILES) * PATH_MAX;
+
+     if(success){
+          table->strings = malloc(header.string_size + 1);
+          table->count = header.file_count;
+          success = table->strings && fread(table->strings, 1, header.string_size, file) == header.string_size &&
+                    table_point_paths(table, header.string_size);
+     }
+
+     fclose(file);
+
+     if(!success){
+          ce_message("%s() ignoring unreadable %s", __FUNCTION__, path);
+          table_free(table);
+     }
+
+     return success;
+}
+
+static bool table_write(const FileTable_t* table, uint64_t string_size, const char* path)
+{
+     FileIndexHeader_t header = {};
+     memcpy(header.magic, file_index_magic, sizeof(file_index_magic));
+     header.version = FILE_INDEX_VERSION;
+     header.file_count = table->count;
+     header.string_size = string_size;
+
+     // NOTE: replace the file, so a session starting up never reads a half written one
+     struct iovec iovecs[2] = {{&header, sizeof(header)}, {table->strings, string_size}};
+     return util_write_file_replacing(path, iovecs, 2);
+}
+
+static void install(FileIndex_t* index, FileTable_t* table)
+{
+     pthread_mutex_lock(&index->lock);
+     table_free(&index->table);
+     index->table = *table;
+     index->generation++;
+     pthread_mutex_unlock(&index->lock);
+
+     memset(table, 0, sizeof(*table));
+}
+
+// build a table from the set, install it, and write it out if we were asked to
+static void publish(FileIndex_t* index, bool save)
+{
+     FileTable_t table;
+     uint64_t string_size = 0;
+     if(!table_build(&index->files, &table, &string_size)){
+          ce_message("%s() failed to allocate table of %" PRId64 " files", __FUNCTION__, index->files.count);
+          return;
+     }
+
+     index->changed = false;
+     index->unsaved = true;
+
+     if(save){
+          if(table_write(&table, string_size, index->index_path)){
+               index->unsaved = false;
+          }else{
+               ce_message("%s() failed to write %s: %s", __FUNCTION__, index->index_path, strerror(errno));
+          }
+     }
+
+     install(index, &table);
+}
+
+// the index's thread
+
+static void full_scan(FileIndex_t* index)
+{
+     // NOTE: start over, watches that are already on a directory come back with the same number
+     set_free(&index->files);
+     watches_free(index);
+     forget_rules(index);
+
+     walk_tree(index, "", NULL);
+     publish(index, true);
+}
+
+static void mark_changed(FileIndex_t* index)
+{
+     if(!index->changed) index->changed_at = util_now_ms();
+     index->changed = true;
+}
+
+static void handle_event(FileIndex_t* index, const struct inotify_event* event)
+{
+     if(event->mask & IN_Q_OVERFLOW){
+          // NOTE: we missed something, nothing short of walking it all again will tell us what
+          pthread_mutex_lock(&index->lock);
+          index->scan = true;
+          pthread_mutex_unlock(&index->lock);
+          return;
+     }
+
+     if(event->mask & IN_IGNORED){
+          watch_remove(index, event->wd);
+          return;
+     }
+
+     const FileWatch_t* watch = watch_find(index, event->wd);
+     if(!watch || !event->len || skipped(watch->path, event->name)) return;
+
+     // NOTE: copy it, walking may move the watches around
+     char directory[PATH_MAX];
+     snprintf(directory, sizeof(directory), "%s", watch->path);
+
+     char* path = util_join_path(directory, event->name);
+     if(!path) return;
+
+     bool is_directory = event->mask & IN_ISDIR;
+
+     if(!is_directory && strcmp(event->name, ".gitignore") == 0){
+          // the rules changed under the whole directory, so walk it again
+          forget_rules(index);
+
+          if(!directory[0]){
+               pthread_mutex_lock(&index->lock);
+               index->scan = true;
+               pthread_mutex_unlock(&index->lock);
+          }else{
+               set_remove_directory(&index->files, directory);
+
+               char parent[PATH_MAX];
+               snprintf(parent, sizeof(parent), "%s", directory);
+               char* slash = strrchr(parent, '/');
+               if(slash){
+                    *slash = 0;
+               }else{
+                    parent[0] = 0;
+               }
+
+               walk_tree(index, directory, rules_for(index, parent));
+               mark_changed(index);
+          }
+
+          free(path);
+          return;
+     }
+
+     if(event->mask & (IN_DELETE | IN_MOVED_FROM)){
+          // NOTE: a directory moved out of the project keeps its watches, and would keep reporting under its old
+          //       path. If it moved somewhere in the project, IN_MOVED_TO walks it and watches it again
+          if(is_directory && (event->mask & IN_MOVED_FROM)) watch_remove_directory(index, path);
+
+          bool removed = is_directory ? set_remove_directory(&index->files, path) > 0 : set_remove(&index->files, path);
+          if(removed) mark_changed(index);
+          free(path);
+          return;
+     }
+
+     if(!(event->mask & (IN_CREATE | IN_MOVED_TO | IN_CLOSE_WRITE))){
+          free(path);
+          return;
+     }
+
+     IgnoreRules_t* rules = rules_for(index, directory);
+
+     if(is_directory){
+          if(!ignored(rules, path, event->name, true) && walk_tree(index, path, rules)) mark_changed(index);
+          free(path);
+          return;
+     }
+
+     char full_path[PATH_MAX];
+     snprintf(full_path, PATH_MAX, "%s/%s", index->root, path);
+     if(ignored(rules, path, event->name, false) || symlinked_directory(full_path)){
+          free(path);
+          return;
+     }
+
+     if(set_add(&index->files, path)) mark_changed(index);
+}
+
+static void read_events(FileIndex_t* index)
+{
+     char events[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+     while(true){
+          ssize_t length = read(index->inotify_fd, events, sizeof(events));
+          if(length <= 0) break;
+
+          for(char* itr = events; itr < events + length;){
+               const struct inotify_event* event = (const struct inotify_event*)(itr);
+               handle_event(index, event);
+               itr += sizeof(*event) + event->len;
+          }
+     }
+}
+
+static void* index_thread(void* data)
+{
+     FileIndex_t* index = data;
+
+     // NOTE: hand out what the last session saw while we walk
+     FileTable_t table;
+     if(table_load(&table, index->index_path)) install(index, &table);
+
+     while(true){
+          pthread_mutex_lock(&index->lock);
+          bool running = index->running;
+          bool scan = index->scan;
+          index->scan = false;
+          pthread_mutex_unlock(&index->lock);
+
+          if(!running) break;
+
+          if(scan){
+               full_scan(index);
+               continue;
+          }
+
+          if(index->changed && util_now_ms() - index->changed_at >= MAX_SETTLE_MS){
+               publish(index, false);
+               continue;
+          }
+
+          int timeout = index->changed ? FILE_INDEX_SETTLE_MS : -1;
+
+          struct pollfd fds[2] = {{index->wake_fds[0], POLLIN, 0}, {index->inotify_fd, POLLIN, 0}};
+          int rc = poll(fds, (index->inotify_fd >= 0) ? 2 : 1, timeout);
+          if(rc < 0 && errno != EINTR){
+               ce_message("%s() poll() failed: %s", __FUNCTION__, strerror(errno));
+               break;
+          }
+
+          if(rc == 0){
+               publish(index, false);
+               continue;
+          }
+
+          if(rc > 0 && (fds[0].revents & POLLIN)){
+               char drain[64];
+               while(read(index->wake_fds[0], drain, sizeof(drain)) > 0);
+          }
+
+          if(rc > 0 && index->inotify_fd >= 0 && (fds[1].revents & POLLIN)) read_events(index);
+     }
+
+     if(index->changed) publish(index, false);
+     if(index->unsaved){
+          // NOTE: only the last table matters, so skip writing the ones in between and write it once on the way out
+          FileTable_t last;
+          uint64_t string_size = 0;
+          if(table_build(&index->files, &last, &string_size)){
+               table_write(&last, string_size, index->index_path);
+               table_free(&last);
+          }
+     }
+
+     return NULL;
+}
+
+bool file_index_start(FileIndex_t* index, const char* root, int64_t thread_count)
+{
+     memset(index, 0, sizeof(*index));
+     index->wake_fds[0] = -1;
+     index->wake_fds[1] = -1;
+     index->inotify_fd = -1;
+
+     index->root = strdup(root);
+     if(asprintf(&index->index_path, "%s/%s", root, FILE_INDEX_FILE) < 0) index->index_path = NULL;
+     if(!index->root || !index->index_path){
+          ce_message("%s() failed to allocate paths", __FUNCTION__);
+          file_index_stop(index);
+          return false;
+     }
+
+     if(thread_count <= 0) thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+     if(thread_count <= 0) thread_count = 1;
+     if(thread_count > FILE_INDEX_MAX_THREADS) thread_count = FILE_INDEX_MAX_THREADS;
+     index->thread_count = thread_count;
+
+     if(pipe2(index->wake_fds, O_NONBLOCK | O_CLOEXEC) != 0){
+          ce_message("%s() pipe2() failed: %s", __FUNCTION__, strerror(errno));
+          index->wake_fds[0] = -1;
+          index->wake_fds[1] = -1;
+          file_index_stop(index);
+          return false;
+     }
+
+     index->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+     if(index->inotify_fd < 0){
+          ce_message("%s() inotify_init1() failed: %s, files will only be found by rescanning", __FUNCTION__,
+                     strerror(errno));
+     }
+
+     pthread_mutex_init(&index->lock, NULL);
+     index->running = true;
+     index->scan = true;
+
+     int rc = pthread_create(&index->thread, NULL, index_thread, index);
+     if(rc != 0){
+          ce_message("%s() pthread_create() failed: %s", __FUNCTION__, strerror(rc));
+          pthread_mutex_destroy(&index->lock);
+          index->running = false;
+          file_index_stop(index);
+          return false;
+     }
+
+     index->thread_started = true;
+     return true;
+}
+
+static void wake(FileIndex_t* index)
+{
+     char byte = 0;
+     if(write(index->wake_fds[1], &byte, 1) < 0){
+          // NOTE: a full pipe is already going to wake the thread
+     }
+}
+
+void file_index_stop(FileIndex_t* index)
+{
+     if(index->thread_started){
+          pthread_mutex_lock(&index->lock);
+          index->running = false;
+          pthread_mutex_unlock(&index->lock);
+          wake(index);
+
+          pthread_join(index->thread, NULL);
+          pthread_mutex_destroy(&index->lock);
+     }
+
+     if(index->wake_fds[0] >= 0) close(index->wake_fds[0]);
+     if(index->wake_fds[1] >= 0) close(index->wake_fds[1]);
+     if(index->inotify_fd >= 0) close(index->inotify_fd);
+
+     set_free(&index->files);
+     watches_free(index);
+     forget_rules(index);
+     table_free(&index->table);
+     free(index->root);
+     free(index->index_path);
+     memset(index, 0, sizeof(*index));
+     index->wake_fds[0] = -1;
+     index->wake_fds[1] = -1;
+     index->inotify_fd = -1;
+}
+
+void file_index_rescan(FileIndex_t* index)
+{
+     if(!index->thread_started) return;
+
+     pthread_mutex_lock(&index->lock);
+     index->scan = true;
+     pthread_mutex_unlock(&index->lock);
+     wake(index);
+}
+
+uint64_t file_index_generation(FileIndex_t* index)
+{
+     if(!index->thread_started) return 0;
+
+     pthread_mutex_lock(&index->lock);
+     uint64_t generation = index->generation;
+     pthread_mutex_unlock(&index->lock);
+     return generation;
+}
+
+void file_index_lock(FileIndex_t* index)
+{
+     pthread_mutex_lock(&index->lock);
+}
+
+void file_index_unlock(FileIndex_t* index)
+{
+     pthread_mutex_unlock(&index->lock);
+}
+
+const FileTable_t* file_index_table(const FileIndex_t* index)
+{
+     return &index->table;
+}
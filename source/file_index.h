@@ -0,0 +1,113 @@
+#pragma once
+
+// every file in a project, relative to its root, so one can be opened by name without walking the tree. Directories are
+// walked in parallel honoring .gitignore, then watched with inotify to keep the list fresh. The list is written to the
+// project so the next session has it before its own walk finishes
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define FILE_INDEX_FILE ".ce_files"
+#define FILE_INDEX_VERSION 1
+#define FILE_INDEX_MAX_THREADS 8
+#define FILE_INDEX_MAX_FILES 500000 // stop walking past this many, we were probably started somewhere like $HOME
+#define FILE_INDEX_SETTLE_MS 100 // wait for a burst of changes to end before the table is rebuilt
+
+// the file is a header followed by every path, sorted and nul terminated
+typedef struct{
+     char magic[8];
+     uint32_t version;
+     uint32_t file_count;
+     uint64_t string_size;
+}FileIndexHeader_t;
+
+// the files as lookups see them, replaced as a whole
+typedef struct{
+     char* strings; // every path back to back
+     const char** paths; // sorted, point into strings
+     int64_t count;
+}FileTable_t;
+
+// the paths the index's thread keeps up to date, an open addressed set
+typedef struct{
+     char** slots; // NULL is empty, FILE_SET_REMOVED a path that was taken out
+     int64_t capacity;
+     int64_t count;
+     int64_t used; // counting removed slots, which still lengthen probes
+}FileSet_t;
+
+// which directory each inotify watch is on, open addressed by watch
+typedef struct{
+     int watch; // 0 is an empty slot, -1 a removed one
+     char* path; // relative to the root, "" for the root
+}FileWatch_t;
+
+typedef struct{
+     char* pattern; // without any leading ! or /, or trailing /
+     bool negate;
+     bool directory_only;
+     bool anchored; // it had a slash, so it matches the path from its .gitignore's directory rather than just a name
+}IgnoreRule_t;
+
+// one directory's .gitignore, on top of the directories above it
+typedef struct IgnoreRules_t{
+     struct IgnoreRules_t* parent;
+     char* base; // relative to the root, "" for the root
+     IgnoreRule_t* rules; // later rules win
+     int64_t count;
+     int64_t capacity;
+}IgnoreRules_t;
+
+typedef struct{
+     IgnoreRules_t** all; // so they can all be free'd together
+     int64_t count;
+     int64_t capacity;
+}IgnoreArena_t;
+
+typedef struct{
+     char* root;
+     char* index_path;
+     int64_t thread_count; // walking threads
+
+     pthread_t thread;
+     bool thread_started;
+     pthread_mutex_t lock;
+     int wake_fds[2]; // the index's thread waits on this and inotify at once
+     bool running;
+     bool scan; // walk the whole project again
+     FileTable_t table; // replaced as a whole by the index's thread, read under lock
+     uint64_t generation; // bumped every time the table is replaced
+
+     // NOTE: only touched by the index's thread
+     int inotify_fd;
+     FileSet_t files;
+     FileWatch_t* watches;
+     int64_t watch_capacity;
+     int64_t watch_used; // counting removed slots
+     bool changed; // since the table was last installed
+     int64_t changed_at; // milliseconds, when the first change since the table was installed came in
+     bool unsaved; // since the file was last written
+
+     // files come and go in bursts in the same directory, so hold on to the last directory's rules
+     char* rules_directory;
+     IgnoreRules_t* rules;
+     IgnoreArena_t rules_arena;
+}FileIndex_t;
+
+bool file_index_start(FileIndex_t* index, const char* root, int64_t thread_count); // thread_count <= 0 uses the cpus
+void file_index_stop(FileIndex_t* index);
+void file_index_rescan(FileIndex_t* index);
+uint64_t file_index_generation(FileIndex_t* index); // 0 until there is a table
+
+// the table is only good until the index is unlocked
+void file_index_lock(FileIndex_t* index);
+void file_index_unlock(FileIndex_t* index);
+const FileTable_t* file_index_table(const FileIndex_t* index);
+
+// walk a project once, the same way the index does, without watching it. Returns every file relative to the root, the
+// paths and the array are the caller's to free
+char** file_index_walk(const char* root, int64_t thread_count, int64_t* count); // thread_count <= 0 uses the cpus
+
+// whether a path, relative to the directory of the .gitignore the pattern came from, matches a gitignore pattern
+bool file_index_glob_match(const char* pattern, const char* path);
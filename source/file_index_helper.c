@@ -0,0 +1,56 @@
+#include "file_index_helper.h"
+#include "buffer.h"
+#include "completion.h"
+
+#include <limits.h>
+
+void file_index_start_project(ConfigState_t* config_state)
+{
+     const char* root = getenv("CE_FILE_INDEX");
+     if(!root) root = FILE_INDEX_DEFAULT_ROOT;
+     if(!root[0]) return;
+
+     file_index_start(&config_state->file_index, root, 0);
+}
+
+void file_index_stop_project(ConfigState_t* config_state)
+{
+     file_index_stop(&config_state->file_index);
+}
+
+bool file_index_complete_files(ConfigState_t* config_state)
+{
+     FileIndex_t* index = &config_state->file_index;
+     if(!file_index_generation(index)){
+          ce_message("%s", index->root ? "still indexing project files" : "project files are not being indexed");
+          return false;
+     }
+
+     pthread_mutex_lock(&completion_lock);
+     auto_complete_free(&config_state->auto_complete);
+
+     // NOTE: the table is sorted, so matches that tie come out in path order
+     file_index_lock(index);
+     const FileTable_t* table = file_index_table(index);
+     for(int64_t i = 0; i < table->count; ++i){
+          auto_complete_insert(&config_state->auto_complete, table->paths[i], NULL);
+     }
+     file_index_unlock(index);
+
+     auto_complete_start(&config_state->auto_complete, ACT_FUZZY, (Point_t){0, 0});
+     completion_update_buffer(config_state->completion_buffer, &config_state->auto_complete, NULL);
+     pthread_mutex_unlock(&completion_lock);
+     return true;
+}
+
+BufferNode_t* file_index_load_file(ConfigState_t* config_state, BufferNode_t** head, const char* path)
+{
+     const char* root = config_state->file_index.root;
+
+     // NOTE: keep buffer names the same as loading them by hand from where we were run would
+     if(!root || strcmp(root, ".") == 0 || path[0] == '/') return buffer_create_from_file(head, path);
+
+     char full_path[PATH_MAX];
+     snprintf(full_path, PATH_MAX, "%s/%s", root, path);
+     return buffer_create_from_file(head, full_path);
+}
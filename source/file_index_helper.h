@@ -0,0 +1,14 @@
+#pragma once
+
+#include "ce_config.h"
+
+#define FILE_INDEX_DEFAULT_ROOT "." // override with CE_FILE_INDEX, set it empty to never index
+
+void file_index_start_project(ConfigState_t* config_state);
+void file_index_stop_project(ConfigState_t* config_state);
+
+// put every file in the project in auto complete to be fuzzy matched, false if we haven't got a table yet
+bool file_index_complete_files(ConfigState_t* config_state);
+
+// open a file by its path from the project's root
+BufferNode_t* file_index_load_file(ConfigState_t* config_state, BufferNode_t** head, const char* path);
@@ -0,0 +1,197 @@
+#include "fuzzy.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+// NOTE: weights are the ones fzf settled on
+#define SCORE_MATCH 16
+#define SCORE_GAP_START -3
+#define SCORE_GAP_EXTENSION -1
+#define BONUS_BOUNDARY (SCORE_MATCH / 2)
+#define BONUS_CAMEL (BONUS_BOUNDARY + SCORE_GAP_EXTENSION)
+#define BONUS_CONSECUTIVE (-(SCORE_GAP_START + SCORE_GAP_EXTENSION))
+#define BONUS_FIRST_MULTIPLIER 2
+
+// NOTE: tolower() goes through the locale on every call, and this is the inner loop
+static inline char fold_case(char c)
+{
+     return (c >= 'A' && c <= 'Z') ? (c - 'A') + 'a' : c;
+}
+
+static int64_t mask_bit(char c)
+{
+     unsigned char folded = fold_case(c);
+     if(folded >= 'a' && folded <= 'z') return folded - 'a';
+     if(folded >= '0' && folded <= '9') return 26 + (folded - '0');
+     return 36 + (folded % 28);
+}
+
+uint64_t fuzzy_mask(const char* string, int64_t length)
+{
+     uint64_t mask = 0;
+     for(int64_t i = 0; i < length; ++i){
+          mask |= (uint64_t)(1) << mask_bit(string[i]);
+     }
+     return mask;
+}
+
+void fuzzy_pattern_init(FuzzyPattern_t* pattern, const char* text)
+{
+     pattern->text = text;
+     pattern->length = strlen(text);
+     pattern->case_sensitive = false;
+     for(int64_t i = 0; i < pattern->length; ++i){
+          if(isupper((unsigned char)(text[i]))){
+               pattern->case_sensitive = true;
+               break;
+          }
+     }
+     pattern->mask = fuzzy_mask(text, pattern->length);
+}
+
+static inline bool chars_equal(const FuzzyPattern_t* pattern, char candidate, char typed)
+{
+     if(pattern->case_sensitive) return candidate == typed;
+     return fold_case(candidate) == typed;
+}
+
+static int32_t char_bonus(char prev, char c)
+{
+     unsigned char p = prev;
+     unsigned char u = c;
+
+     if(!isalnum(u)) return 0;
+     if(!p || p == '/' || p == '_' || p == '-' || p == '.' || isspace(p)) return BONUS_BOUNDARY;
+     if(islower(p) && isupper(u)) return BONUS_CAMEL;
+     if(!isdigit(p) && isdigit(u)) return BONUS_CAMEL;
+     return 0;
+}
+
+int32_t fuzzy_score(const FuzzyPattern_t* pattern, const char* candidate, int64_t candidate_length)
+{
+     if(!pattern->length) return 0;
+
+     // find where the pattern first appears in order
+     int64_t typed = 0;
+     int64_t start = -1;
+     int64_t end = -1;
+     for(int64_t i = 0; i < candidate_length; ++i){
+          if(chars_equal(pattern, candidate[i], pattern->text[typed])){
+               if(typed == 0) start = i;
+               typed++;
+               if(typed == pattern->length){
+                    end = i + 1;
+                    break;
+               }
+          }
+     }
+
+     if(end < 0) return FUZZY_NO_MATCH;
+
+     // then walk back from where it ended, to find the tightest stretch it fits in
+     typed = pattern->length - 1;
+     for(int64_t i = end - 1; i >= start; --i){
+          if(chars_equal(pattern, candidate[i], pattern->text[typed])){
+               typed--;
+               if(typed < 0){
+                    start = i;
+                    break;
+               }
+          }
+     }
+
+     int32_t score = 0;
+     int32_t first_bonus = 0;
+     int64_t consecutive = 0;
+     bool in_gap = false;
+     char prev = start ? candidate[start - 1] : 0;
+     typed = 0;
+
+     for(int64_t i = start; i < end; ++i){
+          char c = candidate[i];
+
+          if(typed < pattern->length && chars_equal(pattern, c, pattern->text[typed])){
+               int32_t bonus = char_bonus(prev, c);
+
+               // NOTE: a run of matches keeps the bonus it started with, so "ce_con" stays ahead of "ce_c_o_n"
+               if(consecutive == 0){
+                    first_bonus = bonus;
+               }else{
+                    if(bonus >= BONUS_BOUNDARY && bonus > first_bonus) first_bonus = bonus;
+                    if(first_bonus > bonus) bonus = first_bonus;
+                    if(BONUS_CONSECUTIVE > bonus) bonus = BONUS_CONSECUTIVE;
+               }
+
+               score += SCORE_MATCH + ((typed == 0) ? bonus * BONUS_FIRST_MULTIPLIER : bonus);
+               consecutive++;
+               in_gap = false;
+               typed++;
+          }else{
+               score += in_gap ? SCORE_GAP_EXTENSION : SCORE_GAP_START;
+               consecutive = 0;
+               first_bonus = 0;
+               in_gap = true;
+          }
+
+          prev = c;
+     }
+
+     return score;
+}
+
+static bool better_match(const FuzzyMatch_t* a, const FuzzyMatch_t* b)
+{
+     if(a->score != b->score) return a->score > b->score;
+     if(a->length != b->length) return a->length < b->length;
+     return a->index < b->index;
+}
+
+static int compare_match(const void* a, const void* b)
+{
+     const FuzzyMatch_t* left = a;
+     const FuzzyMatch_t* right = b;
+     if(better_match(left, right)) return -1;
+     if(better_match(right, left)) return 1;
+     return 0;
+}
+
+// the worst of the best sits at the top of the heap, so it is what a better match pushes out
+static void sift_down(FuzzyMatch_t* heap, int64_t count, int64_t i)
+{
+     while(true){
+          int64_t worst = i;
+          int64_t left = (i * 2) + 1;
+          int64_t right = left + 1;
+          if(left < count && better_match(heap + worst, heap + left)) worst = left;
+          if(right < count && better_match(heap + worst, heap + right)) worst = right;
+          if(worst == i) return;
+
+          FuzzyMatch_t tmp = heap[i];
+          heap[i] = heap[worst];
+          heap[worst] = tmp;
+          i = worst;
+     }
+}
+
+void fuzzy_sort_best(FuzzyMatch_t* matches, int64_t count, int64_t best)
+{
+     if(best > count) best = count;
+     if(best <= 0) return;
+
+     if(best < count){
+          for(int64_t i = (best / 2) - 1; i >= 0; --i){
+               sift_down(matches, best, i);
+          }
+
+          for(int64_t i = best; i < count; ++i){
+               if(!better_match(matches + i, matches)) continue;
+               FuzzyMatch_t tmp = matches[0];
+               matches[0] = matches[i];
+               matches[i] = tmp;
+               sift_down(matches, best, 0);
+          }
+     }
+
+     qsort(matches, best, sizeof(*matches), compare_match);
+}
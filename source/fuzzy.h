@@ -0,0 +1,31 @@
+#pragma once
+
+// fzf style fuzzy matching: the typed characters must appear in order in a candidate, which scores higher the more
+// of them land on word boundaries or run together, and lower for every character skipped in between
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define FUZZY_NO_MATCH INT32_MIN
+
+typedef struct{
+     const char* text;
+     int64_t length;
+     bool case_sensitive; // only once an upper case character is typed
+     uint64_t mask;
+}FuzzyPattern_t;
+
+typedef struct{
+     int64_t index; // whatever the caller uses to find the candidate
+     int32_t score;
+     int32_t length; // shorter candidates win ties
+}FuzzyMatch_t;
+
+// which characters a string has, folding case. A candidate missing any of the pattern's can be thrown out with an and
+uint64_t fuzzy_mask(const char* string, int64_t length);
+
+void fuzzy_pattern_init(FuzzyPattern_t* pattern, const char* text);
+int32_t fuzzy_score(const FuzzyPattern_t* pattern, const char* candidate, int64_t candidate_length);
+
+// puts the best matches first, in order. Only the first best are sorted, the rest follow in no particular order
+void fuzzy_sort_best(FuzzyMatch_t* matches, int64_t count, int64_t best);
@@ -37,7 +37,7 @@ void input_start(Input_t* input, BufferView_t** view, VimState_t* vim_state, con
      input->type = type;
      input->vim_mode_save = vim_state->mode;
 
-     if(vim_state->mode == VM_VISUAL_LINE || vim_state->mode == VM_VISUAL_RANGE){
+     if(vim_state->mode == VM_VISUAL_LINE || vim_state->mode == VM_VISUAL_RANGE || vim_state->mode == VM_VISUAL_BLOCK){
           input->visual_save = vim_state->visual_start;
      }
 
@@ -72,6 +72,9 @@ void input_end(Input_t* input, VimState_t* vim_state)
      case VM_VISUAL_LINE:
           vim_enter_visual_line_mode(vim_state, input->visual_save);
           break;
+     case VM_VISUAL_BLOCK:
+          vim_enter_visual_block_mode(vim_state, input->visual_save);
+          break;
      }
 }
 
@@ -9,6 +9,7 @@ typedef enum{
      INPUT_QUIT,
      INPUT_SWITCH_BUFFER,
      INPUT_LOAD_FILE,
+     INPUT_FIND_FILE,
      INPUT_SEARCH,
      INPUT_REVERSE_SEARCH,
      INPUT_REPLACE,
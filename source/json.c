@@ -0,0 +1,418 @@
+#include "json.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdarg.h>
+
+typedef struct{
+     const char* text;
+     const char* end;
+}JsonParser_t;
+
+static bool parse_value(JsonParser_t* parser, JsonValue_t* value, int depth);
+
+#define JSON_MAX_DEPTH 128
+
+static void skip_whitespace(JsonParser_t* parser)
+{
+     while(parser->text < parser->end && isspace((unsigned char)(*parser->text))) parser->text++;
+}
+
+static bool parse_literal(JsonParser_t* parser, const char* literal)
+{
+     int64_t length = strlen(literal);
+     if(parser->end - parser->text < length || strncmp(parser->text, literal, length) != 0) return false;
+     parser->text += length;
+     return true;
+}
+
+static int parse_hex_digit(char c)
+{
+     if(c >= '0' && c <= '9') return c - '0';
+     if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+     if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+     return -1;
+}
+
+static bool parse_hex4(JsonParser_t* parser, uint32_t* codepoint)
+{
+     if(parser->end - parser->text < 4) return false;
+
+     *codepoint = 0;
+     for(int i = 0; i < 4; ++i){
+          int digit = parse_hex_digit(parser->text[i]);
+          if(digit < 0) return false;
+          *codepoint = (*codepoint << 4) | digit;
+     }
+
+     parser->text += 4;
+     return true;
+}
+
+static int encode_utf8(uint32_t codepoint, char* out)
+{
+     if(codepoint < 0x80){
+          out[0] = codepoint;
+          return 1;
+     }else if(codepoint < 0x800){
+          out[0] = 0xC0 | (codepoint >> 6);
+          out[1] = 0x80 | (codepoint & 0x3F);
+          return 2;
+     }else if(codepoint < 0x10000){
+          out[0] = 0xE0 | (codepoint >> 12);
+          out[1] = 0x80 | ((codepoint >> 6) & 0x3F);
+          out[2] = 0x80 | (codepoint & 0x3F);
+          return 3;
+     }
+
+     out[0] = 0xF0 | (codepoint >> 18);
+     out[1] = 0x80 | ((codepoint >> 12) & 0x3F);
+     out[2] = 0x80 | ((codepoint >> 6) & 0x3F);
+     out[3] = 0x80 | (codepoint & 0x3F);
+     return 4;
+}
+
+static char* parse_string(JsonParser_t* parser)
+{
+     if(parser->text >= parser->end || *parser->text != '"') return NULL;
+     parser->text++;
+
+     // NOTE: escapes only ever shrink, so the raw length is plenty
+     const char* start = parser->text;
+     while(parser->text < parser->end && *parser->text != '"'){
+          if(*parser->text == '\\') parser->text++;
+          parser->text++;
+     }
+     if(parser->text >= parser->end) return NULL;
+
+     int64_t raw_length = parser->text - start;
+     parser->text = start;
+
+     char* string = malloc(raw_length + 1);
+     if(!string) return NULL;
+
+     char* out = string;
+     while(*parser->text != '"'){
+          char c = *parser->text++;
+          if(c != '\\'){
+               *out++ = c;
+               continue;
+          }
+
+          c = *parser->text++;
+          switch(c){
+          case '"':
+          case '\\':
+          case '/':
+               *out++ = c;
+               break;
+          case 'b': *out++ = '\b'; break;
+          case 'f': *out++ = '\f'; break;
+          case 'n': *out++ = '\n'; break;
+          case 'r': *out++ = '\r'; break;
+          case 't': *out++ = '\t'; break;
+          case 'u':
+          {
+               uint32_t codepoint;
+               if(!parse_hex4(parser, &codepoint)) goto invalid;
+
+               // surrogate pair
+               if(codepoint >= 0xD800 && codepoint < 0xDC00 && parser->end - parser->text >= 6 &&
+                  parser->text[0] == '\\' && parser->text[1] == 'u'){
+                    parser->text += 2;
+                    uint32_t low;
+                    if(!parse_hex4(parser, &low) || low < 0xDC00 || low > 0xDFFF) goto invalid;
+                    codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+               }
+
+               out += encode_utf8(codepoint, out);
+          } break;
+          default:
+               goto invalid;
+          }
+     }
+
+     *out = 0;
+     parser->text++; // closing quote
+     return string;
+
+invalid:
+     free(string);
+     return NULL;
+}
+
+static bool append_member(JsonValue_t* value, const JsonValue_t* member, char* key)
+{
+     // NOTE: capacity isn't stored, it is the next power of two past count, starting at 4
+     if(value->count == 0 || (value->count >= 4 && (value->count & (value->count - 1)) == 0)){
+          int64_t new_capacity = value->count ? value->count * 2 : 4;
+          JsonValue_t* new_values = realloc(value->values, new_capacity * sizeof(*new_values));
+          if(!new_values) return false;
+          value->values = new_values;
+
+          if(value->type == JSON_OBJECT){
+               char** new_keys = realloc(value->keys, new_capacity * sizeof(*new_keys));
+               if(!new_keys) return false;
+               value->keys = new_keys;
+          }
+     }
+
+     value->values[value->count] = *member;
+     if(value->type == JSON_OBJECT) value->keys[value->count] = key;
+     value->count++;
+     return true;
+}
+
+static bool parse_members(JsonParser_t* parser, JsonValue_t* value, int depth)
+{
+     bool object = value->type == JSON_OBJECT;
+     char close = object ? '}' : ']';
+
+     parser->text++; // opening bracket
+     skip_whitespace(parser);
+     if(parser->text < parser->end && *parser->text == close){
+          parser->text++;
+          return true;
+     }
+
+     while(true){
+          char* key = NULL;
+          if(object){
+               skip_whitespace(parser);
+               key = parse_string(parser);
+               if(!key) return false;
+
+               skip_whitespace(parser);
+               if(parser->text >= parser->end || *parser->text != ':'){
+                    free(key);
+                    return false;
+               }
+               parser->text++;
+          }
+
+          JsonValue_t member;
+          if(!parse_value(parser, &member, depth + 1)){
+               free(key);
+               return false;
+          }
+
+          if(!append_member(value, &member, key)){
+               free(key);
+               json_free(&member);
+               return false;
+          }
+
+          skip_whitespace(parser);
+          if(parser->text >= parser->end) return false;
+
+          char c = *parser->text++;
+          if(c == close) return true;
+          if(c != ',') return false;
+     }
+}
+
+static bool parse_value(JsonParser_t* parser, JsonValue_t* value, int depth)
+{
+     memset(value, 0, sizeof(*value));
+     if(depth > JSON_MAX_DEPTH) return false;
+
+     skip_whitespace(parser);
+     if(parser->text >= parser->end) return false;
+
+     switch(*parser->text){
+     case '{':
+     case '[':
+          value->type = *parser->text == '{' ? JSON_OBJECT : JSON_ARRAY;
+          if(!parse_members(parser, value, depth)){
+               json_free(value);
+               return false;
+          }
+          return true;
+     case '"':
+          value->type = JSON_STRING;
+          value->string = parse_string(parser);
+          return value->string != NULL;
+     case 't':
+          value->type = JSON_BOOL;
+          value->boolean = true;
+          return parse_literal(parser, "true");
+     case 'f':
+          value->type = JSON_BOOL;
+          value->boolean = false;
+          return parse_literal(parser, "false");
+     case 'n':
+          value->type = JSON_NULL;
+          return parse_literal(parser, "null");
+     default:
+     {
+          // NOTE: strtod() needs a terminated string, numbers are short so copy them out
+          char number[64];
+          int64_t length = 0;
+          while(parser->text + length < parser->end && length < (int64_t)(sizeof(number) - 1) &&
+                strchr("+-0123456789.eE", parser->text[length])){
+               number[length] = parser->text[length];
+               length++;
+          }
+          number[length] = 0;
+
+          char* number_end;
+          value->type = JSON_NUMBER;
+          value->number = strtod(number, &number_end);
+          if(length == 0 || number_end != number + length) return false;
+          parser->text += length;
+          return true;
+     }
+     }
+}
+
+bool json_parse(const char* text, int64_t length, JsonValue_t* value)
+{
+     JsonParser_t parser = {text, text + length};
+     if(!parse_value(&parser, value, 0)) return false;
+
+     skip_whitespace(&parser);
+     if(parser.text != parser.end){
+          json_free(value);
+          return false;
+     }
+
+     return true;
+}
+
+void json_free(JsonValue_t* value)
+{
+     switch(value->type){
+     default:
+          break;
+     case JSON_STRING:
+          free(value->string);
+          break;
+     case JSON_ARRAY:
+     case JSON_OBJECT:
+          for(int64_t i = 0; i < value->count; ++i){
+               json_free(value->values + i);
+               if(value->keys) free(value->keys[i]);
+          }
+          free(value->values);
+          free(value->keys);
+          break;
+     }
+
+     memset(value, 0, sizeof(*value));
+}
+
+const JsonValue_t* json_get(const JsonValue_t* object, const char* key)
+{
+     if(!object || object->type != JSON_OBJECT) return NULL;
+
+     for(int64_t i = 0; i < object->count; ++i){
+          if(strcmp(object->keys[i], key) == 0) return object->values + i;
+     }
+
+     return NULL;
+}
+
+const JsonValue_t* json_at(const JsonValue_t* array, int64_t index)
+{
+     if(!array || array->type != JSON_ARRAY || index < 0 || index >= array->count) return NULL;
+     return array->values + index;
+}
+
+const char* json_get_string(const JsonValue_t* object, const char* key)
+{
+     const JsonValue_t* value = json_get(object, key);
+     if(!value || value->type != JSON_STRING) return NULL;
+     return value->string;
+}
+
+int64_t json_get_int(const JsonValue_t* object, const char* key, int64_t fallback)
+{
+     const JsonValue_t* value = json_get(object, key);
+     if(!value || value->type != JSON_NUMBER) return fallback;
+     return (int64_t)(value->number);
+}
+
+static bool builder_reserve(JsonBuilder_t* builder, int64_t length)
+{
+     if(builder->length + length + 1 <= builder->capacity) return true;
+
+     int64_t new_capacity = builder->capacity ? builder->capacity : 256;
+     while(new_capacity < builder->length + length + 1) new_capacity *= 2;
+
+     char* new_text = realloc(builder->text, new_capacity);
+     if(!new_text){
+          ce_message("%s() failed to grow to %"PRId64" bytes", __FUNCTION__, new_capacity);
+          return false;
+     }
+
+     builder->text = new_text;
+     builder->capacity = new_capacity;
+     return true;
+}
+
+bool json_append(JsonBuilder_t* builder, const char* format, ...)
+{
+     va_list args;
+     va_start(args, format);
+     int length = vsnprintf(NULL, 0, format, args);
+     va_end(args);
+
+     if(length < 0 || !builder_reserve(builder, length)) return false;
+
+     va_start(args, format);
+     vsnprintf(builder->text + builder->length, length + 1, format, args);
+     va_end(args);
+
+     builder->length += length;
+     return true;
+}
+
+bool json_append_string(JsonBuilder_t* builder, const char* string, int64_t length)
+{
+     // worst case every character becomes \u00XX
+     if(!builder_reserve(builder, length * 6 + 2)) return false;
+
+     char* out = builder->text + builder->length;
+     *out++ = '"';
+     for(int64_t i = 0; i < length; ++i){
+          unsigned char c = string[i];
+          switch(c){
+          case '"': *out++ = '\\'; *out++ = '"'; break;
+          case '\\': *out++ = '\\'; *out++ = '\\'; break;
+          case '\n': *out++ = '\\'; *out++ = 'n'; break;
+          case '\r': *out++ = '\\'; *out++ = 'r'; break;
+          case '\t': *out++ = '\\'; *out++ = 't'; break;
+          default:
+               if(c < 0x20){
+                    out += sprintf(out, "\\u%04x", c);
+               }else{
+                    *out++ = c;
+               }
+               break;
+          }
+     }
+     *out++ = '"';
+     *out = 0;
+
+     builder->length = out - builder->text;
+     return true;
+}
+
+bool json_append_raw(JsonBuilder_t* builder, const char* text, int64_t length)
+{
+     if(!builder_reserve(builder, length)) return false;
+
+     if(length) memcpy(builder->text + builder->length, text, length);
+     builder->length += length;
+     builder->text[builder->length] = 0;
+     return true;
+}
+
+void json_builder_free(JsonBuilder_t* builder)
+{
+     free(builder->text);
+     builder->text = NULL;
+     builder->length = 0;
+     builder->capacity = 0;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "ce.h"
+
+typedef enum{
+     JSON_NULL,
+     JSON_BOOL,
+     JSON_NUMBER,
+     JSON_STRING,
+     JSON_ARRAY,
+     JSON_OBJECT,
+}JsonType_t;
+
+typedef struct JsonValue_t{
+     JsonType_t type;
+     union{
+          bool boolean;
+          double number;
+          char* string; // utf8, '\0' terminated
+          struct{
+               struct JsonValue_t* values; // array elements or object member values
+               char** keys; // object member names, NULL for arrays
+               int64_t count;
+          };
+     };
+}JsonValue_t;
+
+bool json_parse(const char* text, int64_t length, JsonValue_t* value);
+void json_free(JsonValue_t* value);
+
+// lookups return NULL if the value is missing or isn't the type asked for, so they can be chained
+const JsonValue_t* json_get(const JsonValue_t* object, const char* key);
+const JsonValue_t* json_at(const JsonValue_t* array, int64_t index);
+const char* json_get_string(const JsonValue_t* object, const char* key);
+int64_t json_get_int(const JsonValue_t* object, const char* key, int64_t fallback);
+
+// for writing json out
+typedef struct{
+     char* text;
+     int64_t length;
+     int64_t capacity;
+}JsonBuilder_t;
+
+bool json_append(JsonBuilder_t* builder, const char* format, ...) __attribute__((format(printf, 2, 3)));
+bool json_append_string(JsonBuilder_t* builder, const char* string, int64_t length); // quoted and escaped
+bool json_append_raw(JsonBuilder_t* builder, const char* text, int64_t length); // as is, for json that is already built
+void json_builder_free(JsonBuilder_t* builder);
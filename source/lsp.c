@@ -0,0 +1,1054 @@
+#include "lsp.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LSP_READ_CHUNK 65536
+#define LSP_EXIT_WAIT_MS 100 // how long we give the server to exit on its own before we kill it
+
+static void wake(LspClient_t* client)
+{
+     char c = 0;
+     if(write(client->wake_fds[1], &c, 1) < 0 && errno != EAGAIN){
+          ce_message("%s() write() failed: %s", __FUNCTION__, strerror(errno));
+     }
+}
+
+// client lock must be held
+static bool flush_outgoing(LspClient_t* client)
+{
+     while(client->outgoing_written < client->outgoing.length){
+          ssize_t written = write(client->write_fd, client->outgoing.text + client->outgoing_written,
+                                  client->outgoing.length - client->outgoing_written);
+          if(written < 0){
+               if(errno == EINTR) continue;
+               if(errno == EAGAIN || errno == EWOULDBLOCK) break;
+
+               // NOTE: the server is gone, the reader will notice it hung up
+               ce_message("%s() write() failed: %s", __FUNCTION__, strerror(errno));
+               client->outgoing.length = 0;
+               client->outgoing_written = 0;
+               return false;
+          }
+
+          client->outgoing_written += written;
+     }
+
+     if(client->outgoing_written == client->outgoing.length){
+          client->outgoing.length = 0;
+          client->outgoing_written = 0;
+          return true;
+     }
+
+     // the server isn't keeping up, let our thread write the rest when it can take it
+     wake(client);
+     return true;
+}
+
+// client lock must be held
+static bool send_message(LspClient_t* client, const JsonBuilder_t* message, bool may_defer)
+{
+     // NOTE: initialize has to be the first thing the server sees, so anything else waits for its response
+     bool deferring = may_defer && !client->initialized;
+     JsonBuilder_t* out = deferring ? &client->deferred : &client->outgoing;
+
+     if(!json_append(out, "Content-Length: %"PRId64"\r\n\r\n", message->length)) return false;
+     if(!json_append_raw(out, message->text, message->length)) return false;
+
+     return deferring ? true : flush_outgoing(client);
+}
+
+// client lock must be held
+static int64_t send_request(LspClient_t* client, LspRequestType_t type, const char* method, const JsonBuilder_t* params)
+{
+     if(client->request_count == client->request_capacity){
+          int64_t new_capacity = client->request_capacity ? client->request_capacity * 2 : 16;
+          LspRequest_t* new_requests = realloc(client->requests, new_capacity * sizeof(*new_requests));
+          if(!new_requests){
+               ce_message("%s() failed to allocate %"PRId64" requests", __FUNCTION__, new_capacity);
+               return -1;
+          }
+
+          client->requests = new_requests;
+          client->request_capacity = new_capacity;
+     }
+
+     int64_t id = client->next_id++;
+
+     JsonBuilder_t message = {};
+     bool built = json_append(&message, "{\"jsonrpc\":\"2.0\",\"id\":%"PRId64",\"method\":\"%s\",\"params\":%s}",
+                              id, method, params->text);
+     if(!built || !send_message(client, &message, type != LRT_INITIALIZE)){
+          json_builder_free(&message);
+          return -1;
+     }
+
+     json_builder_free(&message);
+
+     client->requests[client->request_count] = (LspRequest_t){id, type};
+     client->request_count++;
+     return id;
+}
+
+// client lock must be held
+static bool send_notification(LspClient_t* client, const char* method, const JsonBuilder_t* params)
+{
+     JsonBuilder_t message = {};
+     bool sent = json_append(&message, "{\"jsonrpc\":\"2.0\",\"method\":\"%s\",\"params\":%s}", method, params->text) &&
+                 send_message(client, &message, true);
+     json_builder_free(&message);
+     return sent;
+}
+
+// client lock must be held, returns LRT_NONE if we weren't waiting on the id
+static LspRequestType_t take_request(LspClient_t* client, int64_t id)
+{
+     for(int64_t i = 0; i < client->request_count; ++i){
+          if(client->requests[i].id != id) continue;
+
+          LspRequestType_t type = client->requests[i].type;
+          client->request_count--;
+          memmove(client->requests + i, client->requests + i + 1, (client->request_count - i) * sizeof(*client->requests));
+          return type;
+     }
+
+     return LRT_NONE;
+}
+
+static LspDocument_t* find_document(LspClient_t* client, const Buffer_t* buffer)
+{
+     for(int64_t i = 0; i < client->document_count; ++i){
+          if(client->documents[i].buffer == buffer) return client->documents + i;
+     }
+
+     return NULL;
+}
+
+static LspDocument_t* find_document_by_uri(LspClient_t* client, const char* uri)
+{
+     for(int64_t i = 0; i < client->document_count; ++i){
+          if(strcmp(client->documents[i].uri, uri) == 0) return client->documents + i;
+     }
+
+     return NULL;
+}
+
+static void document_free_diagnostics(LspDocument_t* document)
+{
+     for(int64_t i = 0; i < document->diagnostic_count; ++i){
+          free(document->diagnostics[i].message);
+     }
+
+     free(document->diagnostics);
+     document->diagnostics = NULL;
+     document->diagnostic_count = 0;
+}
+
+static void append_text_document(JsonBuilder_t* params, const LspDocument_t* document)
+{
+     json_append(params, "\"textDocument\":{\"uri\":");
+     json_append_string(params, document->uri, strlen(document->uri));
+}
+
+static void append_edit(JsonBuilder_t* changes, Point_t start, const char* removed, int64_t removed_length,
+                        const char* inserted, int64_t inserted_length, int64_t* line_count)
+{
+     if(removed_length == 0 && inserted_length == 0) return;
+
+     Point_t end = start;
+     for(int64_t i = 0; i < removed_length; ++i){
+          if(removed[i] == '\n'){
+               end.x = 0;
+               end.y++;
+               (*line_count)--;
+          }else{
+               end.x++;
+          }
+     }
+
+     for(int64_t i = 0; i < inserted_length; ++i){
+          if(inserted[i] == '\n') (*line_count)++;
+     }
+
+     json_append(changes, "%s{\"range\":{\"start\":{\"line\":%"PRId64",\"character\":%"PRId64"},"
+                          "\"end\":{\"line\":%"PRId64",\"character\":%"PRId64"}},\"text\":",
+                 changes->length ? "," : "", start.y, start.x, end.y, end.x);
+     json_append_string(changes, inserted, inserted_length);
+     json_append(changes, "}");
+}
+
+// the ranged changes that redo the commit, or undo it
+static void append_commit(JsonBuilder_t* changes, const BufferCommit_t* commit, bool undo, int64_t* line_count)
+{
+     const char* removed = NULL;
+     int64_t removed_length = 0;
+     const char* inserted = NULL;
+     int64_t inserted_length = 0;
+
+     switch(commit->type){
+     default:
+          return;
+     case BCT_INSERT_CHAR:
+          inserted = &commit->c;
+          inserted_length = 1;
+          break;
+     case BCT_INSERT_STRING:
+          inserted = commit->str;
+          inserted_length = strlen(commit->str);
+          break;
+     case BCT_REMOVE_CHAR:
+          removed = &commit->c;
+          removed_length = 1;
+          break;
+     case BCT_REMOVE_STRING:
+          removed = commit->str;
+          removed_length = strlen(commit->str);
+          break;
+     case BCT_CHANGE_CHAR:
+          inserted = &commit->c;
+          inserted_length = 1;
+          removed = &commit->prev_c;
+          removed_length = 1;
+          break;
+     case BCT_CHANGE_STRING:
+          inserted = commit->str;
+          inserted_length = strlen(commit->str);
+          removed = commit->prev_str;
+          removed_length = strlen(commit->prev_str);
+          break;
+     case BCT_INSERT_BLOCK:
+     case BCT_REMOVE_BLOCK:
+     {
+          // each line edit applies to what the one before it left, so undoing them goes backwards
+          bool inserting = (commit->type == BCT_INSERT_BLOCK) != undo;
+
+          int64_t offset = 0;
+          if(undo){
+               for(int64_t i = 0; i < commit->line_edit_count; ++i) offset += commit->line_edits[i].length;
+          }
+
+          for(int64_t e = 0; e < commit->line_edit_count; ++e){
+               int64_t i = undo ? commit->line_edit_count - 1 - e : e;
+               const BufferLineEdit_t* edit = commit->line_edits + i;
+               if(undo) offset -= edit->length;
+
+               Point_t start = {edit->column, edit->line};
+               const char* text = commit->str + offset;
+               if(inserting){
+                    append_edit(changes, start, NULL, 0, text, edit->length, line_count);
+               }else{
+                    append_edit(changes, start, text, edit->length, NULL, 0, line_count);
+               }
+
+               if(!undo) offset += edit->length;
+          }
+     } return;
+     }
+
+     if(undo){
+          append_edit(changes, commit->start, inserted, inserted_length, removed, removed_length, line_count);
+     }else{
+          append_edit(changes, commit->start, removed, removed_length, inserted, inserted_length, line_count);
+     }
+}
+
+static bool commit_is_synced(const BufferCommitNode_t* node, const LspDocument_t* document)
+{
+     return node == document->synced && node->id == document->synced_id;
+}
+
+// the changes since the server last synced, false if we can't tell what they are from the commits
+static bool append_commits_since_sync(JsonBuilder_t* changes, const LspDocument_t* document,
+                                      const BufferCommitNode_t* commit_tail, int64_t* line_count)
+{
+     // the usual case, the server is behind and what it saw is back down the history
+     const BufferCommitNode_t* itr = commit_tail;
+     for(int64_t i = 0; itr && i < LSP_SYNC_MAX_COMMITS; ++i){
+          if(commit_is_synced(itr, document)){
+               while(itr != commit_tail){
+                    itr = itr->next;
+                    append_commit(changes, &itr->commit, false, line_count);
+               }
+               return true;
+          }
+          itr = itr->prev;
+     }
+
+     // the commits it saw were undone, they are waiting to be redone after the tail
+     itr = commit_tail ? commit_tail->next : NULL;
+     for(int64_t i = 0; itr && i < LSP_SYNC_MAX_COMMITS; ++i){
+          if(commit_is_synced(itr, document)){
+               while(itr != commit_tail){
+                    append_commit(changes, &itr->commit, true, line_count);
+                    itr = itr->prev;
+               }
+               return true;
+          }
+          itr = itr->next;
+     }
+
+     // NOTE: something was undone and then changed, so what the server saw isn't in the history anymore
+     return false;
+}
+
+static void append_full_text(JsonBuilder_t* changes, const Buffer_t* buffer)
+{
+     char* text = ce_dupe_buffer(buffer);
+     json_append(changes, "{\"text\":");
+     if(text){
+          json_append_string(changes, text, strlen(text));
+     }else{
+          json_append(changes, "\"\"");
+     }
+     json_append(changes, "}");
+     free(text);
+}
+
+static void set_diagnostics(LspClient_t* client, const char* uri, const JsonValue_t* diagnostics)
+{
+     pthread_mutex_lock(&client->lock);
+
+     LspDocument_t* document = find_document_by_uri(client, uri);
+     if(!document){
+          pthread_mutex_unlock(&client->lock);
+          return;
+     }
+
+     document_free_diagnostics(document);
+
+     int64_t count = diagnostics->count;
+     document->diagnostics = count ? calloc(count, sizeof(*document->diagnostics)) : NULL;
+     if(count && !document->diagnostics){
+          ce_message("%s() failed to allocate %"PRId64" diagnostics", __FUNCTION__, count);
+          pthread_mutex_unlock(&client->lock);
+          return;
+     }
+
+     for(int64_t i = 0; i < count; ++i){
+          const JsonValue_t* diagnostic = json_at(diagnostics, i);
+          const JsonValue_t* range = json_get(diagnostic, "range");
+          const JsonValue_t* start = json_get(range, "start");
+          const JsonValue_t* end = json_get(range, "end");
+          const char* message = json_get_string(diagnostic, "message");
+
+          LspDiagnostic_t* dst = document->diagnostics + document->diagnostic_count;
+          dst->start = (Point_t){json_get_int(start, "character", 0), json_get_int(start, "line", 0)};
+          dst->end = (Point_t){json_get_int(end, "character", 0), json_get_int(end, "line", 0)};
+          dst->severity = json_get_int(diagnostic, "severity", LDS_ERROR);
+          if(dst->severity <= LDS_NONE || dst->severity >= LDS_COUNT) dst->severity = LDS_ERROR;
+          dst->message = strdup(message ? message : "");
+          document->diagnostic_count++;
+     }
+
+     pthread_mutex_unlock(&client->lock);
+}
+
+// the server asked us something, we don't offer anything so null is always the answer
+static void reply_null(LspClient_t* client, const JsonValue_t* id)
+{
+     JsonBuilder_t message = {};
+     json_append(&message, "{\"jsonrpc\":\"2.0\",\"id\":");
+     if(id->type == JSON_STRING){
+          json_append_string(&message, id->string, strlen(id->string));
+     }else{
+          json_append(&message, "%"PRId64, (int64_t)(id->number));
+     }
+     json_append(&message, ",\"result\":null}");
+
+     pthread_mutex_lock(&client->lock);
+     send_message(client, &message, false);
+     pthread_mutex_unlock(&client->lock);
+
+     json_builder_free(&message);
+}
+
+static void handle_initialize(LspClient_t* client, const JsonValue_t* result)
+{
+     // textDocumentSync is either the kind, or an object holding the kind in change, 2 is incremental
+     const JsonValue_t* sync = json_get(json_get(result, "capabilities"), "textDocumentSync");
+     int64_t kind = 0;
+     if(sync && sync->type == JSON_NUMBER){
+          kind = sync->number;
+     }else{
+          kind = json_get_int(sync, "change", 0);
+     }
+
+     pthread_mutex_lock(&client->lock);
+
+     client->incremental = kind == 2;
+     client->initialized = true;
+
+     JsonBuilder_t params = {};
+     json_append(&params, "{}");
+     send_notification(client, "initialized", &params);
+     json_builder_free(&params);
+
+     if(client->deferred.length){
+          json_append_raw(&client->outgoing, client->deferred.text, client->deferred.length);
+          client->deferred.length = 0;
+     }
+
+     flush_outgoing(client);
+
+     pthread_mutex_unlock(&client->lock);
+}
+
+static void dispatch(LspClient_t* client, const JsonValue_t* message)
+{
+     const char* method = json_get_string(message, "method");
+     const JsonValue_t* id = json_get(message, "id");
+
+     if(method){
+          if(id){
+               reply_null(client, id);
+          }else if(strcmp(method, "textDocument/publishDiagnostics") == 0){
+               const JsonValue_t* params = json_get(message, "params");
+               const char* uri = json_get_string(params, "uri");
+               const JsonValue_t* diagnostics = json_get(params, "diagnostics");
+               if(!uri || !diagnostics || diagnostics->type != JSON_ARRAY) return;
+
+               set_diagnostics(client, uri, diagnostics);
+
+               LspResponse_t response = {LRT_DIAGNOSTICS, 0, uri, params};
+               client->handler(client, &response, client->handler_data);
+          }
+
+          return;
+     }
+
+     if(!id || id->type != JSON_NUMBER) return;
+
+     pthread_mutex_lock(&client->lock);
+     LspRequestType_t type = take_request(client, id->number);
+     pthread_mutex_unlock(&client->lock);
+
+     const JsonValue_t* result = json_get(message, "error") ? NULL : json_get(message, "result");
+
+     switch(type){
+     case LRT_NONE:
+          // canceled, or something we never asked for
+          break;
+     case LRT_INITIALIZE:
+          if(!result) ce_message("%s() server failed to initialize", __FUNCTION__);
+          handle_initialize(client, result);
+          break;
+     default:
+     {
+          LspResponse_t response = {type, id->number, NULL, result};
+          client->handler(client, &response, client->handler_data);
+     } break;
+     }
+}
+
+// returns false when the server hung up
+static bool read_messages(LspClient_t* client)
+{
+     if(client->incoming_capacity - client->incoming_length < LSP_READ_CHUNK){
+          int64_t new_capacity = client->incoming_capacity ? client->incoming_capacity * 2 : LSP_READ_CHUNK * 2;
+          char* new_incoming = realloc(client->incoming, new_capacity);
+          if(!new_incoming){
+               ce_message("%s() failed to grow to %"PRId64" bytes", __FUNCTION__, new_capacity);
+               return false;
+          }
+
+          client->incoming = new_incoming;
+          client->incoming_capacity = new_capacity;
+     }
+
+     ssize_t bytes = read(client->read_fd, client->incoming + client->incoming_length,
+                          client->incoming_capacity - client->incoming_length);
+     if(bytes < 0) return errno == EINTR || errno == EAGAIN;
+     if(bytes == 0) return false;
+
+     client->incoming_length += bytes;
+
+     // messages are a Content-Length header, a blank line, then that much json
+     int64_t offset = 0;
+     while(true){
+          const char* start = client->incoming + offset;
+          int64_t available = client->incoming_length - offset;
+
+          const char* header_end = memmem(start, available, "\r\n\r\n", 4);
+          if(!header_end) break;
+
+          int64_t content_length = -1;
+          for(const char* line = start; line < header_end; ){
+               const char* field = "Content-Length:";
+               int64_t field_length = strlen(field);
+               if(header_end - line > field_length && strncasecmp(line, field, field_length) == 0){
+                    content_length = strtoll(line + field_length, NULL, 10);
+               }
+
+               const char* line_end = memmem(line, header_end - line, "\r\n", 2);
+               if(!line_end) break;
+               line = line_end + 2;
+          }
+
+          int64_t header_length = (header_end + 4) - start;
+          if(content_length < 0){
+               ce_message("%s() message without a Content-Length", __FUNCTION__);
+               offset += header_length;
+               continue;
+          }
+
+          if(available - header_length < content_length) break;
+
+          JsonValue_t message;
+          if(json_parse(start + header_length, content_length, &message)){
+               dispatch(client, &message);
+               json_free(&message);
+          }else{
+               ce_message("%s() failed to parse %"PRId64" byte message", __FUNCTION__, content_length);
+          }
+
+          offset += header_length + content_length;
+     }
+
+     client->incoming_length -= offset;
+     memmove(client->incoming, client->incoming + offset, client->incoming_length);
+     return true;
+}
+
+static void* lsp_thread(void* data)
+{
+     LspClient_t* client = data;
+
+     while(true){
+          pthread_mutex_lock(&client->lock);
+          bool running = client->running;
+          bool writing = client->outgoing_written < client->outgoing.length;
+          pthread_mutex_unlock(&client->lock);
+
+          if(!running) break;
+
+          // NOTE: only watch the write end while we have something for it, a closed pipe would always be ready
+          struct pollfd fds[3] = {
+               {client->read_fd, POLLIN, 0},
+               {client->wake_fds[0], POLLIN, 0},
+               {writing ? client->write_fd : -1, POLLOUT, 0},
+          };
+
+          if(poll(fds, 3, -1) < 0){
+               if(errno == EINTR) continue;
+               ce_message("%s() poll() failed: %s", __FUNCTION__, strerror(errno));
+               break;
+          }
+
+          if(fds[1].revents){
+               char drain[64];
+               while(read(client->wake_fds[0], drain, sizeof(drain)) > 0);
+          }
+
+          if(fds[2].revents){
+               pthread_mutex_lock(&client->lock);
+               flush_outgoing(client);
+               pthread_mutex_unlock(&client->lock);
+          }
+
+          if(fds[0].revents && !read_messages(client)){
+               pthread_mutex_lock(&client->lock);
+               bool stopping = !client->running;
+               client->running = false;
+               pthread_mutex_unlock(&client->lock);
+
+               if(!stopping){
+                    LspResponse_t response = {LRT_EXIT, 0, NULL, NULL};
+                    client->handler(client, &response, client->handler_data);
+               }
+               break;
+          }
+     }
+
+     return NULL;
+}
+
+bool lsp_connect(LspClient_t* client, int write_fd, int read_fd, const char* root, lsp_handler* handler,
+                 void* handler_data)
+{
+     *client = (LspClient_t){};
+     client->write_fd = write_fd;
+     client->read_fd = read_fd;
+     client->handler = handler;
+     client->handler_data = handler_data;
+     client->next_id = 1;
+     pthread_mutex_init(&client->lock, NULL);
+
+     client->root = realpath(root, NULL);
+     if(!client->root) client->root = strdup(root);
+     if(!client->root){
+          close(write_fd);
+          close(read_fd);
+          return false;
+     }
+
+     if(pipe2(client->wake_fds, O_NONBLOCK | O_CLOEXEC) != 0){
+          ce_message("%s() pipe2() failed: %s", __FUNCTION__, strerror(errno));
+          client->wake_fds[0] = -1;
+          client->wake_fds[1] = -1;
+          lsp_stop(client);
+          return false;
+     }
+
+     // writes never wait on the server, what it isn't ready for is queued for our thread
+     fcntl(write_fd, F_SETFL, fcntl(write_fd, F_GETFL) | O_NONBLOCK);
+
+     char* root_uri = lsp_path_to_uri(client->root, client->root);
+
+     JsonBuilder_t params = {};
+     json_append(&params, "{\"processId\":%d,\"rootUri\":", getpid());
+     json_append_string(&params, root_uri, strlen(root_uri));
+     json_append(&params, ",\"capabilities\":{\"textDocument\":{"
+                          "\"synchronization\":{\"didSave\":false},"
+                          "\"completion\":{\"completionItem\":{\"snippetSupport\":false}},"
+                          "\"hover\":{\"contentFormat\":[\"plaintext\"]},"
+                          "\"definition\":{\"linkSupport\":false},"
+                          "\"publishDiagnostics\":{}}}}");
+     free(root_uri);
+
+     pthread_mutex_lock(&client->lock);
+     int64_t id = send_request(client, LRT_INITIALIZE, "initialize", &params);
+     pthread_mutex_unlock(&client->lock);
+     json_builder_free(&params);
+
+     if(id < 0){
+          lsp_stop(client);
+          return false;
+     }
+
+     client->running = true;
+
+     int rc = pthread_create(&client->thread, NULL, lsp_thread, client);
+     if(rc != 0){
+          ce_message("%s() pthread_create() failed: %s", __FUNCTION__, strerror(rc));
+          client->running = false;
+          lsp_stop(client);
+          return false;
+     }
+
+     client->thread_started = true;
+     return true;
+}
+
+bool lsp_start(LspClient_t* client, const char* command, const char* root, lsp_handler* handler, void* handler_data)
+{
+     int to_server[2];
+     int from_server[2];
+     if(pipe2(to_server, O_CLOEXEC) != 0){
+          ce_message("%s() pipe2() failed: %s", __FUNCTION__, strerror(errno));
+          return false;
+     }
+
+     if(pipe2(from_server, O_CLOEXEC) != 0){
+          ce_message("%s() pipe2() failed: %s", __FUNCTION__, strerror(errno));
+          close(to_server[0]);
+          close(to_server[1]);
+          return false;
+     }
+
+     pid_t pid = fork();
+     if(pid == -1){
+          ce_message("%s() fork() failed: %s", __FUNCTION__, strerror(errno));
+          close(to_server[0]);
+          close(to_server[1]);
+          close(from_server[0]);
+          close(from_server[1]);
+          return false;
+     }
+
+     if(pid == 0){
+          // NOTE: whatever the server has to say on stderr would scribble over the screen
+          int null_fd = open("/dev/null", O_WRONLY);
+          dup2(to_server[0], STDIN_FILENO);
+          dup2(from_server[1], STDOUT_FILENO);
+          if(null_fd >= 0) dup2(null_fd, STDERR_FILENO);
+
+          if(chdir(root) != 0) _exit(1);
+          execl("/bin/sh", "sh", "-c", command, (char*)(NULL));
+          _exit(127);
+     }
+
+     close(to_server[0]);
+     close(from_server[1]);
+
+     if(!lsp_connect(client, to_server[1], from_server[0], root, handler, handler_data)){
+          kill(pid, SIGKILL);
+          waitpid(pid, NULL, 0);
+          return false;
+     }
+
+     client->pid = pid;
+     return true;
+}
+
+void lsp_stop(LspClient_t* client)
+{
+     if(!client->root) return;
+
+     pthread_mutex_lock(&client->lock);
+
+     // be polite, we don't wait for an answer though
+     if(client->running && client->initialized){
+          JsonBuilder_t params = {};
+          json_append(&params, "null");
+          send_request(client, LRT_NONE, "shutdown", &params);
+          send_notification(client, "exit", &params);
+          json_builder_free(&params);
+     }
+
+     client->running = false;
+     pthread_mutex_unlock(&client->lock);
+
+     if(client->wake_fds[1] >= 0){
+          wake(client);
+          if(client->thread_started) pthread_join(client->thread, NULL);
+          close(client->wake_fds[0]);
+          close(client->wake_fds[1]);
+     }
+
+     // closing its input is how most servers find out to exit, if they didn't take the hint
+     close(client->write_fd);
+     close(client->read_fd);
+
+     if(client->pid){
+          int64_t waited_ms = 0;
+          while(waitpid(client->pid, NULL, WNOHANG) == 0){
+               if(waited_ms >= LSP_EXIT_WAIT_MS){
+                    kill(client->pid, SIGKILL);
+                    waitpid(client->pid, NULL, 0);
+                    break;
+               }
+
+               usleep(1000);
+               waited_ms++;
+          }
+     }
+
+     for(int64_t i = 0; i < client->document_count; ++i){
+          free(client->documents[i].uri);
+          document_free_diagnostics(client->documents + i);
+     }
+
+     free(client->documents);
+     free(client->requests);
+     free(client->incoming);
+     free(client->root);
+     json_builder_free(&client->outgoing);
+     json_builder_free(&client->deferred);
+     pthread_mutex_destroy(&client->lock);
+
+     *client = (LspClient_t){};
+}
+
+bool lsp_running(LspClient_t* client)
+{
+     if(!client->root) return false;
+
+     pthread_mutex_lock(&client->lock);
+     bool running = client->running;
+     pthread_mutex_unlock(&client->lock);
+     return running;
+}
+
+bool lsp_ready(LspClient_t* client)
+{
+     if(!client->root) return false;
+
+     // NOTE: a server that never started (say it isn't installed) may not have closed its end of the pipe yet. Peek
+     //       without reaping it, lsp_stop() still waits on it
+     if(client->pid){
+          siginfo_t info = {};
+          if(waitid(P_PID, client->pid, &info, WEXITED | WNOHANG | WNOWAIT) != 0 || info.si_pid) return false;
+     }
+
+     pthread_mutex_lock(&client->lock);
+     bool ready = client->running && client->initialized;
+     pthread_mutex_unlock(&client->lock);
+     return ready;
+}
+
+bool lsp_open_document(LspClient_t* client, const Buffer_t* buffer, const BufferCommitNode_t* commit_tail,
+                       const char* language_id)
+{
+     pthread_mutex_lock(&client->lock);
+
+     if(find_document(client, buffer)){
+          pthread_mutex_unlock(&client->lock);
+          return true;
+     }
+
+     if(client->document_count == client->document_capacity){
+          int64_t new_capacity = client->document_capacity ? client->document_capacity * 2 : 8;
+          LspDocument_t* new_documents = realloc(client->documents, new_capacity * sizeof(*new_documents));
+          if(!new_documents){
+               ce_message("%s() failed to allocate %"PRId64" documents", __FUNCTION__, new_capacity);
+               pthread_mutex_unlock(&client->lock);
+               return false;
+          }
+
+          client->documents = new_documents;
+          client->document_capacity = new_capacity;
+     }
+
+     LspDocument_t* document = client->documents + client->document_count;
+     *document = (LspDocument_t){};
+     document->uri = lsp_path_to_uri(client->root, buffer->filename);
+     document->buffer = buffer;
+     document->version = 1;
+     document->synced = commit_tail;
+     document->synced_id = commit_tail ? commit_tail->id : 0;
+     document->line_count = buffer->line_count;
+     if(!document->uri){
+          pthread_mutex_unlock(&client->lock);
+          return false;
+     }
+
+     client->document_count++;
+
+     char* text = ce_dupe_buffer(buffer);
+
+     JsonBuilder_t params = {};
+     json_append(&params, "{");
+     append_text_document(&params, document);
+     json_append(&params, ",\"languageId\":\"%s\",\"version\":%"PRId64",\"text\":", language_id, document->version);
+     json_append_string(&params, text ? text : "", text ? strlen(text) : 0);
+     json_append(&params, "}}");
+     free(text);
+
+     bool sent = send_notification(client, "textDocument/didOpen", &params);
+     json_builder_free(&params);
+
+     pthread_mutex_unlock(&client->lock);
+     return sent;
+}
+
+bool lsp_sync_document(LspClient_t* client, const Buffer_t* buffer, const BufferCommitNode_t* commit_tail)
+{
+     pthread_mutex_lock(&client->lock);
+
+     // NOTE: until the server tells us how it wants changes, they pile up in the commits
+     LspDocument_t* document = find_document(client, buffer);
+     if(!document || !client->initialized ||
+        (commit_tail && commit_is_synced(commit_tail, document) && document->line_count == buffer->line_count)){
+          pthread_mutex_unlock(&client->lock);
+          return false;
+     }
+
+     JsonBuilder_t changes = {};
+     int64_t line_count = document->line_count;
+     if(!client->incremental || !append_commits_since_sync(&changes, document, commit_tail, &line_count) ||
+        line_count != buffer->line_count){
+          // NOTE: when the lines don't add up, the buffer was changed without a commit
+          changes.length = 0;
+          append_full_text(&changes, buffer);
+     }
+
+     document->version++;
+     document->synced = commit_tail;
+     document->synced_id = commit_tail ? commit_tail->id : 0;
+     document->line_count = buffer->line_count;
+
+     JsonBuilder_t params = {};
+     json_append(&params, "{");
+     append_text_document(&params, document);
+     json_append(&params, ",\"version\":%"PRId64"},\"contentChanges\":[", document->version);
+     json_append_raw(&params, changes.text, changes.length);
+     json_append(&params, "]}");
+
+     bool sent = send_notification(client, "textDocument/didChange", &params);
+     json_builder_free(&params);
+     json_builder_free(&changes);
+
+     pthread_mutex_unlock(&client->lock);
+     return sent;
+}
+
+void lsp_close_document(LspClient_t* client, const Buffer_t* buffer)
+{
+     pthread_mutex_lock(&client->lock);
+
+     LspDocument_t* document = find_document(client, buffer);
+     if(!document){
+          pthread_mutex_unlock(&client->lock);
+          return;
+     }
+
+     JsonBuilder_t params = {};
+     json_append(&params, "{");
+     append_text_document(&params, document);
+     json_append(&params, "}}");
+     send_notification(client, "textDocument/didClose", &params);
+     json_builder_free(&params);
+
+     free(document->uri);
+     document_free_diagnostics(document);
+
+     int64_t index = document - client->documents;
+     client->document_count--;
+     memmove(document, document + 1, (client->document_count - index) * sizeof(*document));
+
+     pthread_mutex_unlock(&client->lock);
+}
+
+bool lsp_document_open(LspClient_t* client, const Buffer_t* buffer)
+{
+     if(!client->root) return false;
+
+     pthread_mutex_lock(&client->lock);
+     bool open = find_document(client, buffer) != NULL;
+     pthread_mutex_unlock(&client->lock);
+     return open;
+}
+
+int64_t lsp_diagnostic_count(LspClient_t* client, const Buffer_t* buffer, LspDiagnosticSeverity_t severity)
+{
+     if(!client->root) return 0;
+
+     pthread_mutex_lock(&client->lock);
+
+     int64_t count = 0;
+     LspDocument_t* document = find_document(client, buffer);
+     if(document){
+          for(int64_t i = 0; i < document->diagnostic_count; ++i){
+               if(severity == LDS_NONE || document->diagnostics[i].severity == severity) count++;
+          }
+     }
+
+     pthread_mutex_unlock(&client->lock);
+     return count;
+}
+
+int64_t lsp_request(LspClient_t* client, LspRequestType_t type, const Buffer_t* buffer, Point_t position)
+{
+     const char* method = NULL;
+     switch(type){
+     default:
+          ce_message("%s() unsupported request type %d", __FUNCTION__, type);
+          return -1;
+     case LRT_COMPLETION:
+          method = "textDocument/completion";
+          break;
+     case LRT_DEFINITION:
+          method = "textDocument/definition";
+          break;
+     case LRT_HOVER:
+          method = "textDocument/hover";
+          break;
+     }
+
+     pthread_mutex_lock(&client->lock);
+
+     LspDocument_t* document = find_document(client, buffer);
+     if(!document || !client->running){
+          pthread_mutex_unlock(&client->lock);
+          return -1;
+     }
+
+     JsonBuilder_t params = {};
+     json_append(&params, "{");
+     append_text_document(&params, document);
+     json_append(&params, "},\"position\":{\"line\":%"PRId64",\"character\":%"PRId64"}}", position.y, position.x);
+
+     int64_t id = send_request(client, type, method, &params);
+     json_builder_free(&params);
+
+     pthread_mutex_unlock(&client->lock);
+     return id;
+}
+
+void lsp_cancel(LspClient_t* client, int64_t id)
+{
+     if(!client->root || id < 0) return;
+
+     pthread_mutex_lock(&client->lock);
+
+     // NOTE: once it isn't in flight, a response that was already on its way gets dropped
+     if(take_request(client, id) != LRT_NONE){
+          JsonBuilder_t params = {};
+          json_append(&params, "{\"id\":%"PRId64"}", id);
+          send_notification(client, "$/cancelRequest", &params);
+          json_builder_free(&params);
+     }
+
+     pthread_mutex_unlock(&client->lock);
+}
+
+char* lsp_path_to_uri(const char* root, const char* path)
+{
+     JsonBuilder_t uri = {};
+     json_append(&uri, "file://");
+
+     if(path[0] != '/') json_append(&uri, "%s/", root);
+
+     for(const char* c = path; *c; ++c){
+          if(isalnum((unsigned char)(*c)) || strchr("/-._~", *c)){
+               json_append(&uri, "%c", *c);
+          }else{
+               json_append(&uri, "%%%02X", (unsigned char)(*c));
+          }
+     }
+
+     return uri.text;
+}
+
+bool lsp_uri_to_path(const char* uri, char* path, int64_t size)
+{
+     const char* prefix = "file://";
+     if(strncmp(uri, prefix, strlen(prefix)) != 0) return false;
+
+     int64_t length = 0;
+     for(const char* c = uri + strlen(prefix); *c; ++c){
+          if(length + 1 >= size) return false;
+
+          if(*c == '%' && isxdigit((unsigned char)(c[1])) && isxdigit((unsigned char)(c[2]))){
+               char hex[3] = {c[1], c[2], 0};
+               path[length++] = strtol(hex, NULL, 16);
+               c += 2;
+          }else{
+               path[length++] = *c;
+          }
+     }
+
+     path[length] = 0;
+     return true;
+}
+
+bool lsp_location(const JsonValue_t* result, char* path, int64_t size, Point_t* position)
+{
+     // a Location, an array of them, or an array of LocationLinks
+     const JsonValue_t* location = result;
+     if(location && location->type == JSON_ARRAY) location = json_at(location, 0);
+
+     const char* uri = json_get_string(location, "uri");
+     const JsonValue_t* range = json_get(location, "range");
+     if(!uri){
+          uri = json_get_string(location, "targetUri");
+          range = json_get(location, "targetSelectionRange");
+     }
+
+     const JsonValue_t* start = json_get(range, "start");
+     if(!uri || !start) return false;
+
+     *position = (Point_t){json_get_int(start, "character", 0), json_get_int(start, "line", 0)};
+     return lsp_uri_to_path(uri, path, size);
+}
+
+char* lsp_hover_text(const JsonValue_t* result)
+{
+     // MarkupContent, a MarkedString, or an array of MarkedStrings, where a MarkedString may be a plain string
+     const JsonValue_t* contents = json_get(result, "contents");
+     if(contents && contents->type == JSON_ARRAY) contents = json_at(contents, 0);
+     if(!contents) return NULL;
+
+     if(contents->type == JSON_STRING) return strdup(contents->string);
+
+     const char* value = json_get_string(contents, "value");
+     return value ? strdup(value) : NULL;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+// client for a language server (clangd or anything else that speaks LSP over stdio). Messages are written without
+// blocking and read on the client's own thread, responses are handed to the handler from that thread
+
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "ce.h"
+#include "json.h"
+
+#define LSP_SYNC_MAX_COMMITS 1024 // more commits than this since the last sync, just send the whole document
+
+typedef enum{
+     LRT_NONE,
+     LRT_INITIALIZE,
+     LRT_COMPLETION,
+     LRT_DEFINITION,
+     LRT_HOVER,
+     LRT_DIAGNOSTICS, // not a request, the server publishes these when it feels like it
+     LRT_EXIT, // not a request, the server went away
+     LRT_COUNT,
+}LspRequestType_t;
+
+typedef struct{
+     int64_t id;
+     LspRequestType_t type;
+}LspRequest_t;
+
+typedef enum{
+     LDS_NONE,
+     LDS_ERROR,
+     LDS_WARNING,
+     LDS_INFORMATION,
+     LDS_HINT,
+     LDS_COUNT,
+}LspDiagnosticSeverity_t;
+
+typedef struct{
+     Point_t start;
+     Point_t end;
+     LspDiagnosticSeverity_t severity;
+     char* message;
+}LspDiagnostic_t;
+
+// NOTE: positions we send and receive are byte columns, which matches what servers count for ascii source
+typedef struct{
+     char* uri;
+     const Buffer_t* buffer; // only compared against
+     int64_t version;
+     const BufferCommitNode_t* synced; // newest commit the server has seen, only compared against, it may be free'd
+     uint64_t synced_id; // tells a commit apart from a newer one allocated where a free'd one used to be
+     int64_t line_count; // lines the server thinks the document has, if it disagrees with the buffer we resend it all
+     LspDiagnostic_t* diagnostics;
+     int64_t diagnostic_count;
+}LspDocument_t;
+
+typedef struct{
+     LspRequestType_t type;
+     int64_t id;
+     const char* uri; // set for diagnostics
+     const JsonValue_t* result; // NULL if the request failed
+}LspResponse_t;
+
+struct LspClient_t;
+typedef void lsp_handler(struct LspClient_t* client, const LspResponse_t* response, void* data);
+
+typedef struct LspClient_t{
+     pid_t pid; // 0 if we didn't start the server
+     int write_fd;
+     int read_fd;
+     int wake_fds[2]; // poked when there is something new to write, or it is time to stop
+     pthread_t thread;
+     bool thread_started;
+     pthread_mutex_t lock;
+     bool running;
+     bool initialized; // until the server answers initialize, everything but initialize waits in deferred
+     bool incremental; // the server takes ranged changes, otherwise every change sends the whole document
+     char* root; // absolute directory, relative buffer names are relative to it
+
+     int64_t next_id;
+     JsonBuilder_t outgoing;
+     int64_t outgoing_written; // bytes at the front of outgoing that have already been written
+     JsonBuilder_t deferred;
+
+     LspRequest_t* requests; // in flight, responses to anything not in here are dropped
+     int64_t request_count;
+     int64_t request_capacity;
+
+     LspDocument_t* documents;
+     int64_t document_count;
+     int64_t document_capacity;
+
+     char* incoming; // only touched by the client's thread
+     int64_t incoming_length;
+     int64_t incoming_capacity;
+
+     lsp_handler* handler;
+     void* handler_data;
+}LspClient_t;
+
+bool lsp_start(LspClient_t* client, const char* command, const char* root, lsp_handler* handler, void* handler_data);
+bool lsp_connect(LspClient_t* client, int write_fd, int read_fd, const char* root, lsp_handler* handler,
+                 void* handler_data); // talk to a server that is already running, takes ownership of the fds
+void lsp_stop(LspClient_t* client);
+bool lsp_running(LspClient_t* client);
+bool lsp_ready(LspClient_t* client); // answered initialize and still there, requests before then would only wait on it
+
+bool lsp_open_document(LspClient_t* client, const Buffer_t* buffer, const BufferCommitNode_t* commit_tail,
+                       const char* language_id);
+bool lsp_sync_document(LspClient_t* client, const Buffer_t* buffer, const BufferCommitNode_t* commit_tail);
+void lsp_close_document(LspClient_t* client, const Buffer_t* buffer);
+bool lsp_document_open(LspClient_t* client, const Buffer_t* buffer);
+int64_t lsp_diagnostic_count(LspClient_t* client, const Buffer_t* buffer, LspDiagnosticSeverity_t severity);
+
+int64_t lsp_request(LspClient_t* client, LspRequestType_t type, const Buffer_t* buffer, Point_t position); // id, -1 on failure
+void lsp_cancel(LspClient_t* client, int64_t id);
+
+char* lsp_path_to_uri(const char* root, const char* path);
+bool lsp_uri_to_path(const char* uri, char* path, int64_t size);
+
+// pulling things out of results
+bool lsp_location(const JsonValue_t* result, char* path, int64_t size, Point_t* position); // first one, if there are many
+char* lsp_hover_text(const JsonValue_t* result); // free'd by the caller
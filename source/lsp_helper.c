@@ -0,0 +1,239 @@
+#include "lsp_helper.h"
+#include "completion.h"
+#include "destination.h"
+
+#include <ctype.h>
+#include <limits.h>
+
+extern pthread_mutex_t draw_lock;
+extern pthread_mutex_t completion_lock;
+
+static const char* language_id(const Buffer_t* buffer)
+{
+     switch(buffer->type){
+     default:
+          return NULL;
+     case BFT_C:
+          return "c";
+     case BFT_CPP:
+          return "cpp";
+     }
+}
+
+static void apply_completion(ConfigState_t* config_state, const Buffer_t* buffer, const JsonValue_t* result)
+{
+     // a CompletionList, or just its items
+     const JsonValue_t* items = result;
+     if(items && items->type == JSON_OBJECT) items = json_get(items, "items");
+     if(!items || items->type != JSON_ARRAY) return;
+
+     pthread_mutex_lock(&completion_lock);
+
+     auto_complete_free(&config_state->auto_complete);
+
+     for(int64_t i = 0; i < items->count; ++i){
+          const JsonValue_t* item = json_at(items, i);
+          const char* option = json_get_string(json_get(item, "textEdit"), "newText");
+          if(!option) option = json_get_string(item, "insertText");
+          if(!option) option = json_get_string(item, "label");
+          if(!option) continue;
+
+          // NOTE: clangd lines up labels with a leading space or bullet, the prototype is what we want to see
+          const char* label = json_get_string(item, "label");
+          while(label && *label && (isspace((unsigned char)(*label)) || (unsigned char)(*label) >= 0x80)) label++;
+          const char* detail = json_get_string(item, "detail");
+
+          char description[BUFSIZ];
+          description[0] = 0;
+          if(detail && label && strcmp(label, option) != 0){
+               snprintf(description, sizeof(description), "%s %s", detail, label);
+          }else if(detail){
+               snprintf(description, sizeof(description), "%s", detail);
+          }
+
+          auto_complete_insert(&config_state->auto_complete, option, description[0] ? description : NULL);
+     }
+
+     completion_show_options(config_state, buffer, config_state->lsp.completion_start);
+
+     pthread_mutex_unlock(&completion_lock);
+}
+
+static void apply_definition(ConfigState_t* config_state, const JsonValue_t* result)
+{
+     char path[PATH_MAX];
+     Point_t position;
+     if(!lsp_location(result, path, sizeof(path), &position)){
+          ce_message("language server found no definition");
+          return;
+     }
+
+     dest_open_file(config_state->save_buffer_head, config_state->tab_current->view_current, path, position.y + 1,
+                    position.x + 1);
+}
+
+static void apply_hover(ConfigState_t* config_state, const JsonValue_t* result)
+{
+     free(config_state->lsp.hover);
+     config_state->lsp.hover = lsp_hover_text(result);
+     if(!config_state->lsp.hover) return;
+
+     ce_message("%s", config_state->lsp.hover);
+
+     // only the first line fits in the status
+     char* newline = strchr(config_state->lsp.hover, '\n');
+     if(newline) *newline = 0;
+}
+
+static void handle_response(LspClient_t* client, const LspResponse_t* response, void* data)
+{
+     (void)(client);
+     ConfigState_t* config_state = data;
+     LspState_t* lsp = &config_state->lsp;
+
+     // NOTE: the key handler holds the draw lock too, so nothing we look at changes while we apply the answer
+     pthread_mutex_lock(&draw_lock);
+
+     // drop answers the user has moved on from
+     Buffer_t* buffer = config_state->tab_current->view_current->buffer;
+     bool current = response->id == lsp->latest[response->type] && buffer == lsp->request_buffer[response->type];
+
+     switch(response->type){
+     default:
+          break;
+     case LRT_COMPLETION:
+          if(current && lsp->completion_prefix &&
+             completion_still_applies(buffer, config_state->tab_current->view_current->cursor, lsp->completion_start,
+                                      lsp->completion_prefix)){
+               apply_completion(config_state, buffer, response->result);
+          }
+          break;
+     case LRT_DEFINITION:
+          if(current) apply_definition(config_state, response->result);
+          break;
+     case LRT_HOVER:
+          if(current) apply_hover(config_state, response->result);
+          break;
+     case LRT_EXIT:
+          ce_message("language server exited, completing with clang and finding definitions with cscope");
+          break;
+     }
+
+     view_drawer(config_state);
+     pthread_mutex_unlock(&draw_lock);
+}
+
+static bool start_server(ConfigState_t* config_state)
+{
+     LspState_t* lsp = &config_state->lsp;
+     if(lsp->tried) return lsp_running(&lsp->client);
+
+     lsp->tried = true;
+     for(int64_t i = 0; i < LRT_COUNT; ++i) lsp->latest[i] = -1;
+
+     const char* command = getenv("CE_LSP_SERVER");
+     if(!command) command = LSP_DEFAULT_SERVER;
+     if(!command[0]) return false;
+
+     return lsp_start(&lsp->client, command, ".", handle_response, config_state);
+}
+
+// open the buffer with the server if it isn't already, otherwise send it whatever changed
+static bool sync_buffer(ConfigState_t* config_state, Buffer_t* buffer)
+{
+     BufferState_t* buffer_state = buffer->user_data;
+     const char* language = language_id(buffer);
+     if(!language || !buffer->filename || !buffer_state) return false;
+     if(!start_server(config_state)) return false;
+
+     LspClient_t* client = &config_state->lsp.client;
+     if(!lsp_document_open(client, buffer)) return lsp_open_document(client, buffer, buffer_state->commit_tail, language);
+
+     lsp_sync_document(client, buffer, buffer_state->commit_tail);
+     return true;
+}
+
+void lsp_sync_all_buffers(ConfigState_t* config_state, BufferNode_t* head)
+{
+     for(BufferNode_t* itr = head; itr; itr = itr->next){
+          sync_buffer(config_state, itr->buffer);
+     }
+
+     // let the server forget buffers that were deleted
+     LspClient_t* client = &config_state->lsp.client;
+     for(int64_t i = client->document_count - 1; i >= 0; --i){
+          const Buffer_t* buffer = client->documents[i].buffer;
+
+          BufferNode_t* itr = head;
+          while(itr && itr->buffer != buffer) itr = itr->next;
+          if(!itr) lsp_close_document(client, buffer);
+     }
+}
+
+void lsp_stop_server(ConfigState_t* config_state)
+{
+     lsp_stop(&config_state->lsp.client);
+     free(config_state->lsp.hover);
+     config_state->lsp.hover = NULL;
+     free(config_state->lsp.completion_prefix);
+     config_state->lsp.completion_prefix = NULL;
+}
+
+// the buffer is synced and the server can answer right away. One that is still starting, or never will (it isn't
+// installed), leaves the request to clang or cscope
+static bool server_ready(ConfigState_t* config_state, Buffer_t* buffer)
+{
+     return sync_buffer(config_state, buffer) && lsp_ready(&config_state->lsp.client);
+}
+
+static bool request(ConfigState_t* config_state, LspRequestType_t type, Point_t position)
+{
+     LspState_t* lsp = &config_state->lsp;
+     Buffer_t* buffer = config_state->tab_current->view_current->buffer;
+
+     lsp->latest[type] = lsp_request(&lsp->client, type, buffer, position);
+     lsp->request_buffer[type] = buffer;
+     return lsp->latest[type] >= 0;
+}
+
+bool lsp_complete(ConfigState_t* config_state, Point_t start)
+{
+     BufferView_t* view = config_state->tab_current->view_current;
+     if(!server_ready(config_state, view->buffer)) return false;
+
+     if(auto_completing(&config_state->auto_complete)){
+          auto_complete_end(&config_state->auto_complete);
+     }
+
+     // whatever we asked for before is already out of date
+     lsp_cancel_completion(config_state);
+
+     const char* line = (start.y < view->buffer->line_count) ? view->buffer->lines[start.y] : NULL;
+     free(config_state->lsp.completion_prefix);
+     config_state->lsp.completion_prefix = strndup(line ? line : "", start.x);
+     config_state->lsp.completion_start = start;
+     return request(config_state, LRT_COMPLETION, view->cursor);
+}
+
+bool lsp_goto_definition(ConfigState_t* config_state)
+{
+     BufferView_t* view = config_state->tab_current->view_current;
+     if(!server_ready(config_state, view->buffer)) return false;
+
+     return request(config_state, LRT_DEFINITION, view->cursor);
+}
+
+bool lsp_hover(ConfigState_t* config_state)
+{
+     BufferView_t* view = config_state->tab_current->view_current;
+     if(!server_ready(config_state, view->buffer)) return false;
+
+     return request(config_state, LRT_HOVER, view->cursor);
+}
+
+void lsp_cancel_completion(ConfigState_t* config_state)
+{
+     LspState_t* lsp = &config_state->lsp;
+     lsp_cancel(&lsp->client, lsp->latest[LRT_COMPLETION]);
+     lsp->latest[LRT_COMPLETION] = -1;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "ce_config.h"
+
+#define LSP_DEFAULT_SERVER "clangd" // override with CE_LSP_SERVER, set it empty to never start one
+
+void lsp_sync_all_buffers(ConfigState_t* config_state, BufferNode_t* head); // draw_lock must be held, after each key
+void lsp_stop_server(ConfigState_t* config_state);
+
+// these return false if there is no server for the current buffer, so the caller can fall back on clang or cscope
+bool lsp_complete(ConfigState_t* config_state, Point_t start);
+bool lsp_goto_definition(ConfigState_t* config_state);
+bool lsp_hover(ConfigState_t* config_state);
+void lsp_cancel_completion(ConfigState_t* config_state);
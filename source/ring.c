@@ -0,0 +1,76 @@
+#include "ring.h"
+
+#include <inttypes.h>
+
+bool ring_init(Ring_t* ring, int64_t size)
+{
+     int64_t rounded = 1;
+     while(rounded < size) rounded <<= 1;
+
+     ring->bytes = malloc(rounded);
+     if(!ring->bytes){
+          ce_message("%s() failed to allocate %"PRId64" bytes", __FUNCTION__, rounded);
+          return false;
+     }
+
+     ring->size = rounded;
+     ring->head = 0;
+     ring->tail = 0;
+     return true;
+}
+
+void ring_free(Ring_t* ring)
+{
+     free(ring->bytes);
+     ring->bytes = NULL;
+     ring->size = 0;
+     ring->head = 0;
+     ring->tail = 0;
+}
+
+int64_t ring_writable(const Ring_t* ring)
+{
+     int64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+     return ring->size - (ring->tail - head);
+}
+
+bool ring_write(Ring_t* ring, const void* data, int64_t length)
+{
+     if(ring_writable(ring) < length) return false;
+
+     int64_t index = ring->tail & (ring->size - 1);
+     int64_t first_length = CE_MIN(length, ring->size - index);
+     memcpy(ring->bytes + index, data, first_length);
+     memcpy(ring->bytes, (const char*)(data) + first_length, length - first_length);
+
+     // NOTE: publish the tail after the bytes are written, so the consumer never sees bytes before they are there
+     __atomic_store_n(&ring->tail, ring->tail + length, __ATOMIC_RELEASE);
+     return true;
+}
+
+int64_t ring_readable(const Ring_t* ring)
+{
+     int64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+     return tail - ring->head;
+}
+
+bool ring_peek(const Ring_t* ring, void* data, int64_t length)
+{
+     if(ring_readable(ring) < length) return false;
+     if(length == 0) return true;
+
+     int64_t index = ring->head & (ring->size - 1);
+     int64_t first_length = CE_MIN(length, ring->size - index);
+     memcpy(data, ring->bytes + index, first_length);
+     memcpy((char*)(data) + first_length, ring->bytes, length - first_length);
+     return true;
+}
+
+bool ring_read(Ring_t* ring, void* data, int64_t length)
+{
+     if(!ring_peek(ring, data, length)) return false;
+
+     // NOTE: same as the tail, the bytes have to be copied out before the producer is allowed to reuse them
+     __atomic_store_n(&ring->head, ring->head + length, __ATOMIC_RELEASE);
+     return true;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "ce.h"
+
+// single producer, single consumer byte ring. The producer and the consumer can be on different threads without a
+// lock between them, as long as there is only ever one of each at a time
+// NOTE: head and tail only ever grow, they are masked with size - 1 to index into bytes
+typedef struct{
+     char* bytes;
+     int64_t size; // power of 2
+     int64_t head; // next byte to read, only written by the consumer
+     int64_t tail; // next byte to write, only written by the producer
+}Ring_t;
+
+bool ring_init(Ring_t* ring, int64_t size); // size is rounded up to a power of 2
+void ring_free(Ring_t* ring);
+
+// producer side
+int64_t ring_writable(const Ring_t* ring);
+bool ring_write(Ring_t* ring, const void* data, int64_t length); // writes all of data or nothing
+
+// consumer side
+int64_t ring_readable(const Ring_t* ring);
+bool ring_peek(const Ring_t* ring, void* data, int64_t length); // same as ring_read(), without consuming
+bool ring_read(Ring_t* ring, void* data, int64_t length); // reads all of length or nothing
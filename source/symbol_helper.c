@@ -0,0 +1,138 @@
+#include "symbol_helper.h"
+#include "destination.h"
+#include "view.h"
+
+#include <ctype.h>
+#include <inttypes.h>
+
+void symbol_index_start_project(ConfigState_t* config_state)
+{
+     const char* root = getenv("CE_SYMBOL_INDEX");
+     if(!root) root = SYMBOL_DEFAULT_ROOT;
+     if(!root[0]) return;
+
+     symbol_index_start(&config_state->symbol_index, root, 0);
+}
+
+void symbol_index_stop_project(ConfigState_t* config_state)
+{
+     symbol_index_stop(&config_state->symbol_index);
+}
+
+void symbol_buffer_saved(ConfigState_t* config_state, const Buffer_t* buffer)
+{
+     if(buffer->filename) symbol_index_file_saved(&config_state->symbol_index, buffer->filename);
+}
+
+// reads the lines of one file after another, locations come sorted by file and line so we rarely go backwards
+typedef struct{
+     FILE* file;
+     char* path;
+     int64_t line; // of the next line getline() gives us
+     char* text;
+     size_t text_size;
+}LineReader_t;
+
+static const char* read_line(LineReader_t* reader, const char* path, int64_t line)
+{
+     if(!reader->path || strcmp(reader->path, path) != 0 || line < reader->line){
+          if(reader->file) fclose(reader->file);
+          free(reader->path);
+          reader->file = fopen(path, "r");
+          reader->path = strdup(path);
+          reader->line = 0;
+     }
+
+     if(!reader->file) return NULL;
+
+     while(reader->line <= line){
+          ssize_t length = getline(&reader->text, &reader->text_size, reader->file);
+          if(length < 0) return NULL;
+          if(length && reader->text[length - 1] == '\n') reader->text[length - 1] = 0;
+          reader->line++;
+     }
+
+     return reader->text;
+}
+
+static void line_reader_free(LineReader_t* reader)
+{
+     if(reader->file) fclose(reader->file);
+     free(reader->path);
+     free(reader->text);
+}
+
+static void show_list(ConfigState_t* config_state, const char* word, bool definitions,
+                      const SymbolLocation_t* locations, int64_t count)
+{
+     Buffer_t* buffer = &config_state->symbol_list_buffer;
+     buffer->status = BS_NONE;
+     ce_clear_lines(buffer);
+
+     char line[BUFSIZ];
+     snprintf(line, BUFSIZ, "// %"PRId64" %s of %s", count, definitions ? "definitions" : "references", word);
+     ce_append_line(buffer, line);
+
+     LineReader_t reader = {};
+     for(int64_t i = 0; i < count; ++i){
+          const SymbolLocation_t* location = locations + i;
+          if(!location->path) continue;
+
+          const char* text = read_line(&reader, location->path, location->line);
+          if(!text) text = "";
+          while(isspace((unsigned char)(*text))) text++;
+
+          // NOTE: the same file:line:column: format we jump to from terminals
+          snprintf(line, BUFSIZ, "%s:%"PRId64":%"PRId64": %s %s", location->path, location->line + 1,
+                   location->column + 1, symbol_kind_string(location->kind), text);
+          ce_append_line(buffer, line);
+     }
+     line_reader_free(&reader);
+
+     buffer->status = BS_READONLY;
+
+     BufferView_t* view = config_state->tab_current->view_current;
+     if(view->buffer != buffer) view_override_with_buffer(view, buffer, &config_state->buffer_before_query);
+     view->cursor = (Point_t){0, count ? 1 : 0};
+     view->top_row = 0;
+}
+
+bool symbol_goto_definition(ConfigState_t* config_state, BufferNode_t** head, const char* word)
+{
+     SymbolLocation_t* locations = NULL;
+     int64_t count = symbol_index_lookup(&config_state->symbol_index, word, true, &locations);
+     if(count <= 0) return false;
+
+     if(count == 1 && locations[0].path){
+          dest_open_file(head, config_state->tab_current->view_current, locations[0].path, locations[0].line + 1,
+                         locations[0].column + 1);
+     }else{
+          show_list(config_state, word, true, locations, count);
+     }
+
+     symbol_locations_free(locations, count);
+     return true;
+}
+
+bool symbol_show_references(ConfigState_t* config_state, const char* word)
+{
+     SymbolLocation_t* locations = NULL;
+     int64_t count = symbol_index_lookup(&config_state->symbol_index, word, false, &locations);
+     if(count < 0) return false;
+
+     show_list(config_state, word, false, locations, count);
+     symbol_locations_free(locations, count);
+     return true;
+}
+
+bool symbol_list_goto(ConfigState_t* config_state, BufferNode_t** head, int64_t line)
+{
+     Buffer_t* buffer = &config_state->symbol_list_buffer;
+     if(line < 1 || line >= buffer->line_count) return false; // account for the header
+
+     int64_t last_jump = 0;
+     char current_directory[] = ".";
+     return dest_goto_file_location_in_buffer(head, buffer, line, config_state->tab_current->view_head,
+                                              config_state->tab_current->view_current, &last_jump,
+                                              current_directory);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "ce_config.h"
+
+#define SYMBOL_DEFAULT_ROOT "." // override with CE_SYMBOL_INDEX, set it empty to never index
+
+void symbol_index_start_project(ConfigState_t* config_state);
+void symbol_index_stop_project(ConfigState_t* config_state);
+void symbol_buffer_saved(ConfigState_t* config_state, const Buffer_t* buffer);
+
+// these return false if the index has nothing for the word, so the caller can fall back on cscope. More than one
+// location fills the symbol list buffer, which jumps to the one under the cursor on enter
+bool symbol_goto_definition(ConfigState_t* config_state, BufferNode_t** head, const char* word);
+bool symbol_show_references(ConfigState_t* config_state, const char* word);
+bool symbol_list_goto(ConfigState_t* config_state, BufferNode_t** head, int64_t line);
@@ -0,0 +1,1404 @@
+#include "symbol_index.h"
+#include "file_index.h"
+#include "util.h"
+#include "ce.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char symbol_index_magic[8] = {'C', 'E', 'S', 'Y', 'M', 'B', 'O', 'L'};
+
+// NOTE: sorted, so we can bsearch it
+static const char* keywords[] = {
+     "_Alignas", "_Alignof", "_Atomic", "_Bool", "_Complex", "_Generic", "_Imaginary", "_Noreturn", "_Static_assert",
+     "_Thread_local", "__asm__", "__attribute__", "__declspec", "__extension__", "__inline", "__inline__", "__restrict",
+     "__typeof__", "alignas", "alignof", "asm", "auto", "bool", "break", "case", "catch", "char", "char16_t", "char32_t",
+     "class", "const", "const_cast", "constexpr", "continue", "decltype", "default", "delete", "do", "double",
+     "dynamic_cast", "else", "enum", "explicit", "export", "extern", "false", "float", "for", "friend", "goto", "if",
+     "inline", "int", "long", "mutable", "namespace", "new", "noexcept", "nullptr", "operator", "private", "protected",
+     "public", "register", "reinterpret_cast", "restrict", "return", "short", "signed", "sizeof", "static",
+     "static_assert", "static_cast", "struct", "switch", "template", "this", "thread_local", "throw", "true", "try",
+     "typedef", "typeid", "typename", "typeof", "union", "unsigned", "using", "virtual", "void", "volatile", "wchar_t",
+     "while",
+};
+
+#define KEYWORD_MAX_LENGTH 16
+
+static int compare_keyword(const void* a, const void* b)
+{
+     return strcmp(*(const char**)(a), *(const char**)(b));
+}
+
+// returns the keyword, so callers can compare pointers to the ones they care about, or NULL
+static const char* keyword(const char* start, int64_t length)
+{
+     if(length > KEYWORD_MAX_LENGTH) return NULL;
+
+     char word[KEYWORD_MAX_LENGTH + 1];
+     memcpy(word, start, length);
+     word[length] = 0;
+
+     const char* key = word;
+     const char** found = bsearch(&key, keywords, sizeof(keywords) / sizeof(keywords[0]), sizeof(keywords[0]),
+                                  compare_keyword);
+     return found ? *found : NULL;
+}
+
+static bool is_word(const char* start, int64_t length, const char* word)
+{
+     return (int64_t)(strlen(word)) == length && strncmp(start, word, length) == 0;
+}
+
+const char* symbol_kind_string(SymbolKind_t kind)
+{
+     switch(kind){
+     default:
+          return "unknown";
+     case SK_FUNCTION:
+          return "function";
+     case SK_MACRO:
+          return "macro";
+     case SK_TYPE:
+          return "type";
+     case SK_ENUMERATOR:
+          return "enumerator";
+     case SK_VARIABLE:
+          return "variable";
+     case SK_REFERENCE:
+          return "reference";
+     }
+}
+
+void symbol_list_free(SymbolList_t* list)
+{
+     free(list->symbols);
+     free(list->names);
+     memset(list, 0, sizeof(*list));
+}
+
+static int64_t list_add(SymbolList_t* list, const char* name, int64_t length, uint32_t line, uint32_t column,
+                        SymbolKind_t kind)
+{
+     if(list->count == list->capacity){
+          int64_t new_capacity = list->capacity ? list->capacity * 2 : 256;
+          ParsedSymbol_t* new_symbols = realloc(list->symbols, new_capacity * sizeof(*new_symbols));
+          if(!new_symbols) return -1;
+          list->symbols = new_symbols;
+          list->capacity = new_capacity;
+     }
+
+     if(list->names_length + length + 1 > list->names_capacity){
+          int64_t new_capacity = list->names_capacity ? list->names_capacity * 2 : 4096;
+          while(new_capacity < list->names_length + length + 1) new_capacity *= 2;
+          char* new_names = realloc(list->names, new_capacity);
+          if(!new_names) return -1;
+          list->names = new_names;
+          list->names_capacity = new_capacity;
+     }
+
+     ParsedSymbol_t* symbol = list->symbols + list->count;
+     symbol->name = list->names_length;
+     symbol->line = line;
+     symbol->column = column;
+     symbol->kind = kind;
+
+     memcpy(list->names + list->names_length, name, length);
+     list->names_length += length;
+     list->names[list->names_length++] = 0;
+     return list->count++;
+}
+
+typedef enum{
+     TT_END,
+     TT_IDENTIFIER,
+     TT_LITERAL, // numbers, strings and characters
+     TT_PUNCTUATION, // always a single character
+}TokenType_t;
+
+typedef struct{
+     TokenType_t type;
+     const char* start;
+     int64_t length;
+     uint32_t line;
+     uint32_t column;
+     bool directive; // part of a preprocessor line
+     bool directive_start; // the '#' that starts one
+}Token_t;
+
+typedef struct{
+     const char* text;
+     int64_t length;
+     int64_t at;
+     uint32_t line;
+     int64_t line_start;
+     bool line_begin; // nothing but whitespace so far on this line
+     bool directive;
+}Scanner_t;
+
+static void scanner_newline(Scanner_t* scanner)
+{
+     // NOTE: expects at to be on the newline
+     scanner->line++;
+     scanner->line_start = scanner->at + 1;
+}
+
+static bool identifier_char(char c)
+{
+     return isalnum((unsigned char)(c)) || c == '_';
+}
+
+static char scanner_peek(const Scanner_t* scanner, int64_t offset)
+{
+     return (scanner->at + offset < scanner->length) ? scanner->text[scanner->at + offset] : 0;
+}
+
+static Token_t next_token(Scanner_t* scanner)
+{
+     Token_t token = {};
+
+     // skip whitespace and comments
+     while(scanner->at < scanner->length){
+          char c = scanner->text[scanner->at];
+          char next = scanner_peek(scanner, 1);
+
+          if(c == '\n'){
+               scanner_newline(scanner);
+               scanner->at++;
+               scanner->line_begin = true;
+               scanner->directive = false;
+          }else if(c == '\\' && (next == '\n' || (next == '\r' && scanner_peek(scanner, 2) == '\n'))){
+               // a continued line, directives carry on to the next one
+               scanner->at += (next == '\n') ? 1 : 2;
+               scanner_newline(scanner);
+               scanner->at++;
+          }else if(isspace((unsigned char)(c))){
+               scanner->at++;
+          }else if(c == '/' && next == '/'){
+               while(scanner->at < scanner->length && scanner->text[scanner->at] != '\n') scanner->at++;
+          }else if(c == '/' && next == '*'){
+               scanner->at += 2;
+               while(scanner->at < scanner->length &&
+                     !(scanner->text[scanner->at] == '*' && scanner_peek(scanner, 1) == '/')){
+                    if(scanner->text[scanner->at] == '\n') scanner_newline(scanner);
+                    scanner->at++;
+               }
+               scanner->at += 2;
+               if(scanner->at > scanner->length) scanner->at = scanner->length;
+          }else{
+               break;
+          }
+     }
+
+     if(scanner->at >= scanner->length){
+          token.type = TT_END;
+          return token;
+     }
+
+     const char* text = scanner->text;
+     char c = text[scanner->at];
+
+     token.start = text + scanner->at;
+     token.line = scanner->line;
+     token.column = scanner->at - scanner->line_start;
+
+     if(c == '#' && scanner->line_begin){
+          scanner->directive = true;
+          token.directive_start = true;
+     }
+
+     token.directive = scanner->directive;
+     scanner->line_begin = false;
+
+     if(isalpha((unsigned char)(c)) || c == '_'){
+          token.type = TT_IDENTIFIER;
+          while(scanner->at < scanner->length && identifier_char(text[scanner->at])) scanner->at++;
+     }else if(isdigit((unsigned char)(c)) || (c == '.' && isdigit((unsigned char)(scanner_peek(scanner, 1))))){
+          token.type = TT_LITERAL;
+          while(scanner->at < scanner->length && (identifier_char(text[scanner->at]) || text[scanner->at] == '.')){
+               scanner->at++;
+          }
+     }else if(c == '"' || c == '\''){
+          token.type = TT_LITERAL;
+          scanner->at++;
+          while(scanner->at < scanner->length && text[scanner->at] != c && text[scanner->at] != '\n'){
+               if(text[scanner->at] == '\\' && scanner->at + 1 < scanner->length){
+                    scanner->at++;
+                    if(text[scanner->at] == '\n') scanner_newline(scanner);
+               }
+               scanner->at++;
+          }
+          if(scanner->at < scanner->length && text[scanner->at] == c) scanner->at++;
+     }else{
+          token.type = TT_PUNCTUATION;
+          scanner->at++;
+     }
+
+     token.length = (text + scanner->at) - token.start;
+     return token;
+}
+
+typedef enum{
+     SS_NONE,
+     SS_FILE,
+     SS_NAMESPACE, // namespace and extern "C" bodies, which we treat just like the file
+     SS_RECORD, // struct, union and class bodies
+     SS_ENUM,
+     SS_FUNCTION,
+     SS_BLOCK, // everything else in braces, including initializers
+}ScopeType_t;
+
+// what we know about the statement we're in the middle of, as much as we need to spot definitions
+typedef struct{
+     int64_t declarator; // the symbol the statement may be declaring, -1 if there isn't one yet
+     int64_t candidate; // the symbol before the statement's first '(', a function if a body follows
+     int64_t tag; // the name after struct, union, enum, class or namespace
+     ScopeType_t tag_scope; // what opening a body after the tag would start
+     bool expect_tag;
+     bool tag_defined; // the tag's body was already opened
+     bool is_typedef;
+     bool is_extern;
+     bool initializer;
+     bool expect_enumerator;
+     int64_t paren_depth;
+     int64_t bracket_depth;
+}Statement_t;
+
+typedef struct{
+     ScopeType_t type;
+     Statement_t outer; // the statement the body was opened in
+     bool resume; // carry on with outer once the body closes, like the declarators after a struct's body
+}Scope_t;
+
+#define SYMBOL_PARSE_MAX_DEPTH 256
+
+static void statement_reset(Statement_t* statement)
+{
+     memset(statement, 0, sizeof(*statement));
+     statement->declarator = -1;
+     statement->candidate = -1;
+     statement->tag = -1;
+}
+
+static bool declaration_scope(ScopeType_t scope)
+{
+     return scope == SS_FILE || scope == SS_NAMESPACE || scope == SS_RECORD;
+}
+
+// the statement reached a ',', '=' or ';', anything it declared is now known
+static void statement_declared(SymbolList_t* list, Statement_t* statement, ScopeType_t scope)
+{
+     if(statement->is_typedef){
+          int64_t name = (statement->declarator >= 0) ? statement->declarator : statement->candidate;
+          if(name >= 0) list->symbols[name].kind = SK_TYPE;
+     }else if(statement->declarator >= 0 && statement->candidate < 0 && !statement->is_extern && scope != SS_RECORD){
+          list->symbols[statement->declarator].kind = SK_VARIABLE;
+     }
+
+     statement->declarator = -1;
+}
+
+typedef enum{
+     DS_NONE,
+     DS_WORD, // waiting for define, include, if ...
+     DS_DEFINE, // waiting for the macro's name
+     DS_BODY, // identifiers are references
+     DS_SKIP, // nothing on the rest of the line is a symbol
+}DirectiveState_t;
+
+bool symbol_parse(const char* text, int64_t length, SymbolList_t* list)
+{
+     Scanner_t scanner = {};
+     scanner.text = text;
+     scanner.length = length;
+     scanner.line_begin = true;
+
+     Scope_t scopes[SYMBOL_PARSE_MAX_DEPTH];
+     int64_t depth = 0;
+     int64_t overflow = 0; // braces past the depth we track
+     ScopeType_t scope = SS_FILE;
+
+     Statement_t statement;
+     statement_reset(&statement);
+
+     DirectiveState_t directive = DS_NONE;
+
+     // the two tokens before this one, and the symbol the last one added if it was an identifier
+     Token_t prev = {};
+     Token_t prev2 = {};
+     int64_t prev_symbol = -1;
+     const char* prev_keyword = NULL;
+
+     while(true){
+          Token_t token = next_token(&scanner);
+          if(token.type == TT_END) break;
+
+          int64_t symbol = -1;
+          const char* key = NULL;
+
+          if(token.directive){
+               if(token.directive_start){
+                    directive = DS_WORD;
+               }else if(directive == DS_WORD){
+                    directive = DS_BODY;
+                    if(token.type != TT_IDENTIFIER){
+                         directive = DS_SKIP;
+                    }else if(is_word(token.start, token.length, "define")){
+                         directive = DS_DEFINE;
+                    }else if(is_word(token.start, token.length, "include") ||
+                             is_word(token.start, token.length, "include_next") ||
+                             is_word(token.start, token.length, "import") ||
+                             is_word(token.start, token.length, "pragma") ||
+                             is_word(token.start, token.length, "error") ||
+                             is_word(token.start, token.length, "warning") ||
+                             is_word(token.start, token.length, "line")){
+                         directive = DS_SKIP;
+                    }
+               }else if(token.type == TT_IDENTIFIER && directive == DS_DEFINE){
+                    if(list_add(list, token.start, token.length, token.line, token.column, SK_MACRO) < 0) return false;
+                    directive = DS_BODY;
+               }else if(token.type == TT_IDENTIFIER && directive == DS_BODY && !keyword(token.start, token.length) &&
+                        !is_word(token.start, token.length, "defined")){
+                    if(list_add(list, token.start, token.length, token.line, token.column, SK_REFERENCE) < 0) return false;
+               }
+
+               // NOTE: directives don't take part in the statements around them
+               continue;
+          }
+
+          if(token.type == TT_IDENTIFIER){
+               key = keyword(token.start, token.length);
+               if(key){
+                    if(strcmp(key, "typedef") == 0){
+                         statement.is_typedef = true;
+                    }else if(strcmp(key, "extern") == 0){
+                         statement.is_extern = true;
+                    }else if(strcmp(key, "struct") == 0 || strcmp(key, "union") == 0 || strcmp(key, "class") == 0){
+                         // NOTE: 'enum class' is still an enum
+                         if(!(statement.expect_tag && statement.tag_scope == SS_ENUM)){
+                              statement.tag_scope = SS_RECORD;
+                              statement.tag = -1;
+                              statement.tag_defined = false;
+                         }
+                         statement.expect_tag = true;
+                    }else if(strcmp(key, "enum") == 0){
+                         statement.tag_scope = SS_ENUM;
+                         statement.tag = -1;
+                         statement.tag_defined = false;
+                         statement.expect_tag = true;
+                    }else if(strcmp(key, "namespace") == 0){
+                         statement.tag_scope = SS_NAMESPACE;
+                         statement.tag = -1;
+                         statement.expect_tag = true;
+                    }
+               }else{
+                    symbol = list_add(list, token.start, token.length, token.line, token.column, SK_REFERENCE);
+                    if(symbol < 0) return false;
+
+                    if(statement.expect_tag){
+                         statement.tag = symbol;
+                         statement.expect_tag = false;
+                    }else if(scope == SS_ENUM){
+                         if(statement.expect_enumerator && statement.paren_depth == 0){
+                              list->symbols[symbol].kind = SK_ENUMERATOR;
+                              statement.expect_enumerator = false;
+                         }
+                    }else if(declaration_scope(scope) && !statement.initializer && statement.bracket_depth == 0){
+                         if(statement.paren_depth == 0){
+                              statement.declarator = symbol;
+                         }else if(statement.paren_depth == 1 && statement.candidate < 0 &&
+                                  prev.type == TT_PUNCTUATION && prev.start[0] == '*' &&
+                                  prev2.type == TT_PUNCTUATION && prev2.start[0] == '('){
+                              // a function pointer: (*name)
+                              statement.declarator = symbol;
+                         }
+                    }
+               }
+          }else if(token.type == TT_PUNCTUATION){
+               char c = token.start[0];
+               bool top = statement.paren_depth == 0 && statement.bracket_depth == 0;
+
+               if(c != '{') statement.expect_tag = false;
+
+               switch(c){
+               default:
+                    break;
+               case '(':
+                    if(declaration_scope(scope) && top && !statement.initializer && statement.candidate < 0 &&
+                       statement.declarator >= 0 && prev_symbol == statement.declarator){
+                         statement.candidate = statement.declarator;
+                         statement.declarator = -1;
+                    }
+                    statement.paren_depth++;
+                    break;
+               case ')':
+                    if(statement.paren_depth > 0) statement.paren_depth--;
+                    break;
+               case '[':
+                    statement.bracket_depth++;
+                    break;
+               case ']':
+                    if(statement.bracket_depth > 0) statement.bracket_depth--;
+                    break;
+               case '=':
+                    if(!top) break;
+                    if(declaration_scope(scope)) statement_declared(list, &statement, scope);
+                    statement.initializer = true;
+                    break;
+               case ',':
+                    if(!top) break;
+                    if(scope == SS_ENUM){
+                         statement.expect_enumerator = true;
+                    }else if(declaration_scope(scope)){
+                         statement_declared(list, &statement, scope);
+                         statement.initializer = false;
+                    }
+                    break;
+               case ';':
+                    if(!top) break;
+                    if(declaration_scope(scope)) statement_declared(list, &statement, scope);
+                    statement_reset(&statement);
+                    break;
+               case '{':
+               {
+                    statement.expect_tag = false;
+
+                    bool tag_body = (statement.tag_scope == SS_RECORD || statement.tag_scope == SS_ENUM) &&
+                                    !statement.tag_defined && !statement.initializer && statement.candidate < 0;
+
+                    // outside of declarations, only a body right after the tag defines it, not a compound literal
+                    if(tag_body && !declaration_scope(scope)){
+                         tag_body = (statement.tag >= 0 && prev_symbol == statement.tag) ||
+                                    (prev_keyword && (strcmp(prev_keyword, "struct") == 0 ||
+                                                      strcmp(prev_keyword, "union") == 0 ||
+                                                      strcmp(prev_keyword, "class") == 0 ||
+                                                      strcmp(prev_keyword, "enum") == 0));
+                    }
+
+                    ScopeType_t inner = SS_BLOCK;
+                    bool resume = true;
+
+                    if(declaration_scope(scope) &&
+                       (statement.tag_scope == SS_NAMESPACE ||
+                        (statement.is_extern && statement.candidate < 0 && statement.declarator < 0))){
+                         inner = SS_NAMESPACE;
+                         resume = false;
+                    }else if(tag_body){
+                         if(statement.tag >= 0) list->symbols[statement.tag].kind = SK_TYPE;
+                         statement.tag_defined = true;
+                         statement.declarator = -1;
+                         inner = statement.tag_scope;
+                    }else if(declaration_scope(scope) && statement.candidate >= 0 && !statement.initializer &&
+                             statement.paren_depth == 0 && !statement.is_typedef){
+                         list->symbols[statement.candidate].kind = SK_FUNCTION;
+                         inner = SS_FUNCTION;
+                         resume = false;
+                    }
+
+                    if(depth >= SYMBOL_PARSE_MAX_DEPTH){
+                         overflow++;
+                         break;
+                    }
+
+                    scopes[depth].type = inner;
+                    scopes[depth].outer = statement;
+                    scopes[depth].resume = resume;
+                    depth++;
+                    scope = inner;
+
+                    statement_reset(&statement);
+                    if(inner == SS_ENUM) statement.expect_enumerator = true;
+               } break;
+               case '}':
+                    if(overflow){
+                         overflow--;
+                         break;
+                    }
+
+                    if(depth == 0) break; // unbalanced, most likely from #if'd out code
+
+                    depth--;
+                    if(scopes[depth].resume){
+                         statement = scopes[depth].outer;
+                    }else{
+                         statement_reset(&statement);
+                    }
+                    scope = depth ? scopes[depth - 1].type : SS_FILE;
+                    break;
+               }
+          }
+
+          prev2 = prev;
+          prev = token;
+          prev_symbol = symbol;
+          prev_keyword = key;
+     }
+
+     return true;
+}
+
+// strings to indices, the strings are owned by whoever filled it
+typedef struct{
+     const char** keys; // NULL if the slot is empty
+     uint32_t* values;
+     int64_t count;
+     int64_t capacity; // power of 2
+}StringMap_t;
+
+static int64_t string_map_slot(const char** keys, int64_t capacity, const char* key)
+{
+     int64_t mask = capacity - 1;
+     int64_t i = util_hash_string(key) & mask;
+     while(keys[i] && strcmp(keys[i], key) != 0) i = (i + 1) & mask;
+     return i;
+}
+
+static bool string_map_grow(StringMap_t* map)
+{
+     int64_t new_capacity = map->capacity ? map->capacity * 2 : 1024;
+     const char** new_keys = calloc(new_capacity, sizeof(*new_keys));
+     uint32_t* new_values = malloc(new_capacity * sizeof(*new_values));
+     if(!new_keys || !new_values){
+          free(new_keys);
+          free(new_values);
+          return false;
+     }
+
+     for(int64_t i = 0; i < map->capacity; ++i){
+          if(!map->keys[i]) continue;
+          int64_t slot = string_map_slot(new_keys, new_capacity, map->keys[i]);
+          new_keys[slot] = map->keys[i];
+          new_values[slot] = map->values[i];
+     }
+
+     free(map->keys);
+     free(map->values);
+     map->keys = new_keys;
+     map->values = new_values;
+     map->capacity = new_capacity;
+     return true;
+}
+
+// sets value to what was already there for key, otherwise inserts it as is
+static bool string_map_insert(StringMap_t* map, const char* key, uint32_t* value)
+{
+     if(map->capacity){
+          int64_t slot = string_map_slot(map->keys, map->capacity, key);
+          if(map->keys[slot]){
+               *value = map->values[slot];
+               return true;
+          }
+     }
+
+     // keep the load factor under a half
+     if((map->count + 1) * 2 > map->capacity && !string_map_grow(map)) return false;
+
+     int64_t slot = string_map_slot(map->keys, map->capacity, key);
+     map->keys[slot] = key;
+     map->values[slot] = *value;
+     map->count++;
+     return true;
+}
+
+static bool string_map_find(const StringMap_t* map, const char* key, uint32_t* value)
+{
+     if(!map->capacity) return false;
+
+     int64_t slot = string_map_slot(map->keys, map->capacity, key);
+     if(!map->keys[slot]) return false;
+
+     *value = map->values[slot];
+     return true;
+}
+
+static void string_map_free(StringMap_t* map)
+{
+     free(map->keys);
+     free(map->values);
+     memset(map, 0, sizeof(*map));
+}
+
+static void table_free(SymbolTable_t* table)
+{
+     if(table->mapped){
+          munmap(table->data, table->size);
+     }else{
+          free(table->data);
+     }
+
+     memset(table, 0, sizeof(*table));
+}
+
+// check everything points where it should, the file could be from a crash or anyone's guess
+static bool table_open(SymbolTable_t* table, void* data, size_t size, bool mapped)
+{
+     const SymbolIndexHeader_t* header = data;
+     if(size < sizeof(*header)) return false;
+     if(memcmp(header->magic, symbol_index_magic, sizeof(symbol_index_magic)) != 0) return false;
+     if(header->version != SYMBOL_INDEX_VERSION) return false;
+
+     uint64_t available = size - sizeof(*header);
+     if(header->file_count > available / sizeof(SymbolFile_t)) return false;
+     available -= header->file_count * sizeof(SymbolFile_t);
+     if(header->symbol_count > available / sizeof(Symbol_t)) return false;
+     available -= header->symbol_count * sizeof(Symbol_t);
+     if(header->string_size != available || header->string_size == 0) return false;
+
+     const SymbolFile_t* files = (const SymbolFile_t*)(header + 1);
+     const Symbol_t* symbols = (const Symbol_t*)(files + header->file_count);
+     const char* strings = (const char*)(symbols + header->symbol_count);
+     if(strings[header->string_size - 1] != 0) return false;
+
+     for(uint64_t i = 0; i < header->file_count; ++i){
+          if(files[i].path >= header->string_size) return false;
+     }
+
+     for(uint64_t i = 0; i < header->symbol_count; ++i){
+          const Symbol_t* symbol = symbols + i;
+          if(symbol->name >= header->string_size || symbol->file >= header->file_count) return false;
+          if(symbol->kind <= SK_NONE || symbol->kind >= SK_COUNT) return false;
+     }
+
+     table->data = data;
+     table->size = size;
+     table->mapped = mapped;
+     table->header = header;
+     table->files = files;
+     table->symbols = symbols;
+     table->strings = strings;
+     return true;
+}
+
+static bool table_load(SymbolTable_t* table, const char* path)
+{
+     int fd = open(path, O_RDONLY);
+     if(fd < 0) return false;
+
+     struct stat info;
+     if(fstat(fd, &info) != 0 || info.st_size <= 0){
+          close(fd);
+          return false;
+     }
+
+     void* data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+     close(fd);
+     if(data == MAP_FAILED) return false;
+
+     if(!table_open(table, data, info.st_size, true)){
+          munmap(data, info.st_size);
+          return false;
+     }
+
+     return true;
+}
+
+static void table_install(SymbolIndex_t* index, SymbolTable_t* table)
+{
+     pthread_mutex_lock(&index->lock);
+     SymbolTable_t old = index->table;
+     index->table = *table;
+     index->generation++;
+     pthread_mutex_unlock(&index->lock);
+
+     table_free(&old);
+}
+
+// a file the next table will have
+typedef struct{
+     char* path; // relative to the root
+     int64_t modified;
+     bool parse; // otherwise we keep what the current table has for it
+     bool missing; // we went to parse it and couldn't, leave it out
+     SymbolList_t list;
+}IndexFile_t;
+
+typedef struct{
+     IndexFile_t* files;
+     int64_t count;
+     int64_t capacity;
+}IndexFiles_t;
+
+// a symbol on its way into the next table
+typedef struct{
+     const char* name;
+     uint32_t name_id; // index into the unique names
+     uint32_t file;
+     uint32_t line;
+     uint32_t column;
+     SymbolKind_t kind;
+}PendingSymbol_t;
+
+typedef struct{
+     PendingSymbol_t* symbols;
+     int64_t count;
+     int64_t capacity;
+}PendingSymbols_t;
+
+static bool add_file(IndexFiles_t* files, const char* path, int64_t modified)
+{
+     if(files->count == files->capacity){
+          int64_t new_capacity = files->capacity ? files->capacity * 2 : 256;
+          IndexFile_t* new_files = realloc(files->files, new_capacity * sizeof(*new_files));
+          if(!new_files) return false;
+          files->files = new_files;
+          files->capacity = new_capacity;
+     }
+
+     char* path_copy = strdup(path);
+     if(!path_copy) return false;
+
+     IndexFile_t* file = files->files + files->count++;
+     memset(file, 0, sizeof(*file));
+     file->path = path_copy;
+     file->modified = modified;
+     return true;
+}
+
+static void files_free(IndexFiles_t* files)
+{
+     for(int64_t i = 0; i < files->count; ++i){
+          free(files->files[i].path);
+          symbol_list_free(&files->files[i].list);
+     }
+
+     free(files->files);
+     memset(files, 0, sizeof(*files));
+}
+
+static bool add_pending(PendingSymbols_t* pending, const char* name, uint32_t file, uint32_t line, uint32_t column,
+                        SymbolKind_t kind)
+{
+     if(pending->count == pending->capacity){
+          int64_t new_capacity = pending->capacity ? pending->capacity * 2 : 4096;
+          PendingSymbol_t* new_symbols = realloc(pending->symbols, new_capacity * sizeof(*new_symbols));
+          if(!new_symbols) return false;
+          pending->symbols = new_symbols;
+          pending->capacity = new_capacity;
+     }
+
+     PendingSymbol_t* symbol = pending->symbols + pending->count++;
+     symbol->name = name;
+     symbol->file = file;
+     symbol->line = line;
+     symbol->column = column;
+     symbol->kind = kind;
+     return true;
+}
+
+static int64_t modified_time(const struct stat* info)
+{
+     return (int64_t)(info->st_mtim.tv_sec) * 1000000000 + info->st_mtim.tv_nsec;
+}
+
+static bool source_file(const char* path)
+{
+     static const char* extensions[] = {".c", ".h", ".cc", ".cpp", ".cxx", ".hh", ".hpp", ".hxx", ".inl"};
+
+     const char* dot = strrchr(path, '.');
+     if(!dot) return false;
+
+     for(size_t i = 0; i < sizeof(extensions) / sizeof(extensions[0]); ++i){
+          if(strcmp(dot, extensions[i]) == 0) return true;
+     }
+
+     return false;
+}
+
+// the project's source files, walked the same way the file index walks it so both see the same files
+static void find_source_files(const SymbolIndex_t* index, IndexFiles_t* files)
+{
+     int64_t walked_count = 0;
+     char** walked = file_index_walk(index->root, index->thread_count, &walked_count);
+
+     for(int64_t i = 0; i < walked_count; ++i){
+          char path[PATH_MAX];
+          struct stat info;
+          if(files->count < SYMBOL_INDEX_MAX_FILES && source_file(walked[i]) &&
+             snprintf(path, sizeof(path), "%s/%s", index->root, walked[i]) < PATH_MAX &&
+             stat(path, &info) == 0 && S_ISREG(info.st_mode)){
+               add_file(files, walked[i], modified_time(&info));
+          }
+
+          free(walked[i]);
+     }
+
+     free(walked);
+}
+
+static void parse_file(const char* root, IndexFile_t* file)
+{
+     file->missing = true;
+
+     char path[PATH_MAX];
+     if(snprintf(path, sizeof(path), "%s/%s", root, file->path) >= PATH_MAX) return;
+
+     int fd = open(path, O_RDONLY);
+     if(fd < 0) return;
+
+     struct stat info;
+     if(fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size > SYMBOL_INDEX_MAX_FILE_SIZE){
+          close(fd);
+          return;
+     }
+
+     char* text = malloc(info.st_size + 1);
+     if(!text){
+          close(fd);
+          return;
+     }
+
+     int64_t length = 0;
+     while(length < info.st_size){
+          ssize_t bytes = read(fd, text + length, info.st_size - length);
+          if(bytes <= 0) break;
+          length += bytes;
+     }
+
+     close(fd);
+
+     file->modified = modified_time(&info);
+     file->missing = !symbol_parse(text, length, &file->list);
+     if(file->missing) symbol_list_free(&file->list);
+     free(text);
+}
+
+typedef struct{
+     const char* root;
+     IndexFile_t* files;
+     int64_t count;
+     int64_t next; // claimed by the workers with an atomic add
+}ParseWork_t;
+
+static void* parse_worker(void* data)
+{
+     ParseWork_t* work = data;
+
+     while(true){
+          int64_t i = __atomic_fetch_add(&work->next, 1, __ATOMIC_RELAXED);
+          if(i >= work->count) break;
+          if(work->files[i].parse) parse_file(work->root, work->files + i);
+     }
+
+     return NULL;
+}
+
+static void parse_files(SymbolIndex_t* index, IndexFiles_t* files, int64_t parse_count)
+{
+     ParseWork_t work = {index->root, files->files, files->count, 0};
+
+     int64_t thread_count = index->thread_count;
+     if(thread_count > parse_count) thread_count = parse_count;
+
+     pthread_t threads[SYMBOL_INDEX_MAX_THREADS];
+     int64_t started = 0;
+     for(int64_t i = 1; i < thread_count; ++i){
+          if(pthread_create(threads + started, NULL, parse_worker, &work) != 0) break;
+          started++;
+     }
+
+     // this thread pitches in too
+     parse_worker(&work);
+
+     for(int64_t i = 0; i < started; ++i){
+          pthread_join(threads[i], NULL);
+     }
+}
+
+static int compare_string(const void* a, const void* b)
+{
+     return strcmp(*(const char**)(a), *(const char**)(b));
+}
+
+static int compare_index_file(const void* a, const void* b)
+{
+     return strcmp(((const IndexFile_t*)(a))->path, ((const IndexFile_t*)(b))->path);
+}
+
+static int compare_symbol(const void* a, const void* b)
+{
+     const Symbol_t* left = a;
+     const Symbol_t* right = b;
+
+     if(left->name != right->name) return left->name < right->name ? -1 : 1;
+     if(left->kind != right->kind) return left->kind < right->kind ? -1 : 1;
+     if(left->file != right->file) return left->file < right->file ? -1 : 1;
+     if(left->line != right->line) return left->line < right->line ? -1 : 1;
+     if(left->column != right->column) return left->column < right->column ? -1 : 1;
+     return 0;
+}
+
+// lay out the table the way it is written to disk
+static bool build_table(const IndexFiles_t* files, const uint32_t* file_ids, uint32_t file_count,
+                        PendingSymbols_t* pending, void** image, size_t* image_size)
+{
+     bool success = false;
+     StringMap_t names = {};
+     const char** unique = NULL;
+     const char** sorted = NULL;
+     uint32_t* offsets = NULL;
+     int64_t unique_count = 0;
+
+     unique = malloc((pending->count + 1) * sizeof(*unique));
+     if(!unique) goto cleanup;
+
+     for(int64_t i = 0; i < pending->count; ++i){
+          uint32_t id = unique_count;
+          if(!string_map_insert(&names, pending->symbols[i].name, &id)) goto cleanup;
+          if(id == unique_count) unique[unique_count++] = pending->symbols[i].name;
+          pending->symbols[i].name_id = id;
+     }
+
+     // NOTE: names go in sorted, so symbols sort by comparing offsets rather than strings
+     sorted = malloc((unique_count + 1) * sizeof(*sorted));
+     offsets = malloc((unique_count + 1) * sizeof(*offsets));
+     if(!sorted || !offsets) goto cleanup;
+
+     memcpy(sorted, unique, unique_count * sizeof(*sorted));
+     qsort(sorted, unique_count, sizeof(*sorted), compare_string);
+
+     uint64_t string_size = 0;
+     for(int64_t i = 0; i < unique_count; ++i){
+          uint32_t id = 0;
+          string_map_find(&names, sorted[i], &id);
+          offsets[id] = string_size;
+          string_size += strlen(sorted[i]) + 1;
+     }
+
+     uint64_t names_size = string_size;
+     for(int64_t i = 0; i < files->count; ++i){
+          if(file_ids[i] != UINT32_MAX) string_size += strlen(files->files[i].path) + 1;
+     }
+
+     if(string_size == 0) string_size = 1;
+     if(string_size >= UINT32_MAX){
+          ce_message("%s() too many symbols to index", __FUNCTION__);
+          goto cleanup;
+     }
+
+     size_t size = sizeof(SymbolIndexHeader_t) + file_count * sizeof(SymbolFile_t) +
+                   pending->count * sizeof(Symbol_t) + string_size;
+     char* data = calloc(1, size);
+     if(!data) goto cleanup;
+
+     SymbolIndexHeader_t* header = (SymbolIndexHeader_t*)(data);
+     memcpy(header->magic, symbol_index_magic, sizeof(symbol_index_magic));
+     header->version = SYMBOL_INDEX_VERSION;
+     header->file_count = file_count;
+     header->symbol_count = pending->count;
+     header->string_size = string_size;
+
+     SymbolFile_t* table_files = (SymbolFile_t*)(header + 1);
+     Symbol_t* symbols = (Symbol_t*)(table_files + file_count);
+     char* strings = (char*)(symbols + pending->count);
+
+     for(int64_t i = 0; i < unique_count; ++i){
+          uint32_t id = 0;
+          string_map_find(&names, sorted[i], &id);
+          strcpy(strings + offsets[id], sorted[i]);
+     }
+
+     uint64_t path_offset = names_size;
+     for(int64_t i = 0; i < files->count; ++i){
+          if(file_ids[i] == UINT32_MAX) continue;
+          SymbolFile_t* file = table_files + file_ids[i];
+          file->path = path_offset;
+          file->modified = files->files[i].modified;
+          strcpy(strings + path_offset, files->files[i].path);
+          path_offset += strlen(files->files[i].path) + 1;
+     }
+
+     for(int64_t i = 0; i < pending->count; ++i){
+          const PendingSymbol_t* from = pending->symbols + i;
+          Symbol_t* symbol = symbols + i;
+          symbol->name = offsets[from->name_id];
+          symbol->file = from->file;
+          symbol->line = from->line;
+          symbol->column = from->column;
+          symbol->kind = from->kind;
+     }
+
+     qsort(symbols, pending->count, sizeof(*symbols), compare_symbol);
+
+     *image = data;
+     *image_size = size;
+     success = true;
+
+cleanup:
+     string_map_free(&names);
+     free(unique);
+     free(sorted);
+     free(offsets);
+     return success;
+}
+
+// parse whatever changed since the current table and replace it. When we aren't scanning, the files are the ones the
+// current table has, plus any that were saved
+static void rebuild(SymbolIndex_t* index, bool scan, char** dirty, int64_t dirty_count)
+{
+     // NOTE: only this thread replaces the table, so we can read it without the lock
+     const SymbolTable_t* old = &index->table;
+     uint32_t old_file_count = old->data ? old->header->file_count : 0;
+
+     IndexFiles_t files = {};
+     StringMap_t old_paths = {};
+     StringMap_t new_paths = {};
+     PendingSymbols_t pending = {};
+     uint32_t* old_to_new = NULL;
+     uint32_t* file_ids = NULL;
+     void* image = NULL;
+     size_t image_size = 0;
+
+     for(uint32_t i = 0; i < old_file_count; ++i){
+          uint32_t value = i;
+          if(!string_map_insert(&old_paths, old->strings + old->files[i].path, &value)) goto cleanup;
+     }
+
+     if(scan){
+          find_source_files(index, &files);
+     }else{
+          for(uint32_t i = 0; i < old_file_count; ++i){
+               if(!add_file(&files, old->strings + old->files[i].path, old->files[i].modified)) goto cleanup;
+          }
+     }
+
+     for(int64_t i = 0; i < files.count; ++i){
+          uint32_t value = i;
+          if(!string_map_insert(&new_paths, files.files[i].path, &value)) goto cleanup;
+     }
+
+     // saved files are always parsed again, new ones join the index
+     for(int64_t i = 0; i < dirty_count; ++i){
+          uint32_t file = 0;
+          if(string_map_find(&new_paths, dirty[i], &file)){
+               files.files[file].parse = true;
+               continue;
+          }
+
+          if(!add_file(&files, dirty[i], 0)) goto cleanup;
+          files.files[files.count - 1].parse = true;
+     }
+
+     int64_t parse_count = 0;
+     for(int64_t i = 0; i < files.count; ++i){
+          IndexFile_t* file = files.files + i;
+          uint32_t old_file = 0;
+          if(!string_map_find(&old_paths, file->path, &old_file) || old->files[old_file].modified != file->modified){
+               file->parse = true;
+          }
+
+          if(file->parse) parse_count++;
+     }
+
+     // nothing new, nothing gone
+     if(parse_count == 0 && files.count == old_file_count && old->data) goto cleanup;
+
+     if(parse_count) parse_files(index, &files, parse_count);
+
+     // the files that made it get their indices in path order
+     qsort(files.files, files.count, sizeof(*files.files), compare_index_file);
+
+     file_ids = malloc((files.count + 1) * sizeof(*file_ids));
+     old_to_new = malloc((old_file_count + 1) * sizeof(*old_to_new));
+     if(!file_ids || !old_to_new) goto cleanup;
+
+     for(uint32_t i = 0; i < old_file_count; ++i) old_to_new[i] = UINT32_MAX;
+
+     uint32_t file_count = 0;
+     for(int64_t i = 0; i < files.count; ++i){
+          IndexFile_t* file = files.files + i;
+          file_ids[i] = UINT32_MAX;
+          if(file->missing) continue;
+
+          file_ids[i] = file_count++;
+
+          uint32_t old_file = 0;
+          if(!file->parse && string_map_find(&old_paths, file->path, &old_file)) old_to_new[old_file] = file_ids[i];
+     }
+
+     if(file_count == 0 && !old->data) goto cleanup; // no source here, don't leave an index behind
+
+     if(old->data){
+          for(uint64_t i = 0; i < old->header->symbol_count; ++i){
+               const Symbol_t* symbol = old->symbols + i;
+               uint32_t file = old_to_new[symbol->file];
+               if(file == UINT32_MAX) continue;
+               if(!add_pending(&pending, old->strings + symbol->name, file, symbol->line, symbol->column,
+                               symbol->kind)){
+                    goto cleanup;
+               }
+          }
+     }
+
+     for(int64_t i = 0; i < files.count; ++i){
+          IndexFile_t* file = files.files + i;
+          if(!file->parse || file->missing) continue;
+
+          for(int64_t s = 0; s < file->list.count; ++s){
+               const ParsedSymbol_t* symbol = file->list.symbols + s;
+               if(!add_pending(&pending, file->list.names + symbol->name, file_ids[i], symbol->line, symbol->column,
+                               symbol->kind)){
+                    goto cleanup;
+               }
+          }
+     }
+
+     if(!build_table(&files, file_ids, file_count, &pending, &image, &image_size)) goto cleanup;
+
+     SymbolTable_t table = {};
+     // NOTE: replace the file, so an editor mapping the old one never sees a half written one
+     struct iovec iovec = {image, image_size};
+     if(util_write_file_replacing(index->index_path, &iovec, 1) && table_load(&table, index->index_path)){
+          free(image);
+     }else{
+          // NOTE: maybe the project is read only, we can still use what we built
+          table_open(&table, image, image_size, false);
+     }
+
+     image = NULL;
+     table_install(index, &table);
+
+cleanup:
+     free(image);
+     free(file_ids);
+     free(old_to_new);
+     free(pending.symbols);
+     string_map_free(&old_paths);
+     string_map_free(&new_paths);
+     files_free(&files);
+}
+
+static void* index_thread(void* data)
+{
+     SymbolIndex_t* index = data;
+
+     // whatever we wrote last time is good to go while we look for what changed
+     SymbolTable_t table = {};
+     if(table_load(&table, index->index_path)) table_install(index, &table);
+
+     pthread_mutex_lock(&index->lock);
+
+     while(true){
+          while(index->running && !index->scan && !index->dirty_count){
+               pthread_cond_wait(&index->wake, &index->lock);
+          }
+
+          if(!index->running) break;
+
+          bool scan = index->scan;
+          char** dirty = index->dirty;
+          int64_t dirty_count = index->dirty_count;
+          index->scan = false;
+          index->dirty = NULL;
+          index->dirty_count = 0;
+
+          pthread_mutex_unlock(&index->lock);
+
+          rebuild(index, scan, dirty, dirty_count);
+
+          for(int64_t i = 0; i < dirty_count; ++i) free(dirty[i]);
+          free(dirty);
+
+          pthread_mutex_lock(&index->lock);
+     }
+
+     pthread_mutex_unlock(&index->lock);
+     return NULL;
+}
+
+bool symbol_index_start(SymbolIndex_t* index, const char* root, int64_t thread_count)
+{
+     memset(index, 0, sizeof(*index));
+
+     index->real_root = realpath(root, NULL);
+     if(!index->real_root){
+          ce_message("%s() failed to find '%s': %s", __FUNCTION__, root, strerror(errno));
+          return false;
+     }
+
+     index->root = strdup(root);
+     if(asprintf(&index->index_path, "%s/%s", root, SYMBOL_INDEX_FILE) < 0) index->index_path = NULL;
+     if(!index->root || !index->index_path){
+          ce_message("%s() failed to allocate paths", __FUNCTION__);
+          symbol_index_stop(index);
+          return false;
+     }
+
+     if(thread_count <= 0) thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+     if(thread_count <= 0) thread_count = 1;
+     if(thread_count > SYMBOL_INDEX_MAX_THREADS) thread_count = SYMBOL_INDEX_MAX_THREADS;
+     index->thread_count = thread_count;
+
+     pthread_mutex_init(&index->lock, NULL);
+     pthread_cond_init(&index->wake, NULL);
+     index->running = true;
+     index->scan = true;
+
+     int rc = pthread_create(&index->thread, NULL, index_thread, index);
+     if(rc != 0){
+          ce_message("%s() pthread_create() failed: %s", __FUNCTION__, strerror(rc));
+          pthread_mutex_destroy(&index->lock);
+          pthread_cond_destroy(&index->wake);
+          index->running = false;
+          symbol_index_stop(index);
+          return false;
+     }
+
+     index->thread_started = true;
+     return true;
+}
+
+void symbol_index_stop(SymbolIndex_t* index)
+{
+     if(index->thread_started){
+          pthread_mutex_lock(&index->lock);
+          index->running = false;
+          pthread_cond_signal(&index->wake);
+          pthread_mutex_unlock(&index->lock);
+
+          pthread_join(index->thread, NULL);
+          pthread_mutex_destroy(&index->lock);
+          pthread_cond_destroy(&index->wake);
+     }
+
+     for(int64_t i = 0; i < index->dirty_count; ++i) free(index->dirty[i]);
+     free(index->dirty);
+
+     table_free(&index->table);
+     free(index->root);
+     free(index->real_root);
+     free(index->index_path);
+     memset(index, 0, sizeof(*index));
+}
+
+static void request(SymbolIndex_t* index, const char* dirty)
+{
+     pthread_mutex_lock(&index->lock);
+
+     if(dirty){
+          char** new_dirty = realloc(index->dirty, (index->dirty_count + 1) * sizeof(*new_dirty));
+          char* copy = strdup(dirty);
+          if(new_dirty) index->dirty = new_dirty;
+          if(new_dirty && copy){
+               index->dirty[index->dirty_count++] = copy;
+          }else{
+               free(copy);
+          }
+     }else{
+          index->scan = true;
+     }
+
+     pthread_cond_signal(&index->wake);
+     pthread_mutex_unlock(&index->lock);
+}
+
+void symbol_index_file_saved(SymbolIndex_t* index, const char* path)
+{
+     if(!index->thread_started || !source_file(path)) return;
+
+     char* real_path = realpath(path, NULL);
+     if(!real_path) return;
+
+     // only files under the root belong in the index
+     size_t root_length = strlen(index->real_root);
+     if(strncmp(real_path, index->real_root, root_length) == 0 && real_path[root_length] == '/'){
+          request(index, real_path + root_length + 1);
+     }
+
+     free(real_path);
+}
+
+void symbol_index_rescan(SymbolIndex_t* index)
+{
+     if(index->thread_started) request(index, NULL);
+}
+
+uint64_t symbol_index_generation(SymbolIndex_t* index)
+{
+     if(!index->thread_started) return 0;
+
+     pthread_mutex_lock(&index->lock);
+     uint64_t generation = index->generation;
+     pthread_mutex_unlock(&index->lock);
+     return generation;
+}
+
+int64_t symbol_index_lookup(SymbolIndex_t* index, const char* name, bool definitions, SymbolLocation_t** locations)
+{
+     *locations = NULL;
+     if(!index->thread_started) return -1;
+
+     pthread_mutex_lock(&index->lock);
+
+     const SymbolTable_t* table = &index->table;
+     if(!table->data){
+          pthread_mutex_unlock(&index->lock);
+          return -1;
+     }
+
+     // find the first symbol with the name
+     int64_t symbol_count = table->header->symbol_count;
+     int64_t low = 0;
+     int64_t high = symbol_count;
+     while(low < high){
+          int64_t mid = low + (high - low) / 2;
+          if(strcmp(table->strings + table->symbols[mid].name, name) < 0){
+               low = mid + 1;
+          }else{
+               high = mid;
+          }
+     }
+
+     // NOTE: every symbol with the same name shares the same string, and definitions sort before references
+     int64_t start = low;
+     int64_t end = low;
+     if(start < symbol_count && strcmp(table->strings + table->symbols[start].name, name) == 0){
+          uint32_t offset = table->symbols[start].name;
+          while(end < symbol_count && table->symbols[end].name == offset) end++;
+
+          int64_t first_reference = start;
+          while(first_reference < end && table->symbols[first_reference].kind != SK_REFERENCE) first_reference++;
+
+          if(definitions){
+               end = first_reference;
+          }else{
+               start = first_reference;
+          }
+     }
+
+     int64_t count = end - start;
+     if(count > 0){
+          *locations = calloc(count, sizeof(**locations));
+          if(!*locations) count = 0;
+     }
+
+     bool in_place = strcmp(index->root, ".") == 0;
+     for(int64_t i = 0; i < count; ++i){
+          const Symbol_t* symbol = table->symbols + start + i;
+          const char* path = table->strings + table->files[symbol->file].path;
+          SymbolLocation_t* location = (*locations) + i;
+
+          if(in_place){
+               location->path = strdup(path);
+          }else if(asprintf(&location->path, "%s/%s", index->root, path) < 0){
+               location->path = NULL;
+          }
+
+          location->line = symbol->line;
+          location->column = symbol->column;
+          location->kind = symbol->kind;
+     }
+
+     pthread_mutex_unlock(&index->lock);
+     return count;
+}
+
+void symbol_locations_free(SymbolLocation_t* locations, int64_t count)
+{
+     for(int64_t i = 0; i < count; ++i) free(locations[i].path);
+     free(locations);
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+// index of where c and c++ symbols are defined and referenced across a project. It is built in the background by a
+// pool of threads, written to a file in the project and mapped back in, so lookups are a binary search and the next
+// time the project is opened only files that changed since are parsed again
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define SYMBOL_INDEX_FILE ".ce_symbols"
+#define SYMBOL_INDEX_VERSION 1
+#define SYMBOL_INDEX_MAX_THREADS 8
+#define SYMBOL_INDEX_MAX_FILES 50000 // stop walking past this many, we were probably started somewhere like $HOME
+#define SYMBOL_INDEX_MAX_FILE_SIZE (8 * 1024 * 1024) // bigger files are almost certainly generated
+
+typedef enum{
+     SK_NONE,
+     SK_FUNCTION,
+     SK_MACRO,
+     SK_TYPE, // struct, union, enum and class tags, and typedef names
+     SK_ENUMERATOR,
+     SK_VARIABLE, // file scope variables
+     SK_REFERENCE, // sorts after every kind of definition
+     SK_COUNT,
+}SymbolKind_t;
+
+// the file is a header, then the files, then the symbols sorted by name, kind, file and position, then the strings
+typedef struct{
+     char magic[8];
+     uint32_t version;
+     uint32_t file_count;
+     uint64_t symbol_count;
+     uint64_t string_size;
+}SymbolIndexHeader_t;
+
+typedef struct{
+     uint32_t path; // offset into the strings, relative to the root
+     uint32_t unused;
+     int64_t modified; // nanoseconds, when the file was parsed
+}SymbolFile_t;
+
+typedef struct{
+     uint32_t name; // offset into the strings, names are laid out in sorted order so comparing offsets compares names
+     uint32_t file;
+     uint32_t line; // 0 indexed
+     uint32_t column; // 0 indexed
+     uint32_t kind;
+}Symbol_t;
+
+// a whole index, mapped from the file, or kept in memory if we couldn't write it
+typedef struct{
+     void* data; // NULL if there isn't one yet
+     size_t size;
+     bool mapped;
+     const SymbolIndexHeader_t* header;
+     const SymbolFile_t* files;
+     const Symbol_t* symbols;
+     const char* strings;
+}SymbolTable_t;
+
+// what a single file holds, names are packed back to back in one allocation
+typedef struct{
+     uint32_t name; // offset into names
+     uint32_t line;
+     uint32_t column;
+     SymbolKind_t kind;
+}ParsedSymbol_t;
+
+typedef struct{
+     ParsedSymbol_t* symbols;
+     int64_t count;
+     int64_t capacity;
+     char* names;
+     int64_t names_length;
+     int64_t names_capacity;
+}SymbolList_t;
+
+typedef struct{
+     char* path; // joined with the root the index was started with
+     int64_t line; // 0 indexed
+     int64_t column; // 0 indexed
+     SymbolKind_t kind;
+}SymbolLocation_t;
+
+typedef struct{
+     char* root;
+     char* real_root; // saved paths are made relative to this
+     char* index_path;
+     int64_t thread_count; // parsing threads
+
+     pthread_t thread;
+     bool thread_started;
+     pthread_mutex_t lock;
+     pthread_cond_t wake;
+     bool running;
+     bool scan; // walk the project for new and changed files
+     char** dirty; // files saved since the last update, relative to the root
+     int64_t dirty_count;
+     SymbolTable_t table; // replaced as a whole by the index's thread, read under lock
+     uint64_t generation; // bumped every time the table is replaced
+}SymbolIndex_t;
+
+bool symbol_index_start(SymbolIndex_t* index, const char* root, int64_t thread_count); // thread_count <= 0 uses the cpus
+void symbol_index_stop(SymbolIndex_t* index);
+void symbol_index_file_saved(SymbolIndex_t* index, const char* path); // reindex it, and add it if it's new
+void symbol_index_rescan(SymbolIndex_t* index);
+uint64_t symbol_index_generation(SymbolIndex_t* index); // 0 until there is a table to look things up in
+
+// returns how many were found, or -1 if there is no table yet. locations are sorted by kind, then file and position
+int64_t symbol_index_lookup(SymbolIndex_t* index, const char* name, bool definitions, SymbolLocation_t** locations);
+void symbol_locations_free(SymbolLocation_t* locations, int64_t count);
+const char* symbol_kind_string(SymbolKind_t kind);
+
+// find the definitions and references in c or c++ source. A definition's name is not also counted as a reference
+bool symbol_parse(const char* text, int64_t length, SymbolList_t* list);
+void symbol_list_free(SymbolList_t* list);
@@ -594,7 +594,7 @@ static void syntax_determine_highlight(SyntaxHighlighterData_t* data, SyntaxHigh
 {
      const char* buffer_line = data->buffer->lines[data->loc.y];
 
-     if(ce_point_in_range(data->loc, data->buffer->highlight_start, data->buffer->highlight_end)){
+     if(data->loc.x >= data->highlight_first && data->loc.x <= data->highlight_last){
           highlight->type = HL_VISUAL;
           highlight->chars_til_highlight--;
           highlight->highlight_left--;
@@ -5,308 +5,1634 @@
 #include <pwd.h>
 #include <signal.h>
 #include <sys/wait.h>
+#include <fcntl.h>
 #include <ctype.h>
 #include <assert.h>
+#include <inttypes.h>
 
 #ifdef __APPLE__
      #include <util.h>
      #include <sys/ioctl.h>
 #else
      #include <pty.h>
-     #include <fcntl.h> // for O_* constants (sem_open)
 #endif
 
-TerminalColorPairNode_t* terminal_color_pairs_head = NULL;
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 
-void terminal_switch_color(int fg, int bg)
+TerminalColorPairs_t terminal_color_pairs = {};
+
+static bool terminal_color_pairs_init()
+{
+     if(terminal_color_pairs.pairs) return true;
+
+     terminal_color_pairs.pairs = calloc(TERM_COLOR_COUNT * TERM_COLOR_COUNT, sizeof(*terminal_color_pairs.pairs));
+     if(!terminal_color_pairs.pairs) return false;
+
+     // the default colors are always the first pair
+     init_pair(TERM_START_COLOR, COLOR_FOREGROUND, COLOR_BACKGROUND);
+     terminal_color_pairs.pairs[0] = TERM_START_COLOR;
+     terminal_color_pairs.next_pair = TERM_START_COLOR + 1;
+     return true;
+}
+
+void terminal_color_pairs_free()
+{
+     free(terminal_color_pairs.pairs);
+     terminal_color_pairs.pairs = NULL;
+     terminal_color_pairs.next_pair = 0;
+}
+
+// map a 256 palette color onto the 8 or 16 colors the display supports
+static int reduce_color(int color)
+{
+     if(color < COLORS) return color;
+
+     if(color < 16) return color - 8;
+
+     if(color < 232){
+          // the 6x6x6 cube, each channel that is at least half on sets its ansi color bit
+          int cube = color - 16;
+          int r = (cube / 36) >= 3;
+          int g = ((cube / 6) % 6) >= 3;
+          int b = (cube % 6) >= 3;
+          return r | (g << 1) | (b << 2);
+     }
+
+     // grayscale ramp
+     return (color < 244) ? COLOR_BLACK : COLOR_WHITE;
+}
+
+void terminal_switch_color(int fg, int bg, int attrs)
+{
+     assert(terminal_color_pairs.pairs);
+
+     if(fg < -1 || fg >= TERM_COLOR_COUNT - 1) fg = COLOR_FOREGROUND;
+     if(bg < -1 || bg >= TERM_COLOR_COUNT - 1) bg = COLOR_BACKGROUND;
+
+     if(fg >= 0) fg = reduce_color(fg);
+     if(bg >= 0) bg = reduce_color(bg);
+
+     short* pair = terminal_color_pairs.pairs + ((fg + 1) * TERM_COLOR_COUNT + (bg + 1));
+
+     if(!*pair){
+          // NOTE: COLOR_PAIR() only has room for 256 pairs, once we run out fall back to the default colors
+          if(terminal_color_pairs.next_pair < COLOR_PAIRS && terminal_color_pairs.next_pair < 256){
+               *pair = terminal_color_pairs.next_pair++;
+               init_pair(*pair, fg, bg);
+          }else{
+               *pair = TERM_START_COLOR;
+          }
+     }
+
+     attron(COLOR_PAIR(*pair));
+
+     attroff(A_BOLD | A_UNDERLINE | A_REVERSE);
+     if(attrs & TERM_ATTR_BOLD) attron(A_BOLD);
+     if(attrs & TERM_ATTR_UNDERLINE) attron(A_UNDERLINE);
+     if(attrs & TERM_ATTR_REVERSE) attron(A_REVERSE);
+}
+
+void handle_sigchld(int signal, siginfo_t* info, void *ptr)
+{
+     (void)(ptr);
+
+     int stat;
+     pid_t p;
+
+     ce_message("terminal shell saw signal: %d", signal);
+
+     if(signal != SIGINT){
+          if((p = waitpid(info->si_pid, &stat, WNOHANG)) < 0){
+               ce_message("terminal waiting for shell pid %d failed: %s\n", info->si_pid, strerror(errno));
+          }
+
+          if(info->si_pid != p) return;
+
+          if(!WIFEXITED(stat) || WEXITSTATUS(stat)){
+               ce_message("terminal shell child exitted with code %d\n", stat);
+          }
+     }
+}
+
+// binary search for the last run starting at or before the column, -1 means the column is in the line's first color
+static int64_t color_line_find_run(const TerminalColorLine_t* color_line, int64_t column)
+{
+     int64_t found = -1;
+     int64_t low = 0;
+     int64_t high = color_line->run_count - 1;
+
+     while(low <= high){
+          int64_t mid = (low + high) / 2;
+          if(color_line->runs[mid].column <= column){
+               found = mid;
+               low = mid + 1;
+          }else{
+               high = mid - 1;
+          }
+     }
+
+     return found;
+}
+
+static const TerminalColor_t* color_line_run_color(const TerminalColorLine_t* color_line, int64_t run_index)
+{
+     if(run_index < 0) return &color_line->first;
+     return &color_line->runs[run_index].color;
+}
+
+static const TerminalColor_t* color_line_last_color(const TerminalColorLine_t* color_line)
+{
+     return color_line_run_color(color_line, color_line->run_count - 1);
+}
+
+static bool color_equal(TerminalColor_t a, TerminalColor_t b)
+{
+     return a.fg == b.fg && a.bg == b.bg && a.attrs == b.attrs;
+}
+
+static bool color_line_reserve(TerminalColorLine_t* color_line, int32_t run_count)
+{
+     if(run_count <= color_line->run_capacity) return true;
+
+     int32_t new_capacity = color_line->run_capacity ? color_line->run_capacity : 4;
+     while(new_capacity < run_count) new_capacity *= 2;
+
+     TerminalColorRun_t* new_runs = realloc(color_line->runs, new_capacity * sizeof(*new_runs));
+     if(!new_runs) return false;
+
+     color_line->runs = new_runs;
+     color_line->run_capacity = new_capacity;
+     return true;
+}
+
+// build the runs for a screen row into row_runs, returns how many there are
+static int32_t runs_from_cells(TerminalColorRun_t* runs, const TerminalCell_t* cells, int64_t width)
+{
+     int32_t run_count = 0;
+
+     TerminalColor_t current = cells[0].color;
+     for(int64_t c = 1; c < width; ++c){
+          if(color_equal(cells[c].color, current)) continue;
+          current = cells[c].color;
+          runs[run_count] = (TerminalColorRun_t){c, current};
+          run_count++;
+     }
+
+     return run_count;
+}
+
+static void free_color_line(TerminalColorLine_t* color_line)
+{
+     free(color_line->runs);
+     color_line->runs = NULL;
+     color_line->run_count = 0;
+     color_line->run_capacity = 0;
+}
+
+static void terminal_drop_lines(Terminal_t* term, int64_t count)
+{
+     if(!ce_drop_first_lines_readonly(term->buffer, count)) return;
+
+     for(int64_t i = 0; i < count; ++i){
+          free_color_line(term->color_lines + i);
+     }
+
+     term->color_lines += count;
+     term->color_line_offset += count;
+
+     // NOTE: same as the buffer, reclaim the dead space once it outgrows the lines in use
+     if(term->color_line_offset >= term->buffer->line_count){
+          TerminalColorLine_t* allocation = term->color_lines - term->color_line_offset;
+          memmove(allocation, term->color_lines, term->buffer->line_count * sizeof(*term->color_lines));
+          term->color_lines = allocation;
+          term->color_line_offset = 0;
+     }
+
+     term->lines_dropped += count;
+     term->first_changed_line = CE_MAX(term->first_changed_line - count, 0);
+}
+
+static bool terminal_append_line(Terminal_t* term)
+{
+     if(!ce_append_line_readonly(term->buffer, NULL)) return false;
+
+     TerminalColorLine_t* new_color_lines = realloc(term->color_lines - term->color_line_offset,
+                                                    (term->color_line_offset + term->buffer->line_count) *
+                                                    sizeof(*term->color_lines));
+     if(!new_color_lines) return false;
+
+     term->color_lines = new_color_lines + term->color_line_offset;
+     term->color_lines[term->buffer->line_count - 1] =
+          (TerminalColorLine_t){{COLOR_FOREGROUND, COLOR_BACKGROUND, 0}, 0, 0, NULL};
+     return true;
+}
+
+static void terminal_remove_lines_after(Terminal_t* term, int64_t line_count)
+{
+     Buffer_t* buffer = term->buffer;
+     if(buffer->line_count <= line_count) return;
+
+     for(int64_t i = line_count; i < buffer->line_count; ++i){
+          free_color_line(term->color_lines + i);
+     }
+
+     ce_remove_lines_readonly(buffer, line_count, buffer->line_count - line_count);
+}
+
+static int64_t delta_payload_length(const TerminalDelta_t* delta)
+{
+     if(delta->type != TDT_ROW) return 0;
+     return delta->row.text_length + delta->row.run_count * sizeof(TerminalColorRun_t);
+}
+
+static void pending_append(Terminal_t* term, const void* data, int64_t length)
+{
+     if(!length) return;
+
+     if(term->pending_length + length > term->pending_capacity){
+          int64_t new_capacity = term->pending_capacity ? term->pending_capacity : BUFSIZ;
+          while(new_capacity < term->pending_length + length) new_capacity *= 2;
+
+          char* new_pending = realloc(term->pending, new_capacity);
+          if(!new_pending){
+               ce_message("%s() failed to allocate %"PRId64" bytes, terminal output lost", __FUNCTION__, new_capacity);
+               return;
+          }
+
+          term->pending = new_pending;
+          term->pending_capacity = new_capacity;
+     }
+
+     memcpy(term->pending + term->pending_length, data, length);
+     term->pending_length += length;
+}
+
+// move as many whole pending deltas into the ring as fit
+static void flush_pending(Terminal_t* term)
+{
+     if(!term->pending_length) return;
+
+     // NOTE: set before we look at the ring, so if the ring drains right after we give up, we still get woken up
+     __atomic_store_n(&term->waiting_for_space, true, __ATOMIC_SEQ_CST);
+
+     int64_t offset = 0;
+     while(offset < term->pending_length){
+          TerminalDelta_t delta;
+          memcpy(&delta, term->pending + offset, sizeof(delta));
+
+          int64_t length = sizeof(delta) + delta_payload_length(&delta);
+          if(!ring_write(&term->deltas, term->pending + offset, length)) break;
+          offset += length;
+     }
+
+     if(!offset) return;
+
+     memmove(term->pending, term->pending + offset, term->pending_length - offset);
+     term->pending_length -= offset;
+}
+
+static void send_delta(Terminal_t* term, const TerminalDelta_t* delta, const char* text, const TerminalColorRun_t* runs)
+{
+     int64_t text_length = (delta->type == TDT_ROW) ? delta->row.text_length : 0;
+     int64_t runs_length = (delta->type == TDT_ROW) ? delta->row.run_count * sizeof(*runs) : 0;
+
+     if(!term->pending_length && ring_writable(&term->deltas) >= (int64_t)(sizeof(*delta)) + text_length + runs_length){
+          // NOTE: the consumer waits until the whole delta is readable, so writing it in pieces is fine
+          ring_write(&term->deltas, delta, sizeof(*delta));
+          if(text_length) ring_write(&term->deltas, text, text_length);
+          if(runs_length) ring_write(&term->deltas, runs, runs_length);
+          return;
+     }
+
+     // deltas have to be applied in order, so once one is pending, everything after it is too
+     pending_append(term, delta, sizeof(*delta));
+     pending_append(term, text, text_length);
+     pending_append(term, runs, runs_length);
+}
+
+static void send_line_count(Terminal_t* term, int64_t line_count)
+{
+     if(term->line_count == line_count) return;
+
+     term->line_count = line_count;
+
+     TerminalDelta_t delta = {.type = TDT_LINE_COUNT, .line_count = line_count};
+     send_delta(term, &delta, NULL, NULL);
+}
+
+static TerminalCell_t blank_cell(const Terminal_t* term)
+{
+     // NOTE: erased cells take the current background, like xterm
+     return (TerminalCell_t){' ', {COLOR_FOREGROUND, term->pen.bg, 0}};
+}
+
+static void mark_dirty(Terminal_t* term, int64_t row, int64_t first, int64_t last)
+{
+     TerminalDirtyRow_t* dirty = term->dirty_rows + row;
+     if(first < dirty->first) dirty->first = first;
+     if(last > dirty->last) dirty->last = last;
+}
+
+static void mark_clean(Terminal_t* term, int64_t row)
+{
+     term->dirty_rows[row] = (TerminalDirtyRow_t){term->width, -1};
+}
+
+static void clear_cells(Terminal_t* term, int64_t row, int64_t first, int64_t last)
+{
+     if(first < 0) first = 0;
+     if(last >= term->width) last = term->width - 1;
+     if(first > last) return;
+
+     TerminalCell_t blank = blank_cell(term);
+     TerminalCell_t* cells = term->screen->rows[row];
+     for(int64_t c = first; c <= last; ++c) cells[c] = blank;
+
+     mark_dirty(term, row, first, last);
+}
+
+static void clear_rows(Terminal_t* term, int64_t first, int64_t last)
+{
+     for(int64_t r = first; r <= last; ++r) clear_cells(term, r, 0, term->width - 1);
+}
+
+static void set_screen_cursor(Terminal_t* term, int64_t x, int64_t y)
+{
+     if(x < 0) x = 0;
+     if(x >= term->width) x = term->width - 1;
+     if(y < 0) y = 0;
+     if(y >= term->height) y = term->height - 1;
+
+     term->screen_cursor = (Point_t){x, y};
+     term->wrap_pending = false;
+
+     // the cursor has to be on a buffer line, so any row it visits is in use
+     if(term->screen->rows_used <= y) term->screen->rows_used = y + 1;
+}
+
+// send the changed part of a row to its buffer line
+static void send_row(Terminal_t* term, int64_t row)
+{
+     TerminalDirtyRow_t* dirty = term->dirty_rows + row;
+     if(dirty->first > dirty->last) return;
+
+     int64_t line = term->screen_top_line + row;
+     if(line >= term->line_count) send_line_count(term, line + 1);
+
+     const TerminalCell_t* cells = term->screen->rows[row];
+
+     // trailing blanks are left off of the buffer line
+     int64_t length = term->width;
+     while(length > 0 && cells[length - 1].ch == ' ') length--;
+
+     int64_t end = CE_MIN(dirty->last + 1, length);
+     int64_t text_length = CE_MAX(end - dirty->first, 0);
+
+     char text[term->width];
+     for(int64_t c = 0; c < text_length; ++c) text[c] = cells[dirty->first + c].ch;
+
+     TerminalDelta_t delta = {.type = TDT_ROW};
+     delta.row.line = line;
+     delta.row.start = dirty->first;
+     delta.row.text_length = text_length;
+     delta.row.line_length = length;
+     delta.row.first = cells[0].color;
+     delta.row.run_count = runs_from_cells(term->row_runs, cells, term->width);
+
+     send_delta(term, &delta, text, term->row_runs);
+     mark_clean(term, row);
+}
+
+static void send_screen(Terminal_t* term)
+{
+     send_line_count(term, term->screen_top_line + term->screen->rows_used);
+
+     for(int64_t r = 0; r < term->screen->rows_used; ++r) send_row(term, r);
+
+     if(term->scrollback_lines && term->line_count > term->scrollback_lines){
+          int64_t drop = CE_MIN(term->line_count - term->scrollback_lines, term->screen_top_line);
+          if(drop > 0){
+               TerminalDelta_t delta = {.type = TDT_DROP_LINES, .drop_count = drop};
+               send_delta(term, &delta, NULL, NULL);
+               term->screen_top_line -= drop;
+               term->line_count -= drop;
+          }
+     }
+
+     Point_t cursor = {term->screen_cursor.x, term->screen_top_line + term->screen_cursor.y};
+     if(cursor.x != term->sent_cursor.x || cursor.y != term->sent_cursor.y){
+          TerminalDelta_t delta = {.type = TDT_CURSOR, .cursor = cursor};
+          send_delta(term, &delta, NULL, NULL);
+          term->sent_cursor = cursor;
+     }
+
+     flush_pending(term);
+}
+
+static void rotate_rows_up(TerminalCell_t** rows, int64_t first, int64_t last, int64_t count)
+{
+     TerminalCell_t* saved[count];
+     memcpy(saved, rows + first, count * sizeof(*rows));
+     memmove(rows + first, rows + first + count, ((last - first + 1) - count) * sizeof(*rows));
+     memcpy(rows + last - count + 1, saved, count * sizeof(*rows));
+}
+
+static void rotate_rows_down(TerminalCell_t** rows, int64_t first, int64_t last, int64_t count)
+{
+     TerminalCell_t* saved[count];
+     memcpy(saved, rows + last - count + 1, count * sizeof(*rows));
+     memmove(rows + first + count, rows + first, ((last - first + 1) - count) * sizeof(*rows));
+     memcpy(rows + first, saved, count * sizeof(*rows));
+}
+
+static void scroll_up(Terminal_t* term, int64_t top, int64_t bottom, int64_t count, bool to_scrollback)
+{
+     if(count > bottom - top + 1) count = bottom - top + 1;
+     if(count <= 0) return;
+
+     TerminalGrid_t* grid = term->screen;
+
+     // when the whole primary screen scrolls, the top rows become scrollback. Their buffer lines stay where they are
+     // and the screen starts further down the buffer, so none of the rows need to be copied again
+     if(to_scrollback && grid == &term->primary && top == 0 && bottom == term->height - 1){
+          for(int64_t r = 0; r < count; ++r) send_row(term, r);
+
+          term->screen_top_line += count;
+          rotate_rows_up(grid->rows, top, bottom, count);
+          memmove(term->dirty_rows, term->dirty_rows + count, (term->height - count) * sizeof(*term->dirty_rows));
+          for(int64_t r = bottom - count + 1; r <= bottom; ++r) mark_clean(term, r);
+          clear_rows(term, bottom - count + 1, bottom);
+          return;
+     }
+
+     rotate_rows_up(grid->rows, top, bottom, count);
+     clear_rows(term, bottom - count + 1, bottom);
+     for(int64_t r = top; r <= bottom; ++r) mark_dirty(term, r, 0, term->width - 1);
+}
+
+static void scroll_down(Terminal_t* term, int64_t top, int64_t bottom, int64_t count)
+{
+     if(count > bottom - top + 1) count = bottom - top + 1;
+     if(count <= 0) return;
+
+     rotate_rows_down(term->screen->rows, top, bottom, count);
+     clear_rows(term, top, top + count - 1);
+     for(int64_t r = top; r <= bottom; ++r) mark_dirty(term, r, 0, term->width - 1);
+}
+
+static void linefeed(Terminal_t* term)
+{
+     if(term->screen_cursor.y == term->scroll_bottom){
+          scroll_up(term, term->scroll_top, term->scroll_bottom, 1, true);
+          term->wrap_pending = false;
+     }else{
+          set_screen_cursor(term, term->screen_cursor.x, term->screen_cursor.y + 1);
+     }
+}
+
+static void reverse_index(Terminal_t* term)
+{
+     if(term->screen_cursor.y == term->scroll_top){
+          scroll_down(term, term->scroll_top, term->scroll_bottom, 1);
+          term->wrap_pending = false;
+     }else{
+          set_screen_cursor(term, term->screen_cursor.x, term->screen_cursor.y - 1);
+     }
+}
+
+static void put_char(Terminal_t* term, char ch)
+{
+     if(term->wrap_pending){
+          set_screen_cursor(term, 0, term->screen_cursor.y);
+          linefeed(term);
+     }
+
+     Point_t* cursor = &term->screen_cursor;
+     term->screen->rows[cursor->y][cursor->x] = (TerminalCell_t){ch, term->pen};
+     mark_dirty(term, cursor->y, cursor->x, cursor->x);
+
+     if(cursor->x == term->width - 1){
+          term->wrap_pending = true;
+     }else{
+          cursor->x++;
+     }
+}
+
+// move the row's cells from the cursor over by count, positive is right, the cells left behind are cleared
+static void shift_cells(Terminal_t* term, int64_t count)
+{
+     Point_t* cursor = &term->screen_cursor;
+     TerminalCell_t* cells = term->screen->rows[cursor->y];
+     int64_t remaining = term->width - cursor->x;
+     int64_t distance = count < 0 ? -count : count;
+     if(distance > remaining) distance = remaining;
+
+     if(count > 0){
+          memmove(cells + cursor->x + distance, cells + cursor->x, (remaining - distance) * sizeof(*cells));
+          clear_cells(term, cursor->y, cursor->x, cursor->x + distance - 1);
+     }else{
+          memmove(cells + cursor->x, cells + cursor->x + distance, (remaining - distance) * sizeof(*cells));
+          clear_cells(term, cursor->y, term->width - distance, term->width - 1);
+     }
+
+     mark_dirty(term, cursor->y, cursor->x, term->width - 1);
+}
+
+static void erase_display(Terminal_t* term, int mode)
+{
+     Point_t* cursor = &term->screen_cursor;
+
+     switch(mode){
+     default:
+          break;
+     case 0:
+          clear_cells(term, cursor->y, cursor->x, term->width - 1);
+          clear_rows(term, cursor->y + 1, term->height - 1);
+          break;
+     case 1:
+          clear_rows(term, 0, cursor->y - 1);
+          clear_cells(term, cursor->y, 0, cursor->x);
+          break;
+     case 2:
+          if(term->screen == &term->primary){
+               // NOTE: rather than throwing away what was on the screen, it is pushed into scrollback
+               for(int64_t r = 0; r < term->screen->rows_used; ++r) send_row(term, r);
+               term->screen_top_line += term->screen->rows_used;
+               term->screen->rows_used = 0;
+               clear_rows(term, 0, term->height - 1);
+               for(int64_t r = 0; r < term->height; ++r) mark_clean(term, r);
+               set_screen_cursor(term, cursor->x, cursor->y);
+          }else{
+               clear_rows(term, 0, term->height - 1);
+          }
+          break;
+     }
+}
+
+static void erase_line(Terminal_t* term, int mode)
+{
+     Point_t* cursor = &term->screen_cursor;
+
+     switch(mode){
+     default:
+          break;
+     case 0:
+          clear_cells(term, cursor->y, cursor->x, term->width - 1);
+          break;
+     case 1:
+          clear_cells(term, cursor->y, 0, cursor->x);
+          break;
+     case 2:
+          clear_cells(term, cursor->y, 0, term->width - 1);
+          break;
+     }
+}
+
+static void switch_screen(Terminal_t* term, bool alternate)
+{
+     TerminalGrid_t* grid = alternate ? &term->alternate : &term->primary;
+     if(term->screen == grid) return;
+
+     if(alternate){
+          // make sure everything on the primary screen made it into the buffer before the rows are reused
+          for(int64_t r = 0; r < term->screen->rows_used; ++r) send_row(term, r);
+          term->screen = grid;
+          clear_rows(term, 0, term->height - 1);
+          grid->rows_used = term->height; // full screen programs own every row
+     }else{
+          term->screen = grid;
+     }
+
+     for(int64_t r = 0; r < term->height; ++r) mark_dirty(term, r, 0, term->width - 1);
+
+     term->scroll_top = 0;
+     term->scroll_bottom = term->height - 1;
+}
+
+static void save_cursor(Terminal_t* term)
+{
+     term->saved_cursor = term->screen_cursor;
+     term->saved_pen = term->pen;
+}
+
+static void restore_cursor(Terminal_t* term)
+{
+     term->pen = term->saved_pen;
+     set_screen_cursor(term, term->saved_cursor.x, term->saved_cursor.y);
+}
+
+static void set_private_mode(Terminal_t* term, int mode, bool on)
+{
+     switch(mode){
+     default:
+          break;
+     case 1049:
+          if(on){
+               save_cursor(term);
+               switch_screen(term, true);
+          }else{
+               switch_screen(term, false);
+               restore_cursor(term);
+          }
+          break;
+     case 47:
+     case 1047:
+          switch_screen(term, on);
+          break;
+     case 2004:
+          term->bracketed_paste = on;
+          break;
+     }
+}
+
+static void terminal_io_update_events(Terminal_t* term);
+
+// screen_lock must be held. Writes what the shell will take right now and queues the rest for the io thread
+static bool write_input(Terminal_t* term, const char* bytes, int64_t length)
+{
+     if(term->fd <= 0) return false;
+
+     // NOTE: anything already queued has to go first, or the input would arrive out of order
+     while(term->input_length == 0 && length > 0){
+          ssize_t rc = write(term->fd, bytes, length);
+          if(rc < 0){
+               if(errno == EINTR) continue;
+               if(errno == EAGAIN) break;
+               ce_message("%s() write() to shell failed: %s", __FUNCTION__, strerror(errno));
+               return false;
+          }
+
+          bytes += rc;
+          length -= rc;
+     }
+
+     if(length == 0) return true;
+
+     int64_t new_length = term->input_length + length;
+     if(new_length > term->input_capacity){
+          int64_t new_capacity = term->input_capacity ? term->input_capacity : BUFSIZ;
+          while(new_capacity < new_length) new_capacity *= 2;
+
+          char* new_input = realloc(term->input, new_capacity);
+          if(!new_input){
+               ce_message("%s() failed to queue %"PRId64" bytes of input", __FUNCTION__, length);
+               return false;
+          }
+
+          term->input = new_input;
+          term->input_capacity = new_capacity;
+     }
+
+     memcpy(term->input + term->input_length, bytes, length);
+     term->input_length = new_length;
+     terminal_io_update_events(term);
+     return true;
+}
+
+static void respond(Terminal_t* term, const char* response)
+{
+     write_input(term, response, strlen(response));
+}
+
+static int16_t rgb_to_palette(int r, int g, int b)
+{
+     // NOTE: true color is approximated with the 6x6x6 color cube in the 256 color palette
+     r = CE_MIN(CE_MAX(r, 0), 255);
+     g = CE_MIN(CE_MAX(g, 0), 255);
+     b = CE_MIN(CE_MAX(b, 0), 255);
+     return 16 + 36 * ((r * 5 + 127) / 255) + 6 * ((g * 5 + 127) / 255) + ((b * 5 + 127) / 255);
+}
+
+// handles 38 and 48, returns the index of the last argument used
+static int extended_color(const int* arguments, int argument_count, int index, int16_t* color)
+{
+     if(index + 1 >= argument_count) return index;
+
+     switch(arguments[index + 1]){
+     default:
+          return index + 1;
+     case 5:
+          if(index + 2 >= argument_count) return argument_count - 1;
+          if(arguments[index + 2] >= 0 && arguments[index + 2] < 256) *color = arguments[index + 2];
+          return index + 2;
+     case 2:
+          if(index + 4 >= argument_count) return argument_count - 1;
+          *color = rgb_to_palette(arguments[index + 2], arguments[index + 3], arguments[index + 4]);
+          return index + 4;
+     }
+}
+
+static void select_graphic_rendition(Terminal_t* term, const int* arguments, int argument_count)
+{
+     TerminalColor_t* pen = &term->pen;
+
+     for(int a = 0; a < argument_count; ++a){
+          int argument = arguments[a];
+
+          if(argument >= 30 && argument <= 37){
+               pen->fg = argument - 30;
+          }else if(argument >= 40 && argument <= 47){
+               pen->bg = argument - 40;
+          }else if(argument >= 90 && argument <= 97){
+               pen->fg = argument - 90 + 8;
+          }else if(argument >= 100 && argument <= 107){
+               pen->bg = argument - 100 + 8;
+          }else{
+               switch(argument){
+               default:
+                    break;
+               case 0:
+                    *pen = (TerminalColor_t){COLOR_FOREGROUND, COLOR_BACKGROUND, 0};
+                    break;
+               case 1:
+                    pen->attrs |= TERM_ATTR_BOLD;
+                    break;
+               case 4:
+                    pen->attrs |= TERM_ATTR_UNDERLINE;
+                    break;
+               case 7:
+                    pen->attrs |= TERM_ATTR_REVERSE;
+                    break;
+               case 22:
+                    pen->attrs &= ~TERM_ATTR_BOLD;
+                    break;
+               case 24:
+                    pen->attrs &= ~TERM_ATTR_UNDERLINE;
+                    break;
+               case 27:
+                    pen->attrs &= ~TERM_ATTR_REVERSE;
+                    break;
+               case 38:
+                    a = extended_color(arguments, argument_count, a, &pen->fg);
+                    break;
+               case 39:
+                    pen->fg = COLOR_FOREGROUND;
+                    break;
+               case 48:
+                    a = extended_color(arguments, argument_count, a, &pen->bg);
+                    break;
+               case 49:
+                    pen->bg = COLOR_BACKGROUND;
+                    break;
+               }
+          }
+     }
+}
+
+static void csi_dispatch(Terminal_t* term, char final)
+{
+     TerminalParser_t* parser = &term->parser;
+     const int* arguments = parser->arguments;
+     int argument_count = parser->argument_index + 1;
+     Point_t* cursor = &term->screen_cursor;
+
+     // most sequences treat a missing or 0 count as 1
+     int count = arguments[0] ? arguments[0] : 1;
+
+     if(parser->private_marker == '?'){
+          if(final == 'h' || final == 'l'){
+               for(int a = 0; a < argument_count; ++a) set_private_mode(term, arguments[a], final == 'h');
+          }
+          return;
+     }
+
+     if(parser->private_marker == '>'){
+          if(final == 'c') respond(term, "\033[>0;0;0c");
+          return;
+     }
+
+     if(parser->private_marker || parser->intermediate) return;
+
+     switch(final){
+     default:
+          break;
+     case '@':
+          shift_cells(term, count);
+          break;
+     case 'A':
+          set_screen_cursor(term, cursor->x, cursor->y - count);
+          break;
+     case 'B':
+     case 'e':
+          set_screen_cursor(term, cursor->x, cursor->y + count);
+          break;
+     case 'C':
+     case 'a':
+          set_screen_cursor(term, cursor->x + count, cursor->y);
+          break;
+     case 'D':
+          set_screen_cursor(term, cursor->x - count, cursor->y);
+          break;
+     case 'E':
+          set_screen_cursor(term, 0, cursor->y + count);
+          break;
+     case 'F':
+          set_screen_cursor(term, 0, cursor->y - count);
+          break;
+     case 'G':
+     case '`':
+          set_screen_cursor(term, count - 1, cursor->y);
+          break;
+     case 'H':
+     case 'f':
+     {
+          int column = (argument_count > 1 && arguments[1]) ? arguments[1] : 1;
+          set_screen_cursor(term, column - 1, count - 1);
+     } break;
+     case 'd':
+          set_screen_cursor(term, cursor->x, count - 1);
+          break;
+     case 'J':
+          erase_display(term, arguments[0]);
+          break;
+     case 'K':
+          erase_line(term, arguments[0]);
+          break;
+     case 'L':
+          if(cursor->y >= term->scroll_top && cursor->y <= term->scroll_bottom){
+               scroll_down(term, cursor->y, term->scroll_bottom, count);
+          }
+          break;
+     case 'M':
+          if(cursor->y >= term->scroll_top && cursor->y <= term->scroll_bottom){
+               scroll_up(term, cursor->y, term->scroll_bottom, count, false);
+          }
+          break;
+     case 'P':
+          shift_cells(term, -count);
+          break;
+     case 'X':
+          clear_cells(term, cursor->y, cursor->x, cursor->x + count - 1);
+          break;
+     case 'S':
+          scroll_up(term, term->scroll_top, term->scroll_bottom, count, false);
+          break;
+     case 'T':
+          scroll_down(term, term->scroll_top, term->scroll_bottom, count);
+          break;
+     case 'm':
+          select_graphic_rendition(term, arguments, argument_count);
+          break;
+     case 'r':
+     {
+          int64_t top = count - 1;
+          int64_t bottom = (argument_count > 1 && arguments[1]) ? arguments[1] - 1 : term->height - 1;
+          if(bottom >= term->height) bottom = term->height - 1;
+          if(top >= bottom) break;
+
+          term->scroll_top = top;
+          term->scroll_bottom = bottom;
+          set_screen_cursor(term, 0, 0);
+     } break;
+     case 's':
+          save_cursor(term);
+          break;
+     case 'u':
+          restore_cursor(term);
+          break;
+     case 'n':
+          if(arguments[0] == 5){
+               respond(term, "\033[0n");
+          }else if(arguments[0] == 6){
+               char report[64];
+               snprintf(report, 64, "\033[%"PRId64";%"PRId64"R", cursor->y + 1, cursor->x + 1);
+               respond(term, report);
+          }
+          break;
+     case 'c':
+          respond(term, "\033[?1;2c");
+          break;
+     }
+}
+
+static void terminal_reset(Terminal_t* term)
+{
+     term->pen = (TerminalColor_t){COLOR_FOREGROUND, COLOR_BACKGROUND, 0};
+     term->bracketed_paste = false;
+     switch_screen(term, false);
+     erase_display(term, 2);
+     set_screen_cursor(term, 0, 0);
+}
+
+static void escape_dispatch(Terminal_t* term, char byte)
+{
+     TerminalParser_t* parser = &term->parser;
+     parser->state = TPS_GROUND;
+
+     switch(byte){
+     default:
+          break;
+     case '[': // handle "Control Sequence Inducers"
+          memset(parser->arguments, 0, sizeof(parser->arguments));
+          parser->argument_index = 0;
+          parser->private_marker = 0;
+          parser->intermediate = 0;
+          parser->state = TPS_CSI;
+          break;
+     case ']':
+     case 'P':
+     case 'X':
+     case '^':
+     case '_':
+          parser->state = TPS_STRING;
+          break;
+     case '(':
+     case ')':
+     case '*':
+     case '+':
+     case '#':
+     case '%':
+          parser->state = TPS_ESCAPE_INTERMEDIATE;
+          break;
+     case '7':
+          save_cursor(term);
+          break;
+     case '8':
+          restore_cursor(term);
+          break;
+     case 'D':
+          linefeed(term);
+          break;
+     case 'E':
+          set_screen_cursor(term, 0, term->screen_cursor.y);
+          linefeed(term);
+          break;
+     case 'M':
+          reverse_index(term);
+          break;
+     case 'c':
+          terminal_reset(term);
+          break;
+     }
+}
+
+static void control_character(Terminal_t* term, char byte)
+{
+     Point_t* cursor = &term->screen_cursor;
+
+     switch(byte){
+     default:
+          break;
+     case 27:
+          term->parser.state = TPS_ESCAPE;
+          break;
+     case '\b':
+          set_screen_cursor(term, cursor->x - 1, cursor->y);
+          break;
+     case '\t':
+          set_screen_cursor(term, (cursor->x / 8 + 1) * 8, cursor->y);
+          break;
+     case NEWLINE:
+     case '\v':
+     case '\f':
+          linefeed(term);
+          break;
+     case '\r':
+          set_screen_cursor(term, 0, cursor->y);
+          break;
+     }
+}
+
+void terminal_process_output(Terminal_t* term, const char* bytes, int64_t length)
+{
+     TerminalParser_t* parser = &term->parser;
+
+     __atomic_add_fetch(&term->bytes_read, length, __ATOMIC_RELAXED);
+
+     for(int64_t i = 0; i < length; ++i){
+          char byte = bytes[i];
+          unsigned char ubyte = byte;
+
+          switch(parser->state){
+          case TPS_UTF8:
+               if((ubyte & 0xC0) == 0x80){
+                    parser->utf8_remaining--;
+                    if(parser->utf8_remaining == 0) parser->state = TPS_GROUND;
+                    break;
+               }
+
+               // not a continuation byte, so the sequence was cut short
+               parser->state = TPS_GROUND;
+               // fall through
+          case TPS_GROUND:
+               if(ubyte >= 0x80){
+                    // NOTE: we only draw ascii, so each utf8 character takes up one placeholder cell
+                    if((ubyte & 0xE0) == 0xC0){
+                         parser->utf8_remaining = 1;
+                    }else if((ubyte & 0xF0) == 0xE0){
+                         parser->utf8_remaining = 2;
+                    }else if((ubyte & 0xF8) == 0xF0){
+                         parser->utf8_remaining = 3;
+                    }else{
+                         break;
+                    }
+
+                    parser->state = TPS_UTF8;
+                    put_char(term, '?');
+               }else if(isprint(ubyte)){
+                    put_char(term, byte);
+               }else{
+                    control_character(term, byte);
+               }
+               break;
+          case TPS_ESCAPE:
+               escape_dispatch(term, byte);
+               break;
+          case TPS_ESCAPE_INTERMEDIATE:
+               parser->state = TPS_GROUND;
+               break;
+          case TPS_CSI:
+               if(isdigit(ubyte)){
+                    int* argument = parser->arguments + parser->argument_index;
+                    if(*argument < 100000) *argument = *argument * 10 + (byte - '0');
+               }else if(byte == ';' || byte == ':'){
+                    if(parser->argument_index < TERM_MAX_CSI_ARGUMENTS - 1) parser->argument_index++;
+               }else if(byte >= '<' && byte <= '?'){
+                    parser->private_marker = byte;
+               }else if(byte >= ' ' && byte <= '/'){
+                    parser->intermediate = byte;
+               }else if(byte >= '@' && byte <= '~'){
+                    parser->state = TPS_GROUND;
+                    csi_dispatch(term, byte);
+               }else if(byte == 27){
+                    parser->state = TPS_ESCAPE;
+               }else{
+                    control_character(term, byte);
+               }
+               break;
+          case TPS_STRING:
+               if(byte == '\a'){
+                    parser->state = TPS_GROUND;
+               }else if(byte == 27){
+                    parser->state = TPS_STRING_ESCAPE;
+               }
+               break;
+          case TPS_STRING_ESCAPE:
+               // ESC \ ends the string, anything else starts a new escape sequence
+               if(byte == '\\'){
+                    parser->state = TPS_GROUND;
+               }else{
+                    escape_dispatch(term, byte);
+               }
+               break;
+          }
+     }
+
+     send_screen(term);
+}
+
+static void grid_free(TerminalGrid_t* grid)
+{
+     free(grid->cells);
+     free(grid->rows);
+     grid->cells = NULL;
+     grid->rows = NULL;
+     grid->rows_used = 0;
+}
+
+// copies what fits from the old grid, the old grid is freed
+static bool grid_resize(TerminalGrid_t* grid, int64_t width, int64_t height, int64_t old_width, int64_t first_row)
 {
-     assert(terminal_color_pairs_head);
+     TerminalCell_t* cells = malloc(width * height * sizeof(*cells));
+     TerminalCell_t** rows = malloc(height * sizeof(*rows));
+     if(!cells || !rows){
+          free(cells);
+          free(rows);
+          return false;
+     }
 
-     TerminalColorPairNode_t* pair_itr = terminal_color_pairs_head;
-     TerminalColorPairNode_t* prev = NULL;
+     TerminalCell_t blank = {' ', {COLOR_FOREGROUND, COLOR_BACKGROUND, 0}};
+     for(int64_t r = 0; r < height; ++r){
+          rows[r] = cells + r * width;
+          for(int64_t c = 0; c < width; ++c) rows[r][c] = blank;
 
-     int color_id = TERM_START_COLOR;
-     while(pair_itr){
-          if(pair_itr->fg == fg && pair_itr->bg == bg) break;
-          prev = pair_itr;
-          pair_itr = pair_itr->next;
-          color_id++;
+          int64_t old_row = first_row + r;
+          if(grid->rows && old_row < grid->rows_used){
+               memcpy(rows[r], grid->rows[old_row], CE_MIN(width, old_width) * sizeof(*cells));
+          }
      }
 
-     if(!pair_itr){
-          TerminalColorPairNode_t* node = calloc(1, sizeof(*node));
-          if(!node) return;
+     int64_t rows_used = grid->rows_used - first_row;
+     grid_free(grid);
+
+     grid->cells = cells;
+     grid->rows = rows;
+     grid->rows_used = CE_MIN(CE_MAX(rows_used, 0), height);
+     return true;
+}
+
+static bool terminal_screen_resize(Terminal_t* term, int64_t width, int64_t height)
+{
+     if(width <= 0 || height <= 0) return false;
+
+     // rows that no longer fit on the primary screen become scrollback
+     int64_t scrolled = 0;
+     if(term->primary.rows_used > height) scrolled = term->primary.rows_used - height;
+     for(int64_t r = 0; r < scrolled && term->screen == &term->primary; ++r) send_row(term, r);
+
+     TerminalDirtyRow_t* dirty_rows = realloc(term->dirty_rows, height * sizeof(*dirty_rows));
+     if(!dirty_rows) return false;
+     term->dirty_rows = dirty_rows;
+
+     TerminalColorRun_t* row_runs = realloc(term->row_runs, width * sizeof(*row_runs));
+     if(!row_runs) return false;
+     term->row_runs = row_runs;
 
-          node->fg = fg;
-          node->bg = bg;
-          node->next = NULL;
+     if(!grid_resize(&term->primary, width, height, term->width, scrolled)) return false;
+     if(!grid_resize(&term->alternate, width, height, term->width, 0)) return false;
 
-          init_pair(color_id, node->fg, node->bg);
+     term->screen_top_line += scrolled;
+     if(term->screen == &term->alternate) term->alternate.rows_used = height;
 
-          prev->next = node;
+     term->width = width;
+     term->height = height;
+     term->scroll_top = 0;
+     term->scroll_bottom = height - 1;
+
+     for(int64_t r = 0; r < height; ++r) term->dirty_rows[r] = (TerminalDirtyRow_t){0, width - 1};
+
+     set_screen_cursor(term, term->screen_cursor.x, term->screen_cursor.y - scrolled);
+     send_screen(term);
+     return true;
+}
+
+bool terminal_screen_init(Terminal_t* term, int64_t width, int64_t height, Buffer_t* buffer)
+{
+     terminal_screen_free(term);
+
+     term->buffer = buffer;
+
+     if(buffer->line_count == 0){
+          if(!ce_alloc_lines(buffer, 1)) return false;
      }
 
-     attron(COLOR_PAIR(color_id));
+     buffer->status = BS_READONLY;
+
+     term->color_lines = calloc(buffer->line_count, sizeof(*term->color_lines));
+     if(!term->color_lines) return false;
+
+     term->pen = (TerminalColor_t){COLOR_FOREGROUND, COLOR_BACKGROUND, 0};
+     for(int64_t i = 0; i < buffer->line_count; ++i) term->color_lines[i].first = term->pen;
+
+     if(!ring_init(&term->deltas, TERM_DELTA_RING_SIZE)) return false;
+     pthread_mutex_init(&term->screen_lock, NULL);
+
+     term->parser = (TerminalParser_t){};
+     term->screen = &term->primary;
+     term->wrap_pending = false;
+     term->width = 0;
+     term->height = 0;
+
+     // the screen starts on the last line of the buffer, anything before it is scrollback
+     term->line_count = buffer->line_count;
+     term->sent_cursor = (Point_t){-1, -1};
+     term->first_changed_line = 0;
+     term->bytes_read = 0;
+     term->flood = (TerminalFlood_t){};
+     term->bracketed_paste = false;
+     term->screen_top_line = buffer->line_count - 1;
+     term->primary.rows_used = 1;
+
+     if(!terminal_screen_resize(term, width, height)) return false;
+
+     const char* last_line = buffer->lines[term->screen_top_line];
+     int64_t last_line_length = CE_MIN((int64_t)(strlen(last_line)), width);
+     for(int64_t c = 0; c < last_line_length; ++c) term->primary.rows[0][c].ch = last_line[c];
+
+     set_screen_cursor(term, last_line_length, 0);
+     send_screen(term);
+     terminal_apply_updates(term);
+     return true;
 }
 
-void handle_sigchld(int signal, siginfo_t* info, void *ptr)
+void terminal_screen_free(Terminal_t* term)
 {
-     (void)(ptr);
+     if(!term->screen) return;
 
-     int stat;
-     pid_t p;
+     for(int64_t i = 0; i < term->buffer->line_count; ++i){
+          free_color_line(term->color_lines + i);
+     }
 
-     ce_message("terminal shell saw signal: %d", signal);
+     free(term->color_lines - term->color_line_offset);
+     term->color_lines = NULL;
+     term->color_line_offset = 0;
+
+     grid_free(&term->primary);
+     grid_free(&term->alternate);
+     free(term->dirty_rows);
+     free(term->row_runs);
+     term->dirty_rows = NULL;
+     term->row_runs = NULL;
+
+     ring_free(&term->deltas);
+     free(term->pending);
+     term->pending = NULL;
+     term->pending_length = 0;
+     term->pending_capacity = 0;
+
+     free(term->input);
+     term->input = NULL;
+     term->input_length = 0;
+     term->input_capacity = 0;
+
+     pthread_mutex_destroy(&term->screen_lock);
+     term->screen = NULL;
+}
 
-     if(signal != SIGINT){
-          if((p = waitpid(info->si_pid, &stat, WNOHANG)) < 0){
-               ce_message("terminal waiting for shell pid %d failed: %s\n", info->si_pid, strerror(errno));
-          }
+TerminalIO_t terminal_io = {.lock = PTHREAD_MUTEX_INITIALIZER};
 
-          if(info->si_pid != p) return;
+// read while we aren't throttled, wait to write while input is queued
+// screen_lock must be held
+static void terminal_io_update_events(Terminal_t* term)
+{
+     if(!terminal_io.running) return;
 
-          if(!WIFEXITED(stat) || WEXITSTATUS(stat)){
-               ce_message("terminal shell child exitted with code %d\n", stat);
+     struct epoll_event event = {};
+     if(!term->throttled) event.events |= EPOLLIN;
+     if(term->input_length) event.events |= EPOLLOUT;
+     event.data.ptr = term;
+     epoll_ctl(terminal_io.epoll_fd, EPOLL_CTL_MOD, term->fd, &event);
+}
+
+// screen_lock must be held
+static void terminal_io_write_input(Terminal_t* term)
+{
+     int64_t written = 0;
+     while(written < term->input_length){
+          ssize_t rc = write(term->fd, term->input + written, term->input_length - written);
+          if(rc < 0){
+               if(errno == EINTR) continue;
+               if(errno != EAGAIN){
+                    // NOTE: the shell is likely gone, the read side will find out and report it
+                    ce_message("%s() write() to shell failed: %s", __FUNCTION__, strerror(errno));
+                    written = term->input_length;
+               }
+               break;
           }
+
+          written += rc;
+     }
+
+     term->input_length -= written;
+     memmove(term->input, term->input + written, term->input_length);
+     if(term->input_length == 0) terminal_io_update_events(term);
+}
+
+// returns true if any pending deltas were moved into the ring
+static bool terminal_io_flush(Terminal_t* term)
+{
+     pthread_mutex_lock(&term->screen_lock);
+
+     int64_t pending_length = term->pending_length;
+     flush_pending(term);
+
+     if(term->throttled && term->pending_length <= TERM_MAX_PENDING_BYTES){
+          term->throttled = false;
+          terminal_io_update_events(term);
      }
+
+     bool flushed = term->pending_length != pending_length;
+     pthread_mutex_unlock(&term->screen_lock);
+     return flushed;
 }
 
-void* terminal_reader(void* data)
+static void* terminal_io_thread(void* data)
 {
-     Terminal_t* term = data;
+     (void)(data);
+
+     struct epoll_event events[TERM_IO_MAX_EVENTS];
      char bytes[BUFSIZ];
 
-     memset(bytes, 0, BUFSIZ);
+     while(true){
+          pthread_mutex_lock(&terminal_io.lock);
+          bool running = terminal_io.running;
+          uint64_t generation = terminal_io.generation;
+          pthread_mutex_unlock(&terminal_io.lock);
 
-     while(term->is_alive){
-          int rc = read(term->fd, bytes, BUFSIZ);
-          if(rc < 0){
-               ce_message("%s() read() from shell failed: %s\n", __FUNCTION__, strerror(errno));
-               term->is_alive = false;
-               sem_post(term->updated);
-               pthread_exit(NULL);
+          if(!running) break;
+
+          int event_count = epoll_wait(terminal_io.epoll_fd, events, TERM_IO_MAX_EVENTS, -1);
+          if(event_count < 0){
+               if(errno == EINTR) continue;
+               ce_message("%s() epoll_wait() failed: %s", __FUNCTION__, strerror(errno));
+               break;
           }
 
-          bytes[rc] = 0;
+          pthread_mutex_lock(&terminal_io.lock);
 
-          int csi_arguments[16]; // NPAR, does it exist?
-          int csi_argument_index = 0;
+          // NOTE: a terminal removed while we were waiting may have been free'd. The fds are level triggered, so
+          //       throwing the whole batch away is fine, whatever is still readable is reported on the next wait
+          if(generation != terminal_io.generation){
+               pthread_mutex_unlock(&terminal_io.lock);
+               continue;
+          }
 
-          for(int c = 0; c < 16; ++c) csi_arguments[c] = 0;
+          bool updated = false;
 
-          bool escape = false;
-          bool csi = false;
-          char* byte = bytes;
-          while(*byte){
-               if(csi){
-                    if(isdigit(*byte)){
-                         csi_arguments[csi_argument_index] *= 10;
-                         csi_arguments[csi_argument_index] += (*byte - '0');
-                    }else{
-                         if(*byte == ';'){
-                              csi_argument_index++;
-                         }else{
-                              switch(*byte){
-                              default:
-                                   break;
-                              case 'K':
-                                   switch(csi_arguments[0]){
-                                   default:
-                                   {
-                                        int64_t len = (strlen(term->buffer->lines[term->cursor.y]) - term->cursor.x);
-                                        for(int64_t r = 0; r < len; ++r){
-                                             Point_t loc = {term->cursor.x + r, term->cursor.y};
-                                             ce_remove_char_readonly(term->buffer, loc);
-                                        }
-                                   } break;
-                                   case 1:
-                                        break;
-                                   case 2:
-                                        break;
-                                   }
-                                   break;
-                              case 'm':
-                              {
-                                   // get last node in row
-                                   TerminalColorNode_t* last_node = term->color_lines + (term->buffer->line_count - 1);
-                                   while(last_node->next) last_node = last_node->next;
-
-                                   TerminalColorNode_t* new_last_node = calloc(1, sizeof(*new_last_node));
-                                   if(!new_last_node) break;
-
-                                   new_last_node->fg = last_node->fg;
-                                   new_last_node->bg = last_node->bg;
-                                   new_last_node->index = strlen(term->buffer->lines[term->buffer->line_count - 1]);
-                                   new_last_node->next = NULL;
-                                   last_node->next = new_last_node;
-
-                                   for(int a = 0; a <= csi_argument_index; ++a){
-                                        switch(csi_arguments[a]){
-                                        default:
-                                             break;
-                                        case 1: // bold
-                                             break;
-                                        case 0:
-                                             new_last_node->fg = COLOR_FOREGROUND;
-                                             new_last_node->bg = COLOR_BACKGROUND;
-                                             break;
-                                        case 30:
-                                             new_last_node->fg = COLOR_BLACK;
-                                             break;
-                                        case 31:
-                                             new_last_node->fg = COLOR_RED;
-                                             break;
-                                        case 32:
-                                             new_last_node->fg = COLOR_GREEN;
-                                             break;
-                                        case 33:
-                                             new_last_node->fg = COLOR_YELLOW;
-                                             break;
-                                        case 34:
-                                             new_last_node->fg = COLOR_BLUE;
-                                             break;
-                                        case 35:
-                                             new_last_node->fg = COLOR_MAGENTA;
-                                             break;
-                                        case 36:
-                                             new_last_node->fg = COLOR_CYAN;
-                                             break;
-                                        case 37:
-                                             new_last_node->fg = COLOR_WHITE;
-                                             break;
-                                        case 38: // underscore on
-                                             new_last_node->fg = COLOR_FOREGROUND;
-                                             break;
-                                        case 39: // underscore off
-                                             new_last_node->fg = COLOR_FOREGROUND;
-                                             break;
-                                        case 40:
-                                             new_last_node->bg = COLOR_BLACK;
-                                             break;
-                                        case 41:
-                                             new_last_node->bg = COLOR_RED;
-                                             break;
-                                        case 42:
-                                             new_last_node->bg = COLOR_GREEN;
-                                             break;
-                                        case 43:
-                                             new_last_node->bg = COLOR_YELLOW;
-                                             break;
-                                        case 44:
-                                             new_last_node->bg = COLOR_BLUE;
-                                             break;
-                                        case 45:
-                                             new_last_node->bg = COLOR_MAGENTA;
-                                             break;
-                                        case 46:
-                                             new_last_node->bg = COLOR_CYAN;
-                                             break;
-                                        case 47:
-                                             new_last_node->bg = COLOR_WHITE;
-                                             break;
-                                        case 48:
-                                             break;
-                                        case 49:
-                                             new_last_node->bg = COLOR_BACKGROUND;
-                                             break;
-                                        }
-                                   }
-
-                              } break;
-                              }
-
-                              csi_argument_index = 0;
-
-                              // clear arguments
-                              for(int c = 0; c < 16; ++c) csi_arguments[c] = 0;
-
-                              csi = false;
-                         }
-                    }
-               }else if(escape){
-                    switch(*byte){
-                    default:
-                         break;
-                    case '[': // handle "Control Sequence Inducers"
-                         csi = true;
-                         break;
-                    }
+          for(int i = 0; i < event_count; ++i){
+               Terminal_t* term = events[i].data.ptr;
 
-                    escape = false;
-               }else if(isprint(*byte)){
-                    if(ce_point_on_buffer(term->buffer, term->cursor)){
-                         int line_last_index = ce_last_index(term->buffer->lines[term->cursor.y]);
+               if(!term){
+                    uint64_t count;
+                    if(read(terminal_io.wake_fd, &count, sizeof(count)) < 0 && errno != EAGAIN){
+                         ce_message("%s() read() from wake eventfd failed: %s", __FUNCTION__, strerror(errno));
+                    }
 
-                         if(line_last_index && term->cursor.x <= line_last_index){
-                              ce_set_char_readonly(term->buffer, term->cursor, *byte);
-                         }else{
-                              ce_insert_char_readonly(term->buffer, term->cursor, *byte);
-                         }
-                    }else{
-                         ce_insert_char_readonly(term->buffer, term->cursor, *byte);
+                    // some terminal's ring has room again, move over the deltas that were waiting on it
+                    for(int64_t t = 0; t < terminal_io.terminal_count; ++t){
+                         if(terminal_io_flush(terminal_io.terminals[t])) updated = true;
                     }
+                    continue;
+               }
+
+               if(events[i].events & EPOLLOUT){
+                    pthread_mutex_lock(&term->screen_lock);
+                    terminal_io_write_input(term);
+                    pthread_mutex_unlock(&term->screen_lock);
+               }
 
-                    term->cursor.x++;
+               if(!(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) continue;
 
-                    if(term->cursor.x >= term->width){
-                         ce_append_char_readonly(term->buffer, NEWLINE); // ignore where the cursor is
-                         term->cursor.x = 0;
-                         term->cursor.y++;
+               // one read per terminal per wait, so a terminal flooding output can't starve the others
+               int rc = read(term->fd, bytes, BUFSIZ);
+               if(rc < 0 && (errno == EINTR || errno == EAGAIN)) continue;
 
-                         // TODO: consolidate with code below
-                         term->color_lines = realloc(term->color_lines, term->buffer->line_count * sizeof(*term->color_lines));
+               pthread_mutex_lock(&term->screen_lock);
 
-                         TerminalColorNode_t* itr = term->color_lines + (term->buffer->line_count - 2);
-                         while(itr->next) itr = itr->next;
+               if(rc > 0){
+                    terminal_process_output(term, bytes, rc);
 
-                         // NOTE: copy the color profile from the end of the previous line
-                         term->color_lines[term->buffer->line_count - 1] = *itr;
+                    // stop reading until whoever applies the deltas catches up, the shell blocks on a full pty
+                    if(term->pending_length > TERM_MAX_PENDING_BYTES){
+                         term->throttled = true;
+                         terminal_io_update_events(term);
                     }
                }else{
-                    switch(*byte){
-                    case 27: // escape
-                         escape = true;
-                         break;
-                    case '\b': // backspace
-                         term->cursor.x--;
-                         if(term->cursor.x < 0) term->cursor.x = 0;
-                         //ce_remove_char_readonly(&term->buffer, term->cursor);
-                         break;
-                    case NEWLINE:
-                    {
-                         ce_append_char_readonly(term->buffer, NEWLINE); // ignore where the cursor is
-                         term->cursor.x = 0;
-                         term->cursor.y++;
-
-                         term->color_lines = realloc(term->color_lines, term->buffer->line_count * sizeof(*term->color_lines));
-
-                         TerminalColorNode_t* itr = term->color_lines + (term->buffer->line_count - 2);
-                         while(itr->next) itr = itr->next;
-
-                         // NOTE: copy the color profile from the end of the previous line
-                         term->color_lines[term->buffer->line_count - 1] = *itr;
-                    } break;
-                    case '\r': // Carriage return
-                         term->cursor.x = 0;
-                         break;
-                    }
+                    // NOTE: the pty reports EIO once the shell exits
+                    TerminalDelta_t delta = {.type = TDT_EXITED};
+                    send_delta(term, &delta, NULL, NULL);
+                    flush_pending(term);
+                    epoll_ctl(terminal_io.epoll_fd, EPOLL_CTL_DEL, term->fd, NULL);
                }
 
-               byte++;
+               pthread_mutex_unlock(&term->screen_lock);
+               updated = true;
           }
 
-          // if we've read anything, say that we've updated!
-          if(rc) sem_post(term->updated);
+          pthread_mutex_unlock(&terminal_io.lock);
+
+          if(updated){
+               uint64_t count = 1;
+               if(write(terminal_io.updated_fd, &count, sizeof(count)) < 0){
+                    ce_message("%s() write() to updated eventfd failed: %s", __FUNCTION__, strerror(errno));
+               }
+          }
      }
 
-     pthread_exit(NULL);
      return NULL;
 }
 
+static bool terminal_io_start()
+{
+     if(terminal_io.running) return true;
+
+     terminal_io.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+     if(terminal_io.epoll_fd < 0){
+          ce_message("%s() epoll_create1() failed: %s", __FUNCTION__, strerror(errno));
+          return false;
+     }
+
+     terminal_io.wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+     terminal_io.updated_fd = eventfd(0, EFD_CLOEXEC);
+     if(terminal_io.wake_fd < 0 || terminal_io.updated_fd < 0){
+          ce_message("%s() eventfd() failed: %s", __FUNCTION__, strerror(errno));
+          return false;
+     }
+
+     struct epoll_event event = {};
+     event.events = EPOLLIN;
+     event.data.ptr = NULL; // NULL marks the wake fd
+     if(epoll_ctl(terminal_io.epoll_fd, EPOLL_CTL_ADD, terminal_io.wake_fd, &event) < 0){
+          ce_message("%s() epoll_ctl() failed: %s", __FUNCTION__, strerror(errno));
+          return false;
+     }
+
+     terminal_io.running = true;
+
+     int rc = pthread_create(&terminal_io.thread, NULL, terminal_io_thread, NULL);
+     if(rc != 0){
+          terminal_io.running = false;
+          ce_message("%s() pthread_create() failed", __FUNCTION__);
+          return false;
+     }
+
+     return true;
+}
+
+void terminal_io_stop()
+{
+     if(!terminal_io.running) return;
+
+     pthread_mutex_lock(&terminal_io.lock);
+     terminal_io.running = false;
+     pthread_mutex_unlock(&terminal_io.lock);
+
+     uint64_t count = 1;
+     if(write(terminal_io.wake_fd, &count, sizeof(count)) < 0){
+          ce_message("%s() write() to wake eventfd failed: %s", __FUNCTION__, strerror(errno));
+     }
+
+     pthread_join(terminal_io.thread, NULL);
+
+     close(terminal_io.epoll_fd);
+     close(terminal_io.wake_fd);
+     close(terminal_io.updated_fd);
+
+     free(terminal_io.terminals);
+     terminal_io.terminals = NULL;
+     terminal_io.terminal_count = 0;
+     terminal_io.terminal_capacity = 0;
+}
+
+static void terminal_io_wake()
+{
+     if(!terminal_io.running) return;
+
+     uint64_t count = 1;
+     if(write(terminal_io.wake_fd, &count, sizeof(count)) < 0){
+          ce_message("%s() write() to wake eventfd failed: %s", __FUNCTION__, strerror(errno));
+     }
+}
+
+static bool terminal_io_add(Terminal_t* term)
+{
+     if(!terminal_io_start()) return false;
+
+     pthread_mutex_lock(&terminal_io.lock);
+
+     if(terminal_io.terminal_count == terminal_io.terminal_capacity){
+          int64_t new_capacity = terminal_io.terminal_capacity ? terminal_io.terminal_capacity * 2 : 4;
+          Terminal_t** new_terminals = realloc(terminal_io.terminals, new_capacity * sizeof(*new_terminals));
+          if(!new_terminals){
+               pthread_mutex_unlock(&terminal_io.lock);
+               ce_message("%s() failed to grow the terminal list", __FUNCTION__);
+               return false;
+          }
+
+          terminal_io.terminals = new_terminals;
+          terminal_io.terminal_capacity = new_capacity;
+     }
+
+     terminal_io.terminals[terminal_io.terminal_count] = term;
+     terminal_io.terminal_count++;
+
+     pthread_mutex_unlock(&terminal_io.lock);
+
+     struct epoll_event event = {};
+     event.events = EPOLLIN;
+     event.data.ptr = term;
+     if(epoll_ctl(terminal_io.epoll_fd, EPOLL_CTL_ADD, term->fd, &event) < 0){
+          ce_message("%s() epoll_ctl() failed: %s", __FUNCTION__, strerror(errno));
+          return false;
+     }
+
+     return true;
+}
+
+// once this returns, the io thread will not touch the terminal again
+static void terminal_io_remove(Terminal_t* term)
+{
+     if(!terminal_io.running) return;
+
+     pthread_mutex_lock(&terminal_io.lock);
+     // NOTE: it is already gone if the shell exitted
+     epoll_ctl(terminal_io.epoll_fd, EPOLL_CTL_DEL, term->fd, NULL);
+     terminal_io.generation++;
+
+     for(int64_t i = 0; i < terminal_io.terminal_count; ++i){
+          if(terminal_io.terminals[i] != term) continue;
+
+          terminal_io.terminal_count--;
+          terminal_io.terminals[i] = terminal_io.terminals[terminal_io.terminal_count];
+          break;
+     }
+
+     pthread_mutex_unlock(&terminal_io.lock);
+}
+
+static void apply_row(Terminal_t* term, const TerminalDelta_t* delta)
+{
+     Buffer_t* buffer = term->buffer;
+     int64_t line = delta->row.line;
+
+     char text[delta->row.text_length + 1];
+     ring_read(&term->deltas, text, delta->row.text_length);
+
+     TerminalColorLine_t* color_line = term->color_lines + line;
+     if(color_line_reserve(color_line, delta->row.run_count)){
+          ring_read(&term->deltas, color_line->runs, delta->row.run_count * sizeof(*color_line->runs));
+          color_line->first = delta->row.first;
+          color_line->run_count = delta->row.run_count;
+     }else{
+          // drop the colors, but keep the rest of the ring in step
+          TerminalColorRun_t run;
+          for(int32_t r = 0; r < delta->row.run_count; ++r) ring_read(&term->deltas, &run, sizeof(run));
+     }
+
+     int64_t line_length = strlen(buffer->lines[line]);
+
+     if(delta->row.text_length){
+          // NOTE: columns between the end of the line and the text were trailing blanks that haven't changed
+          if(delta->row.start > line_length){
+               int64_t gap = delta->row.start - line_length;
+               char spaces[gap];
+               memset(spaces, ' ', gap);
+               ce_set_string_readonly(buffer, (Point_t){line_length, line}, spaces, gap);
+          }
+
+          ce_set_string_readonly(buffer, (Point_t){delta->row.start, line}, text, delta->row.text_length);
+          line_length = CE_MAX(line_length, delta->row.start + delta->row.text_length);
+     }
+
+     if(delta->row.line_length < line_length){
+          ce_remove_string_readonly(buffer, (Point_t){delta->row.line_length, line},
+                                    line_length - delta->row.line_length);
+     }
+}
+
+bool terminal_apply_updates(Terminal_t* term)
+{
+     bool applied = false;
+     TerminalDelta_t delta;
+
+     while(ring_peek(&term->deltas, &delta, sizeof(delta))){
+          // the producer may have only written part of the delta so far
+          if(ring_readable(&term->deltas) < (int64_t)(sizeof(delta)) + delta_payload_length(&delta)) break;
+
+          ring_read(&term->deltas, &delta, sizeof(delta));
+          applied = true;
+
+          switch(delta.type){
+          case TDT_LINE_COUNT:
+               term->first_changed_line = CE_MIN(term->first_changed_line, delta.line_count);
+               terminal_remove_lines_after(term, delta.line_count);
+               while(term->buffer->line_count < delta.line_count){
+                    if(!terminal_append_line(term)) break;
+               }
+               break;
+          case TDT_ROW:
+               term->first_changed_line = CE_MIN(term->first_changed_line, delta.row.line);
+               apply_row(term, &delta);
+               break;
+          case TDT_DROP_LINES:
+               terminal_drop_lines(term, delta.drop_count);
+               break;
+          case TDT_CURSOR:
+               term->cursor = delta.cursor;
+               break;
+          case TDT_EXITED:
+               term->is_alive = false;
+               break;
+          }
+     }
+
+     if(applied && __atomic_exchange_n(&term->waiting_for_space, false, __ATOMIC_SEQ_CST)) terminal_io_wake();
+
+     return applied;
+}
+
+bool terminal_measure_flood(Terminal_t* term, int64_t now)
+{
+     TerminalFlood_t* flood = &term->flood;
+     int64_t elapsed = now - flood->window_start;
+     if(elapsed < TERM_FLOOD_WINDOW_MS) return false;
+
+     uint64_t bytes_read = __atomic_load_n(&term->bytes_read, __ATOMIC_RELAXED);
+     flood->bytes_per_second = (bytes_read - flood->window_bytes) * 1000 / elapsed;
+     flood->window_bytes = bytes_read;
+     flood->window_start = now;
+
+     if(flood->bytes_per_second >= TERM_FLOOD_BYTES_PER_SECOND){
+          flood->flooded_windows++;
+     }else{
+          flood->flooded_windows = 0;
+     }
+
+     // NOTE: it takes a sustained rate to start fast forwarding, but a single slow window ends it
+     bool fast_forward = flood->flooded_windows >= TERM_FLOOD_WINDOWS;
+     if(fast_forward == flood->fast_forward) return false;
+
+     flood->fast_forward = fast_forward;
+     return true;
+}
+
 bool terminal_init(Terminal_t* term, int64_t width, int64_t height, Buffer_t* buffer)
 {
      if(term->is_alive) return false;
 
+     if(!terminal_screen_init(term, width, height, buffer)) return false;
+
      int master_fd;
      int slave_fd;
 
@@ -360,7 +1686,7 @@ bool terminal_init(Terminal_t* term, int64_t width, int64_t height, Buffer_t* bu
           setenv("USER", pw->pw_name, 1);
           setenv("SHELL", sh, 1);
           setenv("HOME", pw->pw_dir, 1);
-          setenv("TERM", "dumb", 1); // we can change this to "urxvt" when we implement all VT102 commands
+          setenv("TERM", "xterm-256color", 1);
 
           // reset signal handlers
           signal(SIGCHLD, SIG_DFL);
@@ -381,6 +1707,12 @@ bool terminal_init(Terminal_t* term, int64_t width, int64_t height, Buffer_t* bu
           close(slave_fd);
           term->fd = master_fd;
 
+          // NOTE: writes to a shell that isn't reading its input are queued instead of blocking the ui
+          int flags = fcntl(master_fd, F_GETFL);
+          if(flags < 0 || fcntl(master_fd, F_SETFL, flags | O_NONBLOCK) < 0){
+               ce_message("%s() fcntl() failed to make the terminal non-blocking: %s", __FUNCTION__, strerror(errno));
+          }
+
           struct sigaction sa;
           memset(&sa, 0, sizeof(sa));
           sa.sa_sigaction = handle_sigchld;
@@ -393,57 +1725,12 @@ bool terminal_init(Terminal_t* term, int64_t width, int64_t height, Buffer_t* bu
 
      term->is_alive = true;
 
-     term->width = width;
-     term->height = height;
-
-     term->buffer = buffer;
-
-     if(term->buffer->line_count == 0){
-          if(!ce_alloc_lines(term->buffer, 1)){
-               term->is_alive = false;
-               return false;
-          }
-     }
-
-     term->buffer->status = BS_READONLY;
-
-     sem_unlink("terminal_updated");
-     term->updated = sem_open("terminal_updated", O_CREAT | O_EXCL, S_IRUSR | S_IWUSR, 0);
-     if(term->updated == SEM_FAILED){
-          ce_message("%s() sem_open() failed %s", __FUNCTION__, strerror(errno));
-          return false;
-     }
-
-     int rc = pthread_create(&term->reader_thread, NULL, terminal_reader, term);
-     if(rc != 0){
+     if(!terminal_io_add(term)){
           term->is_alive = false;
-          ce_message("pthread_create() failed");
           return false;
      }
 
-     int64_t last_line = term->buffer->line_count - 1;
-
-     term->cursor = (Point_t){0, last_line};
-
-     if(term->buffer->lines[last_line][0]){
-          term->cursor.x = strlen(term->buffer->lines[last_line]);
-     }
-
-     if(!term->color_lines){
-          term->color_lines = calloc(1, sizeof(*term->color_lines));
-          term->color_lines->fg = COLOR_FOREGROUND;
-          term->color_lines->bg = COLOR_BACKGROUND;
-     }
-
-     if(!terminal_color_pairs_head){
-          terminal_color_pairs_head = calloc(1, sizeof(*terminal_color_pairs_head));
-          if(!terminal_color_pairs_head) return false; // leak !
-
-          terminal_color_pairs_head->fg = -1;
-          terminal_color_pairs_head->bg = -1;
-
-          init_pair(TERM_START_COLOR, terminal_color_pairs_head->fg, terminal_color_pairs_head->bg);
-     }
+     if(!terminal_color_pairs_init()) return false; // leak !
 
      return true;
 }
@@ -455,26 +1742,13 @@ void terminal_free(Terminal_t* term)
      }
 
      if(term->fd){
-          for(int64_t i = 0; i < term->buffer->line_count; ++i){
-               TerminalColorNode_t* itr = term->color_lines + i;
-               if(!itr->next) continue; // ignore the first node, skip if it's the only one
-
-               itr = itr->next;
-
-               while(itr){
-                    TerminalColorNode_t* tmp = itr;
-                    itr = itr->next;
-                    free(tmp);
-               }
-          }
-
-          free(term->color_lines);
-
-          sem_close(term->updated);
-          pthread_cancel(term->reader_thread);
-          pthread_join(term->reader_thread, NULL);
+          terminal_io_remove(term);
+          close(term->fd);
      }
 
+     // NOTE: the io thread is done with us, so the screen is safe to tear down
+     terminal_screen_free(term);
+
      term->is_alive = false;
      term->width = 0;
      term->height = 0;
@@ -488,14 +1762,20 @@ bool terminal_resize(Terminal_t* term, int64_t width, int64_t height)
      window_size.ws_row = height;
      window_size.ws_col = width;
 
+     pthread_mutex_lock(&term->screen_lock);
+     bool resized = terminal_screen_resize(term, width, height);
+     pthread_mutex_unlock(&term->screen_lock);
+
+     if(!resized){
+          ce_message("%s() failed to resize screen to %"PRId64"x%"PRId64, __FUNCTION__, width, height);
+          return false;
+     }
+
      if(ioctl(term->fd, TIOCSWINSZ, &window_size) < 0){
           ce_message("%s() ioctl() failed %s", __FUNCTION__, strerror(errno));
           return false;
      }
 
-     term->width = width;
-     term->height = height;
-
      return true;
 }
 
@@ -531,15 +1811,31 @@ bool terminal_send_key(Terminal_t* term, int key)
           }
      }
 
-     int rc = write(term->fd, string, size);
-     if(rc < 0){
-          ce_message("%s() write() to terminal failed: %s", __FUNCTION__, strerror(errno));
-          return false;
-     }
+     pthread_mutex_lock(&term->screen_lock);
+     bool written = write_input(term, string, size);
+     pthread_mutex_unlock(&term->screen_lock);
 
      if(free_string) free((char*)string);
 
-     return true;
+     return written;
+}
+
+bool terminal_send_string(Terminal_t* term, const char* string, int64_t length, bool paste)
+{
+     static const char paste_start[] = "\033[200~";
+     static const char paste_end[] = "\033[201~";
+
+     pthread_mutex_lock(&term->screen_lock);
+
+     // NOTE: the application can tell a paste from typing when it is bracketed, so it won't run each pasted line
+     //       or auto indent the text as it comes in
+     bool bracket = paste && term->bracketed_paste;
+     bool written = (!bracket || write_input(term, paste_start, sizeof(paste_start) - 1)) &&
+                    write_input(term, string, length) &&
+                    (!bracket || write_input(term, paste_end, sizeof(paste_end) - 1));
+
+     pthread_mutex_unlock(&term->screen_lock);
+     return written;
 }
 
 char* terminal_get_current_directory(Terminal_t* term)
@@ -554,21 +1850,30 @@ void terminal_highlight(SyntaxHighlighterData_t* data, void* user_data)
      if(!user_data) return;
 
      TerminalHighlight_t* terminal_highlight = user_data;
-     TerminalColorNode_t* color_node = terminal_highlight->terminal->color_lines + data->loc.y;
+     const TerminalColorLine_t* color_line = terminal_highlight->terminal->color_lines + data->loc.y;
 
      switch(data->state){
      default:
      case SS_BEGINNING_OF_LINE:
           terminal_highlight->highlight_type = HL_OFF;
+
+          // find where we start drawing once, then walk forward through the runs as characters are drawn
+          terminal_highlight->run_index = color_line_find_run(color_line, data->loc.x);
           break;
      case SS_INITIALIZING:
+     {
           terminal_highlight->last_fg = -1;
           terminal_highlight->last_bg = -1;
+          terminal_highlight->last_attrs = -1;
           terminal_highlight->highlight_type = HL_OFF;
-          return;
+
+          short fg = 0;
+          pair_content(S_NORMAL_HIGHLIGHTED, &fg, &terminal_highlight->highlighted_bg);
+          pair_content(S_NORMAL_CURRENT_LINE, &fg, &terminal_highlight->current_line_bg);
+     } return;
      case SS_CHARACTER:
      {
-          if(ce_point_in_range(data->loc, data->buffer->highlight_start, data->buffer->highlight_end)){
+          if(data->loc.x >= data->highlight_first && data->loc.x <= data->highlight_last){
                terminal_highlight->highlight_type = HL_VISUAL;
           }else if(data->loc.y == data->cursor.y){
                terminal_highlight->highlight_type = HL_CURRENT_LINE;
@@ -576,52 +1881,46 @@ void terminal_highlight(SyntaxHighlighterData_t* data, void* user_data)
                terminal_highlight->highlight_type = HL_OFF;
           }
 
-          while(color_node){
-               if(!color_node->next) break;
-               if(color_node->next->index > data->loc.x) break;
-
-               color_node = color_node->next;
+          while(terminal_highlight->run_index + 1 < color_line->run_count &&
+                color_line->runs[terminal_highlight->run_index + 1].column <= data->loc.x){
+               terminal_highlight->run_index++;
           }
 
-          if(!color_node) return;
+          const TerminalColor_t* color = color_line_run_color(color_line, terminal_highlight->run_index);
 
-          int bg_color = color_node->bg;
+          int bg_color = color->bg;
 
           if(terminal_highlight->highlight_type == HL_VISUAL){
-               short fg = 0;
-               short bg = 0;
-               pair_content(S_NORMAL_HIGHLIGHTED, &fg, &bg);
-               bg_color = bg;
+               bg_color = terminal_highlight->highlighted_bg;
           }else if(terminal_highlight->highlight_type == HL_CURRENT_LINE){
-               short fg = 0;
-               short bg = 0;
-               pair_content(S_NORMAL_CURRENT_LINE, &fg, &bg);
-               bg_color = bg;
+               bg_color = terminal_highlight->current_line_bg;
           }
 
-          if(terminal_highlight->last_fg == color_node->fg && terminal_highlight->last_bg == bg_color){
+          if(terminal_highlight->last_fg == color->fg && terminal_highlight->last_bg == bg_color &&
+             terminal_highlight->last_attrs == color->attrs){
                return;
           }
 
-          terminal_switch_color(color_node->fg, bg_color);
+          terminal_switch_color(color->fg, bg_color, color->attrs);
 
-          terminal_highlight->last_fg = color_node->fg;
+          terminal_highlight->last_fg = color->fg;
           terminal_highlight->last_bg = bg_color;
+          terminal_highlight->last_attrs = color->attrs;
      } break;
      case SS_END_OF_LINE:
      {
-          while(color_node->next) color_node = color_node->next;
-
-          if(!color_node) return;
+          const TerminalColor_t* color = color_line_last_color(color_line);
 
-          if(terminal_highlight->last_fg == color_node->fg && terminal_highlight->last_bg == color_node->bg){
+          if(terminal_highlight->last_fg == color->fg && terminal_highlight->last_bg == color->bg &&
+             terminal_highlight->last_attrs == color->attrs){
                return;
           }
 
-          terminal_switch_color(color_node->fg, color_node->bg);
+          terminal_switch_color(color->fg, color->bg, color->attrs);
 
-          terminal_highlight->last_fg = color_node->fg;
-          terminal_highlight->last_bg = color_node->bg;
+          terminal_highlight->last_fg = color->fg;
+          terminal_highlight->last_bg = color->bg;
+          terminal_highlight->last_attrs = color->attrs;
      } break;
      }
 }
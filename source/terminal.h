@@ -2,59 +2,234 @@
 #define CE_TERM_H
 
 #include <pthread.h>
-#include <semaphore.h>
 
 #include "ce.h"
+#include "ring.h"
 #include "syntax.h"
 
 #define TERM_START_COLOR (S_AUTO_COMPLETE + 1)
+#define TERM_DEFAULT_SCROLLBACK_LINES 10000
 
-typedef struct TerminalColorNode_t{
-     int index;
-     int fg;
-     int bg;
-     struct TerminalColorNode_t* next;
-}TerminalColorNode_t;
+typedef enum{
+     TERM_ATTR_BOLD = 1 << 0,
+     TERM_ATTR_UNDERLINE = 1 << 1,
+     TERM_ATTR_REVERSE = 1 << 2,
+}TerminalAttr_t;
 
-typedef struct TerminalColorPairNode_t{
-     int fg;
-     int bg;
-     struct TerminalColorPairNode_t* next;
-}TerminalColorPairNode_t;
+typedef struct{
+     int16_t fg;
+     int16_t bg;
+     uint16_t attrs; // TerminalAttr_t flags
+}TerminalColor_t;
 
-// ce's virtual terminal
 typedef struct{
-     bool is_alive;
-     sem_t* updated;
+     int32_t column; // the color applies from this column until the next run
+     TerminalColor_t color;
+}TerminalColorRun_t;
+
+// NOTE: lines without color changes only use the inline first color and never allocate runs
+typedef struct{
+     TerminalColor_t first; // color at the start of the line
+     int32_t run_count;
+     int32_t run_capacity;
+     TerminalColorRun_t* runs; // sorted by column
+}TerminalColorLine_t;
 
-     Point_t cursor;
+#define TERM_COLOR_COUNT 257 // the default color, -1, followed by the 256 color palette
 
-     int64_t width;
-     int64_t height;
+// fg x bg to ncurses color pair, shared by all terminals. Pairs are initialized the first time they are drawn
+typedef struct{
+     short* pairs; // TERM_COLOR_COUNT * TERM_COLOR_COUNT, indexed by (fg + 1) * TERM_COLOR_COUNT + (bg + 1), 0 if unused
+     short next_pair;
+}TerminalColorPairs_t;
+
+// a character on the screen grid
+typedef struct{
+     char ch;
+     TerminalColor_t color;
+}TerminalCell_t;
+
+typedef struct{
+     TerminalCell_t* cells; // width * height
+     TerminalCell_t** rows; // point into cells, scrolling rotates these rather than moving cells
+     int64_t rows_used; // rows that have a line in the buffer, the rest have never been touched
+}TerminalGrid_t;
+
+// columns changed since the row was last copied into the buffer, first > last when it is clean
+typedef struct{
+     int64_t first;
+     int64_t last;
+}TerminalDirtyRow_t;
+
+typedef enum{
+     TPS_GROUND,
+     TPS_ESCAPE,
+     TPS_ESCAPE_INTERMEDIATE, // character set selection and friends, the byte that follows is skipped
+     TPS_CSI,
+     TPS_STRING, // OSC, DCS and friends, ignored until BEL or ST
+     TPS_STRING_ESCAPE,
+     TPS_UTF8,
+}TerminalParseState_t;
+
+#define TERM_MAX_CSI_ARGUMENTS 16
+
+typedef struct{
+     TerminalParseState_t state;
+     int arguments[TERM_MAX_CSI_ARGUMENTS];
+     int argument_index;
+     char private_marker; // '?' or '>' in front of the arguments, 0 if there isn't one
+     char intermediate;
+     int utf8_remaining;
+}TerminalParser_t;
+
+typedef enum{
+     TDT_LINE_COUNT,
+     TDT_ROW,
+     TDT_DROP_LINES,
+     TDT_CURSOR,
+     TDT_EXITED,
+}TerminalDeltaType_t;
+
+// a change to the terminal's buffer, queued up by whoever drives the screen and applied by whoever owns the buffer
+typedef struct{
+     TerminalDeltaType_t type;
+     union{
+          int64_t line_count;
+          int64_t drop_count;
+          Point_t cursor; // in buffer coordinates
+          struct{ // followed by text_length chars and then run_count TerminalColorRun_t
+               int64_t line;
+               int64_t start; // column the text starts at
+               int64_t text_length;
+               int64_t line_length; // the line is truncated to this length after the text is set
+               TerminalColor_t first;
+               int32_t run_count;
+          }row;
+     };
+}TerminalDelta_t;
+
+#define TERM_DELTA_RING_SIZE (1 << 20)
+#define TERM_MAX_PENDING_BYTES (1 << 22) // past this, the terminal's output isn't read until the buffer catches up
+
+#define TERM_FLOOD_WINDOW_MS 250
+#define TERM_FLOOD_BYTES_PER_SECOND (1 << 20)
+#define TERM_FLOOD_WINDOWS 2 // windows in a row over the rate before we call it a flood
+
+// how fast the terminal's output is coming in, so the ui can stop drawing every read when a command floods it
+typedef struct{
+     uint64_t window_bytes; // bytes_read when the current window started
+     int64_t window_start; // ms
+     int64_t bytes_per_second; // rate over the last complete window
+     int64_t flooded_windows; // complete windows in a row over TERM_FLOOD_BYTES_PER_SECOND
+     bool fast_forward; // output is flooding, it is still applied as it comes in but drawn less often
+}TerminalFlood_t;
 
-     pthread_t reader_thread;
+// ce's virtual terminal
+// NOTE: output is applied to a fixed size screen grid. After each read, the rows that changed are sent as deltas
+//       through the deltas ring. The buffer is only changed when terminal_apply_updates() applies them, so the
+//       thread that owns the buffer never races with the io thread. In the buffer the screen starts at
+//       screen_top_line and the lines above it are scrollback
+typedef struct{
+     // owned by the thread applying updates
+     bool is_alive;
+     Point_t cursor; // in buffer coordinates
+     Buffer_t* buffer;
+     TerminalColorLine_t* color_lines; // size is buffer->line_count
+     int64_t color_line_offset; // like the buffer's line_offset, color_lines is advanced past dropped lines
+     int64_t lines_dropped; // total dropped over the terminal's life, so users can tell when to shift line indices
+     int64_t first_changed_line; // lowest line changed by applied updates, users set it past the end once they catch up
+     TerminalFlood_t flood;
 
      pid_t pid;
      int fd;
+     uint64_t bytes_read; // total output processed, updated atomically so the rate can be measured from any thread
 
-     Buffer_t* buffer;
+     Ring_t deltas;
 
-     TerminalColorNode_t* color_lines; // array of nodes that lead to linked lists, size is buffer->line_count
+     // the screen, owned by whoever holds screen_lock, that is the io thread or terminal_resize()
+     pthread_mutex_t screen_lock;
+
+     int64_t width;
+     int64_t height;
+
+     TerminalGrid_t primary;
+     TerminalGrid_t alternate;
+     TerminalGrid_t* screen; // the grid being shown
+     TerminalDirtyRow_t* dirty_rows; // one per screen row
+     TerminalColorRun_t* row_runs; // scratch space for sending a row's colors, one per column
+     Point_t screen_cursor;
+     Point_t saved_cursor;
+     TerminalColor_t saved_pen;
+     int64_t scroll_top;
+     int64_t scroll_bottom;
+     int64_t screen_top_line;
+     int64_t line_count; // lines the buffer will have once every delta sent so far is applied
+     Point_t sent_cursor; // the cursor in the last TDT_CURSOR delta
+     bool wrap_pending; // the last column was just written, the next character wraps to the next line first
+     TerminalParser_t parser;
+     TerminalColor_t pen; // color set by the last 'm' sequence, applied to what is written next
+
+     int64_t scrollback_lines; // NOTE: 0 means unlimited, otherwise the oldest lines are dropped past this many
+
+     // deltas that did not fit in the ring, they are moved over as the ring drains
+     char* pending;
+     int64_t pending_length;
+     int64_t pending_capacity;
+     bool waiting_for_space; // set when deltas are pending, so applying updates knows to wake up the io thread
+     bool throttled; // too much is pending, we stopped reading the terminal's output
+     bool bracketed_paste; // the application asked for pastes to be wrapped in ESC [ 200 ~ and ESC [ 201 ~
+
+     // input the shell wasn't ready to read yet, the io thread writes it as soon as the fd has room
+     char* input;
+     int64_t input_length;
+     int64_t input_capacity;
 }Terminal_t;
 
-extern TerminalColorPairNode_t* terminal_color_pairs_head; // exposed for cleanup if necessary
+#define TERM_IO_MAX_EVENTS 32
+
+// a single thread reads the output of every terminal, started by the first terminal_init()
+typedef struct{
+     pthread_t thread;
+     pthread_mutex_t lock; // held while the io thread handles a batch of events and while terminals are added or removed
+     bool running;
+     int epoll_fd;
+     int wake_fd; // eventfd, wakes the io thread up to exit or to move pending deltas into rings that have room now
+     int updated_fd; // eventfd, incremented after each batch of output that changed a terminal
+     uint64_t generation; // bumped when a terminal is removed, so events that were already returned are not trusted
+     Terminal_t** terminals;
+     int64_t terminal_count;
+     int64_t terminal_capacity;
+}TerminalIO_t;
+
+extern TerminalIO_t terminal_io;
+void terminal_io_stop();
+
+extern TerminalColorPairs_t terminal_color_pairs;
+void terminal_color_pairs_free();
 
 bool terminal_init(Terminal_t* term, int64_t width, int64_t height, Buffer_t* buffer);
 void terminal_free(Terminal_t* term);
 
+// the screen can be setup and fed without a shell, which is what terminal_init() and the io thread do
+bool terminal_screen_init(Terminal_t* term, int64_t width, int64_t height, Buffer_t* buffer);
+void terminal_screen_free(Terminal_t* term);
+void terminal_process_output(Terminal_t* term, const char* bytes, int64_t length);
+bool terminal_apply_updates(Terminal_t* term); // returns true if anything changed
+bool terminal_measure_flood(Terminal_t* term, int64_t now); // now is in ms, returns true if fast_forward changed
+
 bool terminal_resize(Terminal_t* term, int64_t width, int64_t height);
 bool terminal_send_key(Terminal_t* term, int key);
+bool terminal_send_string(Terminal_t* term, const char* string, int64_t length, bool paste); // paste is bracketed if asked for
 char* terminal_get_current_directory(Terminal_t* term); // string returned must be free'd
 
 typedef struct{
      Terminal_t* terminal;
      int last_fg;
      int last_bg;
+     int last_attrs;
+     int64_t run_index; // run we are drawing on the current line, -1 means the line's first color
+     short highlighted_bg; // looked up once per draw rather than per character
+     short current_line_bg;
      HighlightType_t highlight_type;
 }TerminalHighlight_t;
 
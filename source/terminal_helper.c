@@ -1,61 +1,181 @@
 #include "terminal_helper.h"
 #include "view.h"
 #include "misc.h"
+#include "destination.h"
+#include "util.h"
 
-extern pthread_mutex_t draw_lock;
+#include <unistd.h>
+#include <poll.h>
 
-typedef struct{
-     ConfigState_t* config_state;
-     TerminalNode_t* terminal_node;
-}TerminalCheckUpdateData_t;
+extern pthread_mutex_t draw_lock;
 
-static void terminal_check_update_cleanup(void* data)
+static void terminal_draw_thread_cleanup(void* data)
 {
+     (void)(data);
+
      // release locks we could be holding
      pthread_mutex_unlock(&draw_lock);
-     free(data);
 }
 
-static void* terminal_check_update(void* data)
+static void shift_views_up(BufferView_t* view, const Buffer_t* buffer, int64_t lines)
+{
+     if(view->buffer == buffer){
+          view->cursor.y -= lines;
+          if(view->cursor.y < 0) view->cursor.y = 0;
+          view->top_row -= lines;
+          if(view->top_row < 0) view->top_row = 0;
+     }
+
+     if(view->next_horizontal) shift_views_up(view->next_horizontal, buffer, lines);
+     if(view->next_vertical) shift_views_up(view->next_vertical, buffer, lines);
+}
+
+// when the terminal drops scrollback, everything pointing at a line in its buffer has to move up with the lines
+static void terminal_shift_for_dropped_lines(ConfigState_t* config_state, TerminalNode_t* terminal_node)
+{
+     Terminal_t* terminal = &terminal_node->terminal;
+     int64_t dropped = terminal->lines_dropped - terminal_node->lines_dropped;
+     if(dropped <= 0) return;
+
+     terminal_node->lines_dropped = terminal->lines_dropped;
+
+     terminal_node->last_jump_location -= dropped;
+     if(terminal_node->last_jump_location < 0) terminal_node->last_jump_location = 0;
+
+     dest_index_shift(&terminal_node->destinations, dropped);
+
+     terminal->buffer->cursor.y -= dropped;
+     if(terminal->buffer->cursor.y < 0) terminal->buffer->cursor.y = 0;
+
+     TabView_t* tab_itr = config_state->tab_head;
+     while(tab_itr){
+          shift_views_up(tab_itr->view_head, terminal->buffer, dropped);
+          tab_itr = tab_itr->next;
+     }
+}
+
+// look for destinations in the output as it comes in, so jumping to them doesn't have to parse every line again
+static void terminal_index_destinations(TerminalNode_t* terminal_node)
+{
+     Terminal_t* terminal = &terminal_node->terminal;
+     DestIndex_t* destinations = &terminal_node->destinations;
+
+     dest_index_invalidate(destinations, terminal->first_changed_line);
+     terminal->first_changed_line = terminal->buffer->line_count;
+     if(destinations->scanned >= terminal->buffer->line_count) return;
+
+     char* terminal_current_directory = terminal_get_current_directory(terminal);
+     dest_index_update(destinations, terminal->buffer, terminal_current_directory);
+     free(terminal_current_directory);
+}
+
+bool terminal_apply_all_updates(ConfigState_t* config_state)
 {
-     pthread_cleanup_push(terminal_check_update_cleanup, data);
+     bool updated = false;
+
+     TerminalNode_t* term_itr = config_state->terminal_head;
+     while(term_itr){
+          Terminal_t* terminal = &term_itr->terminal;
+
+          if(terminal_apply_updates(terminal)){
+               updated = true;
+
+               terminal_shift_for_dropped_lines(config_state, term_itr);
+               terminal_index_destinations(term_itr);
+
+               BufferView_t* terminal_view = ce_buffer_in_view(config_state->tab_current->view_head, terminal->buffer);
+               if(terminal_view){
+                    terminal_view->cursor = terminal->cursor;
+                    view_follow_cursor(terminal_view, LNT_NONE);
+
+                    if(config_state->vim_state.mode == VM_INSERT && !terminal->is_alive){
+                         vim_enter_normal_mode(&config_state->vim_state);
+                    }
+               }
+          }
 
-     TerminalCheckUpdateData_t* check_update_data = data;
-     ConfigState_t* config_state = check_update_data->config_state;
-     Terminal_t* terminal = &check_update_data->terminal_node->terminal;
+          term_itr = term_itr->next;
+     }
+
+     return updated;
+}
+
+static uint64_t usec_since_last_draw(ConfigState_t* config_state)
+{
      struct timeval current_time;
-     uint64_t elapsed = 0;
+     gettimeofday(&current_time, NULL);
+     return (current_time.tv_sec - config_state->last_draw_time.tv_sec) * 1000000LL +
+            (current_time.tv_usec - config_state->last_draw_time.tv_usec);
+}
 
-     while(terminal->is_alive){
-          sem_wait(terminal->updated);
+// returns true if any terminal is fast forwarding, sets *changed if one started or stopped
+static bool terminal_measure_all_floods(ConfigState_t* config_state, bool* changed)
+{
+     int64_t now_ms = util_now_ms();
+
+     bool fast_forward = false;
+
+     TerminalNode_t* term_itr = config_state->terminal_head;
+     while(term_itr){
+          if(terminal_measure_flood(&term_itr->terminal, now_ms)) *changed = true;
+          if(term_itr->terminal.flood.fast_forward) fast_forward = true;
+          term_itr = term_itr->next;
+     }
+
+     return fast_forward;
+}
 
-          BufferView_t* terminal_view = ce_buffer_in_view(config_state->tab_current->view_head, terminal->buffer);
-          if(terminal_view){
-               terminal_view->cursor = terminal->cursor;
-               view_follow_cursor(terminal_view, LNT_NONE);
-          }else{
-               continue;
+// applies and draws terminal output as the io thread says it is ready, however many terminals it came from
+static void* terminal_draw_thread(void* data)
+{
+     pthread_cleanup_push(terminal_draw_thread_cleanup, NULL);
+
+     ConfigState_t* config_state = data;
+     struct pollfd updated_poll = {.fd = terminal_io.updated_fd, .events = POLLIN};
+     bool fast_forward = false;
+     bool draw_owed = false; // output was applied but not drawn yet
+
+     while(true){
+          // NOTE: while fast forwarding, wake up every window to keep measuring the rate, and to draw what we held
+          //       back once the output stops
+          int timeout = (fast_forward || draw_owed) ? TERM_FLOOD_WINDOW_MS : -1;
+          int rc = poll(&updated_poll, 1, timeout);
+          if(rc < 0){
+               if(errno == EINTR) continue;
+               ce_message("%s() poll() on updated eventfd failed: %s", __FUNCTION__, strerror(errno));
+               break;
           }
 
-          if(config_state->vim_state.mode == VM_INSERT && !terminal->is_alive){
-               vim_enter_normal_mode(&config_state->vim_state);
+          if(rc > 0){
+               uint64_t count;
+               if(read(terminal_io.updated_fd, &count, sizeof(count)) < 0 && errno != EINTR){
+                    ce_message("%s() read() from updated eventfd failed: %s", __FUNCTION__, strerror(errno));
+                    break;
+               }
           }
 
-          // make sure the other view drawer is done before drawing
+          // wait for our interval limit before drawing, output that comes in meanwhile is applied in the same batch.
+          // When fast forwarding, apply right away so the io thread never has to stop reading on our account
+          uint64_t elapsed = usec_since_last_draw(config_state);
+          if(!fast_forward && elapsed < DRAW_USEC_LIMIT) usleep(DRAW_USEC_LIMIT - elapsed);
+
+          // make sure the other view drawer is done before touching the buffers
           pthread_mutex_lock(&draw_lock);
 
-          // wait for our interval limit, before drawing
-          do{
-               gettimeofday(&current_time, NULL);
-               elapsed = (current_time.tv_sec - config_state->last_draw_time.tv_sec) * 1000000LL +
-                         (current_time.tv_usec - config_state->last_draw_time.tv_usec);
-          }while(elapsed < DRAW_USEC_LIMIT);
+          if(terminal_apply_all_updates(config_state)) draw_owed = true;
+
+          // starting or stopping changes the status line, so it needs a draw too
+          fast_forward = terminal_measure_all_floods(config_state, &draw_owed);
+
+          if(draw_owed && (!fast_forward || usec_since_last_draw(config_state) >= TERMINAL_FAST_FORWARD_DRAW_USEC)){
+               view_drawer(config_state);
+               draw_owed = false;
+          }
 
-          view_drawer(config_state);
           pthread_mutex_unlock(&draw_lock);
      }
 
-     pthread_cleanup_pop(data);
+     pthread_cleanup_pop(0);
      return NULL;
 }
 
@@ -80,19 +200,27 @@ bool terminal_start_in_view(BufferView_t* buffer_view, TerminalNode_t* node, Con
           return false;
      }
 
-     TerminalCheckUpdateData_t* check_update_data = calloc(1, sizeof(*check_update_data));
-     check_update_data->config_state = config_state;
-     check_update_data->terminal_node = node;
-
-     int rc = pthread_create(&node->check_update_thread, NULL, terminal_check_update, check_update_data);
-     if(rc != 0){
-          ce_message("pthread_create() for terminal_check_update() failed");
-          return false;
+     if(!config_state->terminal_draw_thread){
+          int rc = pthread_create(&config_state->terminal_draw_thread, NULL, terminal_draw_thread, config_state);
+          if(rc != 0){
+               config_state->terminal_draw_thread = 0;
+               ce_message("pthread_create() for terminal_draw_thread() failed");
+               return false;
+          }
      }
 
      return true;
 }
 
+void terminal_stop_draw_thread(ConfigState_t* config_state)
+{
+     if(!config_state->terminal_draw_thread) return;
+
+     pthread_cancel(config_state->terminal_draw_thread);
+     pthread_join(config_state->terminal_draw_thread, NULL);
+     config_state->terminal_draw_thread = 0;
+}
+
 void terminal_resize_if_in_view(BufferView_t* view_head, TerminalNode_t* terminal_head)
 {
      while(terminal_head){
@@ -112,10 +240,7 @@ bool terminal_in_view_run_command(TerminalNode_t* terminal_head, BufferView_t* v
      TerminalNode_t* term_itr = terminal_head;
      while(term_itr){
           if(ce_buffer_in_view(view_head, term_itr->buffer)){
-               while(*command){
-                    terminal_send_key(&term_itr->terminal, *command);
-                    command++;
-               }
+               terminal_send_string(&term_itr->terminal, command, strlen(command), false);
 
                misc_move_jump_location_to_end_of_output(term_itr);
                terminal_send_key(&term_itr->terminal, KEY_ENTER);
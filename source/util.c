@@ -0,0 +1,88 @@
+#include "util.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+uint64_t util_hash(uint64_t hash, const char* bytes, int64_t length)
+{
+     for(int64_t i = 0; i < length; ++i){
+          hash ^= (unsigned char)(bytes[i]);
+          hash *= 1099511628211ULL;
+     }
+
+     return hash;
+}
+
+uint64_t util_hash_string(const char* string)
+{
+     return util_hash(UTIL_HASH_SEED, string, strlen(string));
+}
+
+int64_t util_now_ms()
+{
+     struct timespec now;
+     clock_gettime(CLOCK_MONOTONIC, &now);
+     return (int64_t)(now.tv_sec) * 1000 + now.tv_nsec / 1000000;
+}
+
+char* util_join_path(const char* directory, const char* name)
+{
+     char* path = NULL;
+     int rc = directory[0] ? asprintf(&path, "%s/%s", directory, name) : asprintf(&path, "%s", name);
+     return (rc < 0) ? NULL : path;
+}
+
+bool util_entry_is_directory(const char* path, const struct dirent* node, bool follow_links)
+{
+     if(node->d_type == DT_DIR) return true;
+     if(node->d_type != DT_UNKNOWN && !(follow_links && node->d_type == DT_LNK)) return false;
+
+     // NOTE: only symlinks we follow and file systems that don't fill in d_type cost us a stat
+     struct stat info;
+     int rc = follow_links ? stat(path, &info) : lstat(path, &info);
+     return rc == 0 && S_ISDIR(info.st_mode);
+}
+
+bool util_write_file_replacing(const char* path, const struct iovec* iovecs, int iovec_count)
+{
+     char tmp_path[PATH_MAX];
+     if(snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >= PATH_MAX) return false;
+
+     int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+     if(fd < 0) return false;
+
+     bool success = true;
+     for(int i = 0; i < iovec_count && success; ++i){
+          const char* itr = iovecs[i].iov_base;
+          size_t left = iovecs[i].iov_len;
+          while(left){
+               ssize_t written = write(fd, itr, left);
+               if(written < 0 && errno == EINTR) continue;
+               if(written <= 0){
+                    success = false;
+                    break;
+               }
+
+               itr += written;
+               left -= written;
+          }
+     }
+
+     if(close(fd) != 0) success = false;
+
+     if(!success || rename(tmp_path, path) != 0){
+          int saved_errno = errno;
+          unlink(tmp_path);
+          errno = saved_errno;
+          return false;
+     }
+
+     return true;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+// small helpers the indexes and caches share
+
+#include <dirent.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#define UTIL_HASH_SEED 14695981039346656037ULL
+
+// FNV-1a, pass UTIL_HASH_SEED to start, or a previous hash to continue it
+uint64_t util_hash(uint64_t hash, const char* bytes, int64_t length);
+uint64_t util_hash_string(const char* string);
+
+int64_t util_now_ms(); // CLOCK_MONOTONIC
+
+char* util_join_path(const char* directory, const char* name); // "" is the directory itself, NULL if allocation failed
+
+// node came from reading path's directory. follow_links treats a symlink to a directory as one
+bool util_entry_is_directory(const char* path, const struct dirent* node, bool follow_links);
+
+// write to a temporary file next to path and rename it over path, so nobody ever reads a half written file
+bool util_write_file_replacing(const char* path, const struct iovec* iovecs, int iovec_count);
@@ -65,6 +65,17 @@ void vim_yank_add(VimYankNode_t** head, char reg_char, const char* yank_text, Vi
 
      node->text = yank_text;
      node->mode = mode;
+     node->block_width = 0;
+     node->block_height = 0;
+}
+
+void vim_yank_add_block(VimYankNode_t** head, char reg_char, const char* yank_text, int64_t width, int64_t height)
+{
+     vim_yank_add(head, reg_char, yank_text, YANK_BLOCK);
+
+     VimYankNode_t* node = vim_yank_find(*head, reg_char);
+     node->block_width = width;
+     node->block_height = height;
 }
 
 void vim_yanks_free(VimYankNode_t** head)
@@ -179,6 +190,208 @@ void vim_macro_commits_dump(const VimMacroCommitNode_t* macro_commit)
      }
 }
 
+static int64_t multi_cursor_find(const VimMultiCursor_t* multi_cursor, Point_t location)
+{
+     // binary search for the first cursor that is not before location
+     int64_t low = 0;
+     int64_t high = multi_cursor->count;
+     while(low < high){
+          int64_t mid = low + (high - low) / 2;
+          const Point_t* p = multi_cursor->cursors + mid;
+          if(p->y < location.y || (p->y == location.y && p->x < location.x)){
+               low = mid + 1;
+          }else{
+               high = mid;
+          }
+     }
+
+     return low;
+}
+
+bool vim_multi_cursor_add(VimMultiCursor_t* multi_cursor, Point_t location)
+{
+     int64_t index = multi_cursor_find(multi_cursor, location);
+     if(index < multi_cursor->count && ce_points_equal(multi_cursor->cursors[index], location)) return true;
+
+     if(multi_cursor->count == multi_cursor->capacity){
+          int64_t new_capacity = multi_cursor->capacity ? multi_cursor->capacity * 2 : 16;
+          Point_t* new_cursors = realloc(multi_cursor->cursors, new_capacity * sizeof(*new_cursors));
+          if(!new_cursors){
+               ce_message("%s() failed to allocate cursors", __FUNCTION__);
+               return false;
+          }
+
+          multi_cursor->cursors = new_cursors;
+          multi_cursor->capacity = new_capacity;
+     }
+
+     memmove(multi_cursor->cursors + index + 1, multi_cursor->cursors + index,
+             (multi_cursor->count - index) * sizeof(*multi_cursor->cursors));
+     multi_cursor->cursors[index] = location;
+     multi_cursor->count++;
+     return true;
+}
+
+int64_t vim_multi_cursor_add_matches(VimMultiCursor_t* multi_cursor, const Buffer_t* buffer, const regex_t* regex,
+                                     Point_t cursor)
+{
+     int64_t added = 0;
+
+     // one pass over the buffer, picking up every match on each line
+     for(int64_t y = 0; y < buffer->line_count; ++y){
+          const char* line = buffer->lines[y];
+          int64_t offset = 0;
+          int flags = 0;
+          regmatch_t match;
+
+          while(line[offset] && regexec(regex, line + offset, 1, &match, flags) == 0){
+               Point_t location = {offset + match.rm_so, y};
+               if(!ce_points_equal(location, cursor)){
+                    // NOTE: a match we already have a cursor on isn't one we added
+                    int64_t count = multi_cursor->count;
+                    if(!vim_multi_cursor_add(multi_cursor, location)) return added;
+                    if(multi_cursor->count > count) added++;
+               }
+
+               // always make progress, even on empty matches
+               offset += (match.rm_eo > match.rm_so) ? match.rm_eo : match.rm_so + 1;
+               flags = REG_NOTBOL;
+          }
+     }
+
+     return added;
+}
+
+void vim_multi_cursor_clear(VimMultiCursor_t* multi_cursor)
+{
+     multi_cursor->count = 0;
+     multi_cursor->one_shot = false;
+}
+
+void vim_multi_cursor_free(VimMultiCursor_t* multi_cursor)
+{
+     free(multi_cursor->cursors);
+     multi_cursor->cursors = NULL;
+     multi_cursor->count = 0;
+     multi_cursor->capacity = 0;
+}
+
+static bool insert_block_on_lines(Buffer_t* buffer, BufferCommitNode_t** commit_tail, Point_t cursor,
+                                  BufferLineEdit_t* edits, int64_t edit_count, const char* string,
+                                  BufferCommitChain_t chain);
+
+// the keys typed at the view's cursor reduced to the text they left behind, NULL if they did more than insert on one line
+static char* multi_cursor_inserted_text(const KeyNode_t* keys)
+{
+     int64_t key_count = 0;
+     for(const KeyNode_t* itr = keys; itr; itr = itr->next) key_count++;
+
+     int64_t tab_len = strlen(TAB_STRING);
+     char* text = malloc(key_count * tab_len + 1);
+     if(!text) return NULL;
+
+     int64_t len = 0;
+     for(const KeyNode_t* itr = keys; itr; itr = itr->next){
+          if(itr->key == KEY_TAB){
+               memcpy(text + len, TAB_STRING, tab_len);
+               len += tab_len;
+          }else if(itr->key == KEY_BACKSPACE && len > 0){
+               len--;
+          }else if(itr->key >= 0 && itr->key < 256 && isprint(itr->key)){
+               text[len] = itr->key;
+               len++;
+          }else{
+               free(text);
+               return NULL;
+          }
+     }
+
+     text[len] = 0;
+     return text;
+}
+
+// repeat what was just typed at the view's cursor at every other cursor, back to front so no cursor
+// shifts another, as a single block commit chained with the typing
+static bool multi_cursor_apply_insert(VimMultiCursor_t* multi_cursor, Buffer_t* buffer, BufferCommitNode_t** commit_tail,
+                                      const KeyNode_t* keys, Point_t cursor)
+{
+     char* text = multi_cursor_inserted_text(keys);
+     Point_t insert_start = multi_cursor->insert_start;
+     int64_t text_len = text ? strlen(text) : 0;
+
+     if(!text || cursor.y != insert_start.y || cursor.x != insert_start.x + text_len){
+          ce_message("multiple cursors only repeat inserts that stay on a single line");
+          free(text);
+          return false;
+     }
+
+     if(!text_len){
+          free(text);
+          return true;
+     }
+
+     // drop cursors that fell off the buffer or that the view's cursor sits on
+     int64_t keep_count = 0;
+     for(int64_t i = 0; i < multi_cursor->count; ++i){
+          Point_t location = multi_cursor->cursors[i];
+          if(location.y >= buffer->line_count || ce_points_equal(location, insert_start)) continue;
+          multi_cursor->cursors[keep_count] = location;
+          keep_count++;
+     }
+     multi_cursor->count = keep_count;
+
+     if(!multi_cursor->count){
+          free(text);
+          return true;
+     }
+
+     BufferLineEdit_t* edits = malloc(multi_cursor->count * sizeof(*edits));
+     if(!edits){
+          free(text);
+          return false;
+     }
+
+     int64_t edit_count = 0;
+     for(int64_t i = multi_cursor->count - 1; i >= 0; --i){
+          Point_t* location = multi_cursor->cursors + i;
+
+          // cursors after the view's cursor on its line were pushed over by the typing
+          if(location->y == insert_start.y && location->x >= insert_start.x) location->x += text_len;
+
+          int64_t line_len = strlen(buffer->lines[location->y]);
+          if(location->x > line_len) location->x = line_len;
+
+          edits[edit_count] = (BufferLineEdit_t){location->y, location->x, text_len};
+          edit_count++;
+     }
+
+     bool success = insert_block_on_lines(buffer, commit_tail, cursor, edits, edit_count, text, BCC_KEEP_GOING);
+     free(text);
+     if(!success) return false;
+
+     // leave each cursor after its copy of the text, accounting for the copies before it on the same line
+     int64_t same_line_count = 0;
+     for(int64_t i = 0; i < multi_cursor->count; ++i){
+          Point_t* location = multi_cursor->cursors + i;
+          if(i > 0 && location->y == multi_cursor->cursors[i - 1].y){
+               same_line_count++;
+          }else{
+               same_line_count = 0;
+          }
+
+          location->x += text_len * (same_line_count + 1);
+     }
+
+     return true;
+}
+
+static void multi_cursor_finish_insert(VimMultiCursor_t* multi_cursor, Buffer_t* buffer, BufferCommitNode_t** commit_tail,
+                                       const KeyNode_t* keys, Point_t cursor)
+{
+     if(multi_cursor->count) multi_cursor_apply_insert(multi_cursor, buffer, commit_tail, keys, cursor);
+     if(multi_cursor->one_shot) vim_multi_cursor_clear(multi_cursor);
+}
+
 static bool line_is_all_whitespace(Buffer_t* buffer, int64_t line)
 {
      if(line < 0 || line >= buffer->line_count) return false;
@@ -275,6 +488,9 @@ VimKeyHandlerResult_t vim_key_handler(int key, VimState_t* vim_state, BufferView
                     vim_state->last_insert_command = built_command;
                }
 
+               multi_cursor_finish_insert(&vim_buffer_state->multi_cursor, buffer, commit_tail, vim_state->command_head,
+                                          *cursor);
+
                ce_keys_free(&vim_state->command_head);
 
                if(line_is_all_whitespace(buffer, cursor->y)){
@@ -488,6 +704,7 @@ VimKeyHandlerResult_t vim_key_handler(int key, VimState_t* vim_state, BufferView
      } break;
      case VM_VISUAL_RANGE:
      case VM_VISUAL_LINE:
+     case VM_VISUAL_BLOCK:
          if(key == KEY_ESCAPE){
                vim_enter_normal_mode(vim_state);
                break;
@@ -497,23 +714,27 @@ VimKeyHandlerResult_t vim_key_handler(int key, VimState_t* vim_state, BufferView
          }else if(key == 'V'){
                vim_enter_visual_line_mode(vim_state, *cursor);
                break;
+         }else if(key == KEY_VISUAL_BLOCK){
+               vim_enter_visual_block_mode(vim_state, *cursor);
+               break;
           }
      case VM_NORMAL:
      {
-          ce_keys_push(&vim_state->command_head, key);
-          int* built_command = ce_keys_get_string(vim_state->command_head);
+          VimActionParser_t* action_parser = &vim_state->action_parser;
 
           VimAction_t vim_action;
-          VimCommandState_t command_state = vim_action_from_string(built_command, &vim_action, vim_state->mode, buffer,
-                                                                   cursor, &vim_state->visual_start, &vim_state->find_char_state,
-                                                                   vim_state->recording_macro);
-          free(built_command);
+          VimCommandState_t command_state = VCS_INVALID;
+          if(vim_action_parser_push(action_parser, key)){
+               command_state = vim_action_parser_parse(action_parser, &vim_action, vim_state->mode, buffer,
+                                                       cursor, &vim_state->visual_start, &vim_state->find_char_state,
+                                                       vim_state->recording_macro);
+          }
 
           switch(command_state){
           default:
           case VCS_INVALID:
                // allow command to be cleared
-               ce_keys_free(&vim_state->command_head);
+               vim_action_parser_reset(action_parser);
                return result; // did not handle key
           case VCS_CONTINUE:
                if(recording_macro && recording_macro == vim_state->recording_macro){
@@ -527,7 +748,7 @@ VimKeyHandlerResult_t vim_key_handler(int key, VimState_t* vim_state, BufferView
 
                     ce_keys_push(&vim_state->macro_commit_current->command_copy, key);
 
-                    if(!vim_state->command_head->next){
+                    if(action_parser->key_count == 1){
                          KeyNode_t* itr = vim_state->record_macro_head;
                          while(itr->next) {
                               itr = itr->next;
@@ -558,6 +779,9 @@ VimKeyHandlerResult_t vim_key_handler(int key, VimState_t* vim_state, BufferView
                     case VM_VISUAL_LINE:
                          vim_enter_visual_line_mode(vim_state, *cursor);
                          break;
+                    case VM_VISUAL_BLOCK:
+                         vim_enter_visual_block_mode(vim_state, *cursor);
+                         break;
                     }
                }
 
@@ -583,6 +807,10 @@ VimKeyHandlerResult_t vim_key_handler(int key, VimState_t* vim_state, BufferView
                         vim_state->last_action.change.type != VCT_UNINDENT)){
                          vim_state->last_action.motion.visual_start_after = true;
                          vim_state->last_action.motion.visual_length = labs(vim_state->last_action.motion.visual_length);
+                    }else if(vim_state->last_action.motion.type == VMT_VISUAL_BLOCK){
+                         // repeat the same size block down and to the right of the cursor
+                         vim_state->last_action.motion.visual_block_lines = labs(vim_state->last_action.motion.visual_block_lines);
+                         vim_state->last_action.motion.visual_block_columns = labs(vim_state->last_action.motion.visual_block_columns);
                     }
                }
 
@@ -591,7 +819,7 @@ VimKeyHandlerResult_t vim_key_handler(int key, VimState_t* vim_state, BufferView
 
                     ce_keys_push(&vim_state->record_macro_head, key);
 
-                    if(!vim_state->command_head->next){
+                    if(action_parser->key_count == 1){
                          KeyNode_t* itr = vim_state->record_macro_head;
                          while(itr->next) itr = itr->next;
                          vim_state->last_macro_command_begin = itr;
@@ -610,7 +838,7 @@ VimKeyHandlerResult_t vim_key_handler(int key, VimState_t* vim_state, BufferView
                     }
                }
 
-               ce_keys_free(&vim_state->command_head);
+               vim_action_parser_reset(action_parser);
 
                result.type = successful_action ? VKH_COMPLETED_ACTION_SUCCESS : VKH_COMPLETED_ACTION_FAILURE;
                result.completed_action = vim_action;
@@ -626,628 +854,667 @@ VimKeyHandlerResult_t vim_key_handler(int key, VimState_t* vim_state, BufferView
      return result;
 }
 
-static int itoi(int* str)
+static bool isdigit_key(int key)
 {
-     int value = 0;
-
-     while(*str){
-          if(*str < 0 || *str > 255 || !isdigit(*str)) return 0;
-          value = value * 10 + (*str - '0');
-          str++;
-     }
+     return key >= 0 && key <= 255 && isdigit(key);
+}
 
-     return value;
+void vim_action_parser_reset(VimActionParser_t* parser)
+{
+     parser->key_count = 0;
+     parser->parsed_count = 0;
+     parser->state = VAPS_MULTIPLIER;
 }
 
-VimCommandState_t vim_action_from_string(const int* string, VimAction_t* action, VimMode_t vim_mode,
-                                         Buffer_t* buffer, Point_t* cursor, Point_t* visual_start,
-                                         VimFindCharState_t* find_char_state, bool recording_macro)
+bool vim_action_parser_push(VimActionParser_t* parser, int key)
 {
-     int tmp[BUFSIZ];
-     bool visual_mode = false;
-     bool get_motion = true;
-     VimAction_t built_action = {};
-
-     built_action.multiplier = 1;
-     built_action.motion.multiplier = 1;
-
-     // get multiplier if there is one
-     const int* itr = string;
-     while(*itr && *itr >= 0 && *itr <= 255 && isdigit(*itr)) itr++;
-     if(itr != string){
-          int64_t len = itr - string;
-          memcpy(tmp, string, len * sizeof(*tmp));
-          tmp[len] = 0;
-          built_action.multiplier = itoi(tmp);
-
-          if(built_action.multiplier == 0){
-               // it's actually just a motion to move to the beginning of the line!
-               built_action.end_in_vim_mode = vim_mode;
-               built_action.multiplier = 1;
-               built_action.change.type = VCT_MOTION;
-               built_action.motion.type = VMT_BEGINNING_OF_LINE_HARD;
-               *action = built_action;
-               return VCS_COMPLETE;
-          }
-     }
+     if(parser->key_count >= VIM_ACTION_PARSER_MAX_KEYS) return false;
+     parser->keys[parser->key_count] = key;
+     parser->key_count++;
+     return true;
+}
 
-     // set motions early if visual mode, allowing them to be overriden by any action that wants to
-     if(vim_mode == VM_VISUAL_RANGE){
-          visual_mode = true;
-          get_motion = false;
-          built_action.motion.type = VMT_VISUAL_RANGE;
-          built_action.motion.visual_length = ce_compute_length(buffer, *visual_start, *cursor) - 1;
-          built_action.motion.visual_start_after = ce_point_after(*visual_start, *cursor);
-     }else if(vim_mode == VM_VISUAL_LINE){
-          visual_mode = true;
-          get_motion = false;
-          built_action.motion.type = VMT_VISUAL_LINE;
-          built_action.motion.visual_lines = visual_start->y - cursor->y;
-          built_action.motion.visual_start_after = ce_point_after(*visual_start, *cursor);
+VimCommandState_t vim_action_parser_parse(VimActionParser_t* parser, VimAction_t* action, VimMode_t vim_mode,
+                                          Buffer_t* buffer, Point_t* cursor, Point_t* visual_start,
+                                          VimFindCharState_t* find_char_state, bool recording_macro)
+{
+     VimAction_t* built_action = &parser->action;
+
+     if(parser->parsed_count == 0){
+          *built_action = (VimAction_t){};
+          built_action->multiplier = 1;
+          built_action->motion.multiplier = 1;
+          parser->state = VAPS_MULTIPLIER;
+          parser->get_motion = true;
+          parser->digit_count = 0;
+          parser->change_char = 0;
+          parser->motion_char = 0;
      }
 
-     int change_char = *itr;
-
-     // check for yank registers
-     if(*itr == '"'){
-          itr++;
+     while(parser->parsed_count < parser->key_count){
+          int key = parser->keys[parser->parsed_count];
+          parser->parsed_count++;
 
-          if(*itr == '\0'){
-               return VCS_CONTINUE;
-          } else if(!isprint(*itr)){
+          switch(parser->state){
+          default:
                return VCS_INVALID;
-          }
+          case VAPS_MULTIPLIER:
+               // get multiplier if there is one
+               if(isdigit_key(key)){
+                    if(parser->digit_count == 0 && key == '0'){
+                         // it's actually just a motion to move to the beginning of the line!
+                         built_action->end_in_vim_mode = vim_mode;
+                         built_action->change.type = VCT_MOTION;
+                         built_action->motion.type = VMT_BEGINNING_OF_LINE_HARD;
+                         *action = *built_action;
+                         return VCS_COMPLETE;
+                    }
 
-          built_action.change.reg = *itr;
-          itr++;
-     }
+                    if(parser->digit_count == 0) built_action->multiplier = 0;
+                    built_action->multiplier = built_action->multiplier * 10 + (key - '0');
+                    parser->digit_count++;
+                    break;
+               }
 
-     // get the change
-     change_char = *itr;
-     switch(*itr){
-     default:
-          built_action.end_in_vim_mode = vim_mode;
-          built_action.change.type = VCT_MOTION;
-          itr--;
-          if(visual_mode) get_motion = true; // if we are just executing a motion, use override the built motion
-          break;
-     case '.':
-          built_action.change.type = VCT_REPEAT;
-          built_action.motion.type = VMT_NONE;
-          get_motion = false;
-          break;
-     case 'u':
-          built_action.change.type = VCT_UNDO;
-          built_action.motion.type = VMT_NONE;
-          get_motion = false;
-          break;
-     case KEY_REDO:
-          built_action.change.type = VCT_REDO;
-          built_action.motion.type = VMT_NONE;
-          get_motion = false;
-          break;
-     case 'd':
-          built_action.change.type = VCT_DELETE;
-          built_action.yank = true;
-          break;
-     case 'D':
-          built_action.change.type = VCT_DELETE;
-          built_action.motion.type = VMT_END_OF_LINE_HARD;
-          built_action.yank = true;
-          get_motion = false;
-          break;
-     case 'c':
-          built_action.change.type = VCT_DELETE;
-          built_action.end_in_vim_mode = VM_INSERT;
-          built_action.yank = true;
-          break;
-     case 'C':
-          built_action.change.type = VCT_DELETE;
-          built_action.motion.type = VMT_END_OF_LINE_HARD;
-          built_action.end_in_vim_mode = VM_INSERT;
-          built_action.yank = true;
-          get_motion = false;
-          break;
-     case 'a':
-          if(vim_mode == VM_VISUAL_RANGE) { // wait for aw in visual range mode
-               built_action.change.type = VCT_MOTION;
-               built_action.end_in_vim_mode = vim_mode;
-               itr--; // back up so this counts as a motion
-               get_motion = true;
-               break;
-          }
-          built_action.change.type = VCT_MOTION;
-          built_action.motion.type = VMT_RIGHT;
-          built_action.end_in_vim_mode = VM_INSERT;
-          get_motion = false;
-          break;
-     case 'A':
-          built_action.change.type = VCT_MOTION;
-          built_action.motion.type = VMT_END_OF_LINE_PASSED;
-          built_action.end_in_vim_mode = VM_INSERT;
-          get_motion = false;
-          break;
-     case 's':
-          built_action.change.type = VCT_DELETE;
-          built_action.end_in_vim_mode = VM_INSERT;
-          get_motion = false;
-          break;
-     case 'S':
-          built_action.change.type = VCT_SUBSTITUTE;
-          break;
-     case 'i':
-          if(vim_mode == VM_VISUAL_RANGE) { // wait for iw in visual range mode
-               built_action.change.type = VCT_MOTION;
-               built_action.end_in_vim_mode = vim_mode;
-               itr--; // back up so this counts as a motion
-               get_motion = true;
-               break;
-          }
-          built_action.end_in_vim_mode = VM_INSERT;
-          get_motion = false;
-          break;
-     case 'v':
-          built_action.end_in_vim_mode = VM_VISUAL_RANGE;
-          get_motion = false;
-          break;
-     case 'V':
-          built_action.end_in_vim_mode = VM_VISUAL_LINE;
-          get_motion = false;
-          break;
-     case 'I':
-          built_action.change.type = VCT_MOTION;
-          built_action.motion.type = VMT_BEGINNING_OF_LINE_SOFT;
-          built_action.end_in_vim_mode = VM_INSERT;
-          get_motion = false;
-          break;
-     case 'x':
-          built_action.change.type = VCT_DELETE;
-          get_motion = false;
-          if(visual_mode) get_motion = false;
-          break;
-     case 'r':
-          built_action.change.type = VCT_CHANGE_CHAR;
-          built_action.change.change_char = *(++itr);
-          if(!built_action.change.change_char){
-               return VCS_CONTINUE;
-          }
-          if(!isprint(built_action.change.change_char)){
-               if(built_action.change.change_char == KEY_ENTER){
-                    built_action.change.change_char = NEWLINE;
-               }else{
-                    return VCS_INVALID;
+               parser->digit_count = 0;
+
+               // set motions early if visual mode, allowing them to be overriden by any action that wants to
+               if(vim_mode == VM_VISUAL_RANGE){
+                    parser->get_motion = false;
+                    built_action->motion.type = VMT_VISUAL_RANGE;
+                    built_action->motion.visual_length = ce_compute_length(buffer, *visual_start, *cursor) - 1;
+                    built_action->motion.visual_start_after = ce_point_after(*visual_start, *cursor);
+               }else if(vim_mode == VM_VISUAL_LINE){
+                    parser->get_motion = false;
+                    built_action->motion.type = VMT_VISUAL_LINE;
+                    built_action->motion.visual_lines = visual_start->y - cursor->y;
+                    built_action->motion.visual_start_after = ce_point_after(*visual_start, *cursor);
+               }else if(vim_mode == VM_VISUAL_BLOCK){
+                    parser->get_motion = false;
+                    built_action->motion.type = VMT_VISUAL_BLOCK;
+                    built_action->motion.visual_block_lines = visual_start->y - cursor->y;
+                    built_action->motion.visual_block_columns = visual_start->x - cursor->x;
+               }
+
+               // check for yank registers
+               if(key == '"'){
+                    parser->state = VAPS_REGISTER;
+                    break;
                }
-          }
-          get_motion = false;
-          break;
-     case 'g':
-     {
-          built_action.end_in_vim_mode = vim_mode;
-          char next_ch = *(itr + 1);
-          if(next_ch == 'c'){
-               built_action.change.type = VCT_COMMENT;
-               built_action.end_in_vim_mode = VM_NORMAL;
-          }else if(next_ch == 'u'){
-               built_action.change.type = VCT_UNCOMMENT;
-               built_action.end_in_vim_mode = VM_NORMAL;
-          }else if(next_ch == 0){
-               return VCS_CONTINUE;
-          }else{
-               built_action.change.type = VCT_MOTION;
-               if(visual_mode) get_motion = true;
-          }
-     } break;
-     case 'p':
-          if(vim_mode == VM_VISUAL_RANGE || vim_mode == VM_VISUAL_LINE){
-               built_action.change.type = VCT_SUBSTITUTE;
-          }else{
-               built_action.change.type = VCT_PASTE_AFTER;
-               get_motion = false;
-          }
-          break;
-     case 'P':
-          if(vim_mode == VM_VISUAL_RANGE || vim_mode == VM_VISUAL_LINE){
-               built_action.change.type = VCT_SUBSTITUTE;
-          }else{
-               built_action.change.type = VCT_PASTE_BEFORE;
-               get_motion = false;
-          }
-          break;
-     case 'y':
-          built_action.change.type = VCT_YANK;
-          break;
-     case 'Y':
-          built_action.change.type = VCT_YANK;
-          built_action.motion.type = VMT_END_OF_LINE_HARD;
-          get_motion = false;
-          break;
-     case '>':
-          built_action.change.type = VCT_INDENT;
-          built_action.end_in_vim_mode = vim_mode;
-          break;
-     case '<':
-          built_action.change.type = VCT_UNINDENT;
-          built_action.end_in_vim_mode = vim_mode;
-          break;
-     case '~':
-          built_action.change.type = VCT_FLIP_CASE;
-          break;
-     case ';':
-          built_action.change.type = VCT_MOTION;
-          built_action.motion.type = find_char_state->motion_type;
-          get_motion = false;
-          break;
-     case ',':
-          built_action.change.type = VCT_MOTION;
 
-          // reverse the motion
-          switch(find_char_state->motion_type){
-          default:
-               break;
-          case VMT_FIND_NEXT_MATCHING_CHAR:
-               built_action.motion.type = VMT_FIND_PREV_MATCHING_CHAR;
+               parser->state = VAPS_CHANGE;
+               parser->parsed_count--; // re-parse this key as the change
                break;
-          case VMT_FIND_PREV_MATCHING_CHAR:
-               built_action.motion.type = VMT_FIND_NEXT_MATCHING_CHAR;
+          case VAPS_REGISTER:
+               if(!isprint(key)) return VCS_INVALID;
+               built_action->change.reg = key;
+               parser->state = VAPS_CHANGE;
                break;
-          case VMT_TO_NEXT_MATCHING_CHAR:
-               built_action.motion.type = VMT_TO_PREV_MATCHING_CHAR;
-               break;
-          case VMT_TO_PREV_MATCHING_CHAR:
-               built_action.motion.type = VMT_TO_NEXT_MATCHING_CHAR;
-               break;
-          }
-          get_motion = false;
-          break;
-     case 'J':
-          built_action.motion.type = VMT_END_OF_LINE_HARD;
-          built_action.change.type = VCT_JOIN_LINE;
-          get_motion = false;
-          break;
-     case 'O':
-          if(visual_mode){
-               built_action.motion.type = VMT_VISUAL_SWAP_WITH_CURSOR;
-               built_action.end_in_vim_mode = vim_mode;
-          }else{
-               built_action.change.type = VCT_OPEN_ABOVE;
-               built_action.end_in_vim_mode = VM_INSERT;
-          }
-          get_motion = false;
-          break;
-     case 'o':
-          if(visual_mode){
-               built_action.motion.type = VMT_VISUAL_SWAP_WITH_CURSOR;
-               built_action.end_in_vim_mode = vim_mode;
-          }else{
-               built_action.change.type = VCT_OPEN_BELOW;
-               built_action.end_in_vim_mode = VM_INSERT;
-          }
-          get_motion = false;
-          break;
-     case 'q':
-          built_action.change.type = VCT_RECORD_MACRO;
-          if(!recording_macro){
-               built_action.change.reg = *(++itr);
-               if(!built_action.change.reg){
-                    return VCS_CONTINUE;
-               }
-               if(!isprint(built_action.change.reg)){
-                    return VCS_INVALID;
-               }
-          }
-          get_motion = false;
-          break;
-     case '@':
-          built_action.change.type = VCT_PLAY_MACRO;
-          built_action.change.reg = *(++itr);
-          if(!built_action.change.reg){
-               return VCS_CONTINUE;
-          }
-          if(!isprint(built_action.change.reg)){
-               return VCS_INVALID;
-          }
-          get_motion = false;
-          break;
-     case '%':
-          built_action.change.type = VCT_MOTION;
-          built_action.motion.type = VMT_MATCHING_PAIR;
-          built_action.end_in_vim_mode = vim_mode;
-          get_motion = false;
-          break;
-     case '*':
-          built_action.change.type = VCT_MOTION;
-          built_action.motion.type = VMT_SEARCH_WORD_UNDER_CURSOR;
-          built_action.motion.search_direction = CE_DOWN;
-          built_action.end_in_vim_mode = vim_mode;
-          get_motion = false;
-          break;
-     case '#':
-          built_action.change.type = VCT_MOTION;
-          built_action.motion.type = VMT_SEARCH_WORD_UNDER_CURSOR;
-          built_action.motion.search_direction = CE_UP;
-          built_action.end_in_vim_mode = vim_mode;
-          get_motion = false;
-          break;
-     case 'n':
-          built_action.change.type = VCT_MOTION;
-          built_action.motion.type = VMT_SEARCH;
-          built_action.motion.search_direction = CE_DOWN;
-          built_action.end_in_vim_mode = vim_mode;
-          get_motion = false;
-          break;
-     case 'N':
-          built_action.change.type = VCT_MOTION;
-          built_action.motion.type = VMT_SEARCH;
-          built_action.motion.search_direction = CE_UP;
-          built_action.end_in_vim_mode = vim_mode;
-          get_motion = false;
-          break;
-     case KEY_ENTER:
-          built_action.change.type = VCT_SET_MARK;
-          built_action.change.reg = '0';
-          get_motion = false;
-          break;
-     case 'm':
-          built_action.change.type = VCT_SET_MARK;
-          built_action.change.reg = *(++itr);
-          if(!built_action.change.reg){
-               return VCS_CONTINUE;
-          }
-          if(!isprint(built_action.change.reg)){
-               return VCS_INVALID;
-          }
-          get_motion = false;
-          break;
-     case '\'':
-          built_action.change.type = VCT_MOTION;
-          built_action.motion.type = VMT_GOTO_MARK;
-          built_action.motion.reg = *(++itr);
-          if(!built_action.motion.reg){
-               return VCS_CONTINUE;
-          }
-          if(!isprint(built_action.motion.reg)){
-               return VCS_INVALID;
-          }
-          get_motion = false;
-          break;
-     case ' ':
-          built_action.change.type = VCT_MOTION;
-          built_action.motion.type = VMT_GOTO_MARK;
-          built_action.motion.reg = '0';
-          get_motion = false;
-          break;
-     }
+          case VAPS_CHANGE:
+          {
+               bool visual_mode = (vim_mode == VM_VISUAL_RANGE || vim_mode == VM_VISUAL_LINE || vim_mode == VM_VISUAL_BLOCK);
+               parser->change_char = key;
 
-     if(get_motion){
-          // get the motion multiplier
-          itr++;
-          const int* start_itr = itr;
-          while(*itr && isdigit(*itr)) itr++;
-          if(itr != start_itr){
-               int64_t len = itr - start_itr;
-               memcpy(tmp, start_itr, len * sizeof(*tmp));
-               tmp[len] = 0;
-               built_action.motion.multiplier = itoi(tmp);
-
-               if(built_action.motion.multiplier == 0){
-                    built_action.motion.multiplier = 1;
-                    itr--;
-               }
-          }
+               // get the change
+               switch(key){
+               default:
+                    built_action->end_in_vim_mode = vim_mode;
+                    built_action->change.type = VCT_MOTION;
+                    parser->parsed_count--; // back up so this counts as a motion
+                    parser->get_motion = true; // if we are just executing a motion, use override the built motion
+                    break;
+               case '.':
+                    built_action->change.type = VCT_REPEAT;
+                    built_action->motion.type = VMT_NONE;
+                    parser->get_motion = false;
+                    break;
+               case 'u':
+                    built_action->change.type = VCT_UNDO;
+                    built_action->motion.type = VMT_NONE;
+                    parser->get_motion = false;
+                    break;
+               case KEY_REDO:
+                    built_action->change.type = VCT_REDO;
+                    built_action->motion.type = VMT_NONE;
+                    parser->get_motion = false;
+                    break;
+               case 'd':
+                    built_action->change.type = VCT_DELETE;
+                    built_action->yank = true;
+                    break;
+               case 'D':
+                    built_action->change.type = VCT_DELETE;
+                    built_action->motion.type = VMT_END_OF_LINE_HARD;
+                    built_action->yank = true;
+                    parser->get_motion = false;
+                    break;
+               case 'c':
+                    built_action->change.type = VCT_DELETE;
+                    built_action->end_in_vim_mode = VM_INSERT;
+                    built_action->yank = true;
+                    break;
+               case 'C':
+                    built_action->change.type = VCT_DELETE;
+                    built_action->motion.type = VMT_END_OF_LINE_HARD;
+                    built_action->end_in_vim_mode = VM_INSERT;
+                    built_action->yank = true;
+                    parser->get_motion = false;
+                    break;
+               case 'a':
+                    if(vim_mode == VM_VISUAL_RANGE) { // wait for aw in visual range mode
+                         built_action->change.type = VCT_MOTION;
+                         built_action->end_in_vim_mode = vim_mode;
+                         parser->parsed_count--; // back up so this counts as a motion
+                         parser->get_motion = true;
+                         break;
+                    }
+                    built_action->change.type = VCT_MOTION;
+                    built_action->motion.type = VMT_RIGHT;
+                    built_action->end_in_vim_mode = VM_INSERT;
+                    parser->get_motion = false;
+                    break;
+               case 'A':
+                    if(vim_mode == VM_VISUAL_BLOCK){
+                         built_action->change.type = VCT_BLOCK_APPEND;
+                         built_action->end_in_vim_mode = VM_INSERT;
+                         parser->get_motion = false;
+                         break;
+                    }
+                    built_action->change.type = VCT_MOTION;
+                    built_action->motion.type = VMT_END_OF_LINE_PASSED;
+                    built_action->end_in_vim_mode = VM_INSERT;
+                    parser->get_motion = false;
+                    break;
+               case 's':
+                    built_action->change.type = VCT_DELETE;
+                    built_action->end_in_vim_mode = VM_INSERT;
+                    parser->get_motion = false;
+                    break;
+               case 'S':
+                    built_action->change.type = VCT_SUBSTITUTE;
+                    break;
+               case 'i':
+                    if(vim_mode == VM_VISUAL_RANGE) { // wait for iw in visual range mode
+                         built_action->change.type = VCT_MOTION;
+                         built_action->end_in_vim_mode = vim_mode;
+                         parser->parsed_count--; // back up so this counts as a motion
+                         parser->get_motion = true;
+                         break;
+                    }
+                    built_action->end_in_vim_mode = VM_INSERT;
+                    parser->get_motion = false;
+                    break;
+               case 'v':
+                    built_action->end_in_vim_mode = VM_VISUAL_RANGE;
+                    parser->get_motion = false;
+                    break;
+               case 'V':
+                    built_action->end_in_vim_mode = VM_VISUAL_LINE;
+                    parser->get_motion = false;
+                    break;
+               case KEY_VISUAL_BLOCK:
+                    built_action->end_in_vim_mode = VM_VISUAL_BLOCK;
+                    parser->get_motion = false;
+                    break;
+               case 'I':
+                    if(vim_mode == VM_VISUAL_BLOCK){
+                         built_action->change.type = VCT_BLOCK_INSERT;
+                         built_action->end_in_vim_mode = VM_INSERT;
+                         parser->get_motion = false;
+                         break;
+                    }
+                    built_action->change.type = VCT_MOTION;
+                    built_action->motion.type = VMT_BEGINNING_OF_LINE_SOFT;
+                    built_action->end_in_vim_mode = VM_INSERT;
+                    parser->get_motion = false;
+                    break;
+               case 'x':
+                    built_action->change.type = VCT_DELETE;
+                    parser->get_motion = false;
+                    break;
+               case 'r':
+                    built_action->change.type = VCT_CHANGE_CHAR;
+                    parser->state = VAPS_CHANGE_ARG;
+                    continue;
+               case 'g':
+                    built_action->end_in_vim_mode = vim_mode;
+                    parser->state = VAPS_CHANGE_ARG;
+                    continue;
+               case 'p':
+                    if(visual_mode){
+                         built_action->change.type = VCT_SUBSTITUTE;
+                    }else{
+                         built_action->change.type = VCT_PASTE_AFTER;
+                         parser->get_motion = false;
+                    }
+                    break;
+               case 'P':
+                    if(visual_mode){
+                         built_action->change.type = VCT_SUBSTITUTE;
+                    }else{
+                         built_action->change.type = VCT_PASTE_BEFORE;
+                         parser->get_motion = false;
+                    }
+                    break;
+               case 'y':
+                    built_action->change.type = VCT_YANK;
+                    break;
+               case 'Y':
+                    built_action->change.type = VCT_YANK;
+                    built_action->motion.type = VMT_END_OF_LINE_HARD;
+                    parser->get_motion = false;
+                    break;
+               case '>':
+                    built_action->change.type = VCT_INDENT;
+                    built_action->end_in_vim_mode = vim_mode;
+                    break;
+               case '<':
+                    built_action->change.type = VCT_UNINDENT;
+                    built_action->end_in_vim_mode = vim_mode;
+                    break;
+               case '~':
+                    built_action->change.type = VCT_FLIP_CASE;
+                    break;
+               case ';':
+                    built_action->change.type = VCT_MOTION;
+                    built_action->motion.type = find_char_state->motion_type;
+                    parser->get_motion = false;
+                    break;
+               case ',':
+                    built_action->change.type = VCT_MOTION;
 
-          // get the motion
-          switch(*itr){
-          default:
-               return VCS_INVALID;
-          case '\0':
-               return VCS_CONTINUE;
-          case 'h':
-          case KEY_LEFT:
-               built_action.motion.type = VMT_LEFT;
-               break;
-          case 'j':
-          case KEY_DOWN:
-               if(built_action.change.type == VCT_MOTION){
-                    built_action.motion.type = VMT_DOWN;
-               }else{
-                    built_action.motion.type = VMT_LINE_DOWN;
+                    // reverse the motion
+                    switch(find_char_state->motion_type){
+                    default:
+                         break;
+                    case VMT_FIND_NEXT_MATCHING_CHAR:
+                         built_action->motion.type = VMT_FIND_PREV_MATCHING_CHAR;
+                         break;
+                    case VMT_FIND_PREV_MATCHING_CHAR:
+                         built_action->motion.type = VMT_FIND_NEXT_MATCHING_CHAR;
+                         break;
+                    case VMT_TO_NEXT_MATCHING_CHAR:
+                         built_action->motion.type = VMT_TO_PREV_MATCHING_CHAR;
+                         break;
+                    case VMT_TO_PREV_MATCHING_CHAR:
+                         built_action->motion.type = VMT_TO_NEXT_MATCHING_CHAR;
+                         break;
+                    }
+                    parser->get_motion = false;
+                    break;
+               case 'J':
+                    built_action->motion.type = VMT_END_OF_LINE_HARD;
+                    built_action->change.type = VCT_JOIN_LINE;
+                    parser->get_motion = false;
+                    break;
+               case 'O':
+                    if(visual_mode){
+                         built_action->motion.type = VMT_VISUAL_SWAP_WITH_CURSOR;
+                         built_action->end_in_vim_mode = vim_mode;
+                    }else{
+                         built_action->change.type = VCT_OPEN_ABOVE;
+                         built_action->end_in_vim_mode = VM_INSERT;
+                    }
+                    parser->get_motion = false;
+                    break;
+               case 'o':
+                    if(visual_mode){
+                         built_action->motion.type = VMT_VISUAL_SWAP_WITH_CURSOR;
+                         built_action->end_in_vim_mode = vim_mode;
+                    }else{
+                         built_action->change.type = VCT_OPEN_BELOW;
+                         built_action->end_in_vim_mode = VM_INSERT;
+                    }
+                    parser->get_motion = false;
+                    break;
+               case 'q':
+                    built_action->change.type = VCT_RECORD_MACRO;
+                    parser->get_motion = false;
+                    if(!recording_macro){
+                         parser->state = VAPS_CHANGE_ARG;
+                         continue;
+                    }
+                    break;
+               case '@':
+                    built_action->change.type = VCT_PLAY_MACRO;
+                    parser->state = VAPS_CHANGE_ARG;
+                    continue;
+               case '%':
+                    built_action->change.type = VCT_MOTION;
+                    built_action->motion.type = VMT_MATCHING_PAIR;
+                    built_action->end_in_vim_mode = vim_mode;
+                    parser->get_motion = false;
+                    break;
+               case '*':
+                    built_action->change.type = VCT_MOTION;
+                    built_action->motion.type = VMT_SEARCH_WORD_UNDER_CURSOR;
+                    built_action->motion.search_direction = CE_DOWN;
+                    built_action->end_in_vim_mode = vim_mode;
+                    parser->get_motion = false;
+                    break;
+               case '#':
+                    built_action->change.type = VCT_MOTION;
+                    built_action->motion.type = VMT_SEARCH_WORD_UNDER_CURSOR;
+                    built_action->motion.search_direction = CE_UP;
+                    built_action->end_in_vim_mode = vim_mode;
+                    parser->get_motion = false;
+                    break;
+               case 'n':
+                    built_action->change.type = VCT_MOTION;
+                    built_action->motion.type = VMT_SEARCH;
+                    built_action->motion.search_direction = CE_DOWN;
+                    built_action->end_in_vim_mode = vim_mode;
+                    parser->get_motion = false;
+                    break;
+               case 'N':
+                    built_action->change.type = VCT_MOTION;
+                    built_action->motion.type = VMT_SEARCH;
+                    built_action->motion.search_direction = CE_UP;
+                    built_action->end_in_vim_mode = vim_mode;
+                    parser->get_motion = false;
+                    break;
+               case KEY_ENTER:
+                    built_action->change.type = VCT_SET_MARK;
+                    built_action->change.reg = '0';
+                    parser->get_motion = false;
+                    break;
+               case 'm':
+                    built_action->change.type = VCT_SET_MARK;
+                    parser->state = VAPS_CHANGE_ARG;
+                    continue;
+               case '\'':
+                    built_action->change.type = VCT_MOTION;
+                    built_action->motion.type = VMT_GOTO_MARK;
+                    parser->state = VAPS_CHANGE_ARG;
+                    continue;
+               case ' ':
+                    built_action->change.type = VCT_MOTION;
+                    built_action->motion.type = VMT_GOTO_MARK;
+                    built_action->motion.reg = '0';
+                    parser->get_motion = false;
+                    break;
                }
-               break;
-          case 'k':
-          case KEY_UP:
-               if(built_action.change.type == VCT_MOTION){
-                    built_action.motion.type = VMT_UP;
-               }else{
-                    built_action.motion.type = VMT_LINE_UP;
+
+               if(!parser->get_motion){
+                    *action = *built_action;
+                    return VCS_COMPLETE;
                }
+
+               parser->state = VAPS_MOTION_MULTIPLIER;
+          } break;
+          case VAPS_CHANGE_ARG:
+               // the change char needs one more key to complete
+               switch(parser->change_char){
+               default:
+                    return VCS_INVALID;
+               case 'r':
+                    built_action->change.change_char = key;
+                    if(!isprint(built_action->change.change_char)){
+                         if(built_action->change.change_char == KEY_ENTER){
+                              built_action->change.change_char = NEWLINE;
+                         }else{
+                              return VCS_INVALID;
+                         }
+                    }
+                    parser->get_motion = false;
+                    break;
+               case 'q':
+               case '@':
+               case 'm':
+                    built_action->change.reg = key;
+                    if(!isprint(built_action->change.reg)) return VCS_INVALID;
+                    parser->get_motion = false;
+                    break;
+               case '\'':
+                    built_action->motion.reg = key;
+                    if(!isprint(built_action->motion.reg)) return VCS_INVALID;
+                    parser->get_motion = false;
+                    break;
+               case 'g':
+               {
+                    char next_ch = key;
+                    if(next_ch == 'c'){
+                         built_action->change.type = VCT_COMMENT;
+                         built_action->end_in_vim_mode = VM_NORMAL;
+                    }else if(next_ch == 'u'){
+                         built_action->change.type = VCT_UNCOMMENT;
+                         built_action->end_in_vim_mode = VM_NORMAL;
+                    }else{
+                         built_action->change.type = VCT_MOTION;
+                         if(vim_mode == VM_VISUAL_RANGE || vim_mode == VM_VISUAL_LINE || vim_mode == VM_VISUAL_BLOCK) parser->get_motion = true;
+                    }
+
+                    // the key after 'g' is also the start of the motion
+                    parser->parsed_count--;
+               } break;
+               }
+
+               if(!parser->get_motion){
+                    *action = *built_action;
+                    return VCS_COMPLETE;
+               }
+
+               parser->state = VAPS_MOTION_MULTIPLIER;
                break;
-          case KEY_RIGHT:
-          case 'l':
-               built_action.motion.type = VMT_RIGHT;
-               break;
-          case 'w':
-               built_action.motion.type = VMT_WORD_LITTLE;
-               break;
-          case 'W':
-               built_action.motion.type = VMT_WORD_BIG;
-               break;
-          case 'b':
-               built_action.motion.type = VMT_WORD_BEGINNING_LITTLE;
-               break;
-          case 'B':
-               built_action.motion.type = VMT_WORD_BEGINNING_BIG;
-               break;
-          case 'e':
-               built_action.motion.type = VMT_WORD_END_LITTLE;
-               break;
-          case 'E':
-               built_action.motion.type = VMT_WORD_END_BIG;
-               break;
-          case KEY_NPAGE:
-               built_action.motion.type = VMT_HALF_PAGE_UP;
-               break;
-          case KEY_PPAGE:
-               built_action.motion.type = VMT_HALF_PAGE_DOWN;
-               break;
-          case 'H':
-               built_action.motion.type = VMT_SCREEN_TOP;
-               break;
-          case 'M':
-               built_action.motion.type = VMT_SCREEN_MIDDLE;
-               break;
-          case 'L':
-               built_action.motion.type = VMT_SCREEN_BOTTOM;
-               break;
-          case 'f':
-               built_action.motion.type = VMT_FIND_NEXT_MATCHING_CHAR;
-               built_action.motion.match_char = *(++itr);
-               if(!built_action.motion.match_char) return VCS_CONTINUE;
-               break;
-          case 'F':
-               built_action.motion.type = VMT_FIND_PREV_MATCHING_CHAR;
-               built_action.motion.match_char = *(++itr);
-               if(!built_action.motion.match_char) return VCS_CONTINUE;
-               break;
-          case 't':
-               built_action.motion.type = VMT_TO_NEXT_MATCHING_CHAR;
-               built_action.motion.match_char = *(++itr);
-               if(!built_action.motion.match_char) return VCS_CONTINUE;
-               break;
-          case 'T':
-               built_action.motion.type = VMT_TO_PREV_MATCHING_CHAR;
-               built_action.motion.match_char = *(++itr);
-               if(!built_action.motion.match_char) return VCS_CONTINUE;
-               break;
-          case '$':
-               built_action.motion.type = VMT_END_OF_LINE_HARD;
-               break;
-          case '^':
-               built_action.motion.type = VMT_BEGINNING_OF_LINE_SOFT;
-               break;
-          case '0':
-               built_action.motion.type = VMT_BEGINNING_OF_LINE_HARD;
+          case VAPS_MOTION_MULTIPLIER:
+               // get the motion multiplier, a leading 0 is the motion to the beginning of the line
+               if(isdigit_key(key) && (parser->digit_count > 0 || key != '0')){
+                    if(parser->digit_count == 0) built_action->motion.multiplier = 0;
+                    built_action->motion.multiplier = built_action->motion.multiplier * 10 + (key - '0');
+                    parser->digit_count++;
+                    break;
+               }
+
+               parser->state = VAPS_MOTION;
+               parser->parsed_count--; // re-parse this key as the motion
                break;
-          case 'i': // inside
-          {
-               char ch = *(++itr);
+          case VAPS_MOTION:
+               parser->motion_char = key;
 
-               switch(ch){
+               // get the motion
+               switch(key){
                default:
                     return VCS_INVALID;
-               case '\0':
-                    return VCS_CONTINUE;
+               case 'h':
+               case KEY_LEFT:
+                    built_action->motion.type = VMT_LEFT;
+                    break;
+               case 'j':
+               case KEY_DOWN:
+                    if(built_action->change.type == VCT_MOTION){
+                         built_action->motion.type = VMT_DOWN;
+                    }else{
+                         built_action->motion.type = VMT_LINE_DOWN;
+                    }
+                    break;
+               case 'k':
+               case KEY_UP:
+                    if(built_action->change.type == VCT_MOTION){
+                         built_action->motion.type = VMT_UP;
+                    }else{
+                         built_action->motion.type = VMT_LINE_UP;
+                    }
+                    break;
+               case KEY_RIGHT:
+               case 'l':
+                    built_action->motion.type = VMT_RIGHT;
+                    break;
                case 'w':
-                    built_action.motion.type = VMT_INSIDE_WORD_LITTLE;
+                    built_action->motion.type = VMT_WORD_LITTLE;
                     break;
                case 'W':
-                    built_action.motion.type = VMT_INSIDE_WORD_BIG;
+                    built_action->motion.type = VMT_WORD_BIG;
+                    break;
+               case 'b':
+                    built_action->motion.type = VMT_WORD_BEGINNING_LITTLE;
+                    break;
+               case 'B':
+                    built_action->motion.type = VMT_WORD_BEGINNING_BIG;
+                    break;
+               case 'e':
+                    built_action->motion.type = VMT_WORD_END_LITTLE;
+                    break;
+               case 'E':
+                    built_action->motion.type = VMT_WORD_END_BIG;
+                    break;
+               case KEY_NPAGE:
+                    built_action->motion.type = VMT_HALF_PAGE_UP;
+                    break;
+               case KEY_PPAGE:
+                    built_action->motion.type = VMT_HALF_PAGE_DOWN;
+                    break;
+               case 'H':
+                    built_action->motion.type = VMT_SCREEN_TOP;
+                    break;
+               case 'M':
+                    built_action->motion.type = VMT_SCREEN_MIDDLE;
+                    break;
+               case 'L':
+                    built_action->motion.type = VMT_SCREEN_BOTTOM;
+                    break;
+               case 'f':
+               case 'F':
+               case 't':
+               case 'T':
+               case 'i': // inside
+               case 'a': // around
+                    parser->state = VAPS_MOTION_ARG;
+                    continue;
+               case '$':
+                    built_action->motion.type = VMT_END_OF_LINE_HARD;
+                    break;
+               case '^':
+                    built_action->motion.type = VMT_BEGINNING_OF_LINE_SOFT;
+                    break;
+               case '0':
+                    built_action->motion.type = VMT_BEGINNING_OF_LINE_HARD;
+                    break;
+               case 'g':
+                    if(parser->change_char == 'g') {
+                         built_action->motion.type = VMT_BEGINNING_OF_FILE;
+                    }else{
+                         return VCS_INVALID;
+                    }
+               break;
+               case 'u':
+                    if(parser->change_char == 'g') {
+                         built_action->motion.type = VMT_LINE;
+                    }else{
+                         return VCS_INVALID;
+                    }
+               break;
+               case 'G':
+                    built_action->motion.type = VMT_END_OF_FILE;
+                    break;
+               case 'c':
+                    if(parser->change_char == 'c') {
+                         built_action->motion.type = VMT_LINE_SOFT;
+                    }else if(parser->change_char == 'g') {
+                         built_action->motion.type = VMT_LINE;
+                    }else{
+                         return VCS_INVALID;
+                    }
+                    break;
+               case 'd':
+               case 'y':
+               case '<':
+               case '>':
+                    if(parser->change_char == key) {
+                         built_action->motion.type = VMT_LINE;
+                    }else{
+                         return VCS_INVALID;
+                    }
                     break;
-               case '"':
-               case '\'':
-               case ')':
-               case '(':
                case '}':
+                    built_action->motion.type = VMT_NEXT_BLANK_LINE;
+                    break;
                case '{':
-               case '[':
-               case ']':
-                    built_action.motion.type = VMT_INSIDE_PAIR;
-                    built_action.motion.inside_pair = ch;
+                    built_action->motion.type = VMT_PREV_BLANK_LINE;
                     break;
                }
-          } break;
-          case 'a': // around
-          {
-               char ch = *(++itr);
 
-               switch(ch){
+               *action = *built_action;
+               return VCS_COMPLETE;
+          case VAPS_MOTION_ARG:
+               // the motion char needs one more key to complete
+               switch(parser->motion_char){
                default:
                     return VCS_INVALID;
-               case '\0':
-                    return VCS_CONTINUE;
-               case 'w':
-                    built_action.motion.type = VMT_AROUND_WORD_LITTLE;
+               case 'f':
+                    built_action->motion.type = VMT_FIND_NEXT_MATCHING_CHAR;
+                    built_action->motion.match_char = key;
                     break;
-               case 'W':
-                    built_action.motion.type = VMT_AROUND_WORD_BIG;
+               case 'F':
+                    built_action->motion.type = VMT_FIND_PREV_MATCHING_CHAR;
+                    built_action->motion.match_char = key;
                     break;
-               case '"':
-               case '\'':
-               case ')':
-               case '(':
-               case '}':
-               case '{':
-               case '[':
-               case ']':
-                    built_action.motion.type = VMT_AROUND_PAIR;
-                    built_action.motion.around_pair = ch;
+               case 't':
+                    built_action->motion.type = VMT_TO_NEXT_MATCHING_CHAR;
+                    built_action->motion.match_char = key;
                     break;
+               case 'T':
+                    built_action->motion.type = VMT_TO_PREV_MATCHING_CHAR;
+                    built_action->motion.match_char = key;
+                    break;
+               case 'i':
+               case 'a':
+               {
+                    bool inside = parser->motion_char == 'i';
+                    char ch = key;
+
+                    switch(ch){
+                    default:
+                         return VCS_INVALID;
+                    case 'w':
+                         built_action->motion.type = inside ? VMT_INSIDE_WORD_LITTLE : VMT_AROUND_WORD_LITTLE;
+                         break;
+                    case 'W':
+                         built_action->motion.type = inside ? VMT_INSIDE_WORD_BIG : VMT_AROUND_WORD_BIG;
+                         break;
+                    case '"':
+                    case '\'':
+                    case ')':
+                    case '(':
+                    case '}':
+                    case '{':
+                    case '[':
+                    case ']':
+                         if(inside){
+                              built_action->motion.type = VMT_INSIDE_PAIR;
+                              built_action->motion.inside_pair = ch;
+                         }else{
+                              built_action->motion.type = VMT_AROUND_PAIR;
+                              built_action->motion.around_pair = ch;
+                         }
+                         break;
+                    }
+               } break;
                }
-          } break;
-          case 'g':
-               if(change_char == 'g') {
-                    built_action.motion.type = VMT_BEGINNING_OF_FILE;
-               }else{
-                    return VCS_INVALID;
-               }
-          break;
-          case 'u':
-               if(change_char == 'g') {
-                    built_action.motion.type = VMT_LINE;
-               }else{
-                    return VCS_INVALID;
-               }
-          break;
-          case 'G':
-               built_action.motion.type = VMT_END_OF_FILE;
-               break;
-          case 'c':
-               if(change_char == 'c') {
-                    built_action.motion.type = VMT_LINE_SOFT;
-               }else if(change_char == 'g') {
-                    built_action.motion.type = VMT_LINE;
-               }else{
-                    return VCS_INVALID;
-               }
-               break;
-          case 'd':
-               if(change_char == 'd') {
-                    built_action.motion.type = VMT_LINE;
-               }else{
-                    return VCS_INVALID;
-               }
-               break;
-          case 'y':
-               if(change_char == 'y') {
-                    built_action.motion.type = VMT_LINE;
-               }else{
-                    return VCS_INVALID;
-               }
-               break;
-          case '<':
-               if(change_char == '<') {
-                    built_action.motion.type = VMT_LINE;
-               }else{
-                    return VCS_INVALID;
-               }
-               break;
-          case '>':
-               if(change_char == '>') {
-                    built_action.motion.type = VMT_LINE;
-               }else{
-                    return VCS_INVALID;
-               }
-               break;
-          case '}':
-               built_action.motion.type = VMT_NEXT_BLANK_LINE;
-               break;
-          case '{':
-               built_action.motion.type = VMT_PREV_BLANK_LINE;
-               break;
+
+               *action = *built_action;
+               return VCS_COMPLETE;
           }
      }
 
-     *action = built_action;
-     return VCS_COMPLETE;
+     return VCS_CONTINUE;
+}
+
+VimCommandState_t vim_action_from_string(const int* string, VimAction_t* action, VimMode_t vim_mode,
+                                         Buffer_t* buffer, Point_t* cursor, Point_t* visual_start,
+                                         VimFindCharState_t* find_char_state, bool recording_macro)
+{
+     VimActionParser_t parser;
+     vim_action_parser_reset(&parser);
+
+     VimCommandState_t command_state = VCS_CONTINUE;
+     while(*string && command_state == VCS_CONTINUE){
+          if(!vim_action_parser_push(&parser, *string)) return VCS_INVALID;
+          command_state = vim_action_parser_parse(&parser, action, vim_mode, buffer, cursor, visual_start,
+                                                  find_char_state, recording_macro);
+          string++;
+     }
+
+     return command_state;
 }
 
 static int ispunct_or_iswordchar(int c)
@@ -1304,6 +1571,19 @@ bool vim_action_get_range(VimAction_t* action, BufferView_t* view, Point_t* curs
           if(line > last_line) line = last_line;
           action_range->end.x = strlen(buffer->lines[line]);
           action_range->yank_mode = YANK_LINE;
+     }else if(action->motion.type == VMT_VISUAL_BLOCK){
+          // the block's corners, top left as the start and bottom right as the end
+          int64_t other_x = cursor->x + action->motion.visual_block_columns;
+          int64_t other_y = cursor->y + action->motion.visual_block_lines;
+          int64_t last_line = buffer->line_count - 1;
+          if(last_line < 0) return false;
+          if(other_y > last_line) other_y = last_line;
+
+          action_range->start = (Point_t){cursor->x < other_x ? cursor->x : other_x,
+                                          cursor->y < other_y ? cursor->y : other_y};
+          action_range->end = (Point_t){cursor->x > other_x ? cursor->x : other_x,
+                                        cursor->y > other_y ? cursor->y : other_y};
+          action_range->yank_mode = YANK_BLOCK;
      }else if(buffer->line_count){ // can't do motions without a buffer !
           int64_t multiplier = action->multiplier * action->motion.multiplier;
 
@@ -1821,6 +2101,268 @@ const char* get_comment_string(BufferFileType_t type)
      return NULL;
 }
 
+static BufferLineEdit_t* alloc_line_edits(const VimActionRange_t* action_range)
+{
+     int64_t line_count = (action_range->sorted_end->y - action_range->sorted_start->y) + 1;
+     BufferLineEdit_t* edits = malloc(line_count * sizeof(*edits));
+     if(!edits) ce_message("%s() failed to allocate line edits", __FUNCTION__);
+     return edits;
+}
+
+// insert string at each edit's column, committing all of the lines as a single change, takes ownership of edits.
+// Nothing is committed if there are no edits
+static bool insert_block_on_lines(Buffer_t* buffer, BufferCommitNode_t** commit_tail, Point_t cursor,
+                                  BufferLineEdit_t* edits, int64_t edit_count, const char* string,
+                                  BufferCommitChain_t chain)
+{
+     if(!edit_count){
+          free(edits);
+          return true;
+     }
+
+     int64_t string_len = strlen(string);
+     char* text = malloc(edit_count * string_len + 1);
+     if(!text){
+          free(edits);
+          return false;
+     }
+
+     for(int64_t i = 0; i < edit_count; ++i){
+          edits[i].length = string_len;
+          memcpy(text + i * string_len, string, string_len);
+     }
+     text[edit_count * string_len] = 0;
+
+     if(!ce_insert_block(buffer, edits, edit_count, text)){
+          free(edits);
+          free(text);
+          return false;
+     }
+
+     ce_commit_insert_block(commit_tail, cursor, cursor, edits, edit_count, text, chain);
+     return true;
+}
+
+// remove each edit from its line, committing all of the lines as a single change, takes ownership of edits.
+// Nothing is committed if there are no edits
+static bool remove_block_on_lines(Buffer_t* buffer, BufferCommitNode_t** commit_tail, Point_t cursor,
+                                  BufferLineEdit_t* edits, int64_t edit_count, BufferCommitChain_t chain)
+{
+     if(!edit_count){
+          free(edits);
+          return true;
+     }
+
+     char* text = ce_dupe_block(buffer, edits, edit_count);
+     if(!text || !ce_remove_block(buffer, edits, edit_count)){
+          free(edits);
+          free(text);
+          return false;
+     }
+
+     ce_commit_remove_block(commit_tail, cursor, cursor, edits, edit_count, text, chain);
+     return true;
+}
+
+// copy the block out as rows of equal width, lines that end inside the block are padded with spaces
+static char* dupe_visual_block(const Buffer_t* buffer, const VimActionRange_t* action_range)
+{
+     int64_t width = (action_range->end.x - action_range->start.x) + 1;
+     int64_t height = (action_range->end.y - action_range->start.y) + 1;
+
+     char* block = malloc(width * height + 1);
+     if(!block){
+          ce_message("%s() failed to alloc block", __FUNCTION__);
+          return NULL;
+     }
+
+     for(int64_t r = 0; r < height; ++r){
+          const char* line = buffer->lines[action_range->start.y + r];
+          char* row = block + r * width;
+          int64_t copy_len = (int64_t)(strlen(line)) - action_range->start.x;
+          if(copy_len < 0) copy_len = 0;
+          if(copy_len > width) copy_len = width;
+
+          if(copy_len) memcpy(row, line + action_range->start.x, copy_len);
+          memset(row + copy_len, ' ', width - copy_len);
+     }
+
+     block[width * height] = 0;
+     return block;
+}
+
+// one edit per line for the part of the block that exists on that line
+static BufferLineEdit_t* visual_block_line_edits(const Buffer_t* buffer, const VimActionRange_t* action_range,
+                                                 int64_t* edit_count)
+{
+     BufferLineEdit_t* edits = alloc_line_edits(action_range);
+     if(!edits) return NULL;
+
+     *edit_count = 0;
+     for(int64_t i = action_range->start.y; i <= action_range->end.y; ++i){
+          int64_t line_len = strlen(buffer->lines[i]);
+          if(line_len <= action_range->start.x) continue;
+
+          int64_t end = action_range->end.x + 1;
+          if(end > line_len) end = line_len;
+
+          edits[*edit_count] = (BufferLineEdit_t){i, action_range->start.x, end - action_range->start.x};
+          (*edit_count)++;
+     }
+
+     return edits;
+}
+
+// the view's cursor takes the first line of the block, every other line that reaches the block gets a cursor
+// that only lasts for the next insert
+static void visual_block_setup_cursors(VimMultiCursor_t* multi_cursor, const Buffer_t* buffer,
+                                       const VimActionRange_t* action_range, int64_t column)
+{
+     vim_multi_cursor_clear(multi_cursor);
+
+     for(int64_t i = action_range->start.y + 1; i <= action_range->end.y; ++i){
+          int64_t line_len = strlen(buffer->lines[i]);
+          if(line_len < action_range->start.x) continue;
+          vim_multi_cursor_add(multi_cursor, (Point_t){column < line_len ? column : line_len, i});
+     }
+
+     multi_cursor->one_shot = true;
+}
+
+// paste each row of a block yank on its own line starting at column, padding lines that are too short
+static bool paste_visual_block(Buffer_t* buffer, BufferCommitNode_t** commit_tail, Point_t* cursor,
+                               const VimYankNode_t* yank, int64_t column, BufferCommitChain_t chain)
+{
+     if(!buffer->line_count) return false;
+
+     int64_t width = yank->block_width;
+     int64_t height = yank->block_height;
+     Point_t undo_cursor = *cursor;
+
+     // add any lines the block hangs off the end of the buffer
+     int64_t missing_lines = (cursor->y + height) - buffer->line_count;
+     if(missing_lines > 0){
+          int64_t last_line = buffer->line_count - 1;
+          Point_t end_of_buffer = {strlen(buffer->lines[last_line]), last_line};
+          char* newlines = malloc(missing_lines + 1);
+          if(!newlines) return false;
+          memset(newlines, NEWLINE, missing_lines);
+          newlines[missing_lines] = 0;
+
+          if(!ce_insert_string(buffer, end_of_buffer, newlines)){
+               free(newlines);
+               return false;
+          }
+
+          ce_commit_insert_string(commit_tail, end_of_buffer, undo_cursor, undo_cursor, newlines, BCC_KEEP_GOING);
+     }
+
+     BufferLineEdit_t* edits = malloc(height * sizeof(*edits));
+     if(!edits) return false;
+
+     int64_t text_len = 0;
+     for(int64_t r = 0; r < height; ++r){
+          int64_t line = cursor->y + r;
+          int64_t line_len = strlen(buffer->lines[line]);
+          int64_t padding = (column > line_len) ? column - line_len : 0;
+          edits[r] = (BufferLineEdit_t){line, column - padding, padding + width};
+          text_len += padding + width;
+     }
+
+     char* text = malloc(text_len + 1);
+     if(!text){
+          free(edits);
+          return false;
+     }
+
+     char* itr = text;
+     for(int64_t r = 0; r < height; ++r){
+          int64_t padding = edits[r].length - width;
+          memset(itr, ' ', padding);
+          memcpy(itr + padding, yank->text + r * width, width);
+          itr += edits[r].length;
+     }
+     *itr = 0;
+
+     *cursor = (Point_t){column, cursor->y};
+
+     if(!ce_insert_block(buffer, edits, height, text)){
+          free(edits);
+          free(text);
+          return false;
+     }
+
+     ce_commit_insert_block(commit_tail, undo_cursor, *cursor, edits, height, text, chain);
+     return true;
+}
+
+static bool delete_visual_block(VimAction_t* action, Buffer_t* buffer, Point_t* cursor, VimState_t* vim_state,
+                                BufferCommitNode_t** commit_tail, VimBufferState_t* vim_buffer_state,
+                                const VimActionRange_t* action_range, BufferCommitChain_t chain)
+{
+     if(action->yank){
+          char* block = dupe_visual_block(buffer, action_range);
+          if(!block) return false;
+          vim_yank_add_block(&vim_state->yank_head, action->change.reg ? action->change.reg : '"', block,
+                             (action_range->end.x - action_range->start.x) + 1,
+                             (action_range->end.y - action_range->start.y) + 1);
+     }
+
+     int64_t edit_count = 0;
+     BufferLineEdit_t* edits = visual_block_line_edits(buffer, action_range, &edit_count);
+     if(!edits) return false;
+
+     if(!remove_block_on_lines(buffer, commit_tail, *cursor, edits, edit_count, chain)) return false;
+
+     *cursor = action_range->start;
+
+     // 'c' goes on to insert at the left edge of the block on every line
+     if(action->end_in_vim_mode == VM_INSERT){
+          visual_block_setup_cursors(&vim_buffer_state->multi_cursor, buffer, action_range, action_range->start.x);
+     }
+
+     return true;
+}
+
+// move the other cursors the same way the view's cursor moved to get into insert mode
+static void multi_cursor_enter_insert(VimAction_t* action, BufferView_t* view, const Point_t* cursor, VimState_t* vim_state,
+                                      VimBufferState_t* vim_buffer_state)
+{
+     VimMultiCursor_t* multi_cursor = &vim_buffer_state->multi_cursor;
+     multi_cursor->insert_start = *cursor;
+
+     // visual block inserts have already placed their cursors
+     if(action->change.type == VCT_NONE || multi_cursor->one_shot) return;
+
+     if(action->change.type != VCT_MOTION){
+          ce_message("multiple cursors only follow insert motions, clearing cursors");
+          vim_multi_cursor_clear(multi_cursor);
+          return;
+     }
+
+     Buffer_t* buffer = view->buffer;
+     for(int64_t i = 0; i < multi_cursor->count; ++i){
+          Point_t* location = multi_cursor->cursors + i;
+          if(location->y >= buffer->line_count) continue;
+
+          VimActionRange_t action_range;
+          if(!vim_action_get_range(action, view, location, vim_state, vim_buffer_state, &action_range)) continue;
+
+          *location = action_range.end;
+          int64_t line_len = strlen(buffer->lines[location->y]);
+          if(location->x > line_len) location->x = line_len;
+     }
+
+     // cursors on the same line may have landed on top of each other, like with 'A'
+     int64_t keep_count = 0;
+     for(int64_t i = 0; i < multi_cursor->count; ++i){
+          if(keep_count && ce_points_equal(multi_cursor->cursors[keep_count - 1], multi_cursor->cursors[i])) continue;
+          multi_cursor->cursors[keep_count] = multi_cursor->cursors[i];
+          keep_count++;
+     }
+     multi_cursor->count = keep_count;
+}
+
 bool vim_action_apply(VimAction_t* action, BufferView_t* view, Point_t* cursor, VimState_t* vim_state,
                       BufferCommitNode_t** commit_tail, VimBufferState_t* vim_buffer_state)
 {
@@ -1830,6 +2372,22 @@ bool vim_action_apply(VimAction_t* action, BufferView_t* view, Point_t* cursor,
 
      if(!vim_action_get_range(action, view, cursor, vim_state, vim_buffer_state, &action_range) ) return false;
 
+     // these changes only make sense over a contiguous range
+     if(action->motion.type == VMT_VISUAL_BLOCK){
+          switch(action->change.type){
+          default:
+               break;
+          case VCT_CHANGE_CHAR:
+          case VCT_PASTE_BEFORE:
+          case VCT_PASTE_AFTER:
+          case VCT_FLIP_CASE:
+          case VCT_JOIN_LINE:
+          case VCT_SUBSTITUTE:
+               ce_message("change is not supported in visual block mode");
+               return false;
+          }
+     }
+
      // perform action on range
      switch(action->change.type){
      default:
@@ -1850,6 +2408,10 @@ bool vim_action_apply(VimAction_t* action, BufferView_t* view, Point_t* cursor,
                cmd_itr++;
           }
 
+          multi_cursor_finish_insert(&vim_buffer_state->multi_cursor, buffer, commit_tail, vim_state->command_head, *cursor);
+
+          ce_keys_free(&vim_state->command_head);
+
           vim_enter_normal_mode(vim_state);
           if(*commit_tail) (*commit_tail)->commit.chain = BCC_STOP;
      } break;
@@ -1967,6 +2529,12 @@ bool vim_action_apply(VimAction_t* action, BufferView_t* view, Point_t* cursor,
           break;
      case VCT_DELETE:
      {
+          if(action->motion.type == VMT_VISUAL_BLOCK){
+               if(!delete_visual_block(action, buffer, cursor, vim_state, commit_tail, vim_buffer_state, &action_range,
+                                       chain)) return false;
+               break;
+          }
+
           *cursor = *action_range.sorted_start;
 
           bool nothing_after_open_brace = false;
@@ -2091,6 +2659,9 @@ bool vim_action_apply(VimAction_t* action, BufferView_t* view, Point_t* cursor,
                                        *action_range.sorted_start, *action_range.sorted_start, *action_range.sorted_start,
                                        strdup(yank->text), chain);
           } break;
+          case YANK_BLOCK:
+               if(!paste_visual_block(buffer, commit_tail, cursor, yank, cursor->x, chain)) return false;
+               break;
           case YANK_LINE:
           {
                size_t len = strlen(yank->text);
@@ -2144,6 +2715,11 @@ bool vim_action_apply(VimAction_t* action, BufferView_t* view, Point_t* cursor,
                                        strdup(yank->text), chain);
                ce_advance_cursor(buffer, cursor, yank_len);
           } break;
+          case YANK_BLOCK:
+          {
+               int64_t column = buffer->line_count && buffer->lines[cursor->y][0] ? cursor->x + 1 : 0;
+               if(!paste_visual_block(buffer, commit_tail, cursor, yank, column, chain)) return false;
+          } break;
           case YANK_LINE:
           {
                size_t len = strlen(yank->text);
@@ -2217,6 +2793,17 @@ bool vim_action_apply(VimAction_t* action, BufferView_t* view, Point_t* cursor,
      } break;
      case VCT_YANK:
      {
+          if(action->motion.type == VMT_VISUAL_BLOCK){
+               int64_t width = (action_range.end.x - action_range.start.x) + 1;
+               int64_t height = (action_range.end.y - action_range.start.y) + 1;
+               char* block = dupe_visual_block(buffer, &action_range);
+               if(!block) return false;
+
+               vim_yank_add_block(&vim_state->yank_head, '0', strdup(block), width, height);
+               vim_yank_add_block(&vim_state->yank_head, action->change.reg ? action->change.reg : '"', block, width, height);
+               break;
+          }
+
           char* save_zero = ce_dupe_string(buffer, *action_range.sorted_start, *action_range.sorted_end);
           char* save_quote = ce_dupe_string(buffer, *action_range.sorted_start, *action_range.sorted_end);
 
@@ -2232,27 +2819,47 @@ bool vim_action_apply(VimAction_t* action, BufferView_t* view, Point_t* cursor,
           vim_yank_add(&vim_state->yank_head, action->change.reg ? action->change.reg : '"', save_quote,
                        action_range.yank_mode);
      } break;
+     case VCT_BLOCK_INSERT:
+     case VCT_BLOCK_APPEND:
+     {
+          if(action->motion.type != VMT_VISUAL_BLOCK) return false;
+
+          int64_t column = action_range.start.x;
+          if(action->change.type == VCT_BLOCK_APPEND) column = action_range.end.x + 1;
+
+          visual_block_setup_cursors(&vim_buffer_state->multi_cursor, buffer, &action_range, column);
+
+          int64_t line_len = strlen(buffer->lines[action_range.start.y]);
+          *cursor = (Point_t){column < line_len ? column : line_len, action_range.start.y};
+     } break;
      case VCT_INDENT:
      {
           if(action->motion.type == VMT_LINE || action->motion.type == VMT_LINE_UP ||
              action->motion.type == VMT_LINE_DOWN || action->motion.type == VMT_VISUAL_RANGE ||
-             action->motion.type == VMT_VISUAL_LINE){
-               for(int i = action_range.sorted_start->y; i <= action_range.sorted_end->y; ++i){
+             action->motion.type == VMT_VISUAL_LINE || action->motion.type == VMT_VISUAL_BLOCK){
+               BufferLineEdit_t* edits = alloc_line_edits(&action_range);
+               if(!edits) return false;
+
+               int64_t edit_count = 0;
+               for(int64_t i = action_range.sorted_start->y; i <= action_range.sorted_end->y; ++i){
                     if(strlen(buffer->lines[i]) == 0) continue;
-                    Point_t loc = {0, i};
-                    if(!ce_insert_string(buffer, loc, TAB_STRING)) return false;
-                    ce_commit_insert_string(commit_tail, loc, *cursor, *cursor, strdup(TAB_STRING), BCC_KEEP_GOING);
+                    edits[edit_count] = (BufferLineEdit_t){i, 0, 0};
+                    edit_count++;
                }
 
-               if(*commit_tail) (*commit_tail)->commit.chain = chain;
+               if(!insert_block_on_lines(buffer, commit_tail, *cursor, edits, edit_count, TAB_STRING, chain)) return false;
           }
      } break;
      case VCT_UNINDENT:
      {
           if(action->motion.type == VMT_LINE || action->motion.type == VMT_LINE_UP ||
              action->motion.type == VMT_LINE_DOWN || action->motion.type == VMT_VISUAL_RANGE ||
-             action->motion.type == VMT_VISUAL_LINE){
-               for(int l = action_range.sorted_start->y; l <= action_range.sorted_end->y; ++l){
+             action->motion.type == VMT_VISUAL_LINE || action->motion.type == VMT_VISUAL_BLOCK){
+               BufferLineEdit_t* edits = alloc_line_edits(&action_range);
+               if(!edits) return false;
+
+               int64_t edit_count = 0;
+               for(int64_t l = action_range.sorted_start->y; l <= action_range.sorted_end->y; ++l){
                     int64_t whitespace_count = 0;
                     const int64_t tab_len = strlen(TAB_STRING);
                     for(int i = 0; i < tab_len; ++i){
@@ -2264,13 +2871,12 @@ bool vim_action_apply(VimAction_t* action, BufferView_t* view, Point_t* cursor,
                     }
 
                     if(whitespace_count){
-                         Point_t loc = {0, l};
-                         if(!ce_remove_string(buffer, loc, whitespace_count)) return false;
-                         ce_commit_remove_string(commit_tail, loc, *cursor, *cursor, strdup(TAB_STRING), BCC_KEEP_GOING);
+                         edits[edit_count] = (BufferLineEdit_t){l, 0, whitespace_count};
+                         edit_count++;
                     }
                }
 
-               if(*commit_tail) (*commit_tail)->commit.chain = chain;
+               if(!remove_block_on_lines(buffer, commit_tail, *cursor, edits, edit_count, chain)) return false;
           }
      } break;
      case VCT_COMMENT:
@@ -2278,47 +2884,48 @@ bool vim_action_apply(VimAction_t* action, BufferView_t* view, Point_t* cursor,
           const char* comment = get_comment_string(buffer->type);
           if(!comment) break;
 
+          BufferLineEdit_t* edits = alloc_line_edits(&action_range);
+          if(!edits) return false;
+
+          int64_t edit_count = 0;
           for(int64_t i = action_range.sorted_start->y; i <= action_range.sorted_end->y; ++i){
                if(!strlen(buffer->lines[i])) continue;
 
                Point_t soft_beginning = {0, i};
                ce_move_cursor_to_soft_beginning_of_line(buffer, &soft_beginning);
 
-               if(!ce_insert_string(buffer, soft_beginning, comment)){
-                    return false;
-               }
-
-               ce_commit_insert_string(commit_tail, soft_beginning, *cursor, *cursor,
-                                       strdup(comment), BCC_KEEP_GOING);
+               edits[edit_count] = (BufferLineEdit_t){i, soft_beginning.x, 0};
+               edit_count++;
           }
 
-          if(*commit_tail) (*commit_tail)->commit.chain = chain;
+          if(!insert_block_on_lines(buffer, commit_tail, *cursor, edits, edit_count, comment, chain)) return false;
      } break;
      case VCT_UNCOMMENT:
      {
           const char* comment = get_comment_string(buffer->type);
           if(!comment) break;
 
+          BufferLineEdit_t* edits = alloc_line_edits(&action_range);
+          if(!edits) return false;
+
+          int64_t edit_count = 0;
+          int64_t comment_len = strlen(comment);
           for(int64_t i = action_range.sorted_start->y; i <= action_range.sorted_end->y; ++i){
                Point_t soft_beginning = {0, i};
                ce_move_cursor_to_soft_beginning_of_line(buffer, &soft_beginning);
 
-               if(strncmp(buffer->lines[i] + soft_beginning.x, comment,
-                          strlen(comment)) != 0) continue;
+               if(strncmp(buffer->lines[i] + soft_beginning.x, comment, comment_len) != 0) continue;
 
-               if(!ce_remove_string(buffer, soft_beginning, strlen(comment))){
-                    return false;
-               }
-
-               ce_commit_remove_string(commit_tail, soft_beginning, *cursor, *cursor,
-                                       strdup(comment), BCC_KEEP_GOING);
+               edits[edit_count] = (BufferLineEdit_t){i, soft_beginning.x, comment_len};
+               edit_count++;
           }
 
-          if(*commit_tail) (*commit_tail)->commit.chain = chain;
+          if(!remove_block_on_lines(buffer, commit_tail, *cursor, edits, edit_count, chain)) return false;
      } break;
      case VCT_FLIP_CASE:
      {
           Point_t itr = *action_range.sorted_start;
+          BufferCommitNode_t* prev_tail = *commit_tail;
 
           do{
                char prev_char = 0;
@@ -2340,7 +2947,8 @@ bool vim_action_apply(VimAction_t* action, BufferView_t* view, Point_t* cursor,
                ce_advance_cursor(buffer, &itr, 1);
           } while(!ce_point_after(itr, *action_range.sorted_end));
 
-          if(*commit_tail) (*commit_tail)->commit.chain = chain;
+          // NOTE: if nothing changed case, the tail is a commit from before us
+          if(*commit_tail != prev_tail) (*commit_tail)->commit.chain = chain;
      } break;
      case VCT_JOIN_LINE:
      {
@@ -2475,7 +3083,9 @@ bool vim_action_apply(VimAction_t* action, BufferView_t* view, Point_t* cursor,
           }
 
           KeyNode_t* save_command_head = vim_state->command_head;
+          VimActionParser_t save_action_parser = vim_state->action_parser;
           vim_state->command_head = NULL;
+          vim_action_parser_reset(&vim_state->action_parser);
           vim_state->playing_macro = action->change.reg;
 
           for(int64_t i = 0; i < action->multiplier; ++i){
@@ -2496,6 +3106,7 @@ bool vim_action_apply(VimAction_t* action, BufferView_t* view, Point_t* cursor,
                }
 
                ce_keys_free(&vim_state->command_head);
+               vim_action_parser_reset(&vim_state->action_parser);
 
                if(*commit_tail) (*commit_tail)->commit.chain = BCC_STOP;
 
@@ -2504,6 +3115,7 @@ bool vim_action_apply(VimAction_t* action, BufferView_t* view, Point_t* cursor,
 
           vim_state->playing_macro = 0;
           vim_state->command_head = save_command_head;
+          vim_state->action_parser = save_action_parser;
      } break;
      case VCT_SUBSTITUTE:
      {
@@ -2564,6 +3176,8 @@ bool vim_action_apply(VimAction_t* action, BufferView_t* view, Point_t* cursor,
 
           // if we end in insert mode, make sure undo is chained with the action
           if(action->change.type != VCT_NONE && action->change.type != VCT_MOTION && *commit_tail) (*commit_tail)->commit.chain = BCC_KEEP_GOING;
+
+          if(vim_buffer_state->multi_cursor.count) multi_cursor_enter_insert(action, view, cursor, vim_state, vim_buffer_state);
      }else{
           Point_t old_cursor = *cursor;
           ce_clamp_cursor(buffer, cursor);
@@ -2602,6 +3216,12 @@ void vim_enter_visual_line_mode(VimState_t* vim_state, Point_t cursor)
      vim_state->visual_start = cursor;
 }
 
+void vim_enter_visual_block_mode(VimState_t* vim_state, Point_t cursor)
+{
+     vim_state->mode = VM_VISUAL_BLOCK;
+     vim_state->visual_start = cursor;
+}
+
 void vim_stop_recording_macro(VimState_t* vim_state)
 {
      vim_state->recording_macro = 0;
@@ -9,13 +9,14 @@
 #define VIM_PYTHON_COMMENT_STRING "#"
 #define VIM_CONFIG_COMMENT_STRING "#"
 #define TAB_STRING "     "
+#define KEY_VISUAL_BLOCK 22 // ctrl + v
 
 typedef enum{
      VM_NORMAL,
      VM_INSERT,
      VM_VISUAL_RANGE,
      VM_VISUAL_LINE,
-     // TODO: VM_VISUAL_BLOCK,
+     VM_VISUAL_BLOCK,
      // TODO: VM_REPLACE,
      VM_COUNT,
 } VimMode_t;
@@ -36,6 +37,8 @@ typedef enum{
      VCT_JOIN_LINE,
      VCT_OPEN_ABOVE, // NOTE: using the vim cheat sheet terminalogy for 'O' and 'o'
      VCT_OPEN_BELOW,
+     VCT_BLOCK_INSERT, // 'I' and 'A' in visual block mode
+     VCT_BLOCK_APPEND,
      VCT_SET_MARK,
      VCT_RECORD_MACRO,
      VCT_PLAY_MACRO,
@@ -97,6 +100,7 @@ typedef enum{
      VMT_AROUND_WORD_BIG,
      VMT_VISUAL_RANGE,
      VMT_VISUAL_LINE,
+     VMT_VISUAL_BLOCK,
      VMT_VISUAL_SWAP_WITH_CURSOR,
      VMT_SEARCH_WORD_UNDER_CURSOR,
      VMT_SEARCH,
@@ -116,6 +120,10 @@ typedef struct{
           char around_pair;
           int64_t visual_length;
           int64_t visual_lines;
+          struct{
+               int64_t visual_block_lines;
+               int64_t visual_block_columns;
+          };
           Direction_t search_direction;
      };
      bool visual_start_after; // false means after !
@@ -140,6 +148,37 @@ typedef struct{
      char ch;
 } VimFindCharState_t;
 
+// resumable action parser, keys are pushed one at a time and parsing picks up where it left off
+#define VIM_ACTION_PARSER_MAX_KEYS 64
+
+typedef enum{
+     VAPS_MULTIPLIER,
+     VAPS_REGISTER,
+     VAPS_CHANGE,
+     VAPS_CHANGE_ARG,
+     VAPS_MOTION_MULTIPLIER,
+     VAPS_MOTION,
+     VAPS_MOTION_ARG,
+} VimActionParseState_t;
+
+typedef struct{
+     int keys[VIM_ACTION_PARSER_MAX_KEYS];
+     int64_t key_count;
+     int64_t parsed_count;
+     VimActionParseState_t state;
+     VimAction_t action;
+     bool get_motion;
+     int64_t digit_count;
+     int change_char;
+     int motion_char;
+} VimActionParser_t;
+
+void vim_action_parser_reset(VimActionParser_t* parser);
+bool vim_action_parser_push(VimActionParser_t* parser, int key);
+VimCommandState_t vim_action_parser_parse(VimActionParser_t* parser, VimAction_t* action, VimMode_t vim_mode,
+                                          Buffer_t* buffer, Point_t* cursor, Point_t* visual_start,
+                                          VimFindCharState_t* find_char_state, bool recording_macro);
+
 typedef enum{
      VKH_UNHANDLED_KEY,
      VKH_HANDLED_KEY,
@@ -176,17 +215,21 @@ void vim_marks_free(VimMarkNode_t** head);
 typedef enum{
      YANK_NORMAL,
      YANK_LINE,
+     YANK_BLOCK,
 } VimYankMode_t;
 
 typedef struct VimYankNode_t{
      char reg_char;
-     const char* text;
+     const char* text; // NOTE: block yanks are block_height rows of block_width chars, short lines padded with spaces
      VimYankMode_t mode;
+     int64_t block_width;
+     int64_t block_height;
      struct VimYankNode_t* next;
 } VimYankNode_t;
 
 VimYankNode_t* vim_yank_find(VimYankNode_t* head, char reg_char);
 void vim_yank_add(VimYankNode_t** head, char reg_char, const char* yank_text, VimYankMode_t mode);
+void vim_yank_add_block(VimYankNode_t** head, char reg_char, const char* yank_text, int64_t width, int64_t height);
 void vim_yanks_free(VimYankNode_t** head);
 
 
@@ -215,11 +258,28 @@ void vim_macro_commit_push(VimMacroCommitNode_t** macro_commit, KeyNode_t* last_
 void vim_macro_commits_dump(const VimMacroCommitNode_t* macro_commit);
 
 
+// multiple cursors
+typedef struct{
+     Point_t* cursors; // NOTE: does not include the view's cursor, kept sorted from the front of the buffer to the back
+     int64_t count;
+     int64_t capacity;
+     Point_t insert_start; // where the view's cursor entered insert mode
+     bool one_shot; // cursors are dropped after the next insert, used by visual block inserts
+} VimMultiCursor_t;
+
+bool vim_multi_cursor_add(VimMultiCursor_t* multi_cursor, Point_t location);
+int64_t vim_multi_cursor_add_matches(VimMultiCursor_t* multi_cursor, const Buffer_t* buffer, const regex_t* regex,
+                                     Point_t cursor);
+void vim_multi_cursor_clear(VimMultiCursor_t* multi_cursor);
+void vim_multi_cursor_free(VimMultiCursor_t* multi_cursor);
+
+
 // vim state
 typedef struct{
      VimMode_t mode;
 
-     KeyNode_t* command_head;
+     KeyNode_t* command_head; // keys typed in insert mode
+     VimActionParser_t action_parser;
 
      VimAction_t last_action;
      int* last_insert_command;
@@ -246,6 +306,7 @@ typedef struct{
 typedef struct{
      VimMarkNode_t* mark_head;
      int64_t cursor_save_column;
+     VimMultiCursor_t multi_cursor;
 } VimBufferState_t;
 
 typedef struct {
@@ -274,6 +335,7 @@ void vim_enter_normal_mode(VimState_t* vim_state);
 bool vim_enter_insert_mode(VimState_t* vim_state, Buffer_t* buffer);
 void vim_enter_visual_range_mode(VimState_t* vim_state, Point_t cursor);
 void vim_enter_visual_line_mode(VimState_t* vim_state, Point_t cursor);
+void vim_enter_visual_block_mode(VimState_t* vim_state, Point_t cursor);
 
 void vim_stop_recording_macro(VimState_t* vim_state);
 
@@ -0,0 +1,476 @@
+#include "word_index.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <inttypes.h>
+
+static bool word_char(char c)
+{
+     return isalnum((unsigned char)(c)) || c == '_';
+}
+
+static bool ensure_root(WordIndex_t* index)
+{
+     if(index->node_count) return true;
+
+     index->nodes = calloc(1024, sizeof(*index->nodes));
+     if(!index->nodes){
+          ce_message("%s() failed to allocate word nodes", __FUNCTION__);
+          return false;
+     }
+
+     index->node_capacity = 1024;
+     index->node_count = 1;
+     return true;
+}
+
+// binary search the sorted children, returns where c is or would go
+static uint32_t child_slot(const WordIndex_t* index, const WordNode_t* node, char c, bool* found)
+{
+     uint32_t low = 0;
+     uint32_t high = node->child_count;
+     while(low < high){
+          uint32_t mid = low + (high - low) / 2;
+          char mid_c = index->nodes[node->children[mid]].c;
+          if(mid_c == c){
+               *found = true;
+               return mid;
+          }
+          if(mid_c < c){
+               low = mid + 1;
+          }else{
+               high = mid;
+          }
+     }
+
+     *found = false;
+     return low;
+}
+
+static int64_t find_node(const WordIndex_t* index, const char* word, int64_t length)
+{
+     if(!index->node_count) return -1;
+
+     uint32_t node = 0;
+     for(int64_t i = 0; i < length; ++i){
+          bool found = false;
+          uint32_t slot = child_slot(index, index->nodes + node, word[i], &found);
+          if(!found) return -1;
+          node = index->nodes[node].children[slot];
+     }
+
+     return node;
+}
+
+// returns the node the word ends at, 0 if we couldn't allocate it
+static uint32_t add_word(WordIndex_t* index, const char* word, int64_t length)
+{
+     if(!ensure_root(index)) return 0;
+
+     uint32_t node = 0;
+     for(int64_t i = 0; i < length; ++i){
+          bool found = false;
+          uint32_t slot = child_slot(index, index->nodes + node, word[i], &found);
+          if(found){
+               node = index->nodes[node].children[slot];
+               continue;
+          }
+
+          if(index->node_count == index->node_capacity){
+               int64_t new_capacity = index->node_capacity * 2;
+               WordNode_t* new_nodes = realloc(index->nodes, new_capacity * sizeof(*new_nodes));
+               if(!new_nodes) return 0;
+               index->nodes = new_nodes;
+               index->node_capacity = new_capacity;
+          }
+
+          WordNode_t* parent = index->nodes + node;
+          if(parent->child_count == parent->child_capacity){
+               uint32_t new_capacity = parent->child_capacity ? parent->child_capacity * 2 : 2;
+               uint32_t* new_children = realloc(parent->children, new_capacity * sizeof(*new_children));
+               if(!new_children) return 0;
+               parent->children = new_children;
+               parent->child_capacity = new_capacity;
+          }
+
+          uint32_t child = index->node_count++;
+          WordNode_t* child_node = index->nodes + child;
+          memset(child_node, 0, sizeof(*child_node));
+          child_node->parent = node;
+          child_node->c = word[i];
+
+          memmove(parent->children + slot + 1, parent->children + slot, (parent->child_count - slot) * sizeof(uint32_t));
+          parent->children[slot] = child;
+          parent->child_count++;
+
+          node = child;
+     }
+
+     // counts only go down after this, so best stays an upper bound
+     uint32_t count = ++index->nodes[node].count;
+     for(int64_t itr = node; itr >= 0; itr = itr ? (int64_t)(index->nodes[itr].parent) : -1){
+          if(index->nodes[itr].best >= count) break;
+          index->nodes[itr].best = count;
+     }
+
+     return node;
+}
+
+static void remove_words(WordIndex_t* index, WordLine_t* line)
+{
+     for(uint32_t i = 0; i < line->count; ++i){
+          WordNode_t* node = index->nodes + line->words[i];
+          assert(node->count > 0);
+          node->count--;
+     }
+
+     free(line->words);
+     line->words = NULL;
+     line->count = 0;
+}
+
+static void add_words(WordIndex_t* index, WordLine_t* line, const char* text)
+{
+     line->words = NULL;
+     line->count = 0;
+     if(!text) return;
+
+     uint32_t capacity = 0;
+     const char* itr = text;
+     while(*itr){
+          if(!word_char(*itr)){
+               itr++;
+               continue;
+          }
+
+          const char* start = itr;
+          while(word_char(*itr)) itr++;
+          int64_t length = itr - start;
+
+          if(isdigit((unsigned char)(*start)) || length < WORD_INDEX_MIN_LENGTH || length > WORD_INDEX_MAX_LENGTH){
+               continue;
+          }
+
+          if(line->count == capacity){
+               uint32_t new_capacity = capacity ? capacity * 2 : 8;
+               uint32_t* new_words = realloc(line->words, new_capacity * sizeof(*new_words));
+               if(!new_words) return;
+               line->words = new_words;
+               capacity = new_capacity;
+          }
+
+          uint32_t node = add_word(index, start, length);
+          if(node) line->words[line->count++] = node;
+     }
+}
+
+static WordBuffer_t* find_buffer(WordIndex_t* index, const Buffer_t* buffer)
+{
+     for(int64_t i = 0; i < index->buffer_count; ++i){
+          if(index->buffers[i].buffer == buffer) return index->buffers + i;
+     }
+
+     return NULL;
+}
+
+// how many line breaks a commit takes out and puts in when it is redone
+static void commit_line_breaks(const BufferCommit_t* commit, int64_t* removed, int64_t* inserted)
+{
+     *removed = 0;
+     *inserted = 0;
+
+     const char* removed_text = NULL;
+     const char* inserted_text = NULL;
+
+     switch(commit->type){
+     default:
+          return;
+     case BCT_INSERT_CHAR:
+          *inserted = commit->c == '\n';
+          return;
+     case BCT_REMOVE_CHAR:
+          *removed = commit->c == '\n';
+          return;
+     case BCT_CHANGE_CHAR:
+          *inserted = commit->c == '\n';
+          *removed = commit->prev_c == '\n';
+          return;
+     case BCT_INSERT_STRING:
+          inserted_text = commit->str;
+          break;
+     case BCT_REMOVE_STRING:
+          removed_text = commit->str;
+          break;
+     case BCT_CHANGE_STRING:
+          inserted_text = commit->str;
+          removed_text = commit->prev_str;
+          break;
+     }
+
+     for(const char* c = removed_text; c && *c; ++c) *removed += *c == '\n';
+     for(const char* c = inserted_text; c && *c; ++c) *inserted += *c == '\n';
+}
+
+typedef struct{
+     int64_t first; // lines that changed, in the buffer as it is now, first > last if none did
+     int64_t last;
+     int64_t line_delta;
+}WordWindow_t;
+
+// grow the window to cover a change at line, which replaces removed + 1 lines with inserted + 1 lines
+static void window_add(WordWindow_t* window, int64_t line, int64_t removed, int64_t inserted)
+{
+     if(window->first > window->last){
+          window->first = line;
+          window->last = line + inserted;
+     }else{
+          if(line < window->first) window->first = line;
+          window->last = (window->last > line + removed) ? window->last + inserted - removed : line + inserted;
+     }
+
+     window->line_delta += inserted - removed;
+}
+
+static void window_add_commit(WordWindow_t* window, const BufferCommit_t* commit, bool undo)
+{
+     if(commit->type == BCT_INSERT_BLOCK || commit->type == BCT_REMOVE_BLOCK){
+          // NOTE: block line edits never cross a line
+          for(int64_t i = 0; i < commit->line_edit_count; ++i){
+               window_add(window, commit->line_edits[i].line, 0, 0);
+          }
+          return;
+     }
+
+     if(commit->type == BCT_NONE) return;
+
+     int64_t removed = 0;
+     int64_t inserted = 0;
+     commit_line_breaks(commit, &removed, &inserted);
+     if(undo){
+          window_add(window, commit->start.y, inserted, removed);
+     }else{
+          window_add(window, commit->start.y, removed, inserted);
+     }
+}
+
+static bool commit_is_synced(const BufferCommitNode_t* node, const WordBuffer_t* word_buffer)
+{
+     return node == word_buffer->synced && node->id == word_buffer->synced_id;
+}
+
+// the lines the commits since the last sync touched, false if we can't tell from the commits
+static bool window_since_sync(const WordBuffer_t* word_buffer, const BufferCommitNode_t* commit_tail,
+                              WordWindow_t* window)
+{
+     window->first = 0;
+     window->last = -1;
+     window->line_delta = 0;
+
+     const BufferCommitNode_t* itr = commit_tail;
+     for(int64_t i = 0; itr && i < WORD_INDEX_SYNC_MAX_COMMITS; ++i){
+          if(commit_is_synced(itr, word_buffer)){
+               while(itr != commit_tail){
+                    itr = itr->next;
+                    window_add_commit(window, &itr->commit, false);
+               }
+               return true;
+          }
+          itr = itr->prev;
+     }
+
+     // what we saw was undone, the commits are waiting to be redone after the tail
+     itr = commit_tail ? commit_tail->next : NULL;
+     for(int64_t i = 0; itr && i < WORD_INDEX_SYNC_MAX_COMMITS; ++i){
+          if(commit_is_synced(itr, word_buffer)){
+               while(itr != commit_tail){
+                    window_add_commit(window, &itr->commit, true);
+                    itr = itr->prev;
+               }
+               return true;
+          }
+          itr = itr->next;
+     }
+
+     return false;
+}
+
+// replace the words of old lines [first, old_last] with the words of the buffer's lines [first, last]
+static bool splice_lines(WordIndex_t* index, WordBuffer_t* word_buffer, const Buffer_t* buffer, int64_t first,
+                         int64_t last)
+{
+     int64_t delta = buffer->line_count - word_buffer->line_count;
+     int64_t old_last = last - delta;
+     if(first < 0 || last >= buffer->line_count || old_last < first - 1 || old_last >= word_buffer->line_count){
+          return false;
+     }
+
+     for(int64_t i = first; i <= old_last; ++i) remove_words(index, word_buffer->lines + i);
+
+     if(delta > 0){
+          WordLine_t* new_lines = realloc(word_buffer->lines, buffer->line_count * sizeof(*new_lines));
+          if(!new_lines){
+               // NOTE: the words that were there are gone, so pretend the lines went with them
+               memmove(word_buffer->lines + first, word_buffer->lines + old_last + 1,
+                       (word_buffer->line_count - (old_last + 1)) * sizeof(*new_lines));
+               word_buffer->line_count -= (old_last + 1) - first;
+               return false;
+          }
+          word_buffer->lines = new_lines;
+     }
+
+     memmove(word_buffer->lines + last + 1, word_buffer->lines + old_last + 1,
+             (word_buffer->line_count - (old_last + 1)) * sizeof(*word_buffer->lines));
+     word_buffer->line_count = buffer->line_count;
+
+     for(int64_t i = first; i <= last; ++i) add_words(index, word_buffer->lines + i, buffer->lines[i]);
+     return true;
+}
+
+static void clear_lines(WordIndex_t* index, WordBuffer_t* word_buffer)
+{
+     for(int64_t i = 0; i < word_buffer->line_count; ++i) remove_words(index, word_buffer->lines + i);
+     free(word_buffer->lines);
+     word_buffer->lines = NULL;
+     word_buffer->line_count = 0;
+}
+
+void word_index_sync_buffer(WordIndex_t* index, const Buffer_t* buffer, const BufferCommitNode_t* commit_tail)
+{
+     WordBuffer_t* word_buffer = find_buffer(index, buffer);
+     bool full = false;
+
+     if(!word_buffer){
+          WordBuffer_t* new_buffers = realloc(index->buffers, (index->buffer_count + 1) * sizeof(*new_buffers));
+          if(!new_buffers) return;
+          index->buffers = new_buffers;
+          word_buffer = index->buffers + index->buffer_count++;
+          memset(word_buffer, 0, sizeof(*word_buffer));
+          word_buffer->buffer = buffer;
+          full = true;
+     }else if(commit_tail && commit_is_synced(commit_tail, word_buffer)){
+          // NOTE: if the lines don't add up, the buffer was changed without a commit
+          if(word_buffer->line_count == buffer->line_count) return;
+          full = true;
+     }
+
+     WordWindow_t window;
+     if(!full && (!window_since_sync(word_buffer, commit_tail, &window) ||
+                  word_buffer->line_count + window.line_delta != buffer->line_count)){
+          full = true;
+     }
+
+     if(!full && window.first <= window.last && !splice_lines(index, word_buffer, buffer, window.first, window.last)){
+          full = true;
+     }
+
+     if(full){
+          clear_lines(index, word_buffer);
+          if(buffer->line_count){
+               word_buffer->lines = calloc(buffer->line_count, sizeof(*word_buffer->lines));
+               if(word_buffer->lines){
+                    word_buffer->line_count = buffer->line_count;
+                    for(int64_t i = 0; i < buffer->line_count; ++i){
+                         add_words(index, word_buffer->lines + i, buffer->lines[i]);
+                    }
+               }
+          }
+     }
+
+     word_buffer->synced = commit_tail;
+     word_buffer->synced_id = commit_tail ? commit_tail->id : 0;
+}
+
+void word_index_remove_buffer(WordIndex_t* index, const Buffer_t* buffer)
+{
+     WordBuffer_t* word_buffer = find_buffer(index, buffer);
+     if(!word_buffer) return;
+
+     clear_lines(index, word_buffer);
+
+     int64_t i = word_buffer - index->buffers;
+     memmove(index->buffers + i, index->buffers + i + 1, (index->buffer_count - i - 1) * sizeof(*index->buffers));
+     index->buffer_count--;
+}
+
+int64_t word_index_count(const WordIndex_t* index, const char* word)
+{
+     int64_t node = find_node(index, word, strlen(word));
+     if(node <= 0) return 0;
+     return index->nodes[node].count;
+}
+
+typedef struct{
+     const WordIndex_t* index;
+     WordMatch_t* matches;
+     int64_t count;
+     int64_t max;
+     uint32_t* found; // node of each match, their words are filled in at the end
+}WordSearch_t;
+
+static void search(WordSearch_t* search_state, uint32_t node_index, bool is_prefix)
+{
+     const WordNode_t* node = search_state->index->nodes + node_index;
+
+     // NOTE: on a tie the match we already have wins, it comes first alphabetically
+     bool full = search_state->count == search_state->max;
+     if(full && node->best <= search_state->matches[search_state->count - 1].count) return;
+
+     if(!is_prefix && node->count && (!full || node->count > search_state->matches[search_state->count - 1].count)){
+          int64_t i = full ? search_state->count - 1 : search_state->count++;
+          while(i > 0 && search_state->matches[i - 1].count < node->count){
+               search_state->matches[i].count = search_state->matches[i - 1].count;
+               search_state->found[i] = search_state->found[i - 1];
+               i--;
+          }
+          search_state->matches[i].count = node->count;
+          search_state->found[i] = node_index;
+     }
+
+     for(uint32_t i = 0; i < node->child_count; ++i){
+          search(search_state, node->children[i], false);
+     }
+}
+
+int64_t word_index_complete(const WordIndex_t* index, const char* prefix, WordMatch_t* matches, int64_t max_matches)
+{
+     if(max_matches <= 0) return 0;
+
+     int64_t prefix_node = find_node(index, prefix, strlen(prefix));
+     if(prefix_node < 0) return 0;
+
+     uint32_t* found = malloc(max_matches * sizeof(*found));
+     if(!found) return 0;
+
+     WordSearch_t search_state = {index, matches, 0, max_matches, found};
+     search(&search_state, prefix_node, true);
+
+     for(int64_t i = 0; i < search_state.count; ++i){
+          // walk back up to the root, then flip it around
+          char* word = matches[i].word;
+          int64_t length = 0;
+          for(uint32_t node = found[i]; node; node = index->nodes[node].parent){
+               word[length++] = index->nodes[node].c;
+          }
+          word[length] = 0;
+
+          for(int64_t j = 0; j < length / 2; ++j){
+               char tmp = word[j];
+               word[j] = word[length - 1 - j];
+               word[length - 1 - j] = tmp;
+          }
+     }
+
+     free(found);
+     return search_state.count;
+}
+
+void word_index_free(WordIndex_t* index)
+{
+     for(int64_t i = 0; i < index->buffer_count; ++i) clear_lines(index, index->buffers + i);
+     free(index->buffers);
+
+     for(int64_t i = 0; i < index->node_count; ++i) free(index->nodes[i].children);
+     free(index->nodes);
+
+     memset(index, 0, sizeof(*index));
+}
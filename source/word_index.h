@@ -0,0 +1,53 @@
+#pragma once
+
+// counts of the identifiers in every open buffer, kept in a trie so completing a prefix never rescans a buffer. Each
+// buffer is brought up to date from its commits, only the lines an edit touched are looked at again
+
+#include "ce.h"
+
+#define WORD_INDEX_MIN_LENGTH 3 // shorter words aren't worth completing
+#define WORD_INDEX_MAX_LENGTH 128 // longer ones are probably not words at all
+#define WORD_INDEX_SYNC_MAX_COMMITS 1024 // more commits than this since the last sync, just look at every line again
+
+typedef struct{
+     uint32_t parent;
+     char c;
+     uint32_t count; // times the word ending here appears across all the buffers
+     uint32_t best; // no count under this node is bigger, so lookups can skip whole branches
+     uint32_t* children; // sorted by c
+     uint32_t child_count;
+     uint32_t child_capacity;
+}WordNode_t;
+
+typedef struct{
+     uint32_t* words; // the node each word on the line ends at, in order
+     uint32_t count;
+}WordLine_t;
+
+typedef struct{
+     const Buffer_t* buffer; // only compared against
+     const BufferCommitNode_t* synced; // only compared against, it may be free'd
+     uint64_t synced_id;
+     WordLine_t* lines;
+     int64_t line_count;
+}WordBuffer_t;
+
+typedef struct{
+     WordNode_t* nodes; // the root is 0, nodes are never removed, so a word's node stays put
+     int64_t node_count;
+     int64_t node_capacity;
+     WordBuffer_t* buffers;
+     int64_t buffer_count;
+}WordIndex_t;
+
+typedef struct{
+     char word[WORD_INDEX_MAX_LENGTH + 1];
+     int64_t count;
+}WordMatch_t;
+
+// without a commit_tail there is no history to go on, so every line is looked at again
+void word_index_sync_buffer(WordIndex_t* index, const Buffer_t* buffer, const BufferCommitNode_t* commit_tail);
+void word_index_remove_buffer(WordIndex_t* index, const Buffer_t* buffer);
+int64_t word_index_count(const WordIndex_t* index, const char* word);
+int64_t word_index_complete(const WordIndex_t* index, const char* prefix, WordMatch_t* matches, int64_t max_matches);
+void word_index_free(WordIndex_t* index);
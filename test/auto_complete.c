@@ -1,6 +1,8 @@
 #include "auto_complete.h"
 #include "test.h"
 
+#include <inttypes.h>
+
 TEST(insert)
 {
      AutoComplete_t auto_complete = {};
@@ -9,21 +11,15 @@ TEST(insert)
      EXPECT(auto_complete_insert(&auto_complete, "two", "the second option"));
      EXPECT(auto_complete_insert(&auto_complete, "three", "the third option"));
 
-     CompleteNode_t* itr = auto_complete.head;
-
-     EXPECT(strcmp(itr->option, "one") == 0);
-     EXPECT(strcmp(itr->description, "the first option") == 0);
-     itr = itr->next;
-
-     EXPECT(strcmp(itr->option, "two") == 0);
-     EXPECT(strcmp(itr->description, "the second option") == 0);
-     itr = itr->next;
+     ASSERT(auto_complete.option_count == 3);
+     EXPECT(strcmp(auto_complete.options[0].option, "one") == 0);
+     EXPECT(strcmp(auto_complete.options[0].description, "the first option") == 0);
+     EXPECT(strcmp(auto_complete.options[1].option, "two") == 0);
+     EXPECT(strcmp(auto_complete.options[1].description, "the second option") == 0);
+     EXPECT(strcmp(auto_complete.options[2].option, "three") == 0);
+     EXPECT(strcmp(auto_complete.options[2].description, "the third option") == 0);
 
-     EXPECT(strcmp(itr->option, "three") == 0);
-     EXPECT(strcmp(itr->description, "the third option") == 0);
-     itr = itr->next;
-
-     EXPECT(itr == NULL);
+     auto_complete_free(&auto_complete);
 }
 
 TEST(sanity_exact)
@@ -104,6 +100,94 @@ TEST(sanity_occurance)
      EXPECT(!auto_completing(&auto_complete));
 }
 
+TEST(narrow)
+{
+     AutoComplete_t auto_complete = {};
+
+     EXPECT(auto_complete_insert(&auto_complete, "strlen", NULL));
+     EXPECT(auto_complete_insert(&auto_complete, "strcmp", NULL));
+     EXPECT(auto_complete_insert(&auto_complete, "printf", NULL));
+     EXPECT(auto_complete_insert(&auto_complete, "strncmp", NULL));
+     EXPECT(auto_complete_insert(&auto_complete, "strcpy", NULL));
+
+     auto_complete_start(&auto_complete, ACT_EXACT, (Point_t){0, 0});
+
+     // matches stay in the order they were inserted
+     ASSERT(auto_complete_narrow(&auto_complete, "str") == 4);
+     EXPECT(auto_complete.matches[0] == 0);
+     EXPECT(auto_complete.matches[1] == 1);
+     EXPECT(auto_complete.matches[2] == 3);
+     EXPECT(auto_complete.matches[3] == 4);
+     EXPECT(auto_complete_current_match(&auto_complete) == 0);
+
+     ASSERT(auto_complete_narrow(&auto_complete, "strc") == 2);
+     EXPECT(auto_complete.matches[0] == 1);
+     EXPECT(auto_complete.matches[1] == 4);
+     EXPECT(auto_complete_current_match(&auto_complete) == -1);
+
+     // backing up starts over
+     EXPECT(auto_complete_narrow(&auto_complete, "s") == 4);
+     EXPECT(auto_complete_narrow(&auto_complete, "x") == 0);
+     EXPECT(auto_complete_narrow(&auto_complete, NULL) == 5);
+
+     EXPECT(auto_complete_next(&auto_complete, "strc"));
+     EXPECT(strcmp(auto_complete_current(&auto_complete), "strcmp") == 0);
+     EXPECT(auto_complete_prev(&auto_complete, "strc"));
+     EXPECT(strcmp(auto_complete_current(&auto_complete), "strcpy") == 0);
+
+     // what every option starting with "s" has in common
+     char* completion = auto_complete_get_completion(&auto_complete, 1);
+     EXPECT(strcmp(completion, "tr") == 0);
+     free(completion);
+
+     // inserting more options is picked up
+     EXPECT(auto_complete_insert(&auto_complete, "strcat", NULL));
+     EXPECT(auto_complete_narrow(&auto_complete, "strc") == 3);
+     EXPECT(!auto_complete_next(&auto_complete, "memcpy"));
+     EXPECT(!auto_completing(&auto_complete));
+
+     auto_complete_free(&auto_complete);
+     EXPECT(auto_complete_current(&auto_complete) == NULL);
+}
+
+TEST(fuzzy)
+{
+     AutoComplete_t auto_complete = {};
+
+     // enough candidates that ranking them is split across threads
+     char option[64];
+     for(int64_t i = 0; i < AUTO_COMPLETE_FUZZY_THREAD_MIN * 2; ++i){
+          snprintf(option, 64, "source/module_%"PRId64".c", i);
+          EXPECT(auto_complete_insert(&auto_complete, option, NULL));
+     }
+     EXPECT(auto_complete_insert(&auto_complete, "source/ce_config.c", NULL));
+     EXPECT(auto_complete_insert(&auto_complete, "test/config_test.c", NULL));
+
+     auto_complete_start(&auto_complete, ACT_FUZZY, (Point_t){0, 0});
+
+     EXPECT(auto_complete_narrow(&auto_complete, "mod") == AUTO_COMPLETE_FUZZY_THREAD_MIN * 2);
+
+     // narrowing further only looks at what is left, and the best one is selected
+     EXPECT(auto_complete_select(&auto_complete, "confi"));
+     EXPECT(auto_complete.match_count == 2);
+     EXPECT(strcmp(auto_complete_current(&auto_complete), "source/ce_config.c") == 0); // tied, but inserted first
+     EXPECT(auto_complete_next(&auto_complete, "confi"));
+     EXPECT(strcmp(auto_complete_current(&auto_complete), "test/config_test.c") == 0);
+     EXPECT(auto_complete_next(&auto_complete, "confi"));
+     EXPECT(strcmp(auto_complete_current(&auto_complete), "source/ce_config.c") == 0);
+     EXPECT(auto_complete_prev(&auto_complete, "confi"));
+     EXPECT(strcmp(auto_complete_current(&auto_complete), "test/config_test.c") == 0);
+
+     // the best match for a number sits on its own boundary, and shorter wins ties
+     EXPECT(auto_complete_select(&auto_complete, "m77"));
+     EXPECT(strcmp(auto_complete_current(&auto_complete), "source/module_77.c") == 0);
+
+     EXPECT(!auto_complete_select(&auto_complete, "zzz"));
+     EXPECT(!auto_completing(&auto_complete));
+
+     auto_complete_free(&auto_complete);
+}
+
 int main()
 {
      RUN_TESTS();
@@ -1,5 +1,7 @@
 #include <execinfo.h>
+#include <inttypes.h>
 #include <signal.h>
+#include <unistd.h>
 
 #include "ce.h"
 #include "test.h"
@@ -147,6 +149,63 @@ TEST(save_buffer_multiline_line)
      ce_free_buffer(&other_buffer);
 }
 
+static char* read_all(int fd)
+{
+     static char contents[BUFSIZ * 8];
+     ssize_t length = read(fd, contents, sizeof(contents) - 1);
+     if(length < 0) return NULL;
+     contents[length] = 0;
+     return contents;
+}
+
+TEST(buffer_memfd)
+{
+     Buffer_t buffer = {};
+     buffer.line_count = 3;
+     buffer.lines = malloc(3 * sizeof(char*));
+     buffer.lines[0] = strdup("TACOS");
+     buffer.lines[1] = strdup("");
+     buffer.lines[2] = strdup("AWESOME");
+
+     int fd = ce_buffer_memfd(&buffer);
+     ASSERT(fd >= 0);
+     char* contents = read_all(fd);
+     ASSERT(contents);
+     EXPECT(strcmp(contents, "TACOS\n\nAWESOME\n") == 0);
+     close(fd);
+
+     ce_free_buffer(&buffer);
+}
+
+TEST(write_buffer_many_lines)
+{
+     // more lines than fit in one writev()
+     Buffer_t buffer = {};
+     buffer.line_count = 1500;
+     buffer.lines = malloc(buffer.line_count * sizeof(char*));
+
+     char expected[BUFSIZ * 4] = {};
+     for(int64_t i = 0; i < buffer.line_count; ++i){
+          char line[32];
+          snprintf(line, sizeof(line), "%"PRId64, i);
+          buffer.lines[i] = strdup(line);
+          strcat(expected, line);
+          strcat(expected, "\n");
+     }
+
+     int fds[2];
+     ASSERT(pipe(fds) == 0);
+     EXPECT(ce_write_buffer(&buffer, fds[1]));
+     close(fds[1]);
+
+     char* contents = read_all(fds[0]);
+     ASSERT(contents);
+     EXPECT(strcmp(contents, expected) == 0);
+     close(fds[0]);
+
+     ce_free_buffer(&buffer);
+}
+
 TEST(point_on_buffer)
 {
      Buffer_t buffer = {};
@@ -839,6 +898,40 @@ TEST(sanity_clear_lines)
      ce_free_buffer(&buffer);
 }
 
+TEST(drop_first_lines_readonly)
+{
+     Buffer_t buffer = {};
+     ce_alloc_lines(&buffer, 1);
+     buffer.status = BS_READONLY;
+
+     char line[16];
+     for(int i = 1; i <= 5; ++i){
+          snprintf(line, 16, "%d", i);
+          ASSERT(ce_append_line_readonly(&buffer, line));
+     }
+
+     ASSERT(ce_drop_first_lines_readonly(&buffer, 2));
+     ASSERT(buffer.line_count == 4);
+     EXPECT(buffer.line_offset == 2);
+     EXPECT(strcmp(buffer.lines[0], "2") == 0);
+     EXPECT(strcmp(buffer.lines[3], "5") == 0);
+
+     // appending after a drop keeps the dropped space at the front
+     ASSERT(ce_append_line_readonly(&buffer, "6"));
+     EXPECT(strcmp(buffer.lines[4], "6") == 0);
+
+     // once the dropped space outgrows the lines, they are moved back to the front
+     ASSERT(ce_drop_first_lines_readonly(&buffer, 2));
+     ASSERT(buffer.line_count == 3);
+     EXPECT(buffer.line_offset == 0);
+     EXPECT(strcmp(buffer.lines[0], "4") == 0);
+     EXPECT(strcmp(buffer.lines[2], "6") == 0);
+
+     EXPECT(!ce_drop_first_lines_readonly(&buffer, 3));
+
+     ce_free_buffer(&buffer);
+}
+
 TEST(sanity_clear_lines_readonly)
 {
      Buffer_t buffer = {};
@@ -960,6 +1053,93 @@ TEST(sanity_set_char)
      ce_free_buffer(&buffer);
 }
 
+TEST(sanity_set_string)
+{
+     Buffer_t buffer = {};
+     buffer.line_count = 1;
+     buffer.lines = malloc(1 * sizeof(char*));
+     buffer.lines[0] = strdup("TACOS");
+
+     Point_t point = {1, 0};
+     ASSERT(ce_set_string(&buffer, point, "ORTILLA", 3));
+
+     ASSERT(buffer.line_count == 1);
+     EXPECT(strcmp(buffer.lines[0], "TORTS") == 0);
+
+     point.x = 4;
+     ASSERT(ce_set_string(&buffer, point, "ILLA", 4));
+     EXPECT(strcmp(buffer.lines[0], "TORTILLA") == 0);
+
+     point.x = 9;
+     EXPECT(!ce_set_string(&buffer, point, "S", 1));
+
+     ce_free_buffer(&buffer);
+}
+
+TEST(sanity_set_string_readonly)
+{
+     Buffer_t buffer = {};
+     buffer.line_count = 1;
+     buffer.lines = malloc(1 * sizeof(char*));
+     buffer.lines[0] = strdup("TACOS");
+     buffer.status = BS_READONLY;
+
+     Point_t point = {5, 0};
+     EXPECT(!ce_set_string(&buffer, point, " ARE GOOD", 9));
+     ASSERT(ce_set_string_readonly(&buffer, point, " ARE GOOD", 9));
+
+     EXPECT(strcmp(buffer.lines[0], "TACOS ARE GOOD") == 0);
+
+     ce_free_buffer(&buffer);
+}
+
+TEST(sanity_remove_string_readonly)
+{
+     Buffer_t buffer = {};
+     buffer.line_count = 1;
+     buffer.lines = malloc(1 * sizeof(char*));
+     buffer.lines[0] = strdup("TACOS ARE GOOD");
+     buffer.status = BS_READONLY;
+
+     Point_t point = {5, 0};
+     EXPECT(!ce_remove_string(&buffer, point, 9));
+     ASSERT(ce_remove_string_readonly(&buffer, point, 9));
+
+     EXPECT(strcmp(buffer.lines[0], "TACOS") == 0);
+
+     buffer.status = BS_NONE;
+     EXPECT(!ce_remove_string_readonly(&buffer, point, 1));
+
+     ce_free_buffer(&buffer);
+}
+
+TEST(remove_string_multiline_readonly)
+{
+     Buffer_t buffer = {};
+     buffer.line_count = 4;
+     buffer.lines = malloc(4 * sizeof(char*));
+     buffer.lines[0] = strdup("TACOS");
+     buffer.lines[1] = strdup("ARE");
+     buffer.lines[2] = strdup("GOOD");
+     buffer.lines[3] = strdup("AWESOME");
+     buffer.status = BS_READONLY;
+
+     Point_t point = {1, 0};
+     ASSERT(ce_remove_string_readonly(&buffer, point, 9));
+
+     ASSERT(buffer.line_count == 2);
+     EXPECT(strcmp(buffer.lines[0], "TGOOD") == 0);
+     EXPECT(strcmp(buffer.lines[1], "AWESOME") == 0);
+
+     point = (Point_t){5, 0};
+     ASSERT(ce_remove_char_readonly(&buffer, point));
+
+     ASSERT(buffer.line_count == 1);
+     EXPECT(strcmp(buffer.lines[0], "TGOODAWESOME") == 0);
+
+     ce_free_buffer(&buffer);
+}
+
 TEST(sanity_find_matching_pair_same_line)
 {
      Buffer_t buffer = {};
@@ -1344,6 +1524,74 @@ TEST(commit_insert_string_undo_redo)
      ce_commits_free(tail);
 }
 
+TEST(insert_block)
+{
+     Buffer_t buffer = {};
+     buffer.line_count = 3;
+     buffer.lines = malloc(3 * sizeof(char*));
+     buffer.lines[0] = strdup("TACOS");
+     buffer.lines[1] = strdup("");
+     buffer.lines[2] = strdup("AWESOME");
+
+     BufferLineEdit_t edits[3] = {{0, 0, 2}, {1, 0, 0}, {2, 0, 2}};
+     EXPECT(ce_insert_block(&buffer, edits, 3, "////"));
+
+     ASSERT(buffer.line_count == 3);
+     EXPECT(strcmp(buffer.lines[0], "//TACOS") == 0);
+     EXPECT(strcmp(buffer.lines[1], "") == 0);
+     EXPECT(strcmp(buffer.lines[2], "//AWESOME") == 0);
+
+     ce_free_buffer(&buffer);
+}
+
+TEST(commit_remove_block_undo_redo)
+{
+     Buffer_t buffer = {};
+     buffer.line_count = 2;
+     buffer.lines = malloc(2 * sizeof(char*));
+     buffer.lines[0] = strdup("     TACOS");
+     buffer.lines[1] = strdup("  ARE AWESOME");
+
+     BufferCommitNode_t* tail = calloc(1, sizeof(*tail));
+     ASSERT(tail != NULL);
+
+     BufferLineEdit_t* edits = malloc(2 * sizeof(*edits));
+     ASSERT(edits != NULL);
+     edits[0] = (BufferLineEdit_t){0, 0, 5};
+     edits[1] = (BufferLineEdit_t){1, 0, 2};
+
+     char* removed = ce_dupe_block(&buffer, edits, 2);
+     ASSERT(removed != NULL);
+     EXPECT(strcmp(removed, "       ") == 0);
+
+     EXPECT(ce_remove_block(&buffer, edits, 2));
+     EXPECT(strcmp(buffer.lines[0], "TACOS") == 0);
+     EXPECT(strcmp(buffer.lines[1], "ARE AWESOME") == 0);
+
+     Point_t undo = {5, 0};
+     Point_t redo = {0, 0};
+     ce_commit_remove_block(&tail, undo, redo, edits, 2, removed, BCC_STOP);
+
+     Point_t cursor = {};
+     ce_commit_undo(&buffer, &tail, &cursor);
+
+     EXPECT(cursor.x == 5);
+     EXPECT(cursor.y == 0);
+     ASSERT(buffer.line_count == 2);
+     EXPECT(strcmp(buffer.lines[0], "     TACOS") == 0);
+     EXPECT(strcmp(buffer.lines[1], "  ARE AWESOME") == 0);
+
+     ce_commit_redo(&buffer, &tail, &cursor);
+
+     EXPECT(cursor.x == 0);
+     EXPECT(cursor.y == 0);
+     EXPECT(strcmp(buffer.lines[0], "TACOS") == 0);
+     EXPECT(strcmp(buffer.lines[1], "ARE AWESOME") == 0);
+
+     ce_free_buffer(&buffer);
+     ce_commits_free(tail);
+}
+
 TEST(commit_remove_char_undo_redo)
 {
      Buffer_t buffer = {};
@@ -54,8 +54,11 @@ TEST(auto_complete_files_in_dir)
      buffer_initialize(&buffer);
      buffer.status = BS_READONLY;
 
+     DirCache_t dir_cache;
+     dir_cache_init(&dir_cache);
+
      AutoComplete_t auto_complete = {};
-     EXPECT(completion_calc_start_and_path(&auto_complete, "completion_test_dir/", (Point_t){20, 0}, &buffer, "."));
+     EXPECT(completion_calc_start_and_path(&auto_complete, &dir_cache, "completion_test_dir/", (Point_t){20, 0}, &buffer, "."));
 
      EXPECT(buffer.line_count == 5);
      EXPECT(line_in_buffer(&buffer, "./"));
@@ -64,9 +67,82 @@ TEST(auto_complete_files_in_dir)
      EXPECT(line_in_buffer(&buffer, "second"));
      EXPECT(line_in_buffer(&buffer, "third"));
 
+     // a new file shows up without waiting on anything
+     EXPECT(system("touch completion_test_dir/fourth") == 0);
+     EXPECT(completion_calc_start_and_path(&auto_complete, &dir_cache, "completion_test_dir/", (Point_t){20, 0}, &buffer, "."));
+     EXPECT(buffer.line_count == 6);
+     EXPECT(line_in_buffer(&buffer, "fourth"));
+
+     // typing the basename narrows the options we have, keeping what was selected
+     while(auto_complete_current(&auto_complete) && strcmp(auto_complete_current(&auto_complete), "fourth") != 0){
+          auto_complete_next(&auto_complete, "");
+     }
+     ASSERT(auto_complete_current(&auto_complete));
+
+     EXPECT(completion_calc_start_and_path(&auto_complete, &dir_cache, "completion_test_dir/t", (Point_t){21, 0}, &buffer, "."));
+     EXPECT(auto_completing(&auto_complete));
+     EXPECT(auto_complete_current(&auto_complete) && strcmp(auto_complete_current(&auto_complete), "fourth") == 0);
+     EXPECT(line_in_buffer(&buffer, "first"));
+     EXPECT(!line_in_buffer(&buffer, "second"));
+
+     // other directories don't get the options meant for this one
+     EXPECT(completion_calc_start_and_path(&auto_complete, &dir_cache, "completion_test_dir/./", (Point_t){22, 0}, &buffer, "."));
+     EXPECT(line_in_buffer(&buffer, "second"));
+
+     auto_complete_free(&auto_complete);
+
+     dir_cache_free(&dir_cache);
      EXPECT(system("rm -fr completion_test_dir") == 0);
 }
 
+static int64_t preamble_length(const char* contents)
+{
+     return clang_preamble_length(contents, strlen(contents));
+}
+
+TEST(clang_preamble_ends_at_code)
+{
+     const char* contents = "// header\n"
+                            "#include <stdio.h>\n"
+                            "\n"
+                            "  #include \"ce.h\"\n"
+                            "int main(){\n"
+                            "#include \"later.h\"\n";
+     EXPECT(preamble_length(contents) == (int64_t)(strstr(contents, "int main") - contents));
+
+     // a continued directive could run into the code
+     EXPECT(preamble_length("#include <stdio.h>\n#define A \\\n1\nint a;\n") == 19);
+
+     EXPECT(preamble_length("int a;\n") == 0);
+     EXPECT(preamble_length("#include <stdio.h>") == 0);
+
+     // a buffer streamed out ends in a newline, the preamble may be all of it but never past it
+     EXPECT(preamble_length("#include <stdio.h>\n") == 19);
+     EXPECT(clang_preamble_length("#include <stdio.h>\nint a;\n", 19) == 19);
+}
+
+TEST(completion_still_applies_until_the_line_changes)
+{
+     Buffer_t buffer = {};
+     ce_alloc_lines(&buffer, 2);
+     ce_insert_string(&buffer, (Point_t){0, 0}, "     state->");
+
+     Point_t start = {12, 0};
+     EXPECT(completion_still_applies(&buffer, (Point_t){12, 0}, start, "     state->"));
+
+     // typing past where it started narrows what we show, it doesn't make it stale
+     ce_insert_string(&buffer, (Point_t){12, 0}, "ru");
+     EXPECT(completion_still_applies(&buffer, (Point_t){14, 0}, start, "     state->"));
+
+     // moving out of the word, or changing anything before it, does
+     EXPECT(!completion_still_applies(&buffer, (Point_t){11, 0}, start, "     state->"));
+     EXPECT(!completion_still_applies(&buffer, (Point_t){0, 1}, start, "     state->"));
+     ce_insert_string(&buffer, (Point_t){5, 0}, "other");
+     EXPECT(!completion_still_applies(&buffer, (Point_t){19, 0}, start, "     state->"));
+
+     ce_free_buffer(&buffer);
+}
+
 int main()
 {
      RUN_TESTS();
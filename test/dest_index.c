@@ -0,0 +1,188 @@
+#include "test.h"
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "dest_index.h"
+#include "destination.h"
+#include "buffer.h"
+
+static DestIndex_t index_of(const int64_t* lines, int64_t count)
+{
+     DestIndex_t index = {};
+     for(int64_t i = 0; i < count; ++i) dest_index_add(&index, lines[i]);
+     index.scanned = lines[count - 1] + 1;
+     return index;
+}
+
+TEST(next_wraps_around)
+{
+     int64_t lines[] = {3, 7, 12};
+     DestIndex_t index = index_of(lines, 3);
+
+     EXPECT(dest_index_next(&index, 0, true) == 0);
+     EXPECT(dest_index_next(&index, 3, true) == 1);
+     EXPECT(dest_index_next(&index, 8, true) == 2);
+     EXPECT(dest_index_next(&index, 12, true) == 0);
+
+     EXPECT(dest_index_next(&index, 12, false) == 1);
+     EXPECT(dest_index_next(&index, 4, false) == 0);
+     EXPECT(dest_index_next(&index, 3, false) == 2);
+
+     dest_index_free(&index);
+     EXPECT(dest_index_next(&index, 0, true) == -1);
+}
+
+TEST(invalidate_drops_changed_lines)
+{
+     int64_t lines[] = {3, 7, 12};
+     DestIndex_t index = index_of(lines, 3);
+
+     dest_index_invalidate(&index, 20);
+     EXPECT(index.count == 3);
+     EXPECT(index.scanned == 13);
+
+     dest_index_invalidate(&index, 7);
+     EXPECT(index.count == 1);
+     EXPECT(index.scanned == 7);
+
+     dest_index_free(&index);
+}
+
+TEST(shift_for_dropped_lines)
+{
+     int64_t lines[] = {3, 7, 12};
+     DestIndex_t index = index_of(lines, 3);
+
+     dest_index_shift(&index, 5);
+     ASSERT(index.count == 2);
+     EXPECT(index.lines[0] == 2);
+     EXPECT(index.lines[1] == 7);
+     EXPECT(index.scanned == 8);
+
+     dest_index_free(&index);
+}
+
+TEST(file_cache)
+{
+     DestFileCache_t cache = {};
+
+     for(int i = 0; i < 100; ++i){
+          char path[64];
+          snprintf(path, sizeof(path), "not_a_file_%d", i);
+          EXPECT(!dest_file_exists(&cache, path));
+     }
+
+     EXPECT(dest_file_exists(&cache, "source/ce.c"));
+     EXPECT(cache.count == 101);
+     EXPECT(dest_file_exists(&cache, "source/ce.c"));
+     EXPECT(!dest_file_exists(&cache, "not_a_file_42"));
+     EXPECT(cache.count == 101);
+
+     dest_file_cache_free(&cache);
+}
+
+TEST(file_cache_misses_expire)
+{
+     DestFileCache_t cache = {};
+
+     char path[] = "/tmp/ce_dest_index_XXXXXX";
+     int fd = mkstemp(path);
+     ASSERT(fd >= 0);
+     close(fd);
+     unlink(path);
+
+     EXPECT(!dest_file_exists(&cache, path));
+
+     // generated after we missed it, like a build's output
+     fd = open(path, O_CREAT | O_WRONLY, 0644);
+     ASSERT(fd >= 0);
+     close(fd);
+
+     EXPECT(!dest_file_exists(&cache, path));
+     usleep((DEST_FILE_MISS_MS + 50) * 1000);
+     EXPECT(dest_file_exists(&cache, path));
+     EXPECT(cache.count == 1);
+
+     unlink(path);
+     dest_file_cache_free(&cache);
+}
+
+TEST(update_finds_destinations)
+{
+     Buffer_t buffer = {};
+     ce_load_string(&buffer, "make\n"
+                             "source/ce.c:12:5: error: oh no\n"
+                             "not_a_file.c:1:1: error: not here\n"
+                             "source/ce.h:7:1: warning: careful");
+
+     char* directory = getcwd(NULL, 0);
+     DestIndex_t index = {};
+     dest_index_update(&index, &buffer, directory);
+
+     ASSERT(index.count == 2);
+     EXPECT(index.lines[0] == 1);
+     EXPECT(index.lines[1] == 3);
+     EXPECT(index.scanned == 4);
+
+     free(directory);
+     dest_index_free(&index);
+     ce_free_buffer(&buffer);
+}
+
+TEST(jump_after_shell_exits)
+{
+     // NOTE: once the shell is reaped, we can't find out where it was
+     pid_t pid = fork();
+     ASSERT(pid >= 0);
+     if(pid == 0) _exit(0);
+     ASSERT(waitpid(pid, NULL, 0) == pid);
+
+     Buffer_t terminal_buffer = {};
+     ce_load_string(&terminal_buffer, "make\n"
+                                      "source/ce.c:12:5: error: oh no");
+
+     TerminalNode_t terminal_node = {};
+     terminal_node.buffer = &terminal_buffer;
+     terminal_node.terminal.pid = pid;
+     ASSERT(dest_index_add(&terminal_node.destinations, 1));
+     terminal_node.destinations.scanned = 2;
+
+     BufferNode_t* head = NULL;
+     ASSERT(ce_append_buffer_to_list(&head, &terminal_buffer));
+
+     BufferView_t terminal_view = {};
+     terminal_view.buffer = &terminal_buffer;
+     BufferView_t view = {};
+     view.buffer = &terminal_buffer;
+
+     TerminalNode_t* terminal_current = &terminal_node;
+     dest_jump_to_next_in_terminal(&head, &terminal_node, &terminal_current, &terminal_view, &view, true);
+
+     EXPECT(view.buffer != &terminal_buffer);
+     EXPECT(strcmp(view.buffer->name, "source/ce.c") == 0);
+     EXPECT(view.cursor.y == 11);
+     EXPECT(view.cursor.x == 4);
+     EXPECT(terminal_view.cursor.y == 1);
+     EXPECT(terminal_node.last_jump_location == 1);
+
+     while(head){
+          BufferNode_t* next = head->next;
+          if(head->buffer != &terminal_buffer){
+               buffer_state_free(head->buffer->user_data);
+               ce_free_buffer(head->buffer);
+               free(head->buffer);
+          }
+          free(head);
+          head = next;
+     }
+
+     dest_index_free(&terminal_node.destinations);
+     ce_free_buffer(&terminal_buffer);
+}
+
+int main()
+{
+     RUN_TESTS();
+}
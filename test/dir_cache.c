@@ -0,0 +1,138 @@
+#include "test.h"
+
+#include "dir_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static const DirEntry_t* find_entry(const DirListing_t* listing, const char* name)
+{
+     for(int64_t i = 0; i < listing->entry_count; ++i){
+          if(strcmp(listing->entries[i].name, name) == 0) return listing->entries + i;
+     }
+
+     return NULL;
+}
+
+TEST(lists_files_and_directories)
+{
+     EXPECT(system("mkdir -p dir_cache_test_dir/sub && touch dir_cache_test_dir/file") == 0);
+     EXPECT(system("ln -s sub dir_cache_test_dir/link") == 0);
+
+     DirCache_t cache;
+     dir_cache_init(&cache);
+     dir_cache_lock(&cache);
+
+     const DirListing_t* listing = dir_cache_list(&cache, "dir_cache_test_dir/");
+     ASSERT(listing);
+     EXPECT(listing->entry_count == 5); // including . and ..
+
+     const DirEntry_t* entry = find_entry(listing, "sub");
+     EXPECT(entry && entry->directory);
+     entry = find_entry(listing, "link");
+     EXPECT(entry && entry->directory);
+     entry = find_entry(listing, "file");
+     EXPECT(entry && !entry->directory);
+
+     // with or without the slash, it is the same listing
+     EXPECT(dir_cache_list(&cache, "dir_cache_test_dir") == listing);
+     EXPECT(cache.listing_count == 1);
+
+     EXPECT(dir_cache_list(&cache, "dir_cache_test_dir/missing") == NULL);
+     EXPECT(cache.listing_count == 1);
+
+     dir_cache_unlock(&cache);
+     dir_cache_free(&cache);
+     EXPECT(system("rm -rf dir_cache_test_dir") == 0);
+}
+
+TEST(changes_are_picked_up)
+{
+     EXPECT(system("mkdir -p dir_cache_test_dir") == 0);
+
+     DirCache_t cache;
+     dir_cache_init(&cache);
+
+     const DirListing_t* listing = dir_cache_list(&cache, "dir_cache_test_dir");
+     ASSERT(listing);
+     EXPECT(listing->entry_count == 2);
+     EXPECT(!listing->stale);
+
+     EXPECT(system("touch dir_cache_test_dir/new") == 0);
+     listing = dir_cache_list(&cache, "dir_cache_test_dir");
+     ASSERT(listing);
+     EXPECT(listing->entry_count == 3);
+     EXPECT(find_entry(listing, "new"));
+
+     EXPECT(system("mv dir_cache_test_dir/new dir_cache_test_dir/renamed") == 0);
+     listing = dir_cache_list(&cache, "dir_cache_test_dir");
+     ASSERT(listing);
+     EXPECT(!find_entry(listing, "new"));
+     EXPECT(find_entry(listing, "renamed"));
+
+     dir_cache_free(&cache);
+     EXPECT(system("rm -rf dir_cache_test_dir") == 0);
+}
+
+TEST(without_inotify)
+{
+     EXPECT(system("mkdir -p dir_cache_test_dir") == 0);
+
+     DirCache_t cache;
+     dir_cache_init(&cache);
+     if(cache.inotify_fd >= 0) close(cache.inotify_fd);
+     cache.inotify_fd = -1;
+
+     const DirListing_t* listing = dir_cache_list(&cache, "dir_cache_test_dir");
+     ASSERT(listing);
+     EXPECT(listing->watch == -1);
+     EXPECT(listing->entry_count == 2);
+
+     EXPECT(system("touch dir_cache_test_dir/new") == 0);
+     listing = dir_cache_list(&cache, "dir_cache_test_dir");
+     ASSERT(listing);
+     EXPECT(listing->entry_count == 3);
+
+     dir_cache_free(&cache);
+     EXPECT(system("rm -rf dir_cache_test_dir") == 0);
+}
+
+TEST(least_recently_used_is_dropped)
+{
+     EXPECT(system("mkdir -p dir_cache_test_dir") == 0);
+
+     DirCache_t cache;
+     dir_cache_init(&cache);
+
+     char path[256];
+     for(int64_t i = 0; i <= DIR_CACHE_MAX_LISTINGS; ++i){
+          // NOTE: the same directory through different paths, which also shares one watch between them all
+          snprintf(path, 256, "%s%s", (i % 2) ? "./" : "", "dir_cache_test_dir");
+          for(int64_t dots = 0; dots < i / 2; ++dots) strcat(path, "/.");
+          EXPECT(dir_cache_list(&cache, path));
+     }
+
+     EXPECT(cache.listing_count == DIR_CACHE_MAX_LISTINGS);
+
+     // the first one we listed is the one that went
+     bool found = false;
+     for(int64_t i = 0; i < cache.listing_count; ++i){
+          if(strcmp(cache.listings[i].path, "dir_cache_test_dir") == 0) found = true;
+     }
+     EXPECT(!found);
+
+     // the rest are still being watched
+     EXPECT(system("touch dir_cache_test_dir/new") == 0);
+     const DirListing_t* listing = dir_cache_list(&cache, "./dir_cache_test_dir");
+     ASSERT(listing);
+     EXPECT(listing->entry_count == 3);
+
+     dir_cache_free(&cache);
+     EXPECT(system("rm -rf dir_cache_test_dir") == 0);
+}
+
+int main()
+{
+     RUN_TESTS();
+}
@@ -0,0 +1,241 @@
+#include "test.h"
+
+#include "file_index.h"
+
+#include <ftw.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static char project[] = "/tmp/ce_file_index_XXXXXX";
+
+static void write_file(const char* name, const char* text)
+{
+     char path[BUFSIZ];
+     snprintf(path, sizeof(path), "%s/%s", project, name);
+     FILE* file = fopen(path, "w");
+     fputs(text, file);
+     fclose(file);
+}
+
+static void make_directory(const char* name)
+{
+     char path[BUFSIZ];
+     snprintf(path, sizeof(path), "%s/%s", project, name);
+     mkdir(path, 0755);
+}
+
+static bool wait_for_generation(FileIndex_t* index, uint64_t generation)
+{
+     for(int i = 0; i < 5000; ++i){
+          if(file_index_generation(index) >= generation) return true;
+          usleep(1000);
+     }
+
+     return false;
+}
+
+static int compare_path(const void* a, const void* b)
+{
+     return strcmp(*(const char**)(a), *(const char**)(b));
+}
+
+static bool indexed(FileIndex_t* index, const char* path)
+{
+     file_index_lock(index);
+     const FileTable_t* table = file_index_table(index);
+     bool found = bsearch(&path, table->paths, table->count, sizeof(*table->paths), compare_path) != NULL;
+     file_index_unlock(index);
+     return found;
+}
+
+static bool wait_for_indexed(FileIndex_t* index, const char* path, bool expected)
+{
+     for(int i = 0; i < 5000; ++i){
+          if(indexed(index, path) == expected) return true;
+          usleep(1000);
+     }
+
+     return false;
+}
+
+static int remove_entry(const char* path, const struct stat* info, int flag, struct FTW* ftw)
+{
+     (void)(info);
+     (void)(flag);
+     (void)(ftw);
+     return remove(path);
+}
+
+TEST(glob_match)
+{
+     EXPECT(file_index_glob_match("*.o", "ce.o"));
+     EXPECT(!file_index_glob_match("*.o", "ce.c"));
+     EXPECT(!file_index_glob_match("*.o", "build/ce.o")); // * doesn't cross directories
+     EXPECT(file_index_glob_match("build/*.o", "build/ce.o"));
+     EXPECT(file_index_glob_match("**/ce.o", "ce.o"));
+     EXPECT(file_index_glob_match("**/ce.o", "a/b/ce.o"));
+     EXPECT(file_index_glob_match("a/**/ce.o", "a/ce.o"));
+     EXPECT(file_index_glob_match("a/**/ce.o", "a/b/c/ce.o"));
+     EXPECT(!file_index_glob_match("a/**/ce.o", "b/a/ce.o"));
+     EXPECT(file_index_glob_match("build/**", "build/a/b"));
+     EXPECT(file_index_glob_match("ce_?.c", "ce_x.c"));
+     EXPECT(!file_index_glob_match("ce_?.c", "ce_.c"));
+     EXPECT(file_index_glob_match("[a-c]x", "bx"));
+     EXPECT(!file_index_glob_match("[!a-c]x", "bx"));
+     EXPECT(file_index_glob_match("\\*", "*"));
+     EXPECT(!file_index_glob_match("\\*", "x"));
+}
+
+TEST(index_walks_watches_and_persists)
+{
+     ASSERT(mkdtemp(project));
+
+     make_directory("source");
+     make_directory("build");
+     make_directory("deep");
+     make_directory("deep/er");
+     make_directory(".git");
+     write_file(".gitignore", "build/\n*.o\n!keep.o\n/top.txt\n");
+     write_file("source/.gitignore", "generated.c\n");
+     write_file("source/ce.c", "");
+     write_file("source/generated.c", "");
+     write_file("build/ce.o", "");
+     write_file("ce.o", "");
+     write_file("keep.o", "");
+     write_file("top.txt", "");
+     write_file("deep/top.txt", "");
+     write_file("deep/er/file", "");
+     write_file(".git/HEAD", "");
+     write_file(".ce_symbols", "");
+     write_file(".ce_symbols.tmp", "");
+
+     char path[BUFSIZ];
+     snprintf(path, sizeof(path), "%s/link", project);
+     EXPECT(symlink("source", path) == 0);
+
+     FileIndex_t index;
+     ASSERT(file_index_start(&index, project, 2));
+     ASSERT(wait_for_generation(&index, 1));
+
+     EXPECT(indexed(&index, ".gitignore"));
+     EXPECT(indexed(&index, "source/ce.c"));
+     EXPECT(indexed(&index, "source/.gitignore"));
+     EXPECT(indexed(&index, "keep.o"));
+     EXPECT(indexed(&index, "deep/top.txt")); // the pattern was anchored to the root
+     EXPECT(indexed(&index, "deep/er/file"));
+     EXPECT(!indexed(&index, "source/generated.c"));
+     EXPECT(!indexed(&index, "build/ce.o"));
+     EXPECT(!indexed(&index, "ce.o"));
+     EXPECT(!indexed(&index, "top.txt"));
+     EXPECT(!indexed(&index, ".git/HEAD"));
+     EXPECT(!indexed(&index, "link"));
+     EXPECT(!indexed(&index, "link/ce.c"));
+     EXPECT(!indexed(&index, ".ce_symbols"));
+     EXPECT(!indexed(&index, ".ce_symbols.tmp"));
+
+     file_index_lock(&index);
+     EXPECT(file_index_table(&index)->count == 6);
+     file_index_unlock(&index);
+
+     // inotify keeps it fresh
+     write_file("source/new.c", "");
+     ASSERT(wait_for_indexed(&index, "source/new.c", true));
+     write_file("source/new.o", "");
+
+     make_directory("fresh");
+     write_file("fresh/file", "");
+     EXPECT(wait_for_indexed(&index, "fresh/file", true));
+
+     snprintf(path, sizeof(path), "%s/deep", project);
+     char moved[BUFSIZ];
+     snprintf(moved, sizeof(moved), "%s/moved", project);
+     EXPECT(rename(path, moved) == 0);
+     EXPECT(wait_for_indexed(&index, "moved/er/file", true));
+     EXPECT(wait_for_indexed(&index, "deep/er/file", false));
+
+     // files made under a moved directory land under its new name
+     write_file("moved/er/after", "");
+     EXPECT(wait_for_indexed(&index, "moved/er/after", true));
+
+     // a directory moved out of the project is forgotten, along with whatever lands in it afterwards
+     char outside[] = "/tmp/ce_file_index_out_XXXXXX";
+     ASSERT(mkdtemp(outside));
+     make_directory("leaving");
+     make_directory("leaving/sub");
+     write_file("leaving/sub/file", "");
+     ASSERT(wait_for_indexed(&index, "leaving/sub/file", true));
+
+     snprintf(path, sizeof(path), "%s/leaving", project);
+     char gone[BUFSIZ];
+     snprintf(gone, sizeof(gone), "%s/leaving", outside);
+     EXPECT(rename(path, gone) == 0);
+     EXPECT(wait_for_indexed(&index, "leaving/sub/file", false));
+
+     snprintf(path, sizeof(path), "%s/leaving/sub/phantom", outside);
+     FILE* phantom = fopen(path, "w");
+     if(phantom) fclose(phantom);
+     write_file("marker", "");
+     ASSERT(wait_for_indexed(&index, "marker", true));
+     EXPECT(!indexed(&index, "leaving/sub/phantom"));
+
+     // so do changes to what is ignored
+     write_file("source/.gitignore", "ce.c\n");
+     EXPECT(wait_for_indexed(&index, "source/generated.c", true));
+     EXPECT(wait_for_indexed(&index, "source/ce.c", false));
+
+     EXPECT(!indexed(&index, "source/new.o"));
+
+     file_index_stop(&index);
+
+     snprintf(path, sizeof(path), "%s/%s", project, FILE_INDEX_FILE);
+     EXPECT(access(path, F_OK) == 0);
+
+     // the next start hands out what we saw before it walks
+     write_file("offline", "");
+     ASSERT(file_index_start(&index, project, 1));
+     ASSERT(wait_for_generation(&index, 1));
+     EXPECT(indexed(&index, "moved/er/after"));
+     EXPECT(wait_for_indexed(&index, "offline", true));
+     EXPECT(!indexed(&index, FILE_INDEX_FILE));
+     file_index_stop(&index);
+
+     nftw(project, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+     nftw(outside, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+TEST(index_rejects_corrupt_file)
+{
+     char dir[] = "/tmp/ce_file_index_XXXXXX";
+     ASSERT(mkdtemp(dir));
+
+     char path[BUFSIZ];
+     snprintf(path, sizeof(path), "%s/%s", dir, FILE_INDEX_FILE);
+     FILE* file = fopen(path, "w");
+     fputs("CEFILES but not really an index", file);
+     fclose(file);
+
+     snprintf(path, sizeof(path), "%s/only", dir);
+     file = fopen(path, "w");
+     fclose(file);
+
+     FileIndex_t index;
+     ASSERT(file_index_start(&index, dir, 1));
+     ASSERT(wait_for_generation(&index, 1));
+
+     file_index_lock(&index);
+     const FileTable_t* table = file_index_table(&index);
+     EXPECT(table->count == 1);
+     EXPECT(table->count == 1 && strcmp(table->paths[0], "only") == 0);
+     file_index_unlock(&index);
+
+     file_index_stop(&index);
+
+     nftw(dir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+int main()
+{
+     RUN_TESTS();
+}
@@ -0,0 +1,79 @@
+#include "test.h"
+
+#include "fuzzy.h"
+
+#include <string.h>
+
+static int32_t score(const char* pattern_text, const char* candidate)
+{
+     FuzzyPattern_t pattern;
+     fuzzy_pattern_init(&pattern, pattern_text);
+     return fuzzy_score(&pattern, candidate, strlen(candidate));
+}
+
+TEST(subsequence_in_order)
+{
+     EXPECT(score("cfg", "ce_config.c") != FUZZY_NO_MATCH);
+     EXPECT(score("gfc", "ce_config.c") == FUZZY_NO_MATCH);
+     EXPECT(score("cex", "ce_config.c") == FUZZY_NO_MATCH);
+     EXPECT(score("", "anything") == 0);
+}
+
+TEST(smart_case)
+{
+     EXPECT(score("readme", "README.md") != FUZZY_NO_MATCH);
+     EXPECT(score("Readme", "README.md") == FUZZY_NO_MATCH);
+     EXPECT(score("README", "README.md") != FUZZY_NO_MATCH);
+}
+
+TEST(boundaries_and_runs_rank_higher)
+{
+     // starting words beats landing in the middle of them
+     EXPECT(score("cc", "ce_config.c") > score("cc", "account"));
+     EXPECT(score("tc", "test/completion.c") > score("tc", "source/attach.c"));
+     EXPECT(score("bV", "bufferView") > score("bv", "obvious"));
+
+     // characters that run together beat scattered ones
+     EXPECT(score("view", "view.c") > score("view", "vim_iterate_word.c"));
+
+     // the tightest place the pattern fits is what gets scored
+     EXPECT(score("ab", "a____ab") == score("ab", "ab"));
+}
+
+TEST(mask_rejects_missing_characters)
+{
+     FuzzyPattern_t pattern;
+     fuzzy_pattern_init(&pattern, "Qz");
+
+     uint64_t has = fuzzy_mask("quiz", 4);
+     uint64_t lacks = fuzzy_mask("quit", 4);
+     EXPECT((pattern.mask & ~has) == 0);
+     EXPECT((pattern.mask & ~lacks) != 0);
+}
+
+TEST(sort_best)
+{
+     FuzzyMatch_t matches[100];
+     for(int64_t i = 0; i < 100; ++i){
+          matches[i] = (FuzzyMatch_t){i, (int32_t)((i * 37) % 100), 10};
+     }
+
+     fuzzy_sort_best(matches, 100, 5);
+
+     // scores are a permutation of 0-99, so the best five are 99 down to 95
+     for(int64_t i = 0; i < 5; ++i){
+          EXPECT(matches[i].score == 99 - i);
+     }
+
+     // ties go to the shorter candidate, then to whichever came first
+     FuzzyMatch_t ties[3] = {{0, 5, 8}, {1, 5, 4}, {2, 5, 4}};
+     fuzzy_sort_best(ties, 3, 3);
+     EXPECT(ties[0].index == 1);
+     EXPECT(ties[1].index == 2);
+     EXPECT(ties[2].index == 0);
+}
+
+int main()
+{
+     RUN_TESTS();
+}
@@ -0,0 +1,77 @@
+#include "test.h"
+
+#include "json.h"
+
+static bool parse(const char* text, JsonValue_t* value)
+{
+     return json_parse(text, strlen(text), value);
+}
+
+TEST(parse_nested)
+{
+     JsonValue_t value;
+     ASSERT(parse("{\"id\": 3, \"result\": {\"items\": [{\"label\": \"foo\"}, {\"label\": \"bar\"}], \"done\": true},"
+                  " \"error\": null, \"pi\": -3.5e0}", &value));
+
+     EXPECT(json_get_int(&value, "id", -1) == 3);
+     EXPECT(json_get(&value, "error")->type == JSON_NULL);
+     EXPECT(json_get(&value, "pi")->number == -3.5);
+     EXPECT(json_get(json_get(&value, "result"), "done")->boolean);
+
+     const JsonValue_t* items = json_get(json_get(&value, "result"), "items");
+     ASSERT(items && items->count == 2);
+     EXPECT(strcmp(json_get_string(json_at(items, 1), "label"), "bar") == 0);
+
+     // lookups on the wrong type, or that are missing, chain through as NULL
+     EXPECT(json_at(items, 2) == NULL);
+     EXPECT(json_get(items, "label") == NULL);
+     EXPECT(json_get_string(json_get(&value, "nope"), "label") == NULL);
+     EXPECT(json_get_int(&value, "result", 7) == 7);
+
+     json_free(&value);
+}
+
+TEST(parse_escapes)
+{
+     JsonValue_t value;
+     ASSERT(parse("\"tab\\there \\\"quoted\\\" \\u00e9 \\ud83d\\ude00\"", &value));
+     ASSERT(value.type == JSON_STRING);
+     EXPECT(strcmp(value.string, "tab\there \"quoted\" \xc3\xa9 \xf0\x9f\x98\x80") == 0);
+     json_free(&value);
+}
+
+TEST(parse_rejects_malformed)
+{
+     JsonValue_t value;
+     EXPECT(!parse("", &value));
+     EXPECT(!parse("{\"a\": 1", &value));
+     EXPECT(!parse("{\"a\" 1}", &value));
+     EXPECT(!parse("[1, 2,]", &value));
+     EXPECT(!parse("\"unterminated", &value));
+     EXPECT(!parse("tru", &value));
+     EXPECT(!parse("{} {}", &value));
+}
+
+TEST(build_round_trip)
+{
+     const char* text = "line one\nsaid \"hi\"\\\x01";
+
+     JsonBuilder_t builder = {};
+     json_append(&builder, "{\"text\":");
+     json_append_string(&builder, text, strlen(text));
+     json_append(&builder, ",\"count\":%d}", 42);
+     EXPECT(strcmp(builder.text, "{\"text\":\"line one\\nsaid \\\"hi\\\"\\\\\\u0001\",\"count\":42}") == 0);
+
+     JsonValue_t value;
+     ASSERT(json_parse(builder.text, builder.length, &value));
+     EXPECT(strcmp(json_get_string(&value, "text"), text) == 0);
+     EXPECT(json_get_int(&value, "count", 0) == 42);
+
+     json_free(&value);
+     json_builder_free(&builder);
+}
+
+int main()
+{
+     RUN_TESTS();
+}
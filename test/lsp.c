@@ -0,0 +1,450 @@
+#include "test.h"
+
+#include <inttypes.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lsp.h"
+
+// a stand-in for the server, the test reads what the client writes and scripts the answers
+typedef struct{
+     int to_client;
+     int from_client;
+     char incoming[1 << 16];
+     int64_t incoming_length;
+}Server_t;
+
+// what the client handed to the handler
+typedef struct{
+     pthread_mutex_t lock;
+     pthread_cond_t changed;
+     int64_t count;
+     LspRequestType_t type;
+     int64_t id;
+     char detail[256];
+}Handled_t;
+
+static void handle(LspClient_t* client, const LspResponse_t* response, void* data)
+{
+     (void)(client);
+     Handled_t* handled = data;
+
+     pthread_mutex_lock(&handled->lock);
+
+     handled->type = response->type;
+     handled->id = response->id;
+     handled->detail[0] = 0;
+     if(response->type == LRT_COMPLETION){
+          const char* label = json_get_string(json_at(json_get(response->result, "items"), 0), "label");
+          if(label) snprintf(handled->detail, sizeof(handled->detail), "%s", label);
+     }else if(response->type == LRT_DIAGNOSTICS){
+          snprintf(handled->detail, sizeof(handled->detail), "%s", response->uri);
+     }
+     handled->count++;
+
+     pthread_cond_signal(&handled->changed);
+     pthread_mutex_unlock(&handled->lock);
+}
+
+static bool wait_for_handled(Handled_t* handled, int64_t count)
+{
+     struct timespec deadline;
+     clock_gettime(CLOCK_REALTIME, &deadline);
+     deadline.tv_sec += 2;
+
+     pthread_mutex_lock(&handled->lock);
+     while(handled->count < count){
+          if(pthread_cond_timedwait(&handled->changed, &handled->lock, &deadline) != 0) break;
+     }
+     bool reached = handled->count >= count;
+     pthread_mutex_unlock(&handled->lock);
+     return reached;
+}
+
+// false if nothing complete shows up in time
+static bool server_read(Server_t* server, JsonValue_t* message, int timeout_ms)
+{
+     while(true){
+          char* header_end = memmem(server->incoming, server->incoming_length, "\r\n\r\n", 4);
+          if(header_end){
+               int64_t content_length = strtoll(server->incoming + strlen("Content-Length:"), NULL, 10);
+               int64_t header_length = (header_end + 4) - server->incoming;
+               if(server->incoming_length - header_length >= content_length){
+                    bool parsed = json_parse(header_end + 4, content_length, message);
+                    server->incoming_length -= header_length + content_length;
+                    memmove(server->incoming, server->incoming + header_length + content_length, server->incoming_length);
+                    return parsed;
+               }
+          }
+
+          struct pollfd fd = {server->from_client, POLLIN, 0};
+          if(poll(&fd, 1, timeout_ms) <= 0) return false;
+
+          ssize_t bytes = read(server->from_client, server->incoming + server->incoming_length,
+                               sizeof(server->incoming) - server->incoming_length);
+          if(bytes <= 0) return false;
+          server->incoming_length += bytes;
+     }
+}
+
+static void server_send(Server_t* server, const char* json)
+{
+     char header[64];
+     int header_length = snprintf(header, sizeof(header), "Content-Length: %zu\r\n\r\n", strlen(json));
+     if(write(server->to_client, header, header_length) != header_length) return;
+     if(write(server->to_client, json, strlen(json)) < 0) return;
+}
+
+static bool method_is(const JsonValue_t* message, const char* method)
+{
+     const char* message_method = json_get_string(message, "method");
+     return message_method && strcmp(message_method, method) == 0;
+}
+
+static bool connect_client(LspClient_t* client, Server_t* server, Handled_t* handled)
+{
+     signal(SIGPIPE, SIG_IGN);
+
+     int to_server[2];
+     int from_server[2];
+     if(pipe(to_server) != 0 || pipe(from_server) != 0) return false;
+
+     *server = (Server_t){};
+     server->to_client = from_server[1];
+     server->from_client = to_server[0];
+
+     *handled = (Handled_t){};
+     pthread_mutex_init(&handled->lock, NULL);
+     pthread_cond_init(&handled->changed, NULL);
+
+     return lsp_connect(client, to_server[1], from_server[0], ".", handle, handled);
+}
+
+static bool initialize(Server_t* server, const char* capabilities)
+{
+     JsonValue_t message;
+     if(!server_read(server, &message, 1000)) return false;
+     bool asked = method_is(&message, "initialize") && json_get_int(&message, "id", -1) == 1;
+     json_free(&message);
+     if(!asked) return false;
+
+     char response[256];
+     snprintf(response, sizeof(response), "{\"jsonrpc\":\"2.0\",\"id\":1,\"result\":{\"capabilities\":%s}}", capabilities);
+     server_send(server, response);
+
+     if(!server_read(server, &message, 1000)) return false;
+     bool initialized = method_is(&message, "initialized");
+     json_free(&message);
+     return initialized;
+}
+
+static void disconnect(LspClient_t* client, Server_t* server)
+{
+     lsp_stop(client);
+     close(server->to_client);
+     close(server->from_client);
+}
+
+// the single range change in a didChange, false if it isn't one
+static bool read_change(Server_t* server, Point_t* start, Point_t* end, char* text, int64_t text_size)
+{
+     JsonValue_t message;
+     if(!server_read(server, &message, 1000)) return false;
+
+     const JsonValue_t* changes = json_get(json_get(&message, "params"), "contentChanges");
+     const JsonValue_t* range = json_get(json_at(changes, 0), "range");
+     const char* change_text = json_get_string(json_at(changes, 0), "text");
+     bool valid = method_is(&message, "textDocument/didChange") && changes->count == 1 && range && change_text;
+     if(valid){
+          const JsonValue_t* range_start = json_get(range, "start");
+          const JsonValue_t* range_end = json_get(range, "end");
+          *start = (Point_t){json_get_int(range_start, "character", -1), json_get_int(range_start, "line", -1)};
+          *end = (Point_t){json_get_int(range_end, "character", -1), json_get_int(range_end, "line", -1)};
+          snprintf(text, text_size, "%s", change_text);
+     }
+
+     json_free(&message);
+     return valid;
+}
+
+TEST(messages_wait_for_initialize)
+{
+     LspClient_t client;
+     Server_t server;
+     Handled_t handled;
+     ASSERT(connect_client(&client, &server, &handled));
+
+     Buffer_t buffer = {};
+     ce_load_string(&buffer, "int main(){\n     return 0;\n}");
+     buffer.filename = strdup("main.c");
+     BufferCommitNode_t* tail = calloc(1, sizeof(*tail));
+
+     // read the initialize request, but don't answer it yet
+     JsonValue_t message;
+     ASSERT(server_read(&server, &message, 1000));
+     EXPECT(method_is(&message, "initialize"));
+     json_free(&message);
+
+     EXPECT(lsp_open_document(&client, &buffer, tail, "c"));
+     EXPECT(!server_read(&server, &message, 50));
+     EXPECT(!lsp_ready(&client));
+
+     server_send(&server, "{\"jsonrpc\":\"2.0\",\"id\":1,\"result\":{\"capabilities\":{\"textDocumentSync\":2}}}");
+
+     ASSERT(server_read(&server, &message, 1000));
+     EXPECT(method_is(&message, "initialized"));
+     json_free(&message);
+
+     ASSERT(server_read(&server, &message, 1000));
+     EXPECT(method_is(&message, "textDocument/didOpen"));
+     const JsonValue_t* text_document = json_get(json_get(&message, "params"), "textDocument");
+     const char* uri = json_get_string(text_document, "uri");
+     EXPECT(uri && strncmp(uri, "file:///", 8) == 0 && strstr(uri, "/main.c"));
+     EXPECT(strcmp(json_get_string(text_document, "languageId"), "c") == 0);
+     EXPECT(strcmp(json_get_string(text_document, "text"), "int main(){\n     return 0;\n}") == 0);
+     json_free(&message);
+
+     EXPECT(lsp_running(&client));
+     EXPECT(lsp_ready(&client));
+     disconnect(&client, &server);
+     ce_commits_free(tail);
+     ce_free_buffer(&buffer);
+}
+
+TEST(sync_follows_commits)
+{
+     LspClient_t client;
+     Server_t server;
+     Handled_t handled;
+     ASSERT(connect_client(&client, &server, &handled));
+     ASSERT(initialize(&server, "{\"textDocumentSync\":{\"openClose\":true,\"change\":2}}"));
+
+     Buffer_t buffer = {};
+     ce_load_string(&buffer, "int main(){\n     return 0;\n}");
+     buffer.filename = strdup("main.c");
+     BufferCommitNode_t* tail = calloc(1, sizeof(*tail));
+     BufferCommitNode_t* head = tail;
+
+     EXPECT(lsp_open_document(&client, &buffer, tail, "c"));
+     JsonValue_t message;
+     ASSERT(server_read(&server, &message, 1000));
+     json_free(&message);
+
+     // nothing changed, nothing to send
+     EXPECT(!lsp_sync_document(&client, &buffer, tail));
+
+     Point_t start = {};
+     Point_t end = {};
+     char text[256];
+
+     // a new line inside the function
+     Point_t at = {11, 0};
+     ce_insert_string(&buffer, at, "\n     int x;");
+     ce_commit_insert_string(&tail, at, at, at, strdup("\n     int x;"), BCC_STOP);
+     EXPECT(lsp_sync_document(&client, &buffer, tail));
+     ASSERT(read_change(&server, &start, &end, text, sizeof(text)));
+     EXPECT(ce_points_equal(start, at) && ce_points_equal(end, at));
+     EXPECT(strcmp(text, "\n     int x;") == 0);
+
+     // undoing it sends the removal, over both lines
+     Point_t cursor;
+     ce_commit_undo(&buffer, &tail, &cursor);
+     EXPECT(lsp_sync_document(&client, &buffer, tail));
+     ASSERT(read_change(&server, &start, &end, text, sizeof(text)));
+     EXPECT(ce_points_equal(start, at));
+     EXPECT(end.x == 11 && end.y == 1);
+     EXPECT(text[0] == 0);
+
+     // redo sends it again
+     ce_commit_redo(&buffer, &tail, &cursor);
+     EXPECT(lsp_sync_document(&client, &buffer, tail));
+     ASSERT(read_change(&server, &start, &end, text, sizeof(text)));
+     EXPECT(strcmp(text, "\n     int x;") == 0);
+
+     // undo then change without syncing between, the history the server saw is gone so it gets everything
+     ce_commit_undo(&buffer, &tail, &cursor);
+     ce_remove_string(&buffer, (Point_t){5, 1}, 6);
+     ce_commit_remove_string(&tail, (Point_t){5, 1}, (Point_t){5, 1}, (Point_t){5, 1}, strdup("return"), BCC_STOP);
+     EXPECT(lsp_sync_document(&client, &buffer, tail));
+     ASSERT(server_read(&server, &message, 1000));
+     const JsonValue_t* change = json_at(json_get(json_get(&message, "params"), "contentChanges"), 0);
+     EXPECT(json_get(change, "range") == NULL);
+     EXPECT(strcmp(json_get_string(change, "text"), "int main(){\n      0;\n}") == 0);
+     EXPECT(json_get_int(json_get(json_get(&message, "params"), "textDocument"), "version", 0) == 5);
+     json_free(&message);
+
+     lsp_close_document(&client, &buffer);
+     ASSERT(server_read(&server, &message, 1000));
+     EXPECT(method_is(&message, "textDocument/didClose"));
+     json_free(&message);
+     EXPECT(!lsp_document_open(&client, &buffer));
+
+     disconnect(&client, &server);
+     ce_commits_free(head);
+     ce_free_buffer(&buffer);
+}
+
+TEST(full_sync_when_not_incremental)
+{
+     LspClient_t client;
+     Server_t server;
+     Handled_t handled;
+     ASSERT(connect_client(&client, &server, &handled));
+     ASSERT(initialize(&server, "{\"textDocumentSync\":1}"));
+
+     Buffer_t buffer = {};
+     ce_load_string(&buffer, "abc");
+     buffer.filename = strdup("/tmp/a b.c");
+     BufferCommitNode_t* tail = calloc(1, sizeof(*tail));
+     BufferCommitNode_t* head = tail;
+
+     EXPECT(lsp_open_document(&client, &buffer, tail, "c"));
+     JsonValue_t message;
+     ASSERT(server_read(&server, &message, 1000));
+     EXPECT(strcmp(json_get_string(json_get(json_get(&message, "params"), "textDocument"), "uri"), "file:///tmp/a%20b.c") == 0);
+     json_free(&message);
+
+     ce_insert_char(&buffer, (Point_t){3, 0}, 'd');
+     ce_commit_insert_char(&tail, (Point_t){3, 0}, (Point_t){3, 0}, (Point_t){4, 0}, 'd', BCC_STOP);
+     EXPECT(lsp_sync_document(&client, &buffer, tail));
+     ASSERT(server_read(&server, &message, 1000));
+     const JsonValue_t* change = json_at(json_get(json_get(&message, "params"), "contentChanges"), 0);
+     EXPECT(strcmp(json_get_string(change, "text"), "abcd") == 0);
+     json_free(&message);
+
+     disconnect(&client, &server);
+     ce_commits_free(head);
+     ce_free_buffer(&buffer);
+}
+
+TEST(responses_reach_the_handler)
+{
+     LspClient_t client;
+     Server_t server;
+     Handled_t handled;
+     ASSERT(connect_client(&client, &server, &handled));
+     ASSERT(initialize(&server, "{\"textDocumentSync\":2}"));
+
+     Buffer_t buffer = {};
+     ce_load_string(&buffer, "int main(){\n     ret\n}");
+     buffer.filename = strdup("main.c");
+     BufferCommitNode_t* tail = calloc(1, sizeof(*tail));
+
+     EXPECT(lsp_open_document(&client, &buffer, tail, "c"));
+     JsonValue_t message;
+     ASSERT(server_read(&server, &message, 1000));
+     json_free(&message);
+
+     int64_t id = lsp_request(&client, LRT_COMPLETION, &buffer, (Point_t){8, 1});
+     ASSERT(id > 1);
+     ASSERT(server_read(&server, &message, 1000));
+     EXPECT(method_is(&message, "textDocument/completion"));
+     EXPECT(json_get_int(&message, "id", -1) == id);
+     const JsonValue_t* position = json_get(json_get(&message, "params"), "position");
+     EXPECT(json_get_int(position, "line", -1) == 1);
+     EXPECT(json_get_int(position, "character", -1) == 8);
+     json_free(&message);
+
+     // the server asking us something gets a null answer, rather than leaving it hanging
+     server_send(&server, "{\"jsonrpc\":\"2.0\",\"id\":\"progress\",\"method\":\"window/workDoneProgress/create\",\"params\":{}}");
+     ASSERT(server_read(&server, &message, 1000));
+     EXPECT(strcmp(json_get_string(&message, "id"), "progress") == 0);
+     EXPECT(json_get(&message, "result")->type == JSON_NULL);
+     json_free(&message);
+
+     char response[256];
+     snprintf(response, sizeof(response), "{\"jsonrpc\":\"2.0\",\"id\":%"PRId64",\"result\":{\"isIncomplete\":false,"
+              "\"items\":[{\"label\":\"return\"}]}}", id);
+     server_send(&server, response);
+     ASSERT(wait_for_handled(&handled, 1));
+     EXPECT(handled.type == LRT_COMPLETION);
+     EXPECT(handled.id == id);
+     EXPECT(strcmp(handled.detail, "return") == 0);
+
+     // canceled requests tell the server, and whatever it answers anyway is dropped
+     int64_t canceled_id = lsp_request(&client, LRT_HOVER, &buffer, (Point_t){5, 1});
+     ASSERT(server_read(&server, &message, 1000));
+     json_free(&message);
+     lsp_cancel(&client, canceled_id);
+     ASSERT(server_read(&server, &message, 1000));
+     EXPECT(method_is(&message, "$/cancelRequest"));
+     EXPECT(json_get_int(json_get(&message, "params"), "id", -1) == canceled_id);
+     json_free(&message);
+
+     snprintf(response, sizeof(response), "{\"jsonrpc\":\"2.0\",\"id\":%"PRId64",\"result\":null}", canceled_id);
+     server_send(&server, response);
+
+     // diagnostics are kept on the document
+     char* uri = lsp_path_to_uri(client.root, "main.c");
+     snprintf(response, sizeof(response), "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\",\"params\":"
+              "{\"uri\":\"%s\",\"diagnostics\":[{\"range\":{\"start\":{\"line\":1,\"character\":5},"
+              "\"end\":{\"line\":1,\"character\":8}},\"severity\":1,\"message\":\"undeclared\"}]}}", uri);
+     server_send(&server, response);
+     ASSERT(wait_for_handled(&handled, 2));
+     EXPECT(handled.type == LRT_DIAGNOSTICS);
+     EXPECT(strcmp(handled.detail, uri) == 0);
+     EXPECT(handled.count == 2);
+     EXPECT(lsp_diagnostic_count(&client, &buffer, LDS_ERROR) == 1);
+     EXPECT(lsp_diagnostic_count(&client, &buffer, LDS_WARNING) == 0);
+     free(uri);
+
+     // the server going away is reported too
+     close(server.to_client);
+     ASSERT(wait_for_handled(&handled, 3));
+     EXPECT(handled.type == LRT_EXIT);
+     EXPECT(!lsp_running(&client));
+     EXPECT(!lsp_ready(&client));
+
+     lsp_stop(&client);
+     close(server.from_client);
+     ce_commits_free(tail);
+     ce_free_buffer(&buffer);
+}
+
+TEST(missing_server_is_never_ready)
+{
+     Handled_t handled = {};
+     pthread_mutex_init(&handled.lock, NULL);
+     pthread_cond_init(&handled.changed, NULL);
+
+     LspClient_t client;
+     ASSERT(lsp_start(&client, "ce_test_server_that_is_not_installed", ".", handle, &handled));
+
+     // not before the shell gives up on it, nor after
+     EXPECT(!lsp_ready(&client));
+     ASSERT(wait_for_handled(&handled, 1));
+     EXPECT(handled.type == LRT_EXIT);
+     EXPECT(!lsp_ready(&client));
+
+     lsp_stop(&client);
+}
+
+TEST(results)
+{
+     JsonValue_t value;
+     const char* links = "[{\"targetUri\":\"file:///src/a%20b.c\",\"targetRange\":{},"
+                         "\"targetSelectionRange\":{\"start\":{\"line\":4,\"character\":2}}}]";
+     ASSERT(json_parse(links, strlen(links), &value));
+
+     char path[64];
+     Point_t position;
+     EXPECT(lsp_location(&value, path, sizeof(path), &position));
+     EXPECT(strcmp(path, "/src/a b.c") == 0);
+     EXPECT(position.x == 2 && position.y == 4);
+     EXPECT(!lsp_location(&value, path, 4, &position));
+     json_free(&value);
+
+     const char* hover = "{\"contents\":{\"kind\":\"plaintext\",\"value\":\"int x\"}}";
+     ASSERT(json_parse(hover, strlen(hover), &value));
+     char* text = lsp_hover_text(&value);
+     EXPECT(text && strcmp(text, "int x") == 0);
+     free(text);
+     json_free(&value);
+}
+
+int main()
+{
+     RUN_TESTS();
+}
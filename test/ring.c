@@ -0,0 +1,71 @@
+#include "test.h"
+
+#include "ring.h"
+
+TEST(sanity)
+{
+     Ring_t ring = {};
+     ASSERT(ring_init(&ring, 10));
+     EXPECT(ring.size == 16);
+     EXPECT(ring_readable(&ring) == 0);
+     EXPECT(ring_writable(&ring) == 16);
+
+     EXPECT(ring_write(&ring, "TACOS", 5));
+     EXPECT(ring_readable(&ring) == 5);
+     EXPECT(ring_writable(&ring) == 11);
+
+     char data[16] = {};
+     EXPECT(ring_peek(&ring, data, 5));
+     EXPECT(strncmp(data, "TACOS", 5) == 0);
+     EXPECT(ring_readable(&ring) == 5);
+
+     memset(data, 0, sizeof(data));
+     EXPECT(ring_read(&ring, data, 5));
+     EXPECT(strncmp(data, "TACOS", 5) == 0);
+     EXPECT(ring_readable(&ring) == 0);
+
+     ring_free(&ring);
+}
+
+TEST(all_or_nothing)
+{
+     Ring_t ring = {};
+     ASSERT(ring_init(&ring, 8));
+
+     EXPECT(!ring_write(&ring, "123456789", 9));
+     EXPECT(ring_readable(&ring) == 0);
+
+     EXPECT(ring_write(&ring, "12345678", 8));
+     EXPECT(!ring_write(&ring, "9", 1));
+
+     char data[9] = {};
+     EXPECT(!ring_read(&ring, data, 9));
+     EXPECT(ring_readable(&ring) == 8);
+
+     ring_free(&ring);
+}
+
+TEST(wrap_around)
+{
+     Ring_t ring = {};
+     ASSERT(ring_init(&ring, 8));
+
+     char data[8] = {};
+     EXPECT(ring_write(&ring, "123456", 6));
+     EXPECT(ring_read(&ring, data, 6));
+
+     // writing 5 more bytes runs off the end of the ring and wraps to the front
+     EXPECT(ring_write(&ring, "ABCDE", 5));
+     EXPECT(ring_readable(&ring) == 5);
+
+     memset(data, 0, sizeof(data));
+     EXPECT(ring_read(&ring, data, 5));
+     EXPECT(strncmp(data, "ABCDE", 5) == 0);
+
+     ring_free(&ring);
+}
+
+int main()
+{
+     RUN_TESTS();
+}
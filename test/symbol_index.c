@@ -0,0 +1,316 @@
+#include "test.h"
+
+#include "symbol_index.h"
+
+#include <ftw.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// kind of the nth symbol named name, SK_NONE if there isn't one
+static SymbolKind_t kind_of(const SymbolList_t* list, const char* name, int nth)
+{
+     for(int64_t i = 0; i < list->count; ++i){
+          if(strcmp(list->names + list->symbols[i].name, name) != 0) continue;
+          if(nth-- == 0) return list->symbols[i].kind;
+     }
+
+     return SK_NONE;
+}
+
+static const ParsedSymbol_t* find(const SymbolList_t* list, const char* name)
+{
+     for(int64_t i = 0; i < list->count; ++i){
+          if(strcmp(list->names + list->symbols[i].name, name) == 0) return list->symbols + i;
+     }
+
+     return NULL;
+}
+
+static bool parse(const char* text, SymbolList_t* list)
+{
+     memset(list, 0, sizeof(*list));
+     return symbol_parse(text, strlen(text), list);
+}
+
+TEST(parse_definitions)
+{
+     const char* text = "#include <stdio.h>\n"
+                        "#define MAX(a, b) ((a) > (b) ? (a) : (b))\n"
+                        "typedef struct Point_t{\n"
+                        "     int x;\n"
+                        "     int y;\n"
+                        "}Point_t;\n"
+                        "typedef enum{ RED, GREEN = 2, BLUE }Color_t;\n"
+                        "typedef void handler(struct Point_t* point);\n"
+                        "typedef int (*compare_fn)(const void*, const void*);\n"
+                        "static int counter = 0;\n"
+                        "extern int elsewhere;\n"
+                        "const char* names[] = {\"a\", \"b\"};\n"
+                        "int distance(const Point_t* a, const Point_t* b);\n"
+                        "int distance(const Point_t* a, const Point_t* b)\n"
+                        "{\n"
+                        "     struct Local{ int z; } local = {0};\n"
+                        "     return MAX(a->x - b->x, local.z) + counter;\n"
+                        "}\n";
+
+     SymbolList_t list;
+     ASSERT(parse(text, &list));
+
+     EXPECT(kind_of(&list, "stdio", 0) == SK_NONE);
+     EXPECT(kind_of(&list, "MAX", 0) == SK_MACRO);
+     EXPECT(kind_of(&list, "Point_t", 0) == SK_TYPE);
+     EXPECT(kind_of(&list, "Point_t", 1) == SK_TYPE);
+     EXPECT(kind_of(&list, "x", 0) == SK_REFERENCE);
+     EXPECT(kind_of(&list, "RED", 0) == SK_ENUMERATOR);
+     EXPECT(kind_of(&list, "GREEN", 0) == SK_ENUMERATOR);
+     EXPECT(kind_of(&list, "BLUE", 0) == SK_ENUMERATOR);
+     EXPECT(kind_of(&list, "Color_t", 0) == SK_TYPE);
+     EXPECT(kind_of(&list, "handler", 0) == SK_TYPE);
+     EXPECT(kind_of(&list, "point", 0) == SK_REFERENCE);
+     EXPECT(kind_of(&list, "compare_fn", 0) == SK_TYPE);
+     EXPECT(kind_of(&list, "counter", 0) == SK_VARIABLE);
+     EXPECT(kind_of(&list, "counter", 1) == SK_REFERENCE);
+     EXPECT(kind_of(&list, "elsewhere", 0) == SK_REFERENCE);
+     EXPECT(kind_of(&list, "names", 0) == SK_VARIABLE);
+
+     // the prototype declares, only the one with a body defines
+     EXPECT(kind_of(&list, "distance", 0) == SK_REFERENCE);
+     EXPECT(kind_of(&list, "distance", 1) == SK_FUNCTION);
+     EXPECT(kind_of(&list, "Local", 0) == SK_TYPE);
+     EXPECT(kind_of(&list, "local", 0) == SK_REFERENCE);
+     EXPECT(kind_of(&list, "MAX", 1) == SK_REFERENCE);
+
+     symbol_list_free(&list);
+}
+
+TEST(parse_cpp_definitions)
+{
+     const char* text = "extern \"C\" {\n"
+                        "void c_api(void){}\n"
+                        "}\n"
+                        "namespace outer {\n"
+                        "class Shape : public Base {\n"
+                        "public:\n"
+                        "     int area() const { return width * height; }\n"
+                        "     int width;\n"
+                        "};\n"
+                        "enum class Mode : int { Fast, Slow };\n"
+                        "int Shape::perimeter() const\n"
+                        "{\n"
+                        "     return 2 * (width + height);\n"
+                        "}\n"
+                        "}\n";
+
+     SymbolList_t list;
+     ASSERT(parse(text, &list));
+
+     EXPECT(kind_of(&list, "c_api", 0) == SK_FUNCTION);
+     EXPECT(kind_of(&list, "Shape", 0) == SK_TYPE);
+     EXPECT(kind_of(&list, "Base", 0) == SK_REFERENCE);
+     EXPECT(kind_of(&list, "area", 0) == SK_FUNCTION);
+     EXPECT(kind_of(&list, "width", 0) == SK_REFERENCE);
+     EXPECT(kind_of(&list, "Mode", 0) == SK_TYPE);
+     EXPECT(kind_of(&list, "Fast", 0) == SK_ENUMERATOR);
+     EXPECT(kind_of(&list, "Slow", 0) == SK_ENUMERATOR);
+     EXPECT(kind_of(&list, "perimeter", 0) == SK_FUNCTION);
+
+     symbol_list_free(&list);
+}
+
+TEST(parse_skips_comments_strings_and_keywords)
+{
+     const char* text = "// hidden_one\n"
+                        "/* hidden_two\n"
+                        "   still hidden */ int visible(void)\n"
+                        "{\n"
+                        "     const char* s = \"hidden_three \\\" hidden_four\";\n"
+                        "     return sizeof(s) + 'x' + 0x1f;\n"
+                        "}\n";
+
+     SymbolList_t list;
+     ASSERT(parse(text, &list));
+
+     EXPECT(find(&list, "hidden_one") == NULL);
+     EXPECT(find(&list, "hidden_two") == NULL);
+     EXPECT(find(&list, "hidden_three") == NULL);
+     EXPECT(find(&list, "hidden_four") == NULL);
+     EXPECT(find(&list, "sizeof") == NULL);
+     EXPECT(find(&list, "return") == NULL);
+     EXPECT(find(&list, "x1f") == NULL);
+
+     const ParsedSymbol_t* visible = find(&list, "visible");
+     ASSERT(visible);
+     EXPECT(visible->kind == SK_FUNCTION);
+     EXPECT(visible->line == 2);
+     EXPECT(visible->column == 23);
+
+     const ParsedSymbol_t* s = find(&list, "s");
+     ASSERT(s);
+     EXPECT(s->kind == SK_REFERENCE);
+     EXPECT(s->line == 4);
+     EXPECT(s->column == 17);
+
+     symbol_list_free(&list);
+}
+
+static char project[] = "/tmp/ce_symbol_index_XXXXXX";
+
+static void write_file(const char* name, const char* text)
+{
+     char path[BUFSIZ];
+     snprintf(path, sizeof(path), "%s/%s", project, name);
+     FILE* file = fopen(path, "w");
+     fputs(text, file);
+     fclose(file);
+}
+
+static bool wait_for_generation(SymbolIndex_t* index, uint64_t generation)
+{
+     for(int i = 0; i < 5000; ++i){
+          if(symbol_index_generation(index) >= generation) return true;
+          usleep(1000);
+     }
+
+     return false;
+}
+
+static int remove_entry(const char* path, const struct stat* info, int flag, struct FTW* ftw)
+{
+     (void)(info);
+     (void)(flag);
+     (void)(ftw);
+     return remove(path);
+}
+
+TEST(index_builds_persists_and_updates)
+{
+     ASSERT(mkdtemp(project));
+
+     char path[BUFSIZ];
+     snprintf(path, sizeof(path), "%s/source", project);
+     ASSERT(mkdir(path, 0755) == 0);
+     snprintf(path, sizeof(path), "%s/build", project);
+     ASSERT(mkdir(path, 0755) == 0);
+
+     write_file("source/shape.h", "typedef struct{ int w; }Shape_t;\nint area(const Shape_t* shape);\n");
+     write_file("source/shape.c", "#include \"shape.h\"\n\nint area(const Shape_t* shape)\n{\n     return shape->w;\n}\n");
+     write_file("source/main.c", "int area(void);\nint main()\n{\n     return area() + area();\n}\n");
+     write_file(".gitignore", "build/\n");
+     write_file("build/ignored.c", "int area(void){ return 0; }\n");
+     write_file("notes.txt", "int area(void){ return 0; }\n");
+
+     SymbolIndex_t index;
+     ASSERT(symbol_index_start(&index, project, 2));
+     ASSERT(wait_for_generation(&index, 1));
+
+     SymbolLocation_t* locations;
+     int64_t count = symbol_index_lookup(&index, "area", true, &locations);
+     ASSERT(count == 1);
+     snprintf(path, sizeof(path), "%s/source/shape.c", project);
+     EXPECT(strcmp(locations[0].path, path) == 0);
+     EXPECT(locations[0].line == 2);
+     EXPECT(locations[0].column == 4);
+     EXPECT(locations[0].kind == SK_FUNCTION);
+     symbol_locations_free(locations, count);
+
+     // references are sorted by file, then where they are in it
+     count = symbol_index_lookup(&index, "area", false, &locations);
+     ASSERT(count == 4);
+     EXPECT(strstr(locations[0].path, "source/main.c"));
+     EXPECT(locations[0].line == 0);
+     EXPECT(locations[1].line == 3 && locations[1].column == 12);
+     EXPECT(locations[2].line == 3 && locations[2].column == 21);
+     EXPECT(strstr(locations[3].path, "source/shape.h"));
+     symbol_locations_free(locations, count);
+
+     EXPECT(symbol_index_lookup(&index, "nope", true, &locations) == 0);
+     count = symbol_index_lookup(&index, "Shape_t", true, &locations);
+     EXPECT(count == 1);
+     symbol_locations_free(locations, count);
+
+     // saving moves the definition, and brings in files we haven't seen
+     uint64_t generation = symbol_index_generation(&index);
+     write_file("source/shape.c", "#include \"shape.h\"\n\n\n\nint area(const Shape_t* shape){ return shape->w; }\n");
+     write_file("source/extra.c", "int perimeter(void){ return 4; }\n");
+
+     snprintf(path, sizeof(path), "%s/source/shape.c", project);
+     symbol_index_file_saved(&index, path);
+     snprintf(path, sizeof(path), "%s/source/extra.c", project);
+     symbol_index_file_saved(&index, path);
+     ASSERT(wait_for_generation(&index, generation + 1));
+
+     // the saves may be picked up one at a time
+     for(int i = 0; i < 5000; ++i){
+          count = symbol_index_lookup(&index, "perimeter", true, &locations);
+          symbol_locations_free(locations, count);
+          if(count == 1) break;
+          usleep(1000);
+     }
+
+     count = symbol_index_lookup(&index, "area", true, &locations);
+     ASSERT(count == 1);
+     EXPECT(locations[0].line == 4);
+     symbol_locations_free(locations, count);
+
+     count = symbol_index_lookup(&index, "perimeter", true, &locations);
+     EXPECT(count == 1);
+     symbol_locations_free(locations, count);
+
+     symbol_index_stop(&index);
+
+     // the next start maps what we wrote before it looks for changes
+     snprintf(path, sizeof(path), "%s/%s", project, SYMBOL_INDEX_FILE);
+     EXPECT(access(path, F_OK) == 0);
+
+     ASSERT(symbol_index_start(&index, project, 1));
+     ASSERT(wait_for_generation(&index, 1));
+
+     count = symbol_index_lookup(&index, "perimeter", true, &locations);
+     EXPECT(count == 1);
+     symbol_locations_free(locations, count);
+
+     count = symbol_index_lookup(&index, "area", false, &locations);
+     EXPECT(count == 4);
+     symbol_locations_free(locations, count);
+
+     symbol_index_stop(&index);
+
+     nftw(project, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+TEST(index_rejects_corrupt_file)
+{
+     char dir[] = "/tmp/ce_symbol_index_XXXXXX";
+     ASSERT(mkdtemp(dir));
+
+     char path[BUFSIZ];
+     snprintf(path, sizeof(path), "%s/%s", dir, SYMBOL_INDEX_FILE);
+     FILE* file = fopen(path, "w");
+     fputs("CESYMBOL but not really an index", file);
+     fclose(file);
+
+     snprintf(path, sizeof(path), "%s/only.c", dir);
+     file = fopen(path, "w");
+     fputs("int only(void){ return 1; }\n", file);
+     fclose(file);
+
+     SymbolIndex_t index;
+     ASSERT(symbol_index_start(&index, dir, 1));
+     ASSERT(wait_for_generation(&index, 1));
+
+     SymbolLocation_t* locations;
+     int64_t count = symbol_index_lookup(&index, "only", true, &locations);
+     EXPECT(count == 1);
+     symbol_locations_free(locations, count);
+
+     symbol_index_stop(&index);
+
+     nftw(dir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+int main()
+{
+     RUN_TESTS();
+}
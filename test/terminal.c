@@ -0,0 +1,372 @@
+#include "test.h"
+
+#include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "terminal.h"
+
+#define SCREEN_WIDTH 10
+#define SCREEN_HEIGHT 4
+
+static bool screen_init(Terminal_t* term, Buffer_t* buffer)
+{
+     *term = (Terminal_t){};
+     *buffer = (Buffer_t){};
+     return terminal_screen_init(term, SCREEN_WIDTH, SCREEN_HEIGHT, buffer);
+}
+
+static void screen_free(Terminal_t* term, Buffer_t* buffer)
+{
+     terminal_screen_free(term);
+     ce_free_buffer(buffer);
+}
+
+static void output(Terminal_t* term, const char* string)
+{
+     terminal_process_output(term, string, strlen(string));
+     terminal_apply_updates(term);
+}
+
+TEST(sanity_plain_text)
+{
+     Terminal_t term;
+     Buffer_t buffer;
+     ASSERT(screen_init(&term, &buffer));
+
+     output(&term, "$ ls\r\nfile.c\r\n$ ");
+
+     ASSERT(buffer.line_count == 3);
+     EXPECT(strcmp(buffer.lines[0], "$ ls") == 0);
+     EXPECT(strcmp(buffer.lines[1], "file.c") == 0);
+     EXPECT(strcmp(buffer.lines[2], "$") == 0);
+     EXPECT(term.cursor.x == 2);
+     EXPECT(term.cursor.y == 2);
+
+     screen_free(&term, &buffer);
+}
+
+TEST(output_split_across_reads)
+{
+     Terminal_t term;
+     Buffer_t buffer;
+     ASSERT(screen_init(&term, &buffer));
+
+     output(&term, "ab\033[");
+     output(&term, "2");
+     output(&term, "Dc");
+
+     ASSERT(buffer.line_count == 1);
+     EXPECT(strcmp(buffer.lines[0], "cb") == 0);
+     EXPECT(term.cursor.x == 1);
+
+     screen_free(&term, &buffer);
+}
+
+TEST(line_wraps_at_width)
+{
+     Terminal_t term;
+     Buffer_t buffer;
+     ASSERT(screen_init(&term, &buffer));
+
+     output(&term, "0123456789ab");
+
+     ASSERT(buffer.line_count == 2);
+     EXPECT(strcmp(buffer.lines[0], "0123456789") == 0);
+     EXPECT(strcmp(buffer.lines[1], "ab") == 0);
+
+     screen_free(&term, &buffer);
+}
+
+TEST(cursor_position_and_erase)
+{
+     Terminal_t term;
+     Buffer_t buffer;
+     ASSERT(screen_init(&term, &buffer));
+
+     output(&term, "aaaa\r\nbbbb\r\ncccc");
+     output(&term, "\033[2;3HX\033[K");
+
+     ASSERT(buffer.line_count == 3);
+     EXPECT(strcmp(buffer.lines[0], "aaaa") == 0);
+     EXPECT(strcmp(buffer.lines[1], "bbX") == 0);
+     EXPECT(strcmp(buffer.lines[2], "cccc") == 0);
+     EXPECT(term.cursor.x == 3);
+     EXPECT(term.cursor.y == 1);
+
+     output(&term, "\033[1;1H\033[2P\033[3;2H\033[1@");
+
+     EXPECT(strcmp(buffer.lines[0], "aa") == 0);
+     EXPECT(strcmp(buffer.lines[2], "c ccc") == 0);
+
+     screen_free(&term, &buffer);
+}
+
+TEST(scroll_into_scrollback)
+{
+     Terminal_t term;
+     Buffer_t buffer;
+     ASSERT(screen_init(&term, &buffer));
+
+     output(&term, "1\r\n2\r\n3\r\n4\r\n5\r\n6");
+
+     ASSERT(buffer.line_count == 6);
+     EXPECT(term.screen_top_line == 2);
+     for(int64_t i = 0; i < 6; ++i){
+          EXPECT(buffer.lines[i][0] == '1' + i);
+     }
+
+     // moving home only reaches the top of the screen, not the scrollback
+     output(&term, "\033[HX");
+
+     EXPECT(strcmp(buffer.lines[1], "2") == 0);
+     EXPECT(strcmp(buffer.lines[2], "X") == 0);
+
+     screen_free(&term, &buffer);
+}
+
+TEST(scrollback_cap)
+{
+     Terminal_t term;
+     Buffer_t buffer;
+     ASSERT(screen_init(&term, &buffer));
+     term.scrollback_lines = 5;
+
+     output(&term, "1\r\n2\r\n3\r\n4\r\n5\r\n6\r\n7\r\n8");
+
+     ASSERT(buffer.line_count == 5);
+     EXPECT(term.lines_dropped == 3);
+     EXPECT(term.screen_top_line == 1);
+     EXPECT(strcmp(buffer.lines[0], "4") == 0);
+     EXPECT(strcmp(buffer.lines[4], "8") == 0);
+     EXPECT(term.cursor.y == 4);
+
+     screen_free(&term, &buffer);
+}
+
+TEST(clear_screen_keeps_scrollback)
+{
+     Terminal_t term;
+     Buffer_t buffer;
+     ASSERT(screen_init(&term, &buffer));
+
+     output(&term, "old\r\nlines\033[H\033[2Jnew");
+
+     ASSERT(buffer.line_count == 3);
+     EXPECT(strcmp(buffer.lines[0], "old") == 0);
+     EXPECT(strcmp(buffer.lines[1], "lines") == 0);
+     EXPECT(strcmp(buffer.lines[2], "new") == 0);
+
+     screen_free(&term, &buffer);
+}
+
+TEST(scroll_region)
+{
+     Terminal_t term;
+     Buffer_t buffer;
+     ASSERT(screen_init(&term, &buffer));
+
+     output(&term, "a\r\nb\r\nc\r\nd");
+     output(&term, "\033[2;3r\033[3;1H\nx");
+
+     ASSERT(buffer.line_count == 4);
+     EXPECT(strcmp(buffer.lines[0], "a") == 0);
+     EXPECT(strcmp(buffer.lines[1], "c") == 0);
+     EXPECT(strcmp(buffer.lines[2], "x") == 0);
+     EXPECT(strcmp(buffer.lines[3], "d") == 0);
+
+     screen_free(&term, &buffer);
+}
+
+TEST(alternate_screen)
+{
+     Terminal_t term;
+     Buffer_t buffer;
+     ASSERT(screen_init(&term, &buffer));
+
+     output(&term, "$ vim");
+     output(&term, "\033[?1049h\033[Hfull");
+
+     ASSERT(buffer.line_count == SCREEN_HEIGHT);
+     EXPECT(strcmp(buffer.lines[0], "full") == 0);
+
+     output(&term, "\033[?1049l");
+
+     ASSERT(buffer.line_count == 1);
+     EXPECT(strcmp(buffer.lines[0], "$ vim") == 0);
+     EXPECT(term.cursor.x == 5);
+     EXPECT(term.cursor.y == 0);
+
+     screen_free(&term, &buffer);
+}
+
+TEST(updates_wait_to_be_applied)
+{
+     Terminal_t term;
+     Buffer_t buffer;
+     ASSERT(screen_init(&term, &buffer));
+
+     const char* string = "1\r\n2";
+     terminal_process_output(&term, string, strlen(string));
+
+     EXPECT(buffer.line_count == 1);
+     EXPECT(buffer.lines[0][0] == 0);
+
+     EXPECT(terminal_apply_updates(&term));
+     ASSERT(buffer.line_count == 2);
+     EXPECT(strcmp(buffer.lines[1], "2") == 0);
+
+     EXPECT(!terminal_apply_updates(&term));
+
+     screen_free(&term, &buffer);
+}
+
+TEST(updates_overflow_ring)
+{
+     Terminal_t term;
+     Buffer_t buffer;
+     ASSERT(screen_init(&term, &buffer));
+
+     // more lines than the ring can hold before anything is applied
+     char line[16];
+     int64_t line_count = TERM_DELTA_RING_SIZE / sizeof(TerminalDelta_t) + 100;
+     for(int64_t i = 0; i < line_count; ++i){
+          snprintf(line, 16, "%"PRId64"\r\n", i);
+          terminal_process_output(&term, line, strlen(line));
+     }
+
+     EXPECT(term.pending_length > 0);
+
+     // the producer moves pending deltas over as the ring drains
+     while(terminal_apply_updates(&term)) terminal_process_output(&term, NULL, 0);
+
+     EXPECT(term.pending_length == 0);
+     ASSERT(buffer.line_count == line_count + 1);
+     EXPECT(strcmp(buffer.lines[0], "0") == 0);
+     snprintf(line, 16, "%"PRId64, line_count - 1);
+     EXPECT(strcmp(buffer.lines[line_count - 1], line) == 0);
+
+     screen_free(&term, &buffer);
+}
+
+TEST(flood_needs_sustained_rate)
+{
+     Terminal_t term;
+     Buffer_t buffer;
+     ASSERT(screen_init(&term, &buffer));
+
+     // each window reads a little more than the flood rate, carriage returns keep the screen from changing
+     static char bytes[TERM_FLOOD_BYTES_PER_SECOND / (1000 / TERM_FLOOD_WINDOW_MS) + 1];
+     memset(bytes, '\r', sizeof(bytes));
+
+     int64_t now = 1000;
+     EXPECT(!terminal_measure_flood(&term, now));
+
+     for(int64_t w = 1; w < TERM_FLOOD_WINDOWS; ++w){
+          terminal_process_output(&term, bytes, sizeof(bytes));
+          now += TERM_FLOOD_WINDOW_MS;
+          EXPECT(!terminal_measure_flood(&term, now));
+          EXPECT(!term.flood.fast_forward);
+     }
+
+     terminal_process_output(&term, bytes, sizeof(bytes));
+     EXPECT(!terminal_measure_flood(&term, now + 1)); // the window isn't over yet
+     now += TERM_FLOOD_WINDOW_MS;
+     EXPECT(terminal_measure_flood(&term, now));
+     EXPECT(term.flood.fast_forward);
+     EXPECT(term.flood.bytes_per_second >= TERM_FLOOD_BYTES_PER_SECOND);
+
+     // a quiet window stops it
+     now += TERM_FLOOD_WINDOW_MS;
+     EXPECT(terminal_measure_flood(&term, now));
+     EXPECT(!term.flood.fast_forward);
+     EXPECT(term.flood.bytes_per_second == 0);
+
+     screen_free(&term, &buffer);
+}
+
+TEST(paste_is_bracketed_when_asked_for)
+{
+     Terminal_t term;
+     Buffer_t buffer;
+     ASSERT(screen_init(&term, &buffer));
+
+     int fds[2];
+     ASSERT(pipe(fds) == 0);
+     term.fd = fds[1];
+
+     EXPECT(terminal_send_string(&term, "ls\n", 3, true));
+
+     output(&term, "\033[?2004h");
+     EXPECT(term.bracketed_paste);
+
+     EXPECT(terminal_send_string(&term, "ls\n", 3, true));
+     EXPECT(terminal_send_string(&term, "ls", 2, false));
+
+     char bytes[64] = {};
+     EXPECT(read(fds[0], bytes, sizeof(bytes) - 1) > 0);
+     EXPECT(strcmp(bytes, "ls\n\033[200~ls\n\033[201~ls") == 0);
+
+     close(fds[0]);
+     close(fds[1]);
+     term.fd = 0;
+     screen_free(&term, &buffer);
+}
+
+TEST(input_is_queued_when_the_shell_is_not_reading)
+{
+     Terminal_t term;
+     Buffer_t buffer;
+     ASSERT(screen_init(&term, &buffer));
+
+     int fds[2];
+     ASSERT(pipe2(fds, O_NONBLOCK) == 0);
+     term.fd = fds[1];
+
+     // more than the pipe holds
+     static char string[1 << 18];
+     memset(string, 'a', sizeof(string));
+     EXPECT(terminal_send_string(&term, string, sizeof(string), false));
+     EXPECT(term.input_length > 0);
+
+     // later input lines up behind it
+     int64_t input_length = term.input_length;
+     EXPECT(terminal_send_key(&term, 'b'));
+     EXPECT(term.input_length == input_length + 1);
+     EXPECT(term.input[term.input_length - 1] == 'b');
+
+     close(fds[0]);
+     close(fds[1]);
+     term.fd = 0;
+     screen_free(&term, &buffer);
+}
+
+TEST(color_runs)
+{
+     Terminal_t term;
+     Buffer_t buffer;
+     ASSERT(screen_init(&term, &buffer));
+
+     output(&term, "a\033[31mb\033[1;38;5;200mc\033[0md");
+
+     ASSERT(buffer.line_count == 1);
+     EXPECT(strcmp(buffer.lines[0], "abcd") == 0);
+
+     const TerminalColorLine_t* color_line = term.color_lines;
+     EXPECT(color_line->first.fg == COLOR_FOREGROUND);
+     ASSERT(color_line->run_count == 3);
+     EXPECT(color_line->runs[0].column == 1);
+     EXPECT(color_line->runs[0].color.fg == 1);
+     EXPECT(color_line->runs[1].column == 2);
+     EXPECT(color_line->runs[1].color.fg == 200);
+     EXPECT(color_line->runs[1].color.attrs == TERM_ATTR_BOLD);
+     EXPECT(color_line->runs[2].column == 3);
+     EXPECT(color_line->runs[2].color.fg == COLOR_FOREGROUND);
+
+     screen_free(&term, &buffer);
+}
+
+int main()
+{
+     RUN_TESTS();
+}
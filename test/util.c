@@ -0,0 +1,66 @@
+#include "test.h"
+
+#include "util.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+TEST(hash)
+{
+     EXPECT(util_hash_string("") == UTIL_HASH_SEED);
+     EXPECT(util_hash_string("a") == 0xaf63dc4c8601ec8cULL);
+     EXPECT(util_hash_string("foobar") == 0x85944171f73967e8ULL);
+
+     // continuing a hash is the same as hashing it all at once
+     EXPECT(util_hash(util_hash(UTIL_HASH_SEED, "foo", 3), "bar", 3) == util_hash_string("foobar"));
+}
+
+TEST(join_path)
+{
+     char* path = util_join_path("source", "ce.c");
+     EXPECT(path && strcmp(path, "source/ce.c") == 0);
+     free(path);
+
+     path = util_join_path("", "ce.c");
+     EXPECT(path && strcmp(path, "ce.c") == 0);
+     free(path);
+}
+
+TEST(write_file_replacing)
+{
+     char dir[] = "/tmp/ce_util_XXXXXX";
+     ASSERT(mkdtemp(dir));
+
+     char path[BUFSIZ];
+     snprintf(path, sizeof(path), "%s/file", dir);
+
+     struct iovec iovecs[2] = {{"hello ", 6}, {"world", 5}};
+     EXPECT(util_write_file_replacing(path, iovecs, 2));
+     EXPECT(util_write_file_replacing(path, iovecs + 1, 1));
+
+     char contents[32] = {};
+     int fd = open(path, O_RDONLY);
+     ASSERT(fd >= 0);
+     EXPECT(read(fd, contents, sizeof(contents)) == 5);
+     close(fd);
+     EXPECT(strcmp(contents, "world") == 0);
+
+     char tmp_path[BUFSIZ + 8];
+     snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+     EXPECT(access(tmp_path, F_OK) != 0);
+
+     // nowhere to write, and nothing left behind
+     snprintf(path, sizeof(path), "%s/missing/file", dir);
+     EXPECT(!util_write_file_replacing(path, iovecs, 2));
+
+     snprintf(path, sizeof(path), "%s/file", dir);
+     unlink(path);
+     rmdir(dir);
+}
+
+int main()
+{
+     RUN_TESTS();
+}
@@ -136,6 +136,61 @@ TEST(macro_commit_sanity)
      vim_macro_commits_free(&itr);
 }
 
+TEST(action_parser_resumes)
+{
+     Buffer_t buffer = {};
+     Point_t cursor = {0, 0};
+     Point_t visual_start = {0, 0};
+     VimFindCharState_t find_char_state = {};
+     VimActionParser_t parser;
+     VimAction_t action = {};
+
+     vim_action_parser_reset(&parser);
+
+     const char* keys = "3\"ad2f";
+     for(const char* itr = keys; *itr; ++itr){
+          ASSERT(vim_action_parser_push(&parser, *itr));
+          EXPECT(vim_action_parser_parse(&parser, &action, VM_NORMAL, &buffer, &cursor, &visual_start,
+                                         &find_char_state, false) == VCS_CONTINUE);
+     }
+
+     ASSERT(vim_action_parser_push(&parser, 'x'));
+     ASSERT(vim_action_parser_parse(&parser, &action, VM_NORMAL, &buffer, &cursor, &visual_start,
+                                    &find_char_state, false) == VCS_COMPLETE);
+
+     EXPECT(action.multiplier == 3);
+     EXPECT(action.change.type == VCT_DELETE);
+     EXPECT(action.change.reg == 'a');
+     EXPECT(action.motion.type == VMT_FIND_NEXT_MATCHING_CHAR);
+     EXPECT(action.motion.multiplier == 2);
+     EXPECT(action.motion.match_char == 'x');
+}
+
+TEST(action_parser_pushed_keys_parse_together)
+{
+     Buffer_t buffer = {};
+     Point_t cursor = {0, 0};
+     Point_t visual_start = {0, 0};
+     VimFindCharState_t find_char_state = {};
+     VimActionParser_t parser;
+     VimAction_t action = {};
+
+     vim_action_parser_reset(&parser);
+     vim_action_parser_push(&parser, 'g');
+     vim_action_parser_push(&parser, 'g');
+
+     ASSERT(vim_action_parser_parse(&parser, &action, VM_NORMAL, &buffer, &cursor, &visual_start,
+                                    &find_char_state, false) == VCS_COMPLETE);
+     EXPECT(action.change.type == VCT_MOTION);
+     EXPECT(action.motion.type == VMT_BEGINNING_OF_FILE);
+
+     vim_action_parser_reset(&parser);
+     vim_action_parser_push(&parser, 'd');
+     vim_action_parser_push(&parser, 'y');
+     EXPECT(vim_action_parser_parse(&parser, &action, VM_NORMAL, &buffer, &cursor, &visual_start,
+                                    &find_char_state, false) == VCS_INVALID);
+}
+
 typedef struct{
      VimState_t vim_state;
      Buffer_t buffer;
@@ -176,6 +231,7 @@ void key_handler_test_free(KeyHandlerTest_t* kht)
      vim_yanks_free(&kht->vim_state.yank_head);
      vim_marks_free(&kht->vim_buffer_state.mark_head);
      vim_macros_free(&kht->vim_state.macro_head);
+     vim_multi_cursor_free(&kht->vim_buffer_state.multi_cursor);
 }
 
 TEST(motion_left)
@@ -2107,6 +2163,28 @@ TEST(unindent_line)
      key_handler_test_free(&kht);
 }
 
+TEST(unindent_nothing_keeps_prior_commit)
+{
+     KeyHandlerTest_t kht;
+     key_handler_test_init(&kht);
+
+     ce_append_line(&kht.buffer, "if(true){");
+
+     key_handler_test_run(&kht, "x");
+     EXPECT(strcmp(kht.buffer.lines[0], "f(true){") == 0);
+     BufferCommitNode_t* tail = kht.commit_tail;
+
+     // nothing to unindent, so the chain of the commit before it is left alone
+     kht.vim_state.playing_macro = true;
+     key_handler_test_run(&kht, "<<");
+     kht.vim_state.playing_macro = false;
+
+     EXPECT(kht.commit_tail == tail);
+     EXPECT(kht.commit_tail->commit.chain == BCC_STOP);
+
+     key_handler_test_free(&kht);
+}
+
 TEST(unindent_multi_line)
 {
      KeyHandlerTest_t kht;
@@ -2262,6 +2340,241 @@ TEST(invalid_input)
      key_handler_test_free(&kht);
 }
 
+TEST(multi_cursor_add_matches)
+{
+     Buffer_t buffer = {};
+     ce_append_line(&buffer, "taco taco");
+     ce_append_line(&buffer, "burrito");
+     ce_append_line(&buffer, "taco");
+
+     regex_t regex;
+     ASSERT(regcomp(&regex, "taco", REG_EXTENDED) == 0);
+
+     VimMultiCursor_t multi_cursor = {};
+     EXPECT(vim_multi_cursor_add_matches(&multi_cursor, &buffer, &regex, (Point_t){0, 0}) == 2);
+
+     ASSERT(multi_cursor.count == 2);
+     EXPECT(multi_cursor.cursors[0].x == 5);
+     EXPECT(multi_cursor.cursors[0].y == 0);
+     EXPECT(multi_cursor.cursors[1].x == 0);
+     EXPECT(multi_cursor.cursors[1].y == 2);
+
+     // matches that already have a cursor aren't counted again
+     EXPECT(vim_multi_cursor_add_matches(&multi_cursor, &buffer, &regex, (Point_t){0, 0}) == 0);
+     EXPECT(multi_cursor.count == 2);
+
+     regfree(&regex);
+     vim_multi_cursor_free(&multi_cursor);
+     ce_free_buffer(&buffer);
+}
+
+TEST(multi_cursor_insert)
+{
+     KeyHandlerTest_t kht;
+     key_handler_test_init(&kht);
+
+     ce_append_line(&kht.buffer, "a = 1; b = 2;");
+     ce_append_line(&kht.buffer, "c = 3;");
+
+     vim_multi_cursor_add(&kht.vim_buffer_state.multi_cursor, (Point_t){7, 0});
+     vim_multi_cursor_add(&kht.vim_buffer_state.multi_cursor, (Point_t){0, 1});
+
+     key_handler_test_run(&kht, "ix\\b_\\e");
+
+     EXPECT(strcmp(kht.buffer.lines[0], "_a = 1; _b = 2;") == 0);
+     EXPECT(strcmp(kht.buffer.lines[1], "_c = 3;") == 0);
+
+     ASSERT(kht.vim_buffer_state.multi_cursor.count == 2);
+     EXPECT(kht.vim_buffer_state.multi_cursor.cursors[0].x == 9);
+     EXPECT(kht.vim_buffer_state.multi_cursor.cursors[0].y == 0);
+     EXPECT(kht.vim_buffer_state.multi_cursor.cursors[1].x == 1);
+     EXPECT(kht.vim_buffer_state.multi_cursor.cursors[1].y == 1);
+
+     // the typing and every cursor's copy come back as one undo
+     key_handler_test_undo(&kht);
+
+     EXPECT(strcmp(kht.buffer.lines[0], "a = 1; b = 2;") == 0);
+     EXPECT(strcmp(kht.buffer.lines[1], "c = 3;") == 0);
+
+     key_handler_test_free(&kht);
+}
+
+TEST(multi_cursor_insert_same_line)
+{
+     KeyHandlerTest_t kht;
+     key_handler_test_init(&kht);
+
+     ce_append_line(&kht.buffer, "ab ab ab");
+
+     vim_multi_cursor_add(&kht.vim_buffer_state.multi_cursor, (Point_t){3, 0});
+     vim_multi_cursor_add(&kht.vim_buffer_state.multi_cursor, (Point_t){6, 0});
+
+     key_handler_test_run(&kht, "iX\\e");
+
+     EXPECT(strcmp(kht.buffer.lines[0], "Xab Xab Xab") == 0);
+
+     // each cursor's edit on the line applies to what the one before it left
+     key_handler_test_undo(&kht);
+     EXPECT(strcmp(kht.buffer.lines[0], "ab ab ab") == 0);
+
+     ce_commit_redo(&kht.buffer, &kht.commit_tail, &kht.cursor);
+     EXPECT(strcmp(kht.buffer.lines[0], "Xab Xab Xab") == 0);
+
+     key_handler_test_undo(&kht);
+     EXPECT(strcmp(kht.buffer.lines[0], "ab ab ab") == 0);
+
+     key_handler_test_free(&kht);
+}
+
+TEST(multi_cursor_append)
+{
+     KeyHandlerTest_t kht;
+     key_handler_test_init(&kht);
+
+     ce_append_line(&kht.buffer, "one");
+     ce_append_line(&kht.buffer, "three");
+
+     vim_multi_cursor_add(&kht.vim_buffer_state.multi_cursor, (Point_t){1, 1});
+
+     key_handler_test_run(&kht, "A;\\e");
+
+     EXPECT(strcmp(kht.buffer.lines[0], "one;") == 0);
+     EXPECT(strcmp(kht.buffer.lines[1], "three;") == 0);
+
+     key_handler_test_free(&kht);
+}
+
+TEST(visual_block_delete)
+{
+     KeyHandlerTest_t kht;
+     key_handler_test_init(&kht);
+
+     ce_append_line(&kht.buffer, "abcdef");
+     ce_append_line(&kht.buffer, "ab");
+     ce_append_line(&kht.buffer, "abcdef");
+
+     key_handler_test_run(&kht, "l");
+     vim_enter_visual_block_mode(&kht.vim_state, kht.cursor);
+     key_handler_test_run(&kht, "jjlld");
+
+     EXPECT(strcmp(kht.buffer.lines[0], "aef") == 0);
+     EXPECT(strcmp(kht.buffer.lines[1], "a") == 0);
+     EXPECT(strcmp(kht.buffer.lines[2], "aef") == 0);
+     EXPECT(kht.cursor.x == 1);
+     EXPECT(kht.cursor.y == 0);
+     EXPECT(kht.vim_state.mode == VM_NORMAL);
+
+     VimYankNode_t* yank = vim_yank_find(kht.vim_state.yank_head, '"');
+     ASSERT(yank);
+     EXPECT(yank->mode == YANK_BLOCK);
+     EXPECT(yank->block_width == 3);
+     EXPECT(yank->block_height == 3);
+     EXPECT(strcmp(yank->text, "bcdb  bcd") == 0);
+
+     key_handler_test_undo(&kht);
+
+     EXPECT(strcmp(kht.buffer.lines[0], "abcdef") == 0);
+     EXPECT(strcmp(kht.buffer.lines[1], "ab") == 0);
+     EXPECT(strcmp(kht.buffer.lines[2], "abcdef") == 0);
+
+     key_handler_test_free(&kht);
+}
+
+TEST(visual_block_yank_paste)
+{
+     KeyHandlerTest_t kht;
+     key_handler_test_init(&kht);
+
+     ce_append_line(&kht.buffer, "1234");
+     ce_append_line(&kht.buffer, "5678");
+     ce_append_line(&kht.buffer, "x");
+
+     vim_enter_visual_block_mode(&kht.vim_state, kht.cursor);
+     key_handler_test_run(&kht, "jly");
+
+     kht.cursor = (Point_t){0, 2};
+     key_handler_test_run(&kht, "p");
+
+     ASSERT(kht.buffer.line_count == 4);
+     EXPECT(strcmp(kht.buffer.lines[2], "x12") == 0);
+     EXPECT(strcmp(kht.buffer.lines[3], " 56") == 0);
+
+     key_handler_test_undo(&kht);
+
+     ASSERT(kht.buffer.line_count == 3);
+     EXPECT(strcmp(kht.buffer.lines[2], "x") == 0);
+
+     key_handler_test_free(&kht);
+}
+
+TEST(visual_block_insert)
+{
+     KeyHandlerTest_t kht;
+     key_handler_test_init(&kht);
+
+     ce_append_line(&kht.buffer, "int a;");
+     ce_append_line(&kht.buffer, "int b;");
+     ce_append_line(&kht.buffer, "");
+     ce_append_line(&kht.buffer, "int c;");
+
+     vim_enter_visual_block_mode(&kht.vim_state, kht.cursor);
+     key_handler_test_run(&kht, "jjjI// \\e");
+
+     EXPECT(strcmp(kht.buffer.lines[0], "// int a;") == 0);
+     EXPECT(strcmp(kht.buffer.lines[1], "// int b;") == 0);
+     EXPECT(strcmp(kht.buffer.lines[2], "// ") == 0);
+     EXPECT(strcmp(kht.buffer.lines[3], "// int c;") == 0);
+     EXPECT(kht.vim_buffer_state.multi_cursor.count == 0);
+
+     key_handler_test_undo(&kht);
+
+     EXPECT(strcmp(kht.buffer.lines[0], "int a;") == 0);
+     EXPECT(strcmp(kht.buffer.lines[1], "int b;") == 0);
+     EXPECT(strcmp(kht.buffer.lines[3], "int c;") == 0);
+
+     key_handler_test_free(&kht);
+}
+
+TEST(visual_block_append)
+{
+     KeyHandlerTest_t kht;
+     key_handler_test_init(&kht);
+
+     ce_append_line(&kht.buffer, "abc");
+     ce_append_line(&kht.buffer, "abc");
+
+     key_handler_test_run(&kht, "l");
+     vim_enter_visual_block_mode(&kht.vim_state, kht.cursor);
+     key_handler_test_run(&kht, "jA-\\e");
+
+     EXPECT(strcmp(kht.buffer.lines[0], "ab-c") == 0);
+     EXPECT(strcmp(kht.buffer.lines[1], "ab-c") == 0);
+
+     key_handler_test_free(&kht);
+}
+
+TEST(visual_block_change)
+{
+     KeyHandlerTest_t kht;
+     key_handler_test_init(&kht);
+
+     ce_append_line(&kht.buffer, "foo(a);");
+     ce_append_line(&kht.buffer, "foo(b);");
+
+     vim_enter_visual_block_mode(&kht.vim_state, kht.cursor);
+     key_handler_test_run(&kht, "jllcbar\\e");
+
+     EXPECT(strcmp(kht.buffer.lines[0], "bar(a);") == 0);
+     EXPECT(strcmp(kht.buffer.lines[1], "bar(b);") == 0);
+
+     key_handler_test_undo(&kht);
+
+     EXPECT(strcmp(kht.buffer.lines[0], "foo(a);") == 0);
+     EXPECT(strcmp(kht.buffer.lines[1], "foo(b);") == 0);
+
+     key_handler_test_free(&kht);
+}
+
 void segv_handler(int signo)
 {
      void *array[10];
@@ -0,0 +1,160 @@
+#include "test.h"
+
+#include "word_index.h"
+
+// every word the index knows of and how often, with the most frequent first
+static int64_t all_words(const WordIndex_t* index, WordMatch_t* matches, int64_t max_matches)
+{
+     return word_index_complete(index, "", matches, max_matches);
+}
+
+// what we kept up to date should match looking at the whole buffer again
+static bool same_as_fresh(const WordIndex_t* index, const Buffer_t* buffer)
+{
+     WordIndex_t fresh = {};
+     word_index_sync_buffer(&fresh, buffer, NULL);
+
+     WordMatch_t expected[64];
+     WordMatch_t actual[64];
+     int64_t expected_count = all_words(&fresh, expected, 64);
+     int64_t actual_count = all_words(index, actual, 64);
+     word_index_free(&fresh);
+
+     if(expected_count != actual_count) return false;
+
+     for(int64_t i = 0; i < expected_count; ++i){
+          if(strcmp(expected[i].word, actual[i].word) != 0 || expected[i].count != actual[i].count) return false;
+     }
+
+     return true;
+}
+
+TEST(complete_ranks_by_frequency)
+{
+     Buffer_t buffer = {};
+     ce_load_string(&buffer, "alpha alpha alphabet\nalpine alps beta\n// alpha 42abc ab");
+
+     WordIndex_t index = {};
+     word_index_sync_buffer(&index, &buffer, NULL);
+
+     EXPECT(word_index_count(&index, "alpha") == 3);
+     EXPECT(word_index_count(&index, "alp") == 0);
+     EXPECT(word_index_count(&index, "ab") == 0); // too short
+     EXPECT(word_index_count(&index, "abc") == 0); // part of a number
+
+     WordMatch_t matches[8];
+     int64_t count = word_index_complete(&index, "al", matches, 8);
+     ASSERT(count == 4);
+     EXPECT(strcmp(matches[0].word, "alpha") == 0 && matches[0].count == 3);
+     EXPECT(strcmp(matches[1].word, "alphabet") == 0);
+     EXPECT(strcmp(matches[2].word, "alpine") == 0);
+     EXPECT(strcmp(matches[3].word, "alps") == 0);
+
+     // only as many as asked for, and never what was already typed
+     EXPECT(word_index_complete(&index, "al", matches, 2) == 2);
+     EXPECT(strcmp(matches[1].word, "alphabet") == 0);
+     count = word_index_complete(&index, "alpha", matches, 8);
+     ASSERT(count == 1);
+     EXPECT(strcmp(matches[0].word, "alphabet") == 0);
+     EXPECT(word_index_complete(&index, "zeta", matches, 8) == 0);
+
+     word_index_free(&index);
+     ce_free_buffer(&buffer);
+}
+
+TEST(commits_update_only_what_changed)
+{
+     Buffer_t buffer = {};
+     ce_load_string(&buffer, "first line\nsecond line\nthird line");
+     BufferCommitNode_t* tail = calloc(1, sizeof(*tail));
+     BufferCommitNode_t* head = tail;
+
+     WordIndex_t index = {};
+     word_index_sync_buffer(&index, &buffer, tail);
+     EXPECT(word_index_count(&index, "line") == 3);
+
+     // a new line in the middle
+     Point_t at = {11, 1};
+     ce_insert_string(&buffer, at, "\ninserted words");
+     ce_commit_insert_string(&tail, at, at, at, strdup("\ninserted words"), BCC_STOP);
+     word_index_sync_buffer(&index, &buffer, tail);
+     EXPECT(word_index_count(&index, "inserted") == 1);
+     EXPECT(same_as_fresh(&index, &buffer));
+
+     // typing into the middle of a word changes it
+     ce_insert_char(&buffer, (Point_t){3, 0}, 'x');
+     ce_commit_insert_char(&tail, (Point_t){3, 0}, (Point_t){3, 0}, (Point_t){4, 0}, 'x', BCC_STOP);
+     word_index_sync_buffer(&index, &buffer, tail);
+     EXPECT(word_index_count(&index, "first") == 0);
+     EXPECT(word_index_count(&index, "firxst") == 1);
+     EXPECT(same_as_fresh(&index, &buffer));
+
+     // join lines by removing across them
+     Point_t remove_at = {6, 1};
+     char* removed = ce_dupe_string(&buffer, remove_at, (Point_t){8, 2});
+     ce_remove_string(&buffer, remove_at, strlen(removed));
+     ce_commit_remove_string(&tail, remove_at, remove_at, remove_at, removed, BCC_STOP);
+     word_index_sync_buffer(&index, &buffer, tail);
+     EXPECT(buffer.line_count == 3);
+     EXPECT(word_index_count(&index, "inserted") == 0);
+     EXPECT(same_as_fresh(&index, &buffer));
+
+     // undo a couple, then redo one, without syncing between
+     Point_t cursor;
+     ce_commit_undo(&buffer, &tail, &cursor);
+     ce_commit_undo(&buffer, &tail, &cursor);
+     word_index_sync_buffer(&index, &buffer, tail);
+     EXPECT(word_index_count(&index, "first") == 1);
+     EXPECT(word_index_count(&index, "inserted") == 1);
+     EXPECT(same_as_fresh(&index, &buffer));
+
+     ce_commit_redo(&buffer, &tail, &cursor);
+     ce_commit_undo(&buffer, &tail, &cursor);
+     ce_commit_undo(&buffer, &tail, &cursor);
+     word_index_sync_buffer(&index, &buffer, tail);
+     EXPECT(word_index_count(&index, "inserted") == 0);
+     EXPECT(same_as_fresh(&index, &buffer));
+
+     // changed without a commit, the line count gives it away
+     ce_append_line(&buffer, "appended quietly");
+     word_index_sync_buffer(&index, &buffer, tail);
+     EXPECT(word_index_count(&index, "quietly") == 1);
+     EXPECT(same_as_fresh(&index, &buffer));
+
+     word_index_free(&index);
+     ce_commits_free(head);
+     ce_free_buffer(&buffer);
+}
+
+TEST(counts_span_buffers)
+{
+     Buffer_t a = {};
+     Buffer_t b = {};
+     ce_load_string(&a, "shared only_a");
+     ce_load_string(&b, "shared shared only_b");
+
+     WordIndex_t index = {};
+     word_index_sync_buffer(&index, &a, NULL);
+     word_index_sync_buffer(&index, &b, NULL);
+     EXPECT(word_index_count(&index, "shared") == 3);
+
+     WordMatch_t matches[4];
+     EXPECT(word_index_complete(&index, "only", matches, 4) == 2);
+
+     word_index_remove_buffer(&index, &b);
+     EXPECT(word_index_count(&index, "shared") == 1);
+     EXPECT(word_index_count(&index, "only_b") == 0);
+
+     // the rest still complete once counts drop, even though the trie kept the branch
+     ASSERT(word_index_complete(&index, "only", matches, 4) == 1);
+     EXPECT(strcmp(matches[0].word, "only_a") == 0);
+
+     word_index_free(&index);
+     ce_free_buffer(&a);
+     ce_free_buffer(&b);
+}
+
+int main()
+{
+     RUN_TESTS();
+}